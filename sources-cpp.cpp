@@ -8,13 +8,16 @@
 #include "src\common\RootHandler.cpp"
 #include "src\common\Sockets.cpp"
 #include "src\hashes\md5.cpp"
+#include "src\hashes\md5_mb.cpp"
 #include "src\hashes\sha1.cpp"
+#include "src\jenkins\lookup3_mb.cpp"
 #include "src\overwatch\aes.cpp"
 #include "src\overwatch\apm.cpp"
 #include "src\overwatch\cmf.cpp"
 #include "src\CascDecompress.cpp"
 #include "src\CascDecrypt.cpp"
 #include "src\CascDumpData.cpp"
+#include "src\CascExtractFiles.cpp"
 #include "src\CascFiles.cpp"
 #include "src\CascFindFile.cpp"
 #include "src\CascIndexFiles.cpp"
@@ -28,3 +31,4 @@
 #include "src\CascRootFile_Text.cpp"
 #include "src\CascRootFile_TVFS.cpp"
 #include "src\CascRootFile_WoW.cpp"
+#include "src\CascVerifyStorage.cpp"
@@ -14,11 +14,26 @@
 //-----------------------------------------------------------------------------
 // Compression support
 
-// Include functions from zlib
-#ifndef CASC_USE_SYSTEM_ZLIB
-    #include "zlib/zlib.h"
+// Include functions from zlib. The native API of zlib-ng refuses to be included
+// together with zlib.h, so the build system's choice decides which one is used
+#if defined(CASC_USE_ZLIB_NG)
+    #include <zlib-ng.h>
+    typedef zng_stream CASC_ZSTREAM;
+    #define CascInflateInit     zng_inflateInit
+    #define CascInflate         zng_inflate
+    #define CascInflateReset    zng_inflateReset
+    #define CascInflateEnd      zng_inflateEnd
 #else
-    #include <zlib.h>
+    #ifndef CASC_USE_SYSTEM_ZLIB
+        #include "zlib/zlib.h"
+    #else
+        #include <zlib.h>
+    #endif
+    typedef z_stream CASC_ZSTREAM;
+    #define CascInflateInit     inflateInit
+    #define CascInflate         inflate
+    #define CascInflateReset    inflateReset
+    #define CascInflateEnd      inflateEnd
 #endif
 
 #if defined(_DEBUG) && !defined(CASCLIB_NODEBUG)
@@ -30,6 +45,7 @@
 #include "common/Array.h"
 #include "common/ArraySparse.h"
 #include "common/Map.h"
+#include "common/FrameCache.h"
 #include "common/FileTree.h"
 #include "common/FileStream.h"
 #include "common/Directory.h"
@@ -68,6 +84,11 @@
 // The maximum size of an online file
 #define CASC_MAX_ONLINE_FILE_SIZE   0x40000000
 
+// Support of HTTP ranges on the CDN servers
+#define CASC_CDN_RANGES_UNKNOWN     0           // Not known yet. The first sparse archive checks it
+#define CASC_CDN_RANGES_SUPPORTED   1           // Files in archives are downloaded by ranges
+#define CASC_CDN_RANGES_UNSUPPORTED 2           // The server sends entire archives
+
 //-----------------------------------------------------------------------------
 // In-memory structures
 
@@ -111,7 +132,22 @@ typedef struct _CASC_BUILD_FILE
 // Information about index file
 struct CASC_INDEX
 {
-    CASC_BLOB FileData;
+    CASC_INDEX()
+    {
+        pStream = NULL;
+        pbEKeyEntries = NULL;
+        nEKeyEntries = 0;
+        EntryLength = 0;
+        szFileName = NULL;
+        NewSubIndex = 0;
+        OldSubIndex = 0;
+    }
+
+    TFileStream * pStream;                          // Memory-mapped index file
+    LPBYTE pbEKeyEntries;                           // Sorted array of EKey entries in the mapped file
+    size_t nEKeyEntries;                            // Number of entries in pbEKeyEntries
+    size_t EntryLength;                             // Length of one EKey entry, in bytes
+    CASC_ARRAY EKeyEntries;                         // Sorted pointers to the EKey entries. Only used if the file has no sorted array
     LPTSTR szFileName;                              // Full name of the index file
     DWORD NewSubIndex;                              // New subindex
     DWORD OldSubIndex;                              // Old subindex
@@ -155,6 +191,18 @@ typedef struct _CASC_ARCINDEX_FOOTER
 
 } CASC_ARCINDEX_FOOTER, *PCASC_ARCINDEX_FOOTER;
 
+// Memory-mapped archive index file (md5.index). Pages are only parsed on lookup
+typedef struct _CASC_ARCINDEX
+{
+    TFileStream * pStream;                          // Memory-mapped index file
+    LPBYTE pbPages;                                 // Pointer to the first index page
+    LPBYTE pbLastKeys;                              // Table of contents: last EKey of each page
+    CASC_ARCINDEX_FOOTER Footer;                    // Normalized footer of the index file
+    size_t nPageCount;                              // Number of pages in the index file
+    size_t nArchive;                                // Index of the archive in the ArchivesKey
+
+} CASC_ARCINDEX, *PCASC_ARCINDEX;
+
 // Normalized header of the ENCODING file
 typedef struct _CASC_ENCODING_HEADER
 {
@@ -317,6 +365,8 @@ struct TCascStorage
     DWORD dwBuildNumber;                            // Product build number
     DWORD dwRefCount;                               // Number of references
     DWORD dwFeatures;                               // List of CASC features. See CASC_FEATURE_XXX
+    DWORD dwThreadCount;                            // Number of threads to be used for loading the storage
+    DWORD dwCdnRanges;                              // Support of HTTP ranges on the CDN server. See CASC_CDN_RANGES_XXX
 
     CBLD_TYPE BuildFileType;                        // Type of the build file
 
@@ -330,8 +380,7 @@ struct TCascStorage
     CASC_BLOB BuildFiles;                           // List of supported build files
 
     TFileStream * DataFiles[CASC_MAX_DATA_FILES];   // Array of open data files
-    CASC_INDEX IndexFiles[CASC_INDEX_COUNT];        // Array of found index files
-    CASC_MAP IndexEKeyMap;
+    CASC_INDEX IndexFiles[CASC_INDEX_COUNT];        // Array of found index files, one per bucket
 
     CASC_CKEY_ENTRY EncodingCKey;                   // Information about ENCODING file
     CASC_CKEY_ENTRY DownloadCKey;                   // Information about DOWNLOAD file
@@ -343,10 +392,9 @@ struct TCascStorage
     CASC_ARRAY VfsRootList;                         // List of CASC_EKEY_ENTRY for each TVFS sub-root
 
     TRootHandler * pRootHandler;                    // Common handler for various ROOT file formats
-    CASC_ARRAY IndexArray;                          // Array of CASC_EKEY_ENTRY, loaded from online indexes
+    CASC_ARRAY ArchiveIndexes;                      // Array of CASC_ARCINDEX, mapped online indexes
     CASC_ARRAY CKeyArray;                           // Array of CASC_CKEY_ENTRY, loaded from ENCODING file
     CASC_ARRAY TagsArray;                           // Array of CASC_DOWNLOAD_TAG2
-    CASC_MAP IndexMap;                              // Map of EKey -> IndexArray (for online archives)
     CASC_MAP CKeyMap;                               // Map of CKey -> CKeyArray
     CASC_MAP EKeyMap;                               // Map of EKey -> CKeyArray
     size_t LocalFiles;                              // Number of files that are present locally
@@ -355,6 +403,9 @@ struct TCascStorage
     size_t EKeyLength;                              // EKey length from the index files
     DWORD FileOffsetBits;                           // Number of bits in the storage offset which mean data segent offset
 
+    CASC_FRAME_CACHE FrameCache;                    // Storage-wide cache of decoded file frames
+    TFileStreamIo * pFileIo;                        // Engine for asynchronous reads. Created on the first CascReadFileAsync
+    CASC_WORK_QUEUE * pDecodeQueue;                 // Threads that decode frames loaded by asynchronous reads
     CASC_KEY_MAP KeyMap;                            // Growable map of encryption keys
     ULONGLONG  LastFailKeyName;                     // The value of the encryption key that recently was NOT found.
 };
@@ -368,6 +419,10 @@ struct TCascFile
     void InitFileSpans(PCASC_FILE_SPAN pSpans, DWORD dwSpanCount);
     void InitCacheStrategy();
 
+    // Asynchronous reads keep the file alive until their callback returns
+    TCascFile * AddRef();
+    TCascFile * Release();
+
     static TCascFile * IsValid(HANDLE hFile)
     {
         TCascFile * hf = (TCascFile *)hFile;
@@ -395,11 +450,14 @@ struct TCascFile
     DWORD bCloseFileStream:1;                       // If true, file stream needs to be closed during CascCloseFile
     DWORD bOvercomeEncrypted:1;                     // If true, then CascReadFile will fill the part that is encrypted (and key was not found) with zeros
     DWORD bFreeCKeyEntries:1;                       // If true, dectructor will free the array of CKey entries
+    DWORD bParallelDecode:1;                        // If true, frames of large file spans are decoded by multiple threads
 
     ULONGLONG FileCacheStart;                       // Starting offset of the file cached area
     ULONGLONG FileCacheEnd;                         // Ending offset of the file cached area
     LPBYTE pbFileCache;                             // Pointer to file cached area
+    PCASC_FILE_FRAME pFrameHint;                    // The most recently read frame. Speeds up sequential reads
     CSTRTG CacheStrategy;                           // Caching strategy. See CSTRTG enum for more info
+    DWORD dwRefCount;                               // Number of references. CascCloseFile removes one
 };
 
 struct TCascSearch
@@ -431,7 +489,7 @@ struct TCascSearch
         // Free the rest of the members
         CASC_FREE(szMask);
         CASC_FREE(szListFile);
-        CASC_FREE(pCache);
+        ListFile_Free(pCache);
     }
 
     static TCascSearch * IsValid(HANDLE hFind)
@@ -475,6 +533,7 @@ inline void FreeCascBlob(PCASC_BLOB pBlob)
 bool  InvokeProgressCallback(TCascStorage * hs, LPCSTR szMessage, LPCSTR szObject, DWORD CurrentValue, DWORD TotalValue);
 DWORD GetFileSpanInfo(PCASC_CKEY_ENTRY pCKeyEntry, PULONGLONG PtrContentSize, PULONGLONG PtrEncodedSize = NULL);
 DWORD FetchCascFile(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKey, LPCTSTR szExtension, CASC_PATH<TCHAR> & LocalPath, PCASC_ARCHIVE_INFO pArchiveInfo = NULL);
+DWORD FetchCascFiles(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKeys, size_t nKeyCount, LPCTSTR szExtension, LPCSTR szProgressMsg);
 DWORD CheckCascBuildFileExact(CASC_BUILD_FILE & BuildFile, LPCTSTR szLocalPath);
 DWORD CheckCascBuildFileDirs(CASC_BUILD_FILE & BuildFile, LPCTSTR szLocalPath);
 DWORD CheckOnlineStorage(PCASC_OPEN_STORAGE_ARGS pArgs, CASC_BUILD_FILE & BuildFile, bool bOnlineStorage);
@@ -486,6 +545,8 @@ DWORD LoadCdnBuildFile(TCascStorage * hs);
 
 DWORD LoadInternalFileToMemory(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, CASC_BLOB & FileData);
 DWORD LoadFileToMemory(LPCTSTR szFileName, CASC_BLOB & FileData);
+TFileStream * CreateLocalFile(LPCTSTR szLocalName);
+DWORD SaveLocalFile(LPCTSTR szLocalName, LPBYTE pbFileData, size_t cbFileData);
 bool OpenFileByCKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, DWORD dwOpenFlags, HANDLE * PtrFileHandle);
 bool SetCacheStrategy(HANDLE hFile, CSTRTG CacheStrategy);
 
@@ -505,13 +566,24 @@ DWORD CascDirectCopy(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer,
 DWORD CascLoadEncryptionKeys(TCascStorage * hs);
 DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex);
 
+// Implementations of Salsa20 for CascDecryptSalsa20
+#define CASC_SALSA20_AUTO           0           // The fastest one supported by the CPU
+#define CASC_SALSA20_SCALAR         1           // One block at a time
+#define CASC_SALSA20_SIMD4          2           // Four blocks at once (SSE2 or NEON)
+#define CASC_SALSA20_SIMD8          3           // Eight blocks at once (AVX2)
+
+DWORD CascDecryptSalsa20(LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer, LPBYTE pbKey, DWORD cbKeySize, LPBYTE pbVector, DWORD dwImpl);
+
 //-----------------------------------------------------------------------------
 // Support for index files
 
+bool FindArchiveIndexEntry(TCascStorage * hs, LPBYTE pbEKey, CASC_EKEY_ENTRY & EKeyEntry);
 bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry);
 
 DWORD LoadIndexFiles(TCascStorage * hs);
+DWORD HashLocalIndexFiles(TCascStorage * hs, MD5_CTX & md5_ctx);
 void  FreeIndexFiles(TCascStorage * hs);
+void  FreeArchiveIndexFiles(TCascStorage * hs);
 
 //-----------------------------------------------------------------------------
 // Support for ROOT file
@@ -6,6 +6,7 @@
 /*   Date    Ver   Who  Comment                                              */
 /* --------  ----  ---  -------                                              */
 /* 02.05.14  1.00  Lad  The first version of CascDecompress.cpp              */
+/* 16.10.24  1.01  ---  Per-thread inflate state, libdeflate and zlib-ng     */
 /*****************************************************************************/
 
 #define __CASCLIB_SELF__
@@ -13,44 +14,188 @@
 #include "CascCommon.h"
 
 //-----------------------------------------------------------------------------
-// Public functions
+// Inflate backend. The build system defines CASC_USE_LIBDEFLATE or CASC_USE_ZLIB_NG
+// if the library is available. Otherwise, zlib is used. The zlib or zlib-ng stream
+// (CASC_ZSTREAM) and its functions are defined in CascCommon.h
 
-DWORD CascDecompress(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer)
+#ifdef CASC_USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// Decompression state of one thread. Created on the first decompression
+// and reused for all following ones, so no memory is allocated per frame
+struct CASC_INFLATE_STATE
+{
+#ifdef CASC_USE_LIBDEFLATE
+    struct libdeflate_decompressor * pDecompressor; // One-shot decompressor
+#endif
+    CASC_ZSTREAM z;                                 // Stream information for zlib
+    bool bStreamReady;                              // If true, the stream has been initialized
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void WINAPI FreeInflateState(void * pvState)
+{
+    CASC_INFLATE_STATE * pState = (CASC_INFLATE_STATE *)pvState;
+
+    if(pState != NULL)
+    {
+#ifdef CASC_USE_LIBDEFLATE
+        if(pState->pDecompressor != NULL)
+            libdeflate_free_decompressor(pState->pDecompressor);
+#endif
+        if(pState->bStreamReady)
+            CascInflateEnd(&pState->z);
+        CASC_FREE(pState);
+    }
+}
+
+static CASC_INFLATE_STATE * CreateInflateState()
+{
+    CASC_INFLATE_STATE * pState;
+
+    if((pState = CASC_ALLOC_ZERO<CASC_INFLATE_STATE>(1)) != NULL)
+    {
+#ifdef CASC_USE_LIBDEFLATE
+        pState->pDecompressor = libdeflate_alloc_decompressor();
+#endif
+        pState->bStreamReady = false;
+    }
+    return pState;
+}
+
+// The state is freed when the thread exits
+#ifdef CASCLIB_PLATFORM_WINDOWS
+
+static INIT_ONCE InflateStateOnce = INIT_ONCE_STATIC_INIT;
+static DWORD InflateStateIndex = FLS_OUT_OF_INDEXES;
+
+static BOOL CALLBACK CreateInflateStateIndex(PINIT_ONCE /* pInitOnce */, PVOID /* pvParam */, PVOID * /* ppvContext */)
+{
+    InflateStateIndex = FlsAlloc(FreeInflateState);
+    return TRUE;
+}
+
+static CASC_INFLATE_STATE * GetInflateState()
+{
+    CASC_INFLATE_STATE * pState = NULL;
+
+    InitOnceExecuteOnce(&InflateStateOnce, CreateInflateStateIndex, NULL, NULL);
+    if(InflateStateIndex != FLS_OUT_OF_INDEXES)
+    {
+        if((pState = (CASC_INFLATE_STATE *)FlsGetValue(InflateStateIndex)) == NULL)
+        {
+            if((pState = CreateInflateState()) != NULL)
+                FlsSetValue(InflateStateIndex, pState);
+        }
+    }
+    return pState;
+}
+
+#else
+
+static pthread_once_t InflateStateOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t InflateStateKey;
+static bool bInflateStateKey = false;
+
+static void CreateInflateStateKey()
+{
+    bInflateStateKey = (pthread_key_create(&InflateStateKey, FreeInflateState) == 0);
+}
+
+static CASC_INFLATE_STATE * GetInflateState()
 {
-    z_stream z;                        // Stream information for zlib
+    CASC_INFLATE_STATE * pState = NULL;
+
+    pthread_once(&InflateStateOnce, CreateInflateStateKey);
+    if(bInflateStateKey)
+    {
+        if((pState = (CASC_INFLATE_STATE *)pthread_getspecific(InflateStateKey)) == NULL)
+        {
+            if((pState = CreateInflateState()) != NULL)
+                pthread_setspecific(InflateStateKey, pState);
+        }
+    }
+    return pState;
+}
+
+#endif
+
+// Decompresses the data by zlib. If there is no per-thread state,
+// the stream is initialized and freed for this call only
+static DWORD DecompressZlib(CASC_INFLATE_STATE * pState, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer)
+{
+    CASC_ZSTREAM LocalStream;
+    CASC_ZSTREAM * pz = (pState != NULL) ? &pState->z : &LocalStream;
     DWORD dwErrCode = ERROR_FILE_CORRUPT;
-    uInt cbOutBuffer = *pcbOutBuffer;
+    DWORD cbOutBuffer = 0;
     int nResult;
 
-    // Fill the stream structure for zlib
-    z.next_in   = pbInBuffer;
-    z.avail_in  = cbInBuffer;
-    z.total_in  = cbInBuffer;
-    z.next_out  = pbOutBuffer;
-    z.avail_out = cbOutBuffer;
-    z.total_out = 0;
-    z.zalloc    = NULL;
-    z.zfree     = NULL;
-
-    // Reset the total number of output bytes
-    cbOutBuffer = 0;
+    // Initialize the stream, or reset the one from previous decompression
+    if(pState == NULL || pState->bStreamReady == false)
+    {
+        memset(pz, 0, sizeof(CASC_ZSTREAM));
+        nResult = CascInflateInit(pz);
+        if(pState != NULL)
+            pState->bStreamReady = (nResult == Z_OK);
+    }
+    else
+    {
+        nResult = CascInflateReset(pz);
+    }
 
-    // Initialize the decompression structure
-    if((nResult = inflateInit(&z)) == Z_OK)
+    if(nResult == Z_OK)
     {
+        // Fill the stream structure for zlib
+        pz->next_in   = pbInBuffer;
+        pz->avail_in  = cbInBuffer;
+        pz->next_out  = pbOutBuffer;
+        pz->avail_out = pcbOutBuffer[0];
+
         // Call zlib to decompress the data
-        nResult = inflate(&z, Z_NO_FLUSH);
+        nResult = CascInflate(pz, Z_NO_FLUSH);
         if(nResult == Z_OK || nResult == Z_STREAM_END)
         {
             // Give the size of the uncompressed data
-            cbOutBuffer = z.total_out;
+            cbOutBuffer = (DWORD)pz->total_out;
             dwErrCode = ERROR_SUCCESS;
         }
 
-        inflateEnd(&z);
+        if(pState == NULL)
+            CascInflateEnd(pz);
     }
 
     // Give the caller the number of bytes needed
     pcbOutBuffer[0] = cbOutBuffer;
     return dwErrCode;
 }
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+DWORD CascDecompress(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer)
+{
+    CASC_INFLATE_STATE * pState = GetInflateState();
+
+#ifdef CASC_USE_LIBDEFLATE
+    // We know the decompressed size, so the one-shot decompression can be used.
+    // If it fails, we let zlib decompress as much as it can (e.g. truncated data)
+    if(pState != NULL && pState->pDecompressor != NULL)
+    {
+        size_t cbDecompressed = 0;
+
+        if(libdeflate_zlib_decompress_ex(pState->pDecompressor, pbInBuffer, cbInBuffer, pbOutBuffer, pcbOutBuffer[0], NULL, &cbDecompressed) == LIBDEFLATE_SUCCESS)
+        {
+            pcbOutBuffer[0] = (DWORD)cbDecompressed;
+            return ERROR_SUCCESS;
+        }
+    }
+#endif
+
+    return DecompressZlib(pState, pbOutBuffer, pcbOutBuffer, pbInBuffer, cbInBuffer);
+}
@@ -6,12 +6,30 @@
 /*   Date    Ver   Who  Comment                                              */
 /* --------  ----  ---  -------                                              */
 /* 31.10.15  1.00  Lad  The first version of CascDecrypt.cpp                 */
+/* 16.10.24  1.01  ---  Salsa20 with SSE2, AVX2 and NEON                     */
 /*****************************************************************************/
 
 #define __CASCLIB_SELF__
 #include "CascLib.h"
 #include "CascCommon.h"
 
+//-----------------------------------------------------------------------------
+// SIMD support for Salsa20. SSE2 and NEON are used if the compiler targets them,
+// AVX2 is compiled for x64 and used if the CPU supports it
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CASC_SALSA20_SSE2
+#elif (defined(__aarch64__) && defined(__ARM_NEON)) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CASC_SALSA20_NEON
+#endif
+
+#ifdef CASC_CAN_USE_AVX2
+#include <immintrin.h>
+#define CASC_SALSA20_AVX2
+#endif
+
 //-----------------------------------------------------------------------------
 // Local structures
 
@@ -643,12 +661,269 @@ static int Decrypt(PCASC_SALSA20 pState, LPBYTE pbOutBuffer, LPBYTE pbInBuffer,
     return ERROR_SUCCESS;
 }
 
-static int Decrypt_Salsa20(LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer, LPBYTE pbKey, DWORD cbKeySize, LPBYTE pbVector)
+//-----------------------------------------------------------------------------
+// Salsa20 with SIMD. Multiple blocks of the key stream are computed at once;
+// the vector X[i] holds the word i of all blocks, lane n belongs to block n.
+// Each function decrypts whole groups of blocks and returns the number of bytes
+// it has done; the rest of the data is decrypted by Decrypt()
+
+// One double round, in the same order as in Decrypt()
+#define SALSA20_QUARTER(ADD, XOR, ROL, X, a, b, c, d)   \
+    X[b] = XOR(X[b], ROL(ADD(X[a], X[d]), 0x07));       \
+    X[c] = XOR(X[c], ROL(ADD(X[b], X[a]), 0x09));       \
+    X[d] = XOR(X[d], ROL(ADD(X[c], X[b]), 0x0D));       \
+    X[a] = XOR(X[a], ROL(ADD(X[d], X[c]), 0x12))
+
+#define SALSA20_DOUBLE_ROUND(ADD, XOR, ROL, X)                      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x00, 0x04, 0x08, 0x0C);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x05, 0x09, 0x0D, 0x01);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x0A, 0x0E, 0x02, 0x06);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x0F, 0x03, 0x07, 0x0B);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x00, 0x01, 0x02, 0x03);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x05, 0x06, 0x07, 0x04);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x0A, 0x0B, 0x08, 0x09);      \
+    SALSA20_QUARTER(ADD, XOR, ROL, X, 0x0F, 0x0C, 0x0D, 0x0E)
+
+// Gives the block counters (Key[8] and Key[9]) of the next blocks
+static void GetBlockCounters(PCASC_SALSA20 pState, DWORD * CounterLo, DWORD * CounterHi, DWORD dwBlocks)
 {
-    CASC_SALSA20 SalsaState;
+    ULONGLONG Counter = MAKE_OFFSET64(pState->Key[9], pState->Key[8]);
 
-    Initialize(&SalsaState, pbKey, cbKeySize, pbVector);
-    return Decrypt(&SalsaState, pbOutBuffer, pbInBuffer, cbInBuffer);
+    for(DWORD i = 0; i < dwBlocks; i++, Counter++)
+    {
+        CounterLo[i] = (DWORD)(Counter);
+        CounterHi[i] = (DWORD)(Counter >> 32);
+    }
+}
+
+static void AddBlockCounter(PCASC_SALSA20 pState, DWORD dwBlocks)
+{
+    ULONGLONG Counter = MAKE_OFFSET64(pState->Key[9], pState->Key[8]) + dwBlocks;
+
+    pState->Key[8] = (DWORD)(Counter);
+    pState->Key[9] = (DWORD)(Counter >> 32);
+}
+
+#if defined(CASC_SALSA20_SSE2) || defined(CASC_SALSA20_AVX2)
+
+#define SSE2_ROL(v, n)  _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define AVX2_ROL(v, n)  _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+// XORs 16 bytes of the data with 16 bytes of the key stream
+#define SSE2_XOR_16(pbOutBuffer, pbInBuffer, v) \
+    _mm_storeu_si128((__m128i *)(pbOutBuffer), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pbInBuffer)), v))
+
+// Transposes 4x4 words: On input, V0-V3 hold the words 0-3 of four blocks,
+// on output, they hold the words 0-3 of block 0, 1, 2 and 3. With AVX2, this is done in each 128-bit lane
+#define SIMD_TRANSPOSE_4X4(UNPACKLO32, UNPACKHI32, UNPACKLO64, UNPACKHI64, T, V0, V1, V2, V3) \
+    T[0] = UNPACKLO32(V0, V1);      \
+    T[1] = UNPACKLO32(V2, V3);      \
+    T[2] = UNPACKHI32(V0, V1);      \
+    T[3] = UNPACKHI32(V2, V3);      \
+    V0 = UNPACKLO64(T[0], T[1]);    \
+    V1 = UNPACKHI64(T[0], T[1]);    \
+    V2 = UNPACKLO64(T[2], T[3]);    \
+    V3 = UNPACKHI64(T[2], T[3])
+
+#endif
+
+#ifdef CASC_SALSA20_SSE2
+static size_t Decrypt_SSE2(PCASC_SALSA20 pState, LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer)
+{
+    __m128i Input[0x10];
+    __m128i X[0x10];
+    __m128i T[4];
+    DWORD CounterLo[4];
+    DWORD CounterHi[4];
+    size_t cbDecrypted = 0;
+    DWORD i;
+
+    // Each word of the key, repeated for all four blocks
+    for(i = 0; i < 0x10; i++)
+        Input[i] = _mm_set1_epi32((int)pState->Key[i]);
+
+    while((cbInBuffer - cbDecrypted) >= (4 * 0x40))
+    {
+        // Set the block counters
+        GetBlockCounters(pState, CounterLo, CounterHi, 4);
+        Input[0x08] = _mm_loadu_si128((const __m128i *)CounterLo);
+        Input[0x09] = _mm_loadu_si128((const __m128i *)CounterHi);
+        AddBlockCounter(pState, 4);
+
+        // Shuffle the key
+        memcpy(X, Input, sizeof(X));
+        for(i = 0; i < pState->dwRounds; i += 2)
+        {
+            SALSA20_DOUBLE_ROUND(_mm_add_epi32, _mm_xor_si128, SSE2_ROL, X);
+        }
+
+        // Decrypt four words of each block at once
+        for(i = 0; i < 0x10; i += 4)
+        {
+            X[i + 0] = _mm_add_epi32(X[i + 0], Input[i + 0]);
+            X[i + 1] = _mm_add_epi32(X[i + 1], Input[i + 1]);
+            X[i + 2] = _mm_add_epi32(X[i + 2], Input[i + 2]);
+            X[i + 3] = _mm_add_epi32(X[i + 3], Input[i + 3]);
+            SIMD_TRANSPOSE_4X4(_mm_unpacklo_epi32, _mm_unpackhi_epi32, _mm_unpacklo_epi64, _mm_unpackhi_epi64, T, X[i + 0], X[i + 1], X[i + 2], X[i + 3]);
+
+            SSE2_XOR_16(pbOutBuffer + 0x00 + i * 4, pbInBuffer + 0x00 + i * 4, X[i + 0]);
+            SSE2_XOR_16(pbOutBuffer + 0x40 + i * 4, pbInBuffer + 0x40 + i * 4, X[i + 1]);
+            SSE2_XOR_16(pbOutBuffer + 0x80 + i * 4, pbInBuffer + 0x80 + i * 4, X[i + 2]);
+            SSE2_XOR_16(pbOutBuffer + 0xC0 + i * 4, pbInBuffer + 0xC0 + i * 4, X[i + 3]);
+        }
+
+        // Adjust buffers
+        pbOutBuffer += (4 * 0x40);
+        pbInBuffer += (4 * 0x40);
+        cbDecrypted += (4 * 0x40);
+    }
+
+    return cbDecrypted;
+}
+#endif  // CASC_SALSA20_SSE2
+
+#ifdef CASC_SALSA20_AVX2
+CASC_TARGET_AVX2
+static size_t Decrypt_AVX2(PCASC_SALSA20 pState, LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer)
+{
+    __m256i Input[0x10];
+    __m256i X[0x10];
+    __m256i T[4];
+    DWORD CounterLo[8];
+    DWORD CounterHi[8];
+    size_t cbDecrypted = 0;
+    DWORD i;
+
+    // Each word of the key, repeated for all eight blocks
+    for(i = 0; i < 0x10; i++)
+        Input[i] = _mm256_set1_epi32((int)pState->Key[i]);
+
+    while((cbInBuffer - cbDecrypted) >= (8 * 0x40))
+    {
+        // Set the block counters
+        GetBlockCounters(pState, CounterLo, CounterHi, 8);
+        Input[0x08] = _mm256_loadu_si256((const __m256i *)CounterLo);
+        Input[0x09] = _mm256_loadu_si256((const __m256i *)CounterHi);
+        AddBlockCounter(pState, 8);
+
+        // Shuffle the key
+        memcpy(X, Input, sizeof(X));
+        for(i = 0; i < pState->dwRounds; i += 2)
+        {
+            SALSA20_DOUBLE_ROUND(_mm256_add_epi32, _mm256_xor_si256, AVX2_ROL, X);
+        }
+
+        // Decrypt four words of each block at once. After the transposition,
+        // the lower half of X[i + n] belongs to block n, the upper one to block n + 4
+        for(i = 0; i < 0x10; i += 4)
+        {
+            X[i + 0] = _mm256_add_epi32(X[i + 0], Input[i + 0]);
+            X[i + 1] = _mm256_add_epi32(X[i + 1], Input[i + 1]);
+            X[i + 2] = _mm256_add_epi32(X[i + 2], Input[i + 2]);
+            X[i + 3] = _mm256_add_epi32(X[i + 3], Input[i + 3]);
+            SIMD_TRANSPOSE_4X4(_mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64, T, X[i + 0], X[i + 1], X[i + 2], X[i + 3]);
+
+            for(DWORD j = 0; j < 4; j++)
+            {
+                SSE2_XOR_16(pbOutBuffer + (j + 0) * 0x40 + i * 4, pbInBuffer + (j + 0) * 0x40 + i * 4, _mm256_castsi256_si128(X[i + j]));
+                SSE2_XOR_16(pbOutBuffer + (j + 4) * 0x40 + i * 4, pbInBuffer + (j + 4) * 0x40 + i * 4, _mm256_extracti128_si256(X[i + j], 1));
+            }
+        }
+
+        // Adjust buffers
+        pbOutBuffer += (8 * 0x40);
+        pbInBuffer += (8 * 0x40);
+        cbDecrypted += (8 * 0x40);
+    }
+
+    return cbDecrypted;
+}
+#endif  // CASC_SALSA20_AVX2
+
+#ifdef CASC_SALSA20_NEON
+
+#define NEON_ROL(v, n)  vsriq_n_u32(vshlq_n_u32(v, n), v, 32 - (n))
+#define NEON_ZIP1_64(a, b)  vreinterpretq_u32_u64(vzip1q_u64(vreinterpretq_u64_u32(a), vreinterpretq_u64_u32(b)))
+#define NEON_ZIP2_64(a, b)  vreinterpretq_u32_u64(vzip2q_u64(vreinterpretq_u64_u32(a), vreinterpretq_u64_u32(b)))
+
+// XORs 16 bytes of the data with 16 bytes of the key stream
+#define NEON_XOR_16(pbOutBuffer, pbInBuffer, v) \
+    vst1q_u8(pbOutBuffer, veorq_u8(vld1q_u8(pbInBuffer), vreinterpretq_u8_u32(v)))
+
+static size_t Decrypt_NEON(PCASC_SALSA20 pState, LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer)
+{
+    uint32x4_t Input[0x10];
+    uint32x4_t X[0x10];
+    uint32x4_t T[4];
+    DWORD CounterLo[4];
+    DWORD CounterHi[4];
+    size_t cbDecrypted = 0;
+    DWORD i;
+
+    // Each word of the key, repeated for all four blocks
+    for(i = 0; i < 0x10; i++)
+        Input[i] = vdupq_n_u32(pState->Key[i]);
+
+    while((cbInBuffer - cbDecrypted) >= (4 * 0x40))
+    {
+        // Set the block counters
+        GetBlockCounters(pState, CounterLo, CounterHi, 4);
+        Input[0x08] = vld1q_u32(CounterLo);
+        Input[0x09] = vld1q_u32(CounterHi);
+        AddBlockCounter(pState, 4);
+
+        // Shuffle the key
+        memcpy(X, Input, sizeof(X));
+        for(i = 0; i < pState->dwRounds; i += 2)
+        {
+            SALSA20_DOUBLE_ROUND(vaddq_u32, veorq_u32, NEON_ROL, X);
+        }
+
+        // Decrypt four words of each block at once
+        for(i = 0; i < 0x10; i += 4)
+        {
+            X[i + 0] = vaddq_u32(X[i + 0], Input[i + 0]);
+            X[i + 1] = vaddq_u32(X[i + 1], Input[i + 1]);
+            X[i + 2] = vaddq_u32(X[i + 2], Input[i + 2]);
+            X[i + 3] = vaddq_u32(X[i + 3], Input[i + 3]);
+            SIMD_TRANSPOSE_4X4(vzip1q_u32, vzip2q_u32, NEON_ZIP1_64, NEON_ZIP2_64, T, X[i + 0], X[i + 1], X[i + 2], X[i + 3]);
+
+            NEON_XOR_16(pbOutBuffer + 0x00 + i * 4, pbInBuffer + 0x00 + i * 4, X[i + 0]);
+            NEON_XOR_16(pbOutBuffer + 0x40 + i * 4, pbInBuffer + 0x40 + i * 4, X[i + 1]);
+            NEON_XOR_16(pbOutBuffer + 0x80 + i * 4, pbInBuffer + 0x80 + i * 4, X[i + 2]);
+            NEON_XOR_16(pbOutBuffer + 0xC0 + i * 4, pbInBuffer + 0xC0 + i * 4, X[i + 3]);
+        }
+
+        // Adjust buffers
+        pbOutBuffer += (4 * 0x40);
+        pbInBuffer += (4 * 0x40);
+        cbDecrypted += (4 * 0x40);
+    }
+
+    return cbDecrypted;
+}
+#endif  // CASC_SALSA20_NEON
+
+// Returns the fastest Salsa20 implementation for this CPU
+static DWORD GetSalsa20Impl()
+{
+    static DWORD dwSalsa20Impl = CASC_SALSA20_AUTO;
+
+    // Benign race: all threads detect the same value
+    if(dwSalsa20Impl == CASC_SALSA20_AUTO)
+    {
+        DWORD dwImpl = CASC_SALSA20_SCALAR;
+
+#if defined(CASC_SALSA20_SSE2) || defined(CASC_SALSA20_NEON)
+        dwImpl = CASC_SALSA20_SIMD4;
+#endif
+#ifdef CASC_SALSA20_AVX2
+        if(CascGetCpuFeatures() & CASC_CPU_AVX2)
+            dwImpl = CASC_SALSA20_SIMD8;
+#endif
+        dwSalsa20Impl = dwImpl;
+    }
+    return dwSalsa20Impl;
 }
 
 //-----------------------------------------------------------------------------
@@ -943,6 +1218,36 @@ DWORD CascDirectCopy(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer,
     return ERROR_SUCCESS;
 }
 
+DWORD CascDecryptSalsa20(LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuffer, LPBYTE pbKey, DWORD cbKeySize, LPBYTE pbVector, DWORD dwImpl)
+{
+    CASC_SALSA20 SalsaState;
+    size_t cbDecrypted = 0;
+
+    // Check whether the wanted implementation is available
+    if(dwImpl == CASC_SALSA20_AUTO)
+        dwImpl = GetSalsa20Impl();
+    if(dwImpl > GetSalsa20Impl())
+        return ERROR_NOT_SUPPORTED;
+    Initialize(&SalsaState, pbKey, cbKeySize, pbVector);
+
+    // Decrypt as many blocks as possible with SIMD
+#ifdef CASC_SALSA20_AVX2
+    if(dwImpl >= CASC_SALSA20_SIMD8)
+        cbDecrypted += Decrypt_AVX2(&SalsaState, pbOutBuffer + cbDecrypted, pbInBuffer + cbDecrypted, cbInBuffer - cbDecrypted);
+#endif
+#ifdef CASC_SALSA20_SSE2
+    if(dwImpl >= CASC_SALSA20_SIMD4)
+        cbDecrypted += Decrypt_SSE2(&SalsaState, pbOutBuffer + cbDecrypted, pbInBuffer + cbDecrypted, cbInBuffer - cbDecrypted);
+#endif
+#ifdef CASC_SALSA20_NEON
+    if(dwImpl >= CASC_SALSA20_SIMD4)
+        cbDecrypted += Decrypt_NEON(&SalsaState, pbOutBuffer + cbDecrypted, pbInBuffer + cbDecrypted, cbInBuffer - cbDecrypted);
+#endif
+
+    // Decrypt the rest of the data, or all data with the scalar implementation
+    return Decrypt(&SalsaState, pbOutBuffer + cbDecrypted, pbInBuffer + cbDecrypted, cbInBuffer - cbDecrypted);
+}
+
 DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex)
 {
     ULONGLONG KeyName = 0;
@@ -1014,7 +1319,7 @@ DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LP
     switch(EncryptionType)
     {
         case 'S':   // Salsa20
-            dwErrCode = Decrypt_Salsa20(pbOutBuffer, pbInBuffer, (pbBufferEnd - pbInBuffer), pbKey, 0x10, Vector);
+            dwErrCode = CascDecryptSalsa20(pbOutBuffer, pbInBuffer, (pbBufferEnd - pbInBuffer), pbKey, 0x10, Vector, CASC_SALSA20_AUTO);
             if(dwErrCode != ERROR_SUCCESS)
                 return dwErrCode;
 
@@ -0,0 +1,575 @@
+/*****************************************************************************/
+/* CascExtractFiles.cpp              Copyright (c) CascLib contributors 2024 */
+/*---------------------------------------------------------------------------*/
+/* Extracting many files from the storage by multiple threads                */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.24  1.00  ---  The first version of CascExtractFiles.cpp            */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+// Maximum number of extraction threads
+#define CASC_EXTRACT_MAX_THREADS    64
+
+// The files are read and written in pieces of this size, so a worker never holds an entire file
+#define CASC_EXTRACT_CHUNK_SIZE     0x1000000
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// One file to be extracted
+struct CASC_EXTRACT_ENTRY
+{
+    const CASC_FIND_DATA * pFindData;               // The file, as given by the caller or found by the search
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the file. NULL if not found
+    ULONGLONG StorageOffset;                        // Position of the file in the local data files
+    DWORD ArchiveIndex;                             // Index of the data file ("data.###"). CASC_INVALID_INDEX if not local
+    size_t nIndex;                                  // Index of the file in the caller's list
+};
+
+// Each worker extracts a contiguous range of entries. When the range is exhausted,
+// the worker steals the second half of the largest range of another worker
+struct CASC_EXTRACT_WORKER
+{
+    struct CASC_EXTRACT * pExtract;                 // The extraction this worker belongs to
+    CASC_THREAD Thread;                             // The worker thread. Not used by the worker 0 (the calling thread)
+    CASC_LOCK Lock;                                 // Protects nNextEntry and nEndEntry
+    size_t nNextEntry;                              // Next entry to be extracted
+    size_t nEndEntry;                               // End of the worker's range
+    CASC_BLOB FileData;                             // Buffer for one piece of file data, reused for all files of the worker
+    ULONGLONG BytesExtracted;                       // Statistics of the worker
+    size_t FilesExtracted;
+    size_t FilesFailed;
+    DWORD dwStealCount;
+};
+
+struct CASC_EXTRACT
+{
+    TCascStorage * hs;                              // The storage
+    PCASC_EXTRACT_ARGS pArgs;                       // Arguments passed by the caller
+    CASC_EXTRACT_ENTRY * pEntries;                  // Files to be extracted, sorted by their position in the storage
+    CASC_EXTRACT_WORKER * pWorkers;                 // Array of workers
+    size_t nEntries;                                // Number of files to be extracted
+    DWORD dwWorkers;                                // Number of workers
+    DWORD dwCancelled;                              // Nonzero if the caller cancelled the extraction
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Local files go first, sorted by their position in the data files.
+// The other files follow in the order given by the caller
+static int CompareExtractEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    const CASC_EXTRACT_ENTRY * pEntry1 = (const CASC_EXTRACT_ENTRY *)pvEntry1;
+    const CASC_EXTRACT_ENTRY * pEntry2 = (const CASC_EXTRACT_ENTRY *)pvEntry2;
+
+    if(pEntry1->ArchiveIndex != pEntry2->ArchiveIndex)
+        return (pEntry1->ArchiveIndex < pEntry2->ArchiveIndex) ? -1 : 1;
+    if(pEntry1->StorageOffset != pEntry2->StorageOffset)
+        return (pEntry1->StorageOffset < pEntry2->StorageOffset) ? -1 : 1;
+    return (pEntry1->nIndex < pEntry2->nIndex) ? -1 : (pEntry1->nIndex > pEntry2->nIndex) ? 1 : 0;
+}
+
+// Moves the split point forward to the start of the next data file, if there is one
+// in the range. This way, each data file is mostly read by one thread
+static size_t SnapToDataFile(CASC_EXTRACT * pExtract, size_t nSplit, size_t nEndEntry)
+{
+    CASC_EXTRACT_ENTRY * pEntries = pExtract->pEntries;
+
+    for(size_t i = nSplit; i < nEndEntry; i++)
+    {
+        if(i == 0 || pEntries[i].ArchiveIndex != pEntries[i - 1].ArchiveIndex)
+            return i;
+    }
+    return nSplit;
+}
+
+// Collects the list of the files. Either the caller gave us the list, or we search the storage
+static DWORD CollectFiles(TCascStorage * hs, PCASC_EXTRACT_ARGS pArgs, CASC_ARRAY & FoundFiles, const CASC_FIND_DATA ** ppFindData, size_t * pnFindDataCount)
+{
+    PCASC_FIND_DATA pFindData;
+    HANDLE hFind;
+    DWORD dwErrCode;
+
+    // Did the caller give us the list?
+    if(pArgs->pFindData != NULL)
+    {
+        ppFindData[0] = pArgs->pFindData;
+        pnFindDataCount[0] = pArgs->nFindDataCount;
+        return ERROR_SUCCESS;
+    }
+
+    // Search the storage
+    if((dwErrCode = FoundFiles.Create<CASC_FIND_DATA>(0x1000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((pFindData = (PCASC_FIND_DATA)FoundFiles.Insert(1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    hFind = CascFindFirstFile((HANDLE)hs, (pArgs->szMask != NULL) ? pArgs->szMask : "*", pFindData, pArgs->szListFile);
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        while((pFindData = (PCASC_FIND_DATA)FoundFiles.Insert(1)) != NULL)
+        {
+            if(!CascFindNextFile(hFind, pFindData))
+                break;
+        }
+        CascFindClose(hFind);
+
+        // The last item is the one that was not found
+        if(pFindData == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        ppFindData[0] = (const CASC_FIND_DATA *)FoundFiles.ItemArray();
+        pnFindDataCount[0] = FoundFiles.ItemCount() - 1;
+        return ERROR_SUCCESS;
+    }
+
+    // No files found is not an error
+    if((dwErrCode = GetCascError()) == ERROR_NO_MORE_FILES || dwErrCode == ERROR_FILE_NOT_FOUND)
+        dwErrCode = ERROR_SUCCESS;
+    ppFindData[0] = NULL;
+    pnFindDataCount[0] = 0;
+    return dwErrCode;
+}
+
+// Finds the CKey entry of a found file the same way CascOpenFile does with its name.
+// The entries of a multi-span TVFS file are only contiguous in the root handler,
+// so the entry must not be taken from the ENCODING table if the root handler has it
+static PCASC_CKEY_ENTRY FindExtractCKeyEntry(TCascStorage * hs, const CASC_FIND_DATA & FindData)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry = NULL;
+
+    switch(FindData.NameType)
+    {
+        case CascNameFull:
+            pCKeyEntry = hs->pRootHandler->GetFile(hs, FindData.szFileName);
+            break;
+
+        case CascNameDataId:
+            pCKeyEntry = hs->pRootHandler->GetFile(hs, FindData.dwFileDataId);
+            break;
+
+        case CascNameCKey:
+            pCKeyEntry = FindCKeyEntry_CKey(hs, (LPBYTE)FindData.CKey);
+            break;
+
+        default:
+            break;
+    }
+
+    // Files without a name are looked up by EKey
+    if(pCKeyEntry == NULL)
+        pCKeyEntry = FindCKeyEntry_EKey(hs, (LPBYTE)FindData.EKey);
+    return pCKeyEntry;
+}
+
+// Creates the array of entries, sorted by the position of the files in the storage
+static DWORD CreateExtractEntries(CASC_EXTRACT * pExtract, const CASC_FIND_DATA * pFindData, size_t nFindDataCount, size_t & FilesSkipped)
+{
+    TCascStorage * hs = pExtract->hs;
+    CASC_EXTRACT_ENTRY * pEntry;
+    bool bOnlineStorage = (hs->dwFeatures & CASC_FEATURE_ONLINE) ? true : false;
+
+    // Allocate the array of entries
+    if((pExtract->pEntries = CASC_ALLOC<CASC_EXTRACT_ENTRY>(CASCLIB_MAX(nFindDataCount, 1))) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pEntry = pExtract->pEntries;
+
+    // Files that are not present locally can only be extracted from an online storage
+    for(size_t i = 0; i < nFindDataCount; i++)
+    {
+        if(pFindData[i].bFileAvailable == 0 && bOnlineStorage == false)
+        {
+            FilesSkipped++;
+            continue;
+        }
+
+        pEntry->pFindData = pFindData + i;
+        pEntry->pCKeyEntry = FindExtractCKeyEntry(hs, pFindData[i]);
+        pEntry->StorageOffset = 0;
+        pEntry->ArchiveIndex = CASC_INVALID_INDEX;
+        pEntry->nIndex = i;
+
+        if(pEntry->pCKeyEntry != NULL && (pEntry->pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL))
+        {
+            pEntry->StorageOffset = pEntry->pCKeyEntry->StorageOffset;
+            pEntry->ArchiveIndex = (DWORD)(pEntry->StorageOffset >> hs->FileOffsetBits);
+        }
+        pEntry++;
+    }
+
+    // Sort the entries by their position in the storage
+    pExtract->nEntries = (pEntry - pExtract->pEntries);
+    qsort(pExtract->pEntries, pExtract->nEntries, sizeof(CASC_EXTRACT_ENTRY), CompareExtractEntries);
+    return ERROR_SUCCESS;
+}
+
+// Splits the entries to contiguous ranges of about the same size, one per worker
+static void AssignWorkerRanges(CASC_EXTRACT * pExtract)
+{
+    size_t nStartEntry = 0;
+    size_t nEndEntry;
+
+    for(DWORD i = 0; i < pExtract->dwWorkers; i++)
+    {
+        CASC_EXTRACT_WORKER & Worker = pExtract->pWorkers[i];
+
+        // The last worker takes the rest
+        nEndEntry = pExtract->nEntries;
+        if((i + 1) < pExtract->dwWorkers)
+        {
+            nEndEntry = CASCLIB_MAX(nStartEntry, (pExtract->nEntries * (i + 1)) / pExtract->dwWorkers);
+            nEndEntry = SnapToDataFile(pExtract, nEndEntry, pExtract->nEntries);
+        }
+
+        Worker.nNextEntry = nStartEntry;
+        Worker.nEndEntry = nEndEntry;
+        nStartEntry = nEndEntry;
+    }
+}
+
+// Takes the second half of the largest remaining range of another worker.
+// We never hold our own lock while holding the victim's lock
+static bool StealExtractEntries(CASC_EXTRACT * pExtract, CASC_EXTRACT_WORKER * pWorker, size_t & nEntry)
+{
+    CASC_EXTRACT_WORKER * pVictim;
+    size_t nRemaining;
+    size_t nSplit;
+    size_t nEnd;
+
+    for(;;)
+    {
+        // Find the worker with the most remaining work
+        pVictim = NULL;
+        nRemaining = 0;
+        for(DWORD i = 0; i < pExtract->dwWorkers; i++)
+        {
+            CASC_EXTRACT_WORKER * pOther = pExtract->pWorkers + i;
+
+            if(pOther != pWorker)
+            {
+                CascLock(pOther->Lock);
+                if((pOther->nEndEntry - pOther->nNextEntry) > nRemaining)
+                {
+                    nRemaining = pOther->nEndEntry - pOther->nNextEntry;
+                    pVictim = pOther;
+                }
+                CascUnlock(pOther->Lock);
+            }
+        }
+
+        // No work left anywhere
+        if(pVictim == NULL)
+            return false;
+
+        // Take the second half of the victim's range. The victim may have progressed meanwhile
+        CascLock(pVictim->Lock);
+        nSplit = nEnd = pVictim->nEndEntry;
+        if(pVictim->nNextEntry < pVictim->nEndEntry)
+        {
+            nSplit = pVictim->nNextEntry + (pVictim->nEndEntry - pVictim->nNextEntry) / 2;
+            nSplit = SnapToDataFile(pExtract, nSplit, pVictim->nEndEntry);
+            pVictim->nEndEntry = nSplit;
+        }
+        CascUnlock(pVictim->Lock);
+
+        // Make the stolen range our own. If the victim has just finished, try again
+        if(nSplit < nEnd)
+        {
+            CascLock(pWorker->Lock);
+            pWorker->nNextEntry = nSplit + 1;
+            pWorker->nEndEntry = nEnd;
+            pWorker->dwStealCount++;
+            CascUnlock(pWorker->Lock);
+
+            nEntry = nSplit;
+            return true;
+        }
+    }
+}
+
+static bool GetNextExtractEntry(CASC_EXTRACT * pExtract, CASC_EXTRACT_WORKER * pWorker, size_t & nEntry)
+{
+    bool bHaveEntry = false;
+
+    // Stop if the caller cancelled the extraction
+    if(pExtract->dwCancelled)
+        return false;
+
+    // Take the next entry from our own range
+    CascLock(pWorker->Lock);
+    if(pWorker->nNextEntry < pWorker->nEndEntry)
+    {
+        nEntry = pWorker->nNextEntry++;
+        bHaveEntry = true;
+    }
+    CascUnlock(pWorker->Lock);
+
+    // If there is none, steal from other worker
+    return bHaveEntry || StealExtractEntries(pExtract, pWorker, nEntry);
+}
+
+// Creates the output file. Subdirectories are created as needed
+static DWORD CreateExtractFile(CASC_EXTRACT * pExtract, CASC_EXTRACT_ENTRY & Entry, CASC_PATH<TCHAR> & LocalPath, TFileStream ** PtrStream)
+{
+    TCHAR szFileName[MAX_PATH];
+
+    // Files in TVFS storages have ':' in their names. Make them a directory
+    CascStrCopy(szFileName, _countof(szFileName), Entry.pFindData->szFileName);
+    for(size_t i = 0; szFileName[i] != 0; i++)
+    {
+        if(szFileName[i] == _T(':'))
+            szFileName[i] = PATH_SEP_CHAR;
+    }
+
+    LocalPath.Create(pExtract->pArgs->szOutputDir, szFileName, NULL);
+    if((PtrStream[0] = CreateLocalFile(LocalPath)) == NULL)
+        return GetCascError();
+    return ERROR_SUCCESS;
+}
+
+// Reads the file piece by piece. Each piece is appended to the output file
+// and given to the callback, so the size of the file doesn't matter
+static DWORD ExtractEntryData(CASC_EXTRACT * pExtract, CASC_EXTRACT_WORKER * pWorker, CASC_EXTRACT_ENTRY & Entry, ULONGLONG & BytesExtracted)
+{
+    PCASC_EXTRACT_ARGS pArgs = pExtract->pArgs;
+    CASC_PATH<TCHAR> LocalPath;
+    TFileStream * pOutStream = NULL;
+    ULONGLONG FileSize = 0;
+    HANDLE hFile = NULL;
+    DWORD dwBytesToRead;
+    DWORD dwBytesRead;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Open the file. Each file is read only once, so there is no need to cache anything
+    BytesExtracted = 0;
+    if(!OpenFileByCKeyEntry(pExtract->hs, Entry.pCKeyEntry, pArgs->dwOpenFlags, &hFile))
+        return GetCascError();
+    SetCacheStrategy(hFile, CascCacheNothing);
+
+    // Make sure that the buffer can hold one piece of the file
+    if(!CascGetFileSize64(hFile, &FileSize))
+        dwErrCode = GetCascError();
+    if(dwErrCode == ERROR_SUCCESS && FileSize > pWorker->FileData.cbData && pWorker->FileData.cbData < CASC_EXTRACT_CHUNK_SIZE)
+        dwErrCode = pWorker->FileData.SetSize((size_t)CASCLIB_MIN(FileSize, CASC_EXTRACT_CHUNK_SIZE));
+
+    // Create the output file
+    if(dwErrCode == ERROR_SUCCESS && pArgs->szOutputDir != NULL)
+        dwErrCode = CreateExtractFile(pExtract, Entry, LocalPath, &pOutStream);
+
+    // Read the file and pass it on, one piece at a time
+    while(dwErrCode == ERROR_SUCCESS && BytesExtracted < FileSize)
+    {
+        dwBytesToRead = (DWORD)CASCLIB_MIN(FileSize - BytesExtracted, CASC_EXTRACT_CHUNK_SIZE);
+        if(!CascReadFile(hFile, pWorker->FileData.pbData, dwBytesToRead, &dwBytesRead))
+        {
+            dwErrCode = GetCascError();
+            break;
+        }
+        if(dwBytesRead != dwBytesToRead)
+        {
+            dwErrCode = ERROR_HANDLE_EOF;
+            break;
+        }
+
+        // Append the piece to the output file
+        if(pOutStream != NULL && !FileStream_Write(pOutStream, NULL, pWorker->FileData.pbData, dwBytesRead))
+        {
+            dwErrCode = GetCascError();
+            break;
+        }
+
+        // Give the piece to the callback
+        if(pArgs->PfnCallback != NULL && pArgs->PfnCallback(pArgs->PtrUserParam, Entry.pFindData, ERROR_SUCCESS, BytesExtracted, pWorker->FileData.pbData, dwBytesRead))
+        {
+            CascInterlockedIncrement(&pExtract->dwCancelled);
+            dwErrCode = ERROR_CANCELLED;
+        }
+        BytesExtracted += dwBytesRead;
+    }
+    CascCloseFile(hFile);
+
+    // Close the output file. Don't leave incomplete files behind
+    if(pOutStream != NULL)
+    {
+        FileStream_Close(pOutStream);
+        if(dwErrCode != ERROR_SUCCESS)
+            _tremove(LocalPath);
+    }
+    return dwErrCode;
+}
+
+static void ExtractEntry(CASC_EXTRACT * pExtract, CASC_EXTRACT_WORKER * pWorker, CASC_EXTRACT_ENTRY & Entry)
+{
+    PCASC_EXTRACT_ARGS pArgs = pExtract->pArgs;
+    ULONGLONG BytesExtracted = 0;
+    DWORD dwErrCode;
+
+    // Read the file, write it to the output directory and give it to the callback
+    dwErrCode = ExtractEntryData(pExtract, pWorker, Entry, BytesExtracted);
+
+    // Update the statistics
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        pWorker->BytesExtracted += BytesExtracted;
+        pWorker->FilesExtracted++;
+    }
+    else
+    {
+        pWorker->FilesFailed++;
+    }
+
+    // Tell the callback that the file is complete
+    if(pArgs->PfnCallback != NULL)
+    {
+        if(pArgs->PfnCallback(pArgs->PtrUserParam, Entry.pFindData, dwErrCode, BytesExtracted, NULL, 0))
+        {
+            CascInterlockedIncrement(&pExtract->dwCancelled);
+        }
+    }
+}
+
+static void Worker_ExtractFiles(void * pvParam)
+{
+    CASC_EXTRACT_WORKER * pWorker = (CASC_EXTRACT_WORKER *)pvParam;
+    CASC_EXTRACT * pExtract = pWorker->pExtract;
+    size_t nEntry = 0;
+
+    while(GetNextExtractEntry(pExtract, pWorker, nEntry))
+    {
+        ExtractEntry(pExtract, pWorker, pExtract->pEntries[nEntry]);
+    }
+}
+
+static DWORD RunExtractWorkers(CASC_EXTRACT * pExtract, DWORD dwThreadCount)
+{
+    // Each thread should get some work
+    dwThreadCount = (dwThreadCount != 0) ? dwThreadCount : CascGetProcessorCount();
+    dwThreadCount = (DWORD)CASCLIB_MIN(dwThreadCount, CASCLIB_MAX(pExtract->nEntries, 1));
+    dwThreadCount = CASCLIB_MIN(dwThreadCount, CASC_EXTRACT_MAX_THREADS);
+
+    // Allocate the workers
+    if((pExtract->pWorkers = new CASC_EXTRACT_WORKER[dwThreadCount]) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pExtract->dwWorkers = dwThreadCount;
+
+    // Initialize all workers before any of them starts to steal
+    for(DWORD i = 0; i < dwThreadCount; i++)
+    {
+        CASC_EXTRACT_WORKER & Worker = pExtract->pWorkers[i];
+
+        Worker.pExtract = pExtract;
+        Worker.Thread.bRunning = false;
+        Worker.BytesExtracted = 0;
+        Worker.FilesExtracted = 0;
+        Worker.FilesFailed = 0;
+        Worker.dwStealCount = 0;
+        CascInitLock(Worker.Lock);
+    }
+    AssignWorkerRanges(pExtract);
+
+    // Start the threads. If a thread fails to start, its range gets stolen by the others.
+    // The calling thread is the worker 0
+    for(DWORD i = 1; i < dwThreadCount; i++)
+        CascCreateThread(pExtract->pWorkers[i].Thread, Worker_ExtractFiles, pExtract->pWorkers + i);
+    Worker_ExtractFiles(pExtract->pWorkers);
+
+    // Wait for all threads to finish
+    for(DWORD i = 1; i < dwThreadCount; i++)
+        CascWaitForThread(pExtract->pWorkers[i].Thread);
+    return ERROR_SUCCESS;
+}
+
+static void FreeExtractWorkers(CASC_EXTRACT * pExtract)
+{
+    if(pExtract->pWorkers != NULL)
+    {
+        for(DWORD i = 0; i < pExtract->dwWorkers; i++)
+            CascFreeLock(pExtract->pWorkers[i].Lock);
+        delete [] pExtract->pWorkers;
+    }
+    pExtract->pWorkers = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+bool WINAPI CascExtractFiles(HANDLE hStorage, PCASC_EXTRACT_ARGS pArgs, PCASC_EXTRACT_STATS pStats)
+{
+    const CASC_FIND_DATA * pFindData = NULL;
+    CASC_EXTRACT Extract;
+    CASC_ARRAY FoundFiles;
+    ULONGLONG StartTime = CascGetTickCount();
+    size_t nFindDataCount = 0;
+    size_t FilesSkipped = 0;
+    DWORD dwErrCode;
+
+    // Validate the storage handle and the parameters
+    if((Extract.hs = TCascStorage::IsValid(hStorage)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+    if(pArgs == NULL || pArgs->Size < sizeof(CASC_EXTRACT_ARGS) || (pArgs->szOutputDir == NULL && pArgs->PfnCallback == NULL))
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+    if(pArgs->pFindData == NULL && pArgs->nFindDataCount != 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Initialize the extraction
+    Extract.pArgs = pArgs;
+    Extract.pEntries = NULL;
+    Extract.pWorkers = NULL;
+    Extract.nEntries = 0;
+    Extract.dwWorkers = 0;
+    Extract.dwCancelled = 0;
+
+    // Collect the files and sort them by their position in the storage
+    dwErrCode = CollectFiles(Extract.hs, pArgs, FoundFiles, &pFindData, &nFindDataCount);
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = CreateExtractEntries(&Extract, pFindData, nFindDataCount, FilesSkipped);
+
+    // Extract the files
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = RunExtractWorkers(&Extract, pArgs->dwThreadCount);
+    if(dwErrCode == ERROR_SUCCESS && Extract.dwCancelled)
+        dwErrCode = ERROR_CANCELLED;
+
+    // Give the statistics to the caller
+    if(pStats != NULL)
+    {
+        memset(pStats, 0, sizeof(CASC_EXTRACT_STATS));
+        for(DWORD i = 0; i < Extract.dwWorkers; i++)
+        {
+            pStats->BytesExtracted += Extract.pWorkers[i].BytesExtracted;
+            pStats->FilesExtracted += Extract.pWorkers[i].FilesExtracted;
+            pStats->FilesFailed += Extract.pWorkers[i].FilesFailed;
+            pStats->dwStealCount += Extract.pWorkers[i].dwStealCount;
+        }
+        pStats->FilesSkipped = FilesSkipped;
+        pStats->ElapsedMs = CascGetTickCount() - StartTime;
+        pStats->BytesPerSecond = (pStats->BytesExtracted * 1000) / CASCLIB_MAX(pStats->ElapsedMs, 1);
+        pStats->dwThreadCount = Extract.dwWorkers;
+    }
+
+    // Free all buffers
+    FreeExtractWorkers(&Extract);
+    CASC_FREE(Extract.pEntries);
+    FoundFiles.Free();
+
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
@@ -1036,8 +1036,8 @@ static DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName)
                     // Skip the very first separator
                     if(bFirstSeparator == true)
                     {
-                        // Is it there?
-                        if(DirectoryExists(szLocalPath) == false && MakeDirectory(szLocalPath) == false)
+                        // Is it there? Note that another thread may have just created it
+                        if(DirectoryExists(szLocalPath) == false && MakeDirectory(szLocalPath) == false && DirectoryExists(szLocalPath) == false)
                         {
                             dwErrCode = ERROR_PATH_NOT_FOUND;
                             break;
@@ -1066,16 +1066,23 @@ static DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName)
     return dwErrCode;
 }
 
-static DWORD SaveLocalFile(LPCTSTR szLocalName, LPBYTE pbFileData, size_t cbFileData)
+// Creates the local file, including the directories on the way
+TFileStream * CreateLocalFile(LPCTSTR szLocalName)
 {
-    TFileStream * pLocStream;
-    DWORD dwErrCode = ERROR_DISK_FULL;
-
     // Make sure that the path exists
     ForcePathExist(szLocalName, true);
 
     // Create local file
-    pLocStream = FileStream_CreateFile(szLocalName, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+    return FileStream_CreateFile(szLocalName, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+}
+
+DWORD SaveLocalFile(LPCTSTR szLocalName, LPBYTE pbFileData, size_t cbFileData)
+{
+    TFileStream * pLocStream;
+    DWORD dwErrCode = ERROR_DISK_FULL;
+
+    // Create local file
+    pLocStream = CreateLocalFile(szLocalName);
     if(pLocStream != NULL)
     {
         if(FileStream_Write(pLocStream, NULL, pbFileData, (DWORD)(cbFileData)))
@@ -1258,6 +1265,104 @@ static DWORD HttpDownloadFile(
     return dwErrCode;
 }
 
+// Checks whether the CDN server supports HTTP ranges. If it doesn't, the server
+// has sent the entire file, so we save it to the local file
+static DWORD HttpCheckRanges(TCascStorage * hs, LPCTSTR szRemoteName, LPCTSTR szLocalName)
+{
+    TFileStream * pRemStream;
+    ULONGLONG FileSize = 0;
+    LPBYTE pbFileData;
+    DWORD dwStreamFlags = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Open the remote stream
+    pRemStream = FileStream_OpenFile(szRemoteName, BASE_PROVIDER_HTTP | STREAM_PROVIDER_FLAT | STREAM_FLAG_RANGE_ACCESS);
+    if(pRemStream == NULL)
+        return GetCascError();
+
+    // Retrieving the file size sends a range request for the first byte.
+    // If the server ignores the range, the stream loses the range flag
+    if(FileStream_GetSize(pRemStream, &FileSize) && FileStream_GetFlags(pRemStream, &dwStreamFlags))
+    {
+        if(dwStreamFlags & STREAM_FLAG_RANGE_ACCESS)
+        {
+            hs->dwCdnRanges = CASC_CDN_RANGES_SUPPORTED;
+        }
+        else
+        {
+            hs->dwCdnRanges = CASC_CDN_RANGES_UNSUPPORTED;
+
+            // Don't throw away the data that we have already downloaded
+            if(0 < FileSize && FileSize < CASC_MAX_ONLINE_FILE_SIZE && (pbFileData = CASC_ALLOC<BYTE>((size_t)FileSize)) != NULL)
+            {
+                if(FileStream_Read(pRemStream, NULL, pbFileData, (DWORD)FileSize))
+                    SaveLocalFile(szLocalName, pbFileData, (size_t)FileSize);
+                CASC_FREE(pbFileData);
+            }
+        }
+    }
+    else
+    {
+        dwErrCode = GetCascError();
+    }
+
+    // Close the remote stream
+    FileStream_Close(pRemStream);
+    return dwErrCode;
+}
+
+// Prepares a sparse local copy of a remote archive. The name of the copy has the form
+// "<local archive>.sparse*http:<cdn server>/<cdn path>/data/xx/yy/<archive key>".
+// When the file is open, only the blocks that are read are downloaded from the server
+// and stored to the local copy, together with the bitmap of the present blocks.
+// The ".sparse" suffix prevents the copy from being taken as a complete archive.
+static DWORD FetchSparseArchive(TCascStorage * hs, LPCTSTR szRootPath, LPBYTE pbArchiveKey, CASC_PATH<TCHAR> & LocalPath)
+{
+    LPCTSTR szCdnServers = hs->szCdnServers;
+    DWORD dwErrCode = ERROR_FILE_NOT_FOUND;
+    TCHAR szCdnServer[MAX_PATH] = _T("");
+
+    // If the entire archive is present, use it
+    LocalPath.Create(szRootPath, GetSubFolder(PathTypeData), NULL);
+    LocalPath.AppendEKey(pbArchiveKey);
+    if(FileAlreadyExists(LocalPath))
+        return ERROR_SUCCESS;
+
+    // Force-create the local path
+    if((dwErrCode = ForcePathExist(LocalPath, true)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Try all download servers
+    while((szCdnServers = ExtractCdnServerName(szCdnServer, _countof(szCdnServer), szCdnServers)) != NULL)
+    {
+        CASC_PATH<TCHAR> RemotePath(URL_SEP_CHAR);
+
+        // Construct the full remote URL path
+        RemotePath.Create(szCdnServer, hs->szCdnPath, GetSubFolder(PathTypeData), NULL);
+        RemotePath.AppendEKey(pbArchiveKey);
+
+        // The first sparse archive checks whether the server supports ranges
+        if(hs->dwCdnRanges == CASC_CDN_RANGES_UNKNOWN)
+        {
+            if((dwErrCode = HttpCheckRanges(hs, RemotePath, LocalPath)) != ERROR_SUCCESS)
+                continue;
+        }
+
+        // If the server doesn't support ranges, we might have the entire archive now
+        if(hs->dwCdnRanges != CASC_CDN_RANGES_SUPPORTED)
+            return FileAlreadyExists(LocalPath) ? ERROR_SUCCESS : ERROR_NOT_SUPPORTED;
+
+        // Append the name of the master file. Don't use AppendString,
+        // as it would convert the URL separators to path separators
+        LocalPath.AppendString(_T(".sparse*http:"), false);
+        for(LPCTSTR szRemotePath = RemotePath; szRemotePath[0] != 0; szRemotePath++)
+            LocalPath.AppendChar(szRemotePath[0]);
+        return ERROR_SUCCESS;
+    }
+
+    return dwErrCode;
+}
+
 DWORD SetProductCodeName(TCascStorage * hs, LPCSTR szCodeName, size_t nLength)
 {
     if(hs->szCodeName == NULL && szCodeName != NULL)
@@ -1330,20 +1435,20 @@ DWORD FetchCascFile(
 
 DWORD FetchCascFile(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKey, LPCTSTR szExtension, CASC_PATH<TCHAR> & LocalPath, PCASC_ARCHIVE_INFO pArchiveInfo)
 {
-    PCASC_EKEY_ENTRY pEKeyEntry;
-    LPBYTE pbArchiveKey;
+    CASC_EKEY_ENTRY EKeyEntry;
+    LPBYTE pbArchiveKey = NULL;
     DWORD dwErrCode = ERROR_SUCCESS;
 
     // Data files may be stored in archives, therefore we need to check
-    if((pbEKey != NULL) && (pEKeyEntry = (PCASC_EKEY_ENTRY)hs->IndexMap.FindObject(pbEKey)) != NULL)
+    if((pbEKey != NULL) && FindArchiveIndexEntry(hs, pbEKey, EKeyEntry))
     {
         // Can't complete if the caller doesn't know the archive info
         if(pArchiveInfo != NULL)
         {
             // Fill-in the archive info
-            pArchiveInfo->ArchiveIndex = (DWORD)(pEKeyEntry->StorageOffset >> hs->FileOffsetBits);
-            pArchiveInfo->ArchiveOffs = (DWORD)(pEKeyEntry->StorageOffset & ((ValueOne64 << hs->FileOffsetBits) - 1));
-            pArchiveInfo->EncodedSize = pEKeyEntry->EncodedSize;
+            pArchiveInfo->ArchiveIndex = (DWORD)(EKeyEntry.StorageOffset >> hs->FileOffsetBits);
+            pArchiveInfo->ArchiveOffs = (DWORD)(EKeyEntry.StorageOffset & ((ValueOne64 << hs->FileOffsetBits) - 1));
+            pArchiveInfo->EncodedSize = EKeyEntry.EncodedSize;
 
             // Fill-in the archive key
             pbArchiveKey = pbEKey = hs->ArchivesKey.pbData + (MD5_HASH_SIZE * pArchiveInfo->ArchiveIndex);
@@ -1368,6 +1473,14 @@ DWORD FetchCascFile(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKey, LPCTS
                 return ERROR_SUCCESS;
         }
 
+        // For files in online archives, only download the needed parts of the archive
+        if(pbArchiveKey != NULL && (hs->dwFeatures & CASC_FEATURE_ONLINE) && hs->dwCdnRanges != CASC_CDN_RANGES_UNSUPPORTED)
+        {
+            dwErrCode = FetchSparseArchive(hs, (hs->szDataPath != NULL) ? hs->szDataPath : hs->szRootPath, pbArchiveKey, LocalPath);
+            if(dwErrCode == ERROR_SUCCESS)
+                return ERROR_SUCCESS;
+        }
+
         // Try to download the file into the "data/<type>" path
         if(hs->szDataPath != NULL)
         {
@@ -1387,6 +1500,237 @@ DWORD FetchCascFile(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKey, LPCTS
     return dwErrCode;
 }
 
+//-----------------------------------------------------------------------------
+// Parallel download of multiple files from the CDN servers
+
+#define CASC_DOWNLOAD_THREADS       4       // Number of parallel downloads, unless the caller asked for more threads
+#define CASC_MAX_DOWNLOAD_THREADS   16      // Maximum number of parallel downloads
+#define CASC_MAX_CDN_SERVERS        16      // Maximum number of CDN servers used for downloading
+
+struct CASC_CDN_SERVER
+{
+    char szHostName[MAX_PATH];              // Host name of the server, without port
+    unsigned PortNum;                       // Port number. Default is 80
+};
+
+// Shared state of all download threads
+struct CASC_DOWNLOAD_POOL
+{
+    TCascStorage * hs;
+    CPATH_TYPE PathType;                    // Type of the downloaded files
+    LPBYTE pbEKeys;                         // Array of keys of the files to download
+    LPCTSTR szExtension;                    // File extension, if any
+    LPCSTR szProgressMsg;                   // Message for the progress callback
+    CASC_LOCK Lock;                         // Lock for the connection stack and progress counter
+
+    CASC_CDN_SERVER Servers[CASC_MAX_CDN_SERVERS];
+    DWORD dwServerCount;
+
+    // Each download thread uses its own set of keep-alive connections
+    CASC_SOCKET_CACHE Connections[CASC_MAX_DOWNLOAD_THREADS];
+    PCASC_SOCKET_CACHE FreeConnections[CASC_MAX_DOWNLOAD_THREADS];
+    DWORD dwFreeConnections;
+
+    DWORD dwFilesDone;
+    DWORD dwFileCount;
+};
+
+static PCASC_SOCKET_CACHE AcquireConnections(CASC_DOWNLOAD_POOL * pPool)
+{
+    PCASC_SOCKET_CACHE pConnections;
+
+    // There is never more threads than connection sets, so this never fails
+    CascLock(pPool->Lock);
+    assert(pPool->dwFreeConnections > 0);
+    pConnections = pPool->FreeConnections[--pPool->dwFreeConnections];
+    CascUnlock(pPool->Lock);
+    return pConnections;
+}
+
+static void ReleaseConnections(CASC_DOWNLOAD_POOL * pPool, PCASC_SOCKET_CACHE pConnections)
+{
+    CascLock(pPool->Lock);
+    pPool->FreeConnections[pPool->dwFreeConnections++] = pConnections;
+    CascUnlock(pPool->Lock);
+}
+
+// Downloads one file from one CDN server. The file is written to a temporary file first,
+// which is then renamed. This way, a failed download never leaves an incomplete file behind
+static DWORD DownloadFileFromServer(CASC_DOWNLOAD_POOL * pPool, PCASC_SOCKET_CACHE pConnections, CASC_CDN_SERVER & Server, LPBYTE pbEKey, LPCTSTR szLocalName)
+{
+    CASC_PATH<TCHAR> RemotePath(URL_SEP_CHAR);
+    CASC_PATH<TCHAR> TempPath(szLocalName, NULL);
+    TFileStream * pTempStream;
+    PCASC_SOCKET pSocket;
+    char szRemotePath[MAX_PATH];
+    char request[MAX_PATH + 0x100];
+    size_t request_length;
+    DWORD dwErrCode;
+
+    // Construct the remote path, e.g. "/tpr/wow/data/c6/50/c650c203d52b9e5bdcf1d4b2b8b5bd16.index"
+    RemotePath.Create(pPool->hs->szCdnPath, GetSubFolder(pPool->PathType), NULL);
+    RemotePath.AppendEKey(pbEKey);
+    RemotePath.AppendString(pPool->szExtension, false);
+    CascStrCopy(szRemotePath, _countof(szRemotePath), (LPCTSTR)RemotePath);
+
+    // Get a keep-alive connection to the server
+    if((pSocket = pConnections->Connect(Server.szHostName, Server.PortNum)) == NULL)
+        return GetCascError();
+
+    // Create the temporary file
+    TempPath.AppendString(_T(".download"), false);
+    pTempStream = FileStream_CreateFile(TempPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+    if(pTempStream != NULL)
+    {
+        // Download the file directly to the temporary file
+        request_length = CascStrPrintf(request, _countof(request), "GET /%s HTTP/1.1\r\nHost: %s\r\nConnection: Keep-Alive\r\n\r\n", szRemotePath, Server.szHostName);
+        dwErrCode = pSocket->ReadResponseToStream(request, request_length, pTempStream);
+
+        // Rename the temporary file over the local file. This closes the temporary stream.
+        // Until the rename, the local file (if any) remains untouched
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            if(!FileStream_Rename(pTempStream, szLocalName))
+                dwErrCode = GetCascError();
+        }
+        else
+        {
+            FileStream_Close(pTempStream);
+        }
+
+        // Delete the temporary file on failure
+        if(dwErrCode != ERROR_SUCCESS)
+            _tremove(TempPath);
+    }
+    else
+    {
+        dwErrCode = GetCascError();
+    }
+
+    pSocket->Release();
+    return dwErrCode;
+}
+
+static void MakeLocalPath(CASC_DOWNLOAD_POOL * pPool, LPCTSTR szRootPath, LPBYTE pbEKey, CASC_PATH<TCHAR> & LocalPath)
+{
+    LocalPath.Create(szRootPath, GetSubFolder(pPool->PathType), NULL);
+    LocalPath.AppendEKey(pbEKey);
+    LocalPath.AppendString(pPool->szExtension, false);
+}
+
+static DWORD DownloadFile_Worker(void * pvContext, DWORD dwItemIndex)
+{
+    CASC_DOWNLOAD_POOL * pPool = (CASC_DOWNLOAD_POOL *)pvContext;
+    PCASC_SOCKET_CACHE pConnections;
+    CASC_PATH<TCHAR> LocalPath;
+    CASC_PATH<TCHAR> RootPath;
+    TCascStorage * hs = pPool->hs;
+    LPBYTE pbEKey = pPool->pbEKeys + (dwItemIndex * MD5_HASH_SIZE);
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bFileExists;
+    bool bCancelled;
+
+    // Like FetchCascFile, we download the file to the "data/<type>" path, if any.
+    // Skip the files that are present there or in the "<type>" path
+    MakeLocalPath(pPool, (hs->szDataPath != NULL) ? hs->szDataPath : hs->szRootPath, pbEKey, LocalPath);
+    bFileExists = FileAlreadyExists(LocalPath);
+    if(bFileExists == false && hs->szDataPath != NULL)
+    {
+        MakeLocalPath(pPool, hs->szRootPath, pbEKey, RootPath);
+        bFileExists = FileAlreadyExists(RootPath);
+    }
+
+    // Download the file, if not present
+    if(bFileExists == false && (dwErrCode = ForcePathExist(LocalPath, true)) == ERROR_SUCCESS)
+    {
+        pConnections = AcquireConnections(pPool);
+
+        // Spread the files over all servers. If a server fails, try the next one
+        for(DWORD i = 0; i < pPool->dwServerCount; i++)
+        {
+            CASC_CDN_SERVER & Server = pPool->Servers[(dwItemIndex + i) % pPool->dwServerCount];
+
+            dwErrCode = DownloadFileFromServer(pPool, pConnections, Server, pbEKey, LocalPath);
+            if(dwErrCode == ERROR_SUCCESS || dwErrCode == ERROR_NOT_ENOUGH_MEMORY)
+                break;
+        }
+
+        ReleaseConnections(pPool, pConnections);
+    }
+
+    // Inform the user about the progress
+    CascLock(pPool->Lock);
+    bCancelled = InvokeProgressCallback(hs, pPool->szProgressMsg, NULL, ++pPool->dwFilesDone, pPool->dwFileCount);
+    CascUnlock(pPool->Lock);
+
+    // Failed downloads are not fatal here; the caller will find out when fetching the file
+    if(bCancelled)
+        return ERROR_CANCELLED;
+    return (dwErrCode == ERROR_NOT_ENOUGH_MEMORY) ? ERROR_NOT_ENOUGH_MEMORY : ERROR_SUCCESS;
+}
+
+// Downloads all files from the key array that are not present locally.
+// The files are downloaded in parallel, using keep-alive connections to all CDN servers
+DWORD FetchCascFiles(TCascStorage * hs, CPATH_TYPE PathType, LPBYTE pbEKeys, size_t nKeyCount, LPCTSTR szExtension, LPCSTR szProgressMsg)
+{
+    CASC_DOWNLOAD_POOL * pPool;
+    LPCTSTR szCdnServers = hs->szCdnServers;
+    TCHAR szCdnServer[MAX_PATH] = _T("");
+    DWORD dwThreadCount = CASCLIB_MAX(hs->dwThreadCount, CASC_DOWNLOAD_THREADS);
+    DWORD dwErrCode;
+
+    // Only for online storages
+    if(!(hs->dwFeatures & CASC_FEATURE_ONLINE) || hs->szCdnServers == NULL || hs->szCdnPath == NULL || nKeyCount == 0)
+        return ERROR_SUCCESS;
+
+    // The pool is too large to be placed on the stack
+    if((pPool = new CASC_DOWNLOAD_POOL) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pPool->hs = hs;
+    pPool->PathType = PathType;
+    pPool->pbEKeys = pbEKeys;
+    pPool->szExtension = szExtension;
+    pPool->szProgressMsg = szProgressMsg;
+    pPool->dwServerCount = 0;
+    pPool->dwFilesDone = 0;
+    pPool->dwFileCount = (DWORD)nKeyCount;
+    CascInitLock(pPool->Lock);
+
+    // Parse the servers. They may have port number, e.g. "127.0.0.1:8080"
+    while(pPool->dwServerCount < CASC_MAX_CDN_SERVERS && (szCdnServers = ExtractCdnServerName(szCdnServer, _countof(szCdnServer), szCdnServers)) != NULL)
+    {
+        CASC_CDN_SERVER & Server = pPool->Servers[pPool->dwServerCount++];
+        char * szPortNum;
+
+        CascStrCopy(Server.szHostName, _countof(Server.szHostName), szCdnServer);
+        Server.PortNum = CASC_PORT_HTTP;
+        if((szPortNum = strchr(Server.szHostName, ':')) != NULL)
+        {
+            Server.PortNum = atoi(szPortNum + 1);
+            szPortNum[0] = 0;
+        }
+    }
+
+    // Prepare one set of keep-alive connections for each thread
+    dwThreadCount = CASCLIB_MIN(dwThreadCount, CASC_MAX_DOWNLOAD_THREADS);
+    for(DWORD i = 0; i < dwThreadCount; i++)
+    {
+        pPool->Connections[i].SetCaching(true);
+        pPool->FreeConnections[i] = &pPool->Connections[i];
+    }
+    pPool->dwFreeConnections = dwThreadCount;
+
+    // Download the files
+    dwErrCode = CascRunParallel(DownloadFile_Worker, pPool, (DWORD)nKeyCount, dwThreadCount);
+
+    // Close all connections
+    for(DWORD i = 0; i < dwThreadCount; i++)
+        pPool->Connections[i].SetCaching(false);
+    CascFreeLock(pPool->Lock);
+    delete pPool;
+    return dwErrCode;
+}
+
 static DWORD FetchAndLoadConfigFile(TCascStorage * hs, PCASC_BLOB pFileKey, PARSE_TEXT_FILE PfnParseProc)
 {
     CASC_PATH<TCHAR> LocalPath;
@@ -1409,7 +1753,7 @@ static DWORD FetchAndLoadConfigFile(TCascStorage * hs, PCASC_BLOB pFileKey, PARS
             {
                 dwErrCode = ERROR_FILE_CORRUPT;
             }
-            CASC_FREE(pvListFile);
+            ListFile_Free(pvListFile);
         }
         else
         {
@@ -151,8 +151,24 @@ static LPTSTR CreateIndexFileName(TCascStorage * hs, DWORD IndexValue, DWORD Ind
     return CASC_PATH<TCHAR>(hs->szIndexPath, szPlainName, NULL).New();
 }
 
+static void FreeIndexFile(CASC_INDEX & IndexFile)
+{
+    // Unmap the file and free the array of EKey entries
+    FileStream_Close(IndexFile.pStream);
+    IndexFile.pStream = NULL;
+    IndexFile.pbEKeyEntries = NULL;
+    IndexFile.nEKeyEntries = 0;
+    IndexFile.EKeyEntries.Free();
+
+    // Free the file name
+    CASC_FREE(IndexFile.szFileName);
+}
+
 static void SaveFileOffsetBitsAndEKeyLength(TCascStorage * hs, BYTE FileOffsetBits, BYTE EKeyLength)
 {
+    // Index files may be loaded by multiple threads
+    CascLock(hs->StorageLock);
+
     if(hs->FileOffsetBits == 0)
         hs->FileOffsetBits = FileOffsetBits;
     assert(hs->FileOffsetBits == FileOffsetBits);
@@ -160,6 +176,8 @@ static void SaveFileOffsetBitsAndEKeyLength(TCascStorage * hs, BYTE FileOffsetBi
     if(hs->EKeyLength == 0)
         hs->EKeyLength = EKeyLength;
     assert(hs->EKeyLength == EKeyLength);
+
+    CascUnlock(hs->StorageLock);
 }
 
 // Verifies a guarded block - data availability and checksum match
@@ -290,10 +308,10 @@ static DWORD LoadIndexItems(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKE
 static DWORD CaptureIndexHeader_V1(CASC_INDEX_HEADER & InHeader, LPBYTE pbFileData, size_t cbFileData, DWORD BucketIndex)
 {
     PFILE_INDEX_HEADER_V1 pIndexHeader = (PFILE_INDEX_HEADER_V1)pbFileData;
+    FILE_INDEX_HEADER_V1 IndexHeader;
     LPBYTE pbKeyEntries;
     LPBYTE pbFileEnd = pbFileData + cbFileData;
     size_t cbKeyEntries;
-    DWORD HeaderHash;
 
     // Check the available size. Note that the index file can be just a header.
     if((pbFileData + sizeof(FILE_INDEX_HEADER_V1)) > pbFileEnd)
@@ -303,15 +321,12 @@ static DWORD CaptureIndexHeader_V1(CASC_INDEX_HEADER & InHeader, LPBYTE pbFileDa
     if(pIndexHeader->EncodedSizeLength != 0x04 || pIndexHeader->StorageOffsetLength != 0x05 || pIndexHeader->EKeyLength != 0x09)
         return ERROR_NOT_SUPPORTED;
 
-    // Verify the header hash
-    HeaderHash = pIndexHeader->HeaderHash;
-    pIndexHeader->HeaderHash = 0;
-    if(hashlittle(pbFileData, sizeof(FILE_INDEX_HEADER_V1), 0) != HeaderHash)
+    // Verify the header hash. The file may be mapped as read-only, so we hash a copy of the header
+    memcpy(&IndexHeader, pIndexHeader, sizeof(FILE_INDEX_HEADER_V1));
+    IndexHeader.HeaderHash = 0;
+    if(hashlittle(&IndexHeader, sizeof(FILE_INDEX_HEADER_V1), 0) != pIndexHeader->HeaderHash)
         return ERROR_BAD_FORMAT;
 
-    // Return the header hash back
-    pIndexHeader->HeaderHash = HeaderHash;
-
     // Copy the fields
     InHeader.IndexVersion        = pIndexHeader->IndexVersion;
     InHeader.BucketIndex         = pIndexHeader->BucketIndex;
@@ -470,47 +485,217 @@ static DWORD LoadIndexFile(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry,
     return ERROR_BAD_FORMAT;
 }
 
-// Checks the EKey entry for EKey of the ENCODING manifest
-static bool InsertEncodingEKeyToMap(TCascStorage * hs, CASC_INDEX_HEADER &, LPBYTE pbEKeyEntry)
+// Collects the EKey entry to the per-bucket array. Used for index files
+// whose EKey entries are not stored as one sorted array
+static bool CollectEKeyEntry(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, LPBYTE pbEKeyEntry)
 {
-    hs->IndexEKeyMap.InsertObject(pbEKeyEntry, pbEKeyEntry);
+    CASC_INDEX & IndexFile = hs->IndexFiles[InHeader.BucketIndex];
+
+    return (IndexFile.EKeyEntries.Insert(&pbEKeyEntry, 1) != NULL);
+}
+
+// Sorts the pointers to EKey entries by the EKey. Entries with the same EKey
+// keep their order in the file, so the lookup finds the first one
+static int CompareEKeyEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    LPBYTE pbEKeyEntry1 = *(LPBYTE *)pvEntry1;
+    LPBYTE pbEKeyEntry2 = *(LPBYTE *)pvEntry2;
+    int nResult = memcmp(pbEKeyEntry1, pbEKeyEntry2, CASC_EKEY_SIZE);
+
+    if(nResult == 0)
+        nResult = (pbEKeyEntry1 < pbEKeyEntry2) ? -1 : (pbEKeyEntry1 > pbEKeyEntry2) ? 1 : 0;
+    return nResult;
+}
+
+static bool IsSortedEKeyArray(LPBYTE pbEKeyEntry, size_t nEKeyEntries, size_t EntryLength)
+{
+    for(size_t i = 1; i < nEKeyEntries; i++, pbEKeyEntry += EntryLength)
+    {
+        if(memcmp(pbEKeyEntry, pbEKeyEntry + EntryLength, CASC_EKEY_SIZE) > 0)
+            return false;
+    }
     return true;
 }
 
-static DWORD ProcessLocalIndexFiles(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry, DWORD dwIndexCount)
+// The bucket (index file) is given by XOR of all bytes of the EKey, folded to 4 bits
+static DWORD GetBucketIndex(LPBYTE pbEKey)
 {
-    DWORD dwErrCode = ERROR_SUCCESS;
+    BYTE HashValue = pbEKey[0] ^ pbEKey[1] ^ pbEKey[2] ^ pbEKey[3] ^ pbEKey[4] ^ pbEKey[5] ^ pbEKey[6] ^ pbEKey[7] ^ pbEKey[8];
 
-    // Load each index file
-    for(DWORD i = 0; i < dwIndexCount; i++)
+    return (HashValue & 0x0F) ^ (HashValue >> 0x04);
+}
+
+// Finds the EKey entry in the index file of the EKey's bucket
+static LPBYTE FindLocalEKeyEntry(TCascStorage * hs, LPBYTE pbEKey)
+{
+    CASC_INDEX & IndexFile = hs->IndexFiles[GetBucketIndex(pbEKey)];
+    LPBYTE * EKeyEntries = (LPBYTE *)IndexFile.EKeyEntries.ItemArray();
+    LPBYTE pbEKeyEntry;
+    size_t nEKeyEntries = (EKeyEntries != NULL) ? IndexFile.EKeyEntries.ItemCount() : IndexFile.nEKeyEntries;
+    size_t nMin = 0;
+    size_t nMax = nEKeyEntries;
+
+    // Find the first entry with EKey that is equal or greater than the searched one
+    while(nMin < nMax)
+    {
+        size_t nMid = (nMin + nMax) / 2;
+
+        pbEKeyEntry = (EKeyEntries != NULL) ? EKeyEntries[nMid] : IndexFile.pbEKeyEntries + (nMid * IndexFile.EntryLength);
+        if(memcmp(pbEKeyEntry, pbEKey, CASC_EKEY_SIZE) < 0)
+            nMin = nMid + 1;
+        else
+            nMax = nMid;
+    }
+
+    // Check whether we found the EKey
+    if(nMin >= nEKeyEntries)
+        return NULL;
+    pbEKeyEntry = (EKeyEntries != NULL) ? EKeyEntries[nMin] : IndexFile.pbEKeyEntries + (nMin * IndexFile.EntryLength);
+    return (memcmp(pbEKeyEntry, pbEKey, CASC_EKEY_SIZE) == 0) ? pbEKeyEntry : NULL;
+}
+
+// Maps the index file into memory and locates its EKey entries. Index files
+// with one sorted array of EKey entries are searched directly in the mapped data
+static DWORD LoadLocalIndexFile(TCascStorage * hs, DWORD dwIndex)
+{
+    CASC_INDEX_HEADER InHeader;
+    CASC_INDEX & IndexFile = hs->IndexFiles[dwIndex];
+    ULONGLONG FileSize = 0;
+    LPBYTE pbEKeyEntry = NULL;
+    LPBYTE pbFileData;
+    LPBYTE pbFileEnd;
+    size_t cbFileData;
+    DWORD BlockSize = 0;
+    DWORD dwErrCode;
+
+    // Create the file name
+    if((IndexFile.szFileName = CreateIndexFileName(hs, dwIndex, IndexFile.NewSubIndex)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Map the index file. It stays mapped as long as the storage is open
+    IndexFile.pStream = FileStream_OpenFile(IndexFile.szFileName, BASE_PROVIDER_MAP | STREAM_PROVIDER_FLAT);
+    if(IndexFile.pStream == NULL)
+        return GetCascError();
+    FileStream_GetSize(IndexFile.pStream, &FileSize);
+    cbFileData = (size_t)FileSize;
+    if((pbFileData = FileStream_GetMappedData(IndexFile.pStream, 0, (DWORD)cbFileData)) == NULL)
+        return ERROR_BAD_FORMAT;
+    pbFileEnd = pbFileData + cbFileData;
+
+    // Locate the continuous array of EKey entries
+    if(CaptureIndexHeader_V2(InHeader, pbFileData, cbFileData, dwIndex) == ERROR_SUCCESS)
+    {
+        pbEKeyEntry = CaptureGuardedBlock2(pbFileData + InHeader.HeaderLength + InHeader.HeaderPadding, pbFileEnd, InHeader.EntryLength, &BlockSize);
+    }
+    else if(CaptureIndexHeader_V1(InHeader, pbFileData, cbFileData, dwIndex) == ERROR_SUCCESS)
+    {
+        pbEKeyEntry = pbFileData + InHeader.HeaderLength + InHeader.HeaderPadding;
+        BlockSize = (DWORD)(pbFileEnd - pbEKeyEntry);
+    }
+    else
+    {
+        return ERROR_BAD_FORMAT;
+    }
+
+    // Remember the values from the index header
+    SaveFileOffsetBitsAndEKeyLength(hs, InHeader.FileOffsetBits, InHeader.EKeyLength);
+    IndexFile.EntryLength = InHeader.EntryLength;
+
+    // If the EKey entries are sorted, we can binary-search them in the mapped file
+    if(pbEKeyEntry != NULL && IsSortedEKeyArray(pbEKeyEntry, BlockSize / InHeader.EntryLength, InHeader.EntryLength))
+    {
+        IndexFile.pbEKeyEntries = pbEKeyEntry;
+        IndexFile.nEKeyEntries = BlockSize / InHeader.EntryLength;
+        return ERROR_SUCCESS;
+    }
+
+    // Otherwise, collect pointers to all EKey entries and sort them
+    if((dwErrCode = IndexFile.EKeyEntries.Create<LPBYTE>((cbFileData / sizeof(FILE_EKEY_ENTRY)) + 1)) == ERROR_SUCCESS)
     {
-        CASC_INDEX & IndexFile = hs->IndexFiles[i];
+        // The collecting callback only fails if it can't enlarge the array
+        dwErrCode = LoadIndexFile(hs, CollectEKeyEntry, pbFileData, cbFileData, dwIndex);
+        if(dwErrCode == ERROR_INDEX_PARSING_DONE)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
 
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            qsort(IndexFile.EKeyEntries.ItemArray(), IndexFile.EKeyEntries.ItemCount(), sizeof(LPBYTE), CompareEKeyEntries);
+        }
+    }
+
+    return dwErrCode;
+}
+
+// Loads all index files, one by one
+static DWORD LoadLocalIndexFiles_Sequential(TCascStorage * hs)
+{
+    DWORD dwErrCode;
+
+    // Load each index file
+    for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
+    {
         // Inform the user about what we are doing
-        if(InvokeProgressCallback(hs, "Loading index files", NULL, i, dwIndexCount))
+        if(InvokeProgressCallback(hs, "Loading index files", NULL, i, CASC_INDEX_COUNT))
+            return ERROR_CANCELLED;
+
+        // Storages downloaded by Blizzget tool don't have all index files present
+        if((dwErrCode = LoadLocalIndexFile(hs, i)) != ERROR_SUCCESS)
+            return (dwErrCode == ERROR_FILE_NOT_FOUND) ? ERROR_SUCCESS : dwErrCode;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Context for loading the index files in parallel
+struct CASC_INDEX_LOAD
+{
+    TCascStorage * hs;
+    DWORD dwErrCodes[CASC_INDEX_COUNT];
+};
+
+static DWORD LoadLocalIndexFile_Worker(void * pvContext, DWORD dwIndex)
+{
+    CASC_INDEX_LOAD * pIndexLoad = (CASC_INDEX_LOAD *)pvContext;
+
+    // The errors are evaluated by the caller, in order of the index files
+    pIndexLoad->dwErrCodes[dwIndex] = LoadLocalIndexFile(pIndexLoad->hs, dwIndex);
+    return ERROR_SUCCESS;
+}
+
+// Loads all index files using multiple threads
+static DWORD LoadLocalIndexFiles_Parallel(TCascStorage * hs)
+{
+    CASC_INDEX_LOAD IndexLoad;
+    DWORD dwErrCode;
+
+    // Load all index files at once
+    IndexLoad.hs = hs;
+    dwErrCode = CascRunParallel(LoadLocalIndexFile_Worker, &IndexLoad, CASC_INDEX_COUNT, hs->dwThreadCount);
+    if(dwErrCode != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Check the results in the same order as the single-threaded loading does
+    for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
+    {
+        // Storages downloaded by Blizzget tool don't have all index files present.
+        // Index files following the first missing one are not used.
+        if(IndexLoad.dwErrCodes[i] == ERROR_FILE_NOT_FOUND)
         {
-            dwErrCode = ERROR_CANCELLED;
+            for(DWORD j = i; j < CASC_INDEX_COUNT; j++)
+                FreeIndexFile(hs->IndexFiles[j]);
             break;
         }
 
-        // Load the index file
-        if((dwErrCode = LoadIndexFile(hs, PfnEKeyEntry, IndexFile.FileData.pbData, IndexFile.FileData.cbData, i)) != ERROR_SUCCESS)
-            break;
+        // Any other error is fatal
+        if(IndexLoad.dwErrCodes[i] != ERROR_SUCCESS)
+            return IndexLoad.dwErrCodes[i];
     }
 
-    // Swallow the "done parsing" error
-    if(dwErrCode == ERROR_INDEX_PARSING_DONE)
-        dwErrCode = ERROR_SUCCESS;
-
-    // Remember the number of files that are present locally
-    hs->LocalFiles = hs->CKeyArray.ItemCount();
-    return dwErrCode;
+    return ERROR_SUCCESS;
 }
 
 static DWORD LoadLocalIndexFiles(TCascStorage * hs)
 {
-    ULONGLONG TotalSize = 0;
-    DWORD dwIndexCount = 0;
     DWORD dwErrCode;
 
     // Inform the user about what we are doing
@@ -524,39 +709,14 @@ static DWORD LoadLocalIndexFiles(TCascStorage * hs)
         if(hs->szIndexFormat == NULL)
             return ERROR_FILE_NOT_FOUND;
 
-        // Load each index file
-        for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
-        {
-            CASC_INDEX & IndexFile = hs->IndexFiles[i];
-
-            // Create the file name
-            if((IndexFile.szFileName = CreateIndexFileName(hs, i, IndexFile.NewSubIndex)) == NULL)
-                return ERROR_NOT_ENOUGH_MEMORY;
-
-            // WoW6 actually reads THE ENTIRE file to memory. Verified on Mac build (x64).
-            dwErrCode = LoadFileToMemory(IndexFile.szFileName, IndexFile.FileData);
-            if(dwErrCode != ERROR_SUCCESS)
-            {
-                // Storages downloaded by Blizzget tool don't have all index files present
-                if((dwErrCode = GetCascError()) == ERROR_FILE_NOT_FOUND)
-                {
-                    dwErrCode = ERROR_SUCCESS;
-                    break;
-                }
-                return dwErrCode;
-            }
-
-            // Add to the total size of the index files
-            TotalSize += IndexFile.FileData.cbData;
-            dwIndexCount++;
-        }
+        // Map all index files. If allowed, they are verified by multiple threads
+        if(hs->dwThreadCount > 1)
+            dwErrCode = LoadLocalIndexFiles_Parallel(hs);
+        else
+            dwErrCode = LoadLocalIndexFiles_Sequential(hs);
 
-        // Build the map of EKey -> IndexEKeyEntry
-        dwErrCode = hs->IndexEKeyMap.Create((size_t)(TotalSize / sizeof(FILE_EKEY_ENTRY)), CASC_EKEY_SIZE, 0);
-        if(dwErrCode == ERROR_SUCCESS)
-        {
-            dwErrCode = ProcessLocalIndexFiles(hs, InsertEncodingEKeyToMap, dwIndexCount);
-        }
+        // Remember the number of files that are present locally
+        hs->LocalFiles = hs->CKeyArray.ItemCount();
     }
 
     return dwErrCode;
@@ -629,116 +789,156 @@ static DWORD CaptureIndexEntry(CASC_ARCINDEX_FOOTER  & InFooter, CASC_EKEY_ENTRY
     return CascIsValidMD5(EKeyEntry.EKey) ? ERROR_SUCCESS : ERROR_BAD_FORMAT;
 }
 
-static DWORD VerifyIndexSize(CASC_ARCINDEX_FOOTER  & InFooter, LPBYTE pbIndexFile, size_t cbIndexFile, LPBYTE * PtrIndexEnd)
+// The index file consists of pages, the table of contents (last EKey of each page),
+// the hashes of the pages and the footer. Verifies that the size matches
+// and gives the number of pages
+static DWORD VerifyIndexSize(CASC_ARCINDEX_FOOTER & InFooter, size_t cbIndexFile, size_t * PtrPageCount)
 {
+    size_t cbPageAndToc = InFooter.PageLength + InFooter.EKeyLength + InFooter.FooterHashBytes;
     size_t nPageCount;
 
     // Set the new length (without the footer)
+    if(cbIndexFile < InFooter.FooterLength || InFooter.PageLength < InFooter.ItemLength)
+        return ERROR_BAD_FORMAT;
     cbIndexFile = cbIndexFile - InFooter.FooterLength;
-    nPageCount = cbIndexFile / (InFooter.PageLength + MD5_HASH_SIZE);
 
-    // There must be equal or more pages
-    if(((InFooter.PageLength + MD5_HASH_SIZE) * nPageCount) > cbIndexFile)
+    // There must be whole number of pages, each with its TOC entry
+    nPageCount = cbIndexFile / cbPageAndToc;
+    if((nPageCount * cbPageAndToc) != cbIndexFile)
         return ERROR_BAD_FORMAT;
 
-    // Return the end-of-index
-    nPageCount = cbIndexFile / (InFooter.PageLength + MD5_HASH_SIZE);
-    PtrIndexEnd[0] = pbIndexFile + (nPageCount * InFooter.PageLength);
+    PtrPageCount[0] = nPageCount;
     return ERROR_SUCCESS;
 }
 
-static DWORD LoadArchiveIndexPage(TCascStorage * hs, CASC_ARCINDEX_FOOTER & InFooter, LPBYTE pbIndexPage, LPBYTE pbIndexPageEnd, size_t nArchive)
+static bool IsZeroIndexKey(LPBYTE pbEKey, size_t nKeyLength)
 {
-    CASC_EKEY_ENTRY EKeyEntry;
-    DWORD dwErrCode;
-
-    while (pbIndexPage <= pbIndexPageEnd)
+    for(size_t i = 0; i < nKeyLength; i++)
     {
-        // Capture the index entry
-        dwErrCode = CaptureIndexEntry(InFooter, EKeyEntry, pbIndexPage, pbIndexPageEnd, nArchive);
-        if(dwErrCode != ERROR_SUCCESS)
-            break;
-
-        // Insert a new entry to the index array
-        if((hs->IndexArray.Insert(&EKeyEntry, 1)) == NULL)
-            return ERROR_NOT_ENOUGH_MEMORY;
-
-        // Move to the next entry
-        pbIndexPage += InFooter.ItemLength;
+        if(pbEKey[i] != 0)
+            return false;
     }
-
-    return ERROR_SUCCESS;
+    return true;
 }
 
-static DWORD LoadArchiveIndexFile(TCascStorage * hs, LPBYTE pbIndexFile, size_t cbIndexFile, size_t nArchive)
+// Finds the EKey in one archive index. The pages are sorted by EKey, so we binary-search
+// the table of contents for the page, then the page for the entry
+static bool FindEntryInArchiveIndex(CASC_ARCINDEX & Index, LPBYTE pbEKey, CASC_EKEY_ENTRY & EKeyEntry)
 {
-    CASC_ARCINDEX_FOOTER InFooter;
-    LPBYTE pbIndexEnd = NULL;
-    DWORD dwErrCode;
-
-    // Validate and capture the footer
-    dwErrCode = CaptureArchiveIndexFooter(InFooter, pbIndexFile, cbIndexFile);
-    if(dwErrCode != ERROR_SUCCESS)
-        return dwErrCode;
+    CASC_ARCINDEX_FOOTER & InFooter = Index.Footer;
+    LPBYTE pbIndexPage;
+    LPBYTE pbIndexEntry;
+    size_t nKeyLength = InFooter.EKeyLength;
+    size_t nItemCount = InFooter.PageLength / InFooter.ItemLength;
+    size_t nMin = 0;
+    size_t nMax = Index.nPageCount;
+
+    // Find the first page whose last EKey is equal or greater than the searched one
+    while(nMin < nMax)
+    {
+        size_t nMid = (nMin + nMax) / 2;
 
-    // Remember the file offset and EKey length
-    SaveFileOffsetBitsAndEKeyLength(hs, InFooter.OffsetBytes * 8, InFooter.EKeyLength);
+        if(memcmp(Index.pbLastKeys + (nMid * nKeyLength), pbEKey, nKeyLength) < 0)
+            nMin = nMid + 1;
+        else
+            nMax = nMid;
+    }
 
-    // Verify the size of the index file
-    dwErrCode = VerifyIndexSize(InFooter, pbIndexFile, cbIndexFile, &pbIndexEnd);
-    if(dwErrCode != ERROR_SUCCESS)
-        return dwErrCode;
+    // The EKey is greater than all EKeys in the index
+    if(nMin >= Index.nPageCount)
+        return false;
+    pbIndexPage = Index.pbPages + (nMin * InFooter.PageLength);
 
-    // Parse all pages
-    while (pbIndexFile < pbIndexEnd)
+    // Find the entry in the page. Unused space at the end of the page is filled with zeros
+    nMin = 0;
+    nMax = nItemCount;
+    while(nMin < nMax)
     {
-        // Load the entire page
-        dwErrCode = LoadArchiveIndexPage(hs, InFooter, pbIndexFile, pbIndexFile + InFooter.PageLength, nArchive);
-        if(dwErrCode != ERROR_SUCCESS)
-            break;
+        size_t nMid = (nMin + nMax) / 2;
 
-        // Move to the next page
-        pbIndexFile += InFooter.PageLength;
+        pbIndexEntry = pbIndexPage + (nMid * InFooter.ItemLength);
+        if(!IsZeroIndexKey(pbIndexEntry, nKeyLength) && memcmp(pbIndexEntry, pbEKey, nKeyLength) < 0)
+            nMin = nMid + 1;
+        else
+            nMax = nMid;
     }
 
-    return ERROR_SUCCESS;
+    // Did we find the entry?
+    if(nMin >= nItemCount)
+        return false;
+    pbIndexEntry = pbIndexPage + (nMin * InFooter.ItemLength);
+    if(memcmp(pbIndexEntry, pbEKey, nKeyLength))
+        return false;
+
+    return (CaptureIndexEntry(InFooter, EKeyEntry, pbIndexEntry, pbIndexPage + InFooter.PageLength, Index.nArchive) == ERROR_SUCCESS);
 }
 
-static DWORD BuildMapOfArchiveIndices(TCascStorage * hs)
+// Maps the archive index into memory. Only the footer is parsed;
+// the pages are only touched when an EKey is looked up
+static DWORD LoadArchiveIndexFile(TCascStorage * hs, LPCTSTR szFileName, size_t nArchive)
 {
-    PCASC_EKEY_ENTRY pEKeyEntry;
-    size_t nItemCount = hs->IndexArray.ItemCount();
+    CASC_ARCINDEX Index;
+    ULONGLONG FileSize = 0;
+    LPBYTE pbIndexFile;
+    size_t cbIndexFile;
     DWORD dwErrCode;
 
-    // Create the map
-    dwErrCode = hs->IndexMap.Create(nItemCount, MD5_HASH_SIZE, FIELD_OFFSET(CASC_EKEY_ENTRY, EKey));
-    if(dwErrCode != ERROR_SUCCESS)
-        return dwErrCode;
-
-    // Insert all items
-    for(size_t i = 0; i < nItemCount; i++)
+    // Open the index file as memory-mapped file
+    memset(&Index, 0, sizeof(CASC_ARCINDEX));
+    Index.pStream = FileStream_OpenFile(szFileName, BASE_PROVIDER_MAP | STREAM_PROVIDER_FLAT);
+    if(Index.pStream == NULL)
+        return GetCascError();
+
+    // Get the pointer to the mapped data
+    FileStream_GetSize(Index.pStream, &FileSize);
+    cbIndexFile = (size_t)FileSize;
+    pbIndexFile = FileStream_GetMappedData(Index.pStream, 0, (DWORD)cbIndexFile);
+    if(pbIndexFile != NULL && cbIndexFile > sizeof(FILE_INDEX_FOOTER<0x08>))
     {
-        pEKeyEntry = (PCASC_EKEY_ENTRY)hs->IndexArray.ItemAt(i);
-        if(pEKeyEntry != NULL)
+        // Validate and capture the footer
+        dwErrCode = CaptureArchiveIndexFooter(Index.Footer, pbIndexFile, cbIndexFile);
+        if(dwErrCode == ERROR_SUCCESS)
         {
-            if(!hs->IndexMap.InsertObject(pEKeyEntry, pEKeyEntry->EKey))
+            // Remember the file offset and EKey length
+            SaveFileOffsetBitsAndEKeyLength(hs, Index.Footer.OffsetBytes * 8, Index.Footer.EKeyLength);
+
+            // Verify the size of the index file and locate the table of contents
+            dwErrCode = VerifyIndexSize(Index.Footer, cbIndexFile, &Index.nPageCount);
+            if(dwErrCode == ERROR_SUCCESS)
             {
-                return ERROR_NOT_ENOUGH_MEMORY;
+                Index.pbPages = pbIndexFile;
+                Index.pbLastKeys = pbIndexFile + (Index.nPageCount * Index.Footer.PageLength);
+                Index.nArchive = nArchive;
+
+                // Insert the index to the array. The array owns the stream from now on
+                if(hs->ArchiveIndexes.Insert(&Index, 1) != NULL)
+                    return ERROR_SUCCESS;
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
             }
         }
     }
+    else
+    {
+        dwErrCode = ERROR_BAD_FORMAT;
+    }
 
+    FileStream_Close(Index.pStream);
     return dwErrCode;
 }
 
 static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
 {
-    CASC_BLOB FileData;
     size_t nArchiveCount = (hs->ArchivesKey.cbData / MD5_HASH_SIZE);
     DWORD dwErrCode = ERROR_SUCCESS;
 
     // Create the array object for the indices
-    dwErrCode = hs->IndexArray.Create(sizeof(CASC_EKEY_ENTRY), 0x10000);
+    dwErrCode = hs->ArchiveIndexes.Create(sizeof(CASC_ARCINDEX), CASCLIB_MAX(nArchiveCount, 1));
+    if(dwErrCode != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Download all missing indices in parallel.
+    // If some download fails, FetchCascFile will try it again
+    dwErrCode = FetchCascFiles(hs, PathTypeData, hs->ArchivesKey.pbData, nArchiveCount, _T(".index"), "Downloading archive indexes");
     if(dwErrCode != ERROR_SUCCESS)
         return dwErrCode;
 
@@ -749,37 +949,42 @@ static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
         LPBYTE pbIndexHash = hs->ArchivesKey.pbData + (i * MD5_HASH_SIZE);
 
         // Inform the user about what we are doing
-        if(InvokeProgressCallback(hs, "Downloading archive indexes", NULL, (DWORD)(i), (DWORD)(nArchiveCount)))
+        if(InvokeProgressCallback(hs, "Loading archive indexes", NULL, (DWORD)(i), (DWORD)(nArchiveCount)))
         {
             dwErrCode = ERROR_CANCELLED;
             break;
         }
 
-        // Fetch and parse the archive index
+        // Fetch and map the archive index
         dwErrCode = FetchCascFile(hs, PathTypeData, pbIndexHash, _T(".index"), LocalPath);
         if(dwErrCode == ERROR_SUCCESS)
-        {
-            // Load the index file to memory
-            if((dwErrCode = LoadFileToMemory(LocalPath, FileData)) == ERROR_SUCCESS)
-            {
-                dwErrCode = LoadArchiveIndexFile(hs, FileData.pbData, FileData.cbData, i);
-            }
-        }
+            dwErrCode = LoadArchiveIndexFile(hs, LocalPath, i);
 
         // Break if an error
         if(dwErrCode != ERROR_SUCCESS)
             break;
     }
 
-    // Build map of EKey -> CASC_EKEY_ENTRY
-    if(dwErrCode == ERROR_SUCCESS)
-        dwErrCode = BuildMapOfArchiveIndices(hs);
     return dwErrCode;
 }
 
 //-----------------------------------------------------------------------------
 // Public functions
 
+// Finds the EKey in the archive indexes of an online storage. Only the page TOCs
+// of the mapped indexes are searched, no entries are kept in memory
+bool FindArchiveIndexEntry(TCascStorage * hs, LPBYTE pbEKey, CASC_EKEY_ENTRY & EKeyEntry)
+{
+    PCASC_ARCINDEX pIndex;
+
+    for(size_t i = 0; (pIndex = (PCASC_ARCINDEX)hs->ArchiveIndexes.ItemAt(i)) != NULL; i++)
+    {
+        if(FindEntryInArchiveIndex(*pIndex, pbEKey, EKeyEntry))
+            return true;
+    }
+    return false;
+}
+
 bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry)
 {
     // Don't do this on online storages
@@ -788,7 +993,7 @@ bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry)
         LPBYTE pbEKeyEntry;
 
         // If the file was found, then copy the content to the CKey entry
-        pbEKeyEntry = (LPBYTE)hs->IndexEKeyMap.FindObject(pCKeyEntry->EKey);
+        pbEKeyEntry = FindLocalEKeyEntry(hs, pCKeyEntry->EKey);
         if(pbEKeyEntry == NULL)
             return false;
 
@@ -817,20 +1022,69 @@ DWORD LoadIndexFiles(TCascStorage * hs)
     }
 }
 
-void FreeIndexFiles(TCascStorage * hs)
+// Adds names, sizes and times of all local index files to the MD5 hash.
+// The result identifies the state of the index files, without loading them
+DWORD HashLocalIndexFiles(TCascStorage * hs, MD5_CTX & md5_ctx)
 {
-    // Free the map of EKey -> Index Ekey item
-    hs->IndexEKeyMap.Free();
+    TFileStream * pStream;
+    ULONGLONG FileSize;
+    ULONGLONG FileTime;
+    LPTSTR szFileName;
+    DWORD dwErrCode;
 
-    // Free all loaded index files
-    for(size_t i = 0; i < CASC_INDEX_COUNT; i++)
+    // Find the index files
+    if((dwErrCode = ScanDirectory(hs->szIndexPath, NULL, IndexDirectory_OnFileFound, hs)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(hs->szIndexFormat == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    // Take the same index files that LoadLocalIndexFiles would load
+    for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
     {
-        CASC_INDEX & IndexFile = hs->IndexFiles[i];
+        if((szFileName = CreateIndexFileName(hs, i, hs->IndexFiles[i].NewSubIndex)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        pStream = FileStream_OpenFile(szFileName, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+        if(pStream != NULL)
+        {
+            FileSize = FileTime = 0;
+            FileStream_GetSize(pStream, &FileSize);
+            FileStream_GetTime(pStream, &FileTime);
+            FileStream_Close(pStream);
+
+            MD5_Update(&md5_ctx, szFileName, (unsigned long)(_tcslen(szFileName) * sizeof(TCHAR)));
+            MD5_Update(&md5_ctx, &FileSize, sizeof(ULONGLONG));
+            MD5_Update(&md5_ctx, &FileTime, sizeof(ULONGLONG));
+        }
+        else
+        {
+            dwErrCode = GetCascError();
+        }
 
-        // Free the file data
-        IndexFile.FileData.Free();
+        CASC_FREE(szFileName);
 
-        // Free the file name
-        CASC_FREE(IndexFile.szFileName);
+        // Index files following the first missing one are not used
+        if(dwErrCode == ERROR_FILE_NOT_FOUND)
+            return ERROR_SUCCESS;
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
     }
+
+    return ERROR_SUCCESS;
+}
+
+void FreeIndexFiles(TCascStorage * hs)
+{
+    // Free all loaded index files
+    for(size_t i = 0; i < CASC_INDEX_COUNT; i++)
+        FreeIndexFile(hs->IndexFiles[i]);
+}
+
+void FreeArchiveIndexFiles(TCascStorage * hs)
+{
+    PCASC_ARCINDEX pIndex;
+
+    for(size_t i = 0; (pIndex = (PCASC_ARCINDEX)hs->ArchiveIndexes.ItemAt(i)) != NULL; i++)
+        FileStream_Close(pIndex->pStream);
+    hs->ArchiveIndexes.Free();
 }
@@ -90,6 +90,7 @@ extern "C" {
 #define CASC_OVERCOME_ENCRYPTED     0x00000020  // When CascReadFile encounters a block encrypted with a key that is missing, the block is filled with zeros and returned as success
 #define CASC_OPEN_CKEY_ONCE         0x00000040  // Only opens a file with given CKey once, regardless on how many file names does it have. Used by CascLib test program
                                                 // If the file was already open before, CascOpenFile returns false and ERROR_FILE_ALREADY_OPENED
+#define CASC_PARALLEL_DECODE        0x00000080  // When reading the whole file, frames of large file spans are decoded by multiple threads
 
 #define CASC_LOCALE_ALL             0xFFFFFFFF
 #define CASC_LOCALE_ALL_WOW         0x0001F3F6  // All except enCN and enTW
@@ -159,7 +160,9 @@ extern "C" {
 #define CASC_FEATURE_DATA_ARCHIVES  0x00000100  // The storage supports files stored in data.### archives
 #define CASC_FEATURE_DATA_FILES     0x00000200  // The storage supports raw files stored in %CascRoot%\xx\yy\xxyy## (CKey-based)
 #define CASC_FEATURE_ONLINE         0x00000400  // Load the missing files from online CDNs
+#define CASC_FEATURE_MAP_DATA_FILES 0x00000800  // (Local) Memory-map the data.### files instead of reading them
 #define CASC_FEATURE_FORCE_DOWNLOAD 0x00001000  // (Online) always download "versions" and "cdns" even if it exists locally
+#define CASC_FEATURE_PARALLEL_DECODE 0x00002000 // All files are open with CASC_PARALLEL_DECODE
 
 // Macro to convert FileDataId to the argument of CascOpenFile
 #define CASC_FILE_DATA_ID(FileDataId) ((LPCSTR)(size_t)FileDataId)
@@ -193,6 +196,7 @@ typedef enum _CASC_STORAGE_INFO_CLASS
     CascStorageProduct,                         // Gives CASC_STORAGE_PRODUCT
     CascStorageTags,                            // Gives CASC_STORAGE_TAGS structure
     CascStoragePathProduct,                     // Gives Path:Product into a LPTSTR buffer
+    CascStorageFrameCacheInfo,                  // Gives CASC_FRAME_CACHE_INFO structure
     CascStorageInfoClassMax
 
 } CASC_STORAGE_INFO_CLASS, *PCASC_STORAGE_INFO_CLASS;
@@ -283,6 +287,17 @@ typedef struct _CASC_STORAGE_PRODUCT
 
 } CASC_STORAGE_PRODUCT, *PCASC_STORAGE_PRODUCT;
 
+typedef struct _CASC_FRAME_CACHE_INFO
+{
+    ULONGLONG Hits;                             // Number of frames that were served from the frame cache
+    ULONGLONG Misses;                           // Number of frames that had to be loaded and decoded
+    ULONGLONG Evictions;                        // Number of frames that were evicted from the cache to make space
+    ULONGLONG CurrentSize;                      // Total size of the decoded frames currently in the cache
+    ULONGLONG MaxSize;                          // Maximum size of the frame cache. Zero if the frame cache is disabled
+    ULONGLONG FrameCount;                       // Number of frames currently in the cache
+
+} CASC_FRAME_CACHE_INFO, *PCASC_FRAME_CACHE_INFO;
+
 typedef struct _CASC_FILE_FULL_INFO
 {
     BYTE CKey[MD5_HASH_SIZE];                   // CKey
@@ -315,6 +330,39 @@ typedef struct _CASC_FILE_SPAN_INFO
 
 } CASC_FILE_SPAN_INFO, *PCASC_FILE_SPAN_INFO;
 
+// One file to be read by CascReadFilesBatch. The file is specified the same way as in CascOpenFile
+typedef struct _CASC_BATCH_ITEM
+{
+    const void * pvFileName;                    // File name, CKey, EKey or file data ID, depending on dwOpenFlags
+    DWORD dwLocaleFlags;                        // Locale flags, as in CascOpenFile
+    DWORD dwOpenFlags;                          // Open flags, as in CascOpenFile
+    void * pvUserData;                          // Any value. CascLib doesn't use it
+
+} CASC_BATCH_ITEM, *PCASC_BATCH_ITEM;
+
+// Problems found by CascVerifyStorage (CASC_VERIFY_SPAN::dwProblem)
+#define CASC_VERIFY_MISSING_SEGMENT 0x00000001  // The data file ("data.###") does not exist or cannot be read
+#define CASC_VERIFY_MISSING_SPAN    0x00000002  // The span lies beyond the end of the data file
+#define CASC_VERIFY_BAD_HEADER      0x00000003  // The BLTE header is malformed or does not match the span size
+#define CASC_VERIFY_BAD_EKEY        0x00000004  // MD5 of the BLTE header does not match the EKey
+#define CASC_VERIFY_BAD_FRAME       0x00000005  // MD5 of an encoded frame does not match the hash in the BLTE header
+#define CASC_VERIFY_BAD_CKEY        0x00000006  // MD5 of the decoded content does not match the CKey
+#define CASC_VERIFY_DECODE_FAILED   0x00000007  // The content could not be decoded. CASC_VERIFY_SPAN::dwErrCode has the reason
+
+// One corrupt or missing span found by CascVerifyStorage
+typedef struct _CASC_VERIFY_SPAN
+{
+    BYTE CKey[MD5_HASH_SIZE];                   // CKey of the file. Zeros if the file is not in the ENCODING manifest
+    BYTE EKey[MD5_HASH_SIZE];                   // EKey of the span. May only be partial, padded by zeros
+    DWORD ArchiveIndex;                         // Index of the data file ("data.###")
+    DWORD ArchiveOffs;                          // Offset of the span in the data file
+    DWORD EncodedSize;                          // Size of the span in the data file, as given by the index files
+    DWORD FrameIndex;                           // The first bad frame for CASC_VERIFY_BAD_FRAME. CASC_INVALID_INDEX otherwise
+    DWORD dwProblem;                            // See CASC_VERIFY_XXX
+    DWORD dwErrCode;                            // Error code for CASC_VERIFY_DECODE_FAILED, ERROR_FILE_CORRUPT otherwise
+
+} CASC_VERIFY_SPAN, *PCASC_VERIFY_SPAN;
+
 //-----------------------------------------------------------------------------
 // Extended version of CascOpenStorage
 
@@ -338,6 +386,46 @@ typedef bool (WINAPI * PFNPRODUCTCALLBACK)(     // Return 'true' to cancel the l
     size_t * PtrSelectedProduct                 // [out] This is the selected product to open. On input, set to 0 (aka the first product)
     );
 
+// Called by CascReadFilesBatch once for every file, in order in which the files are stored in the storage.
+// The file data are only valid during the call
+typedef bool (WINAPI * PFNBATCHCALLBACK)(       // Return 'true' to cancel the batch
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    const CASC_BATCH_ITEM * pItem,              // The item from the batch
+    DWORD dwErrCode,                            // ERROR_SUCCESS if the file was read, otherwise error code
+    const void * pvFileData,                    // Entire content of the file. NULL if the file was not read
+    ULONGLONG cbFileData                        // Size of the file content, in bytes
+    );
+
+// Called by CascReadFileAsync when the read operation is complete. The callback is called
+// on a worker thread of CascLib. The buffer must stay valid until then and may be used from now on.
+// The file handle stays valid until the callback returns, even if CascCloseFile was called before;
+// the file is then closed after the callback. If it was not closed yet, it may be closed from the callback
+typedef void (WINAPI * PFNREADCALLBACK)(
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    HANDLE hFile,                               // Handle of the file that has been read
+    DWORD dwErrCode,                            // ERROR_SUCCESS if the data were read, otherwise error code
+    DWORD dwBytesRead                           // Number of bytes read. Can be less than requested at the end of the file
+    );
+
+// Called by CascExtractFiles for every piece of file data, in order, and then once more when the file is complete.
+// All calls for one file come from the same thread; calls for different files may come from several threads at once.
+// The file data are only valid during the call
+typedef bool (WINAPI * PFNEXTRACTCALLBACK)(     // Return 'true' to cancel the extraction
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    const CASC_FIND_DATA * pFindData,           // The file being extracted
+    DWORD dwErrCode,                            // ERROR_SUCCESS if the file was extracted, otherwise error code
+    ULONGLONG ByteOffset,                       // Position of the data in the file. In the final call, number of bytes extracted
+    const void * pvFileData,                    // Piece of the file content. NULL in the final call
+    DWORD cbFileData                            // Size of the piece, in bytes. Zero in the final call
+    );
+
+// Called by CascVerifyStorage once for every corrupt or missing span.
+// The callback is called by one thread at a time, in no particular order of the spans
+typedef bool (WINAPI * PFNVERIFYCALLBACK)(      // Return 'true' to cancel the verification
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    const CASC_VERIFY_SPAN * pSpan              // The corrupt or missing span
+    );
+
 typedef struct _CASC_OPEN_STORAGE_ARGS
 {
     size_t Size;                                // Length of this structure. Initialize to sizeof(CASC_OPEN_STORAGE_ARGS)
@@ -370,8 +458,84 @@ typedef struct _CASC_OPEN_STORAGE_ARGS
     LPCTSTR szCdnHostUrl;                       // If non-null, specifies the custom CDN URL. Must contain protocol, can contain port number
                                                 // Example: http://eu.custom-wow-cdn.com:8000
 
+    size_t FrameCacheSize;                      // If non-zero, CascLib keeps a storage-wide cache of decoded file frames up to this size (in bytes)
+                                                // Frames of files that are opened repeatedly are then not loaded and decoded again
+
+    DWORD dwThreadCount;                        // If greater than 1, CascLib uses up to this number of threads for loading the storage
+
+    LPCTSTR szSnapshotFile;                     // If non-null, name of the storage snapshot file. Only used for local storages.
+                                                // If the snapshot matches the storage, ENCODING and DOWNLOAD are not loaded.
+                                                // Otherwise, the snapshot is created after the storage is loaded.
+
 } CASC_OPEN_STORAGE_ARGS, *PCASC_OPEN_STORAGE_ARGS;
 
+//-----------------------------------------------------------------------------
+// Extracting many files at once
+
+typedef struct _CASC_EXTRACT_ARGS
+{
+    size_t Size;                                // Length of this structure. Initialize to sizeof(CASC_EXTRACT_ARGS)
+
+    LPCSTR szMask;                              // If pFindData is NULL, files matching this mask are extracted. NULL means "*"
+    LPCTSTR szListFile;                         // (optional) Listfile used for searching the storage
+
+    const CASC_FIND_DATA * pFindData;           // If non-NULL, array of files to extract, as returned by CascFindFirstFile/CascFindNextFile
+    size_t nFindDataCount;                      // Number of items in pFindData
+
+    LPCTSTR szOutputDir;                        // If non-NULL, the files are written to this directory
+    PFNEXTRACTCALLBACK PfnCallback;             // If non-NULL, called for every file. At least one of szOutputDir and PfnCallback must be given
+    void * PtrUserParam;                        // Pointer-sized parameter that will be passed to PfnCallback
+
+    DWORD dwOpenFlags;                          // Open flags for the files (CASC_STRICT_DATA_CHECK, CASC_OVERCOME_ENCRYPTED)
+    DWORD dwThreadCount;                        // Number of extraction threads. Zero means one thread per processor
+
+} CASC_EXTRACT_ARGS, *PCASC_EXTRACT_ARGS;
+
+typedef struct _CASC_EXTRACT_STATS
+{
+    ULONGLONG BytesExtracted;                   // Total size of the extracted file content
+    ULONGLONG BytesPerSecond;                   // Average throughput of the extraction
+    ULONGLONG ElapsedMs;                        // Duration of the extraction, in milliseconds
+    size_t FilesExtracted;                      // Number of files extracted successfully
+    size_t FilesFailed;                         // Number of files that failed to be read or written
+    size_t FilesSkipped;                        // Number of files skipped because they are not available locally
+    DWORD dwThreadCount;                        // Number of threads that performed the extraction
+    DWORD dwStealCount;                         // How many times a thread took work from another thread
+
+} CASC_EXTRACT_STATS, *PCASC_EXTRACT_STATS;
+
+//-----------------------------------------------------------------------------
+// Verifying the local storage
+
+// Flags for CASC_VERIFY_ARGS::dwFlags
+#define CASC_VERIFY_CONTENT         0x00000001  // Also decode every file and compare MD5 of the content with the CKey
+
+typedef struct _CASC_VERIFY_ARGS
+{
+    size_t Size;                                // Length of this structure. Initialize to sizeof(CASC_VERIFY_ARGS)
+
+    PFNVERIFYCALLBACK PfnCallback;              // (optional) Called for every corrupt or missing span
+    void * PtrUserParam;                        // Pointer-sized parameter that will be passed to PfnCallback
+
+    DWORD dwFlags;                              // CASC_VERIFY_CONTENT or zero
+    DWORD dwThreadCount;                        // Number of data files verified at once. Zero means one thread per processor
+
+} CASC_VERIFY_ARGS, *PCASC_VERIFY_ARGS;
+
+typedef struct _CASC_VERIFY_REPORT
+{
+    ULONGLONG BytesVerified;                    // Total encoded size of the verified spans
+    ULONGLONG BytesPerSecond;                   // Average throughput of the verification
+    ULONGLONG ElapsedMs;                        // Duration of the verification, in milliseconds
+    size_t SpansVerified;                       // Number of spans that have been checked
+    size_t SpansCorrupt;                        // Number of spans with bad header, frame, EKey or CKey
+    size_t SpansMissing;                        // Number of spans whose data are not present in the data files
+    size_t SpansNotDecoded;                     // CASC_VERIFY_CONTENT: Number of spans whose content was not checked (e.g. missing encryption key)
+    DWORD dwSegmentCount;                       // Number of data files ("data.###") that have been verified
+    DWORD dwThreadCount;                        // Number of threads that performed the verification
+
+} CASC_VERIFY_REPORT, *PCASC_VERIFY_REPORT;
+
 //-----------------------------------------------------------------------------
 // Functions for storage manipulation
 
@@ -388,6 +552,8 @@ bool   WINAPI CascSetFileFlags(HANDLE hFile, DWORD dwOpenFlags);
 bool   WINAPI CascGetFileSize64(HANDLE hFile, PULONGLONG PtrFileSize);
 bool   WINAPI CascSetFilePointer64(HANDLE hFile, LONGLONG DistanceToMove, PULONGLONG PtrNewPos, DWORD dwMoveMethod);
 bool   WINAPI CascReadFile(HANDLE hFile, void * lpBuffer, DWORD dwToRead, PDWORD pdwRead);
+bool   WINAPI CascReadFileAsync(HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PFNREADCALLBACK PfnCallback, void * PtrUserParam);
+bool   WINAPI CascReadFilesBatch(HANDLE hStorage, const CASC_BATCH_ITEM * pItems, size_t nItemCount, PFNBATCHCALLBACK PfnCallback, void * PtrUserParam);
 bool   WINAPI CascCloseFile(HANDLE hFile);
 
 DWORD  WINAPI CascGetFileSize(HANDLE hFile, PDWORD pdwFileSizeHigh);
@@ -397,6 +563,9 @@ HANDLE WINAPI CascFindFirstFile(HANDLE hStorage, LPCSTR szMask, PCASC_FIND_DATA
 bool   WINAPI CascFindNextFile(HANDLE hFind, PCASC_FIND_DATA pFindData);
 bool   WINAPI CascFindClose(HANDLE hFind);
 
+bool   WINAPI CascExtractFiles(HANDLE hStorage, PCASC_EXTRACT_ARGS pArgs, PCASC_EXTRACT_STATS pStats);
+bool   WINAPI CascVerifyStorage(HANDLE hStorage, PCASC_VERIFY_ARGS pArgs, PCASC_VERIFY_REPORT pReport);
+
 bool   WINAPI CascAddEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPBYTE Key);
 bool   WINAPI CascAddStringEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPCSTR szKey);
 bool   WINAPI CascImportKeysFromString(HANDLE hStorage, LPCSTR szKeyList);
@@ -23,12 +23,14 @@ TCascFile::TCascFile(TCascStorage * ahs, PCASC_CKEY_ENTRY apCKeyEntry)
     ClassName = CASC_MAGIC_FILE;
 
     FilePointer = 0;
+    dwRefCount = 1;
     pCKeyEntry = apCKeyEntry;
     SpanCount = (pCKeyEntry->SpanCount != 0) ? pCKeyEntry->SpanCount : 1;
     bVerifyIntegrity = false;
     bDownloadFileIf = false;
     bCloseFileStream = false;
     bFreeCKeyEntries = false;
+    bParallelDecode = false;
 
     // Allocate the array of file spans
     if((pFileSpan = CASC_ALLOC_ZERO<CASC_FILE_SPAN>(SpanCount)) != NULL)
@@ -73,6 +75,24 @@ TCascFile::~TCascFile()
     ClassName = 0;
 }
 
+TCascFile * TCascFile::AddRef()
+{
+    CascInterlockedIncrement(&dwRefCount);
+    return this;
+}
+
+TCascFile * TCascFile::Release()
+{
+    // The file is deleted when the last reference is gone. This can happen
+    // on a worker thread, after the callback of an asynchronous read
+    if(CascInterlockedDecrement(&dwRefCount) == 0)
+    {
+        delete this;
+        return NULL;
+    }
+    return this;
+}
+
 DWORD TCascFile::OpenFileSpans(LPCTSTR szSpanList)
 {
     TFileStream * pStream;
@@ -151,6 +171,7 @@ void TCascFile::InitCacheStrategy()
     CacheStrategy = CascCacheLastFrame;
     FileCacheStart = FileCacheEnd = 0;
     pbFileCache = NULL;
+    pFrameHint = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -202,6 +223,7 @@ bool OpenFileByCKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, DWORD d
             hf->bVerifyIntegrity   = (dwOpenFlags & CASC_STRICT_DATA_CHECK)  ? true : false;
             hf->bDownloadFileIf    = (hs->dwFeatures & CASC_FEATURE_ONLINE)  ? true : false;
             hf->bOvercomeEncrypted = (dwOpenFlags & CASC_OVERCOME_ENCRYPTED) ? true : false;
+            hf->bParallelDecode    = (dwOpenFlags & CASC_PARALLEL_DECODE) || (hs->dwFeatures & CASC_FEATURE_PARALLEL_DECODE);
             dwErrCode = ERROR_SUCCESS;
         }
         else
@@ -447,7 +469,8 @@ bool WINAPI CascCloseFile(HANDLE hFile)
     hf = TCascFile::IsValid(hFile);
     if(hf != NULL)
     {
-        delete hf;
+        // Pending asynchronous reads hold their own references
+        hf->Release();
         return true;
     }
 
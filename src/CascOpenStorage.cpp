@@ -24,6 +24,63 @@
 // Limit for "additional" items in CKey table
 #define CASC_MAX_EXTRA_ITEMS 0x40
 
+// Storage snapshot file
+#define CASC_SNAPSHOT_SIGNATURE   0x504E5343        // 'CSNP'
+#define CASC_SNAPSHOT_VERSION     1
+#define CASC_SNAPSHOT_BLOCK_SIZE  0x01000000        // Snapshot data are read and written by 16 MB blocks
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// Manifest file that is loaded by a background thread while the main thread parses the ENCODING manifest
+struct CASC_PREFETCH
+{
+    CASC_PREFETCH()
+    {
+        memset(&Thread, 0, sizeof(CASC_THREAD));
+        dwErrCode = ERROR_FILE_NOT_FOUND;
+        hs = NULL;
+    }
+
+    ~CASC_PREFETCH()
+    {
+        CascWaitForThread(Thread);
+    }
+
+    TCascStorage * hs;                              // Storage handle. NULL if the file is not being prefetched
+    CASC_CKEY_ENTRY CKeyEntry;                      // CKey entry of the file, as it is going to be inserted from the ENCODING manifest
+    CASC_BLOB FileData;                             // Data of the loaded file
+    CASC_THREAD Thread;                             // The thread that loads the file
+    DWORD dwErrCode;                                // Result of the loading
+};
+
+// Header of the storage snapshot file. The header is followed by:
+// * Array of CASC_CKEY_ENTRY (CKeyEntryCount items)
+// * CKey map as array of DWORD (CKeyMapSize items). Each value is index of the CKey entry + 1, zero means empty slot
+// * EKey map as array of DWORD (EKeyMapSize items)
+// * Array of CASC_TAG_ENTRY2 (TagEntryCount items, each has TagEntrySize bytes)
+struct CASC_SNAPSHOT_HEADER
+{
+    DWORD Signature;                                // CASC_SNAPSHOT_SIGNATURE
+    DWORD Version;                                  // CASC_SNAPSHOT_VERSION
+    DWORD HeaderSize;                               // sizeof(CASC_SNAPSHOT_HEADER)
+    DWORD CKeyEntrySize;                            // sizeof(CASC_CKEY_ENTRY)
+    BYTE StorageStamp[MD5_HASH_SIZE];               // MD5 of the build key, config key and the index files
+    ULONGLONG FileSize;                             // Total size of the snapshot file
+    ULONGLONG CKeyEntryCount;                       // Number of CKey entries
+    ULONGLONG CKeyMapSize;                          // Hash table size of the CKey map
+    ULONGLONG EKeyMapSize;                          // Hash table size of the EKey map
+    ULONGLONG TagEntrySize;                         // Size of one tag entry
+    ULONGLONG TagEntryCount;                        // Number of tag entries
+    ULONGLONG LocalFiles;                           // Value of TCascStorage::LocalFiles
+    ULONGLONG TotalFiles;                           // Value of TCascStorage::TotalFiles
+    CASC_CKEY_ENTRY EncodingCKey;                   // Value of TCascStorage::EncodingCKey
+    DWORD FileOffsetBits;                           // Value of TCascStorage::FileOffsetBits
+    DWORD EKeyLength;                               // Value of TCascStorage::EKeyLength
+    DWORD dwFeatures;                               // Features that are set by loading the manifests (CASC_FEATURE_TAGS)
+    DWORD Padding;
+};
+
 //-----------------------------------------------------------------------------
 // DEBUG functions
 
@@ -68,13 +125,16 @@ TCascStorage::TCascStorage()
     szBuildKey = NULL;
 
     memset(DataFiles, 0, sizeof(DataFiles));
-    memset(IndexFiles, 0, sizeof(IndexFiles));
     CascInitLock(StorageLock);
     dwDefaultLocale = 0;
     dwBuildNumber = 0;
     dwFeatures = 0;
+    dwThreadCount = 1;
+    dwCdnRanges = CASC_CDN_RANGES_UNKNOWN;
     BuildFileType = CascBuildNone;
 
+    pFileIo = NULL;
+    pDecodeQueue = NULL;
     LastFailKeyName = 0;
     LocalFiles = TotalFiles = EKeyEntries = EKeyLength = FileOffsetBits = 0;
     pArgs = NULL;
@@ -87,6 +147,12 @@ TCascStorage::~TCascStorage()
         delete pRootHandler;
     pRootHandler = NULL;
 
+    // Stop the asynchronous reading before the data files are closed
+    FileStream_FreeIo(pFileIo);
+    CascFreeWorkQueue(pDecodeQueue);
+    pFileIo = NULL;
+    pDecodeQueue = NULL;
+
     // Close all data files
     for(size_t i = 0; i < CASC_MAX_DATA_FILES; i++)
     {
@@ -95,6 +161,7 @@ TCascStorage::~TCascStorage()
     }
 
     // Cleanup space occupied by index files
+    FreeArchiveIndexFiles(this);
     FreeIndexFiles(this);
 
     // Cleanup the lock
@@ -210,31 +277,39 @@ static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, CASC_CKEY_ENTRY & CKe
     return pCKeyEntry;
 }
 
+// Initializes the CKey entry from an ENCODING entry
+static bool InitCKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, PFILE_CKEY_ENTRY pFileEntry)
+{
+    // Stop on file-of-interest
+    BREAK_ON_WATCHED(pFileEntry->EKey);
+
+    // Initialize the entry
+    CopyMemory16(pCKeyEntry->CKey, pFileEntry->CKey);
+    CopyMemory16(pCKeyEntry->EKey, pFileEntry->EKey);
+    pCKeyEntry->StorageOffset = CASC_INVALID_OFFS64;
+    pCKeyEntry->TagBitMask = 0;
+    pCKeyEntry->ContentSize = ConvertBytesToInteger_4(pFileEntry->ContentSize);
+    pCKeyEntry->EncodedSize = CASC_INVALID_SIZE;
+    pCKeyEntry->Flags = CASC_CE_HAS_CKEY | CASC_CE_HAS_EKEY | CASC_CE_IN_ENCODING;
+    pCKeyEntry->RefCount = 0;
+    pCKeyEntry->SpanCount = 1;
+    pCKeyEntry->Priority = 0;
+
+    // Copy the information from index files to the CKey entry
+    return CopyEKeyEntry(hs, pCKeyEntry);
+}
+
 // Inserts an entry from ENCODING
 static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, PFILE_CKEY_ENTRY pFileEntry)
 {
     PCASC_CKEY_ENTRY pCKeyEntry;
 
-    // Stop on file-of-interest
-    BREAK_ON_WATCHED(pFileEntry->EKey);
-
     // Insert a new entry to the array. DO NOT ALLOW enlarge array here
     pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.Insert(1, false);
     if(pCKeyEntry != NULL)
     {
         // Initialize the entry
-        CopyMemory16(pCKeyEntry->CKey, pFileEntry->CKey);
-        CopyMemory16(pCKeyEntry->EKey, pFileEntry->EKey);
-        pCKeyEntry->StorageOffset = CASC_INVALID_OFFS64;
-        pCKeyEntry->TagBitMask = 0;
-        pCKeyEntry->ContentSize = ConvertBytesToInteger_4(pFileEntry->ContentSize);
-        pCKeyEntry->EncodedSize = CASC_INVALID_SIZE;
-        pCKeyEntry->Flags = CASC_CE_HAS_CKEY | CASC_CE_HAS_EKEY | CASC_CE_IN_ENCODING;
-        pCKeyEntry->RefCount = 0;
-        pCKeyEntry->SpanCount = 1;
-
-        // Copy the information from index files to the CKey entry
-        CopyEKeyEntry(hs, pCKeyEntry);
+        InitCKeyEntry(hs, pCKeyEntry, pFileEntry);
 
         // Insert the item into both maps
         hs->CKeyMap.InsertObject(pCKeyEntry, pCKeyEntry->CKey);
@@ -435,7 +510,311 @@ static DWORD LoadEncodingCKeyPage(TCascStorage * hs, CASC_ENCODING_HEADER & EnHe
     return ERROR_SUCCESS;
 }
 
-static DWORD LoadEncodingManifest(TCascStorage * hs)
+static DWORD CheckEncodingCKeyPage(CASC_ENCODING_HEADER & EnHeader, PFILE_CKEY_PAGE pPageHeader, LPBYTE pbCKeyPage, LPBYTE pbEncodingEnd)
+{
+    // Check if there is enough space in the buffer
+    if((pbCKeyPage + EnHeader.CKeyPageSize) > pbEncodingEnd)
+        return ERROR_FILE_CORRUPT;
+
+    // Check the hash of the entire segment
+    // Note that verifying takes considerable time of the storage loading
+//  if(!VerifyDataBlockHash(pbCKeyPage, EnHeader.CKeyPageSize, pPageHeader->SegmentHash))
+//      return ERROR_FILE_CORRUPT;
+
+    // Check if the CKey matches with the expected first value
+    if(memcmp(((PFILE_CKEY_ENTRY)pbCKeyPage)->CKey, pPageHeader->FirstKey, MD5_HASH_SIZE))
+        return ERROR_FILE_CORRUPT;
+
+    return ERROR_SUCCESS;
+}
+
+static DWORD LoadEncodingCKeyPages(TCascStorage * hs, CASC_ENCODING_HEADER & EnHeader, PFILE_CKEY_PAGE pPageHeader, LPBYTE pbCKeyPage, LPBYTE pbEncodingEnd)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Go through all CKey pages and verify them
+    for(DWORD i = 0; i < EnHeader.CKeyPageCount; i++)
+    {
+        // Verify the page
+        if((dwErrCode = CheckEncodingCKeyPage(EnHeader, pPageHeader + i, pbCKeyPage, pbEncodingEnd)) != ERROR_SUCCESS)
+            break;
+
+        // Load the entire page of CKey entries.
+        // This operation will never fail, because all memory is already pre-allocated
+        dwErrCode = LoadEncodingCKeyPage(hs, EnHeader, pbCKeyPage, pbCKeyPage + EnHeader.CKeyPageSize);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+
+        // Move to the next CKey page
+        pbCKeyPage += EnHeader.CKeyPageSize;
+    }
+
+    return dwErrCode;
+}
+
+// Information about one CKey page, for loading the pages in parallel
+struct CASC_ENCODING_PAGE
+{
+    size_t FirstEntry;                              // Index of the first CKey entry of the page, relative to the first ENCODING entry
+    size_t EntryCount;                              // Number of CKey entries in the page
+    size_t NewCKeys;                                // Number of items that the page added to the CKey map
+    size_t NewEKeys;                                // Number of items that the page added to the EKey map
+};
+
+// Context for loading the CKey pages in parallel
+struct CASC_ENCODING_LOAD
+{
+    TCascStorage * hs;
+    CASC_ENCODING_HEADER * pEnHeader;
+    CASC_ENCODING_PAGE * pPages;                    // Information about each page
+    PCASC_CKEY_ENTRY pCKeyEntries;                  // The first CKey entry reserved for the ENCODING entries
+    LPBYTE pbCKeyPages;                             // Begin of the first CKey page
+};
+
+// Phase 1: Count the entries in the page
+static DWORD CountEncodingCKeyPage_Worker(void * pvContext, DWORD dwPageIndex)
+{
+    CASC_ENCODING_LOAD * pLoad = (CASC_ENCODING_LOAD *)pvContext;
+    CASC_ENCODING_HEADER & EnHeader = *pLoad->pEnHeader;
+    PFILE_CKEY_ENTRY pFileEntry;
+    LPBYTE pbFileEntry = pLoad->pbCKeyPages + (size_t)dwPageIndex * EnHeader.CKeyPageSize;
+    LPBYTE pbEndOfPage = pbFileEntry + EnHeader.CKeyPageSize;
+    size_t EntryCount = 0;
+
+    // Use the same walk as LoadEncodingCKeyPage
+    while(pbFileEntry < pbEndOfPage)
+    {
+        pFileEntry = (PFILE_CKEY_ENTRY)pbFileEntry;
+        if(pFileEntry->EKeyCount == 0)
+            break;
+
+        pbFileEntry = pbFileEntry + 2 + 4 + EnHeader.CKeyLength + (pFileEntry->EKeyCount * EnHeader.EKeyLength);
+        EntryCount++;
+    }
+
+    pLoad->pPages[dwPageIndex].EntryCount = EntryCount;
+    return ERROR_SUCCESS;
+}
+
+// Phase 2: Fill the page's slice of the CKey array
+static DWORD LoadEncodingCKeyPage_Worker(void * pvContext, DWORD dwPageIndex)
+{
+    CASC_ENCODING_LOAD * pLoad = (CASC_ENCODING_LOAD *)pvContext;
+    CASC_ENCODING_HEADER & EnHeader = *pLoad->pEnHeader;
+    CASC_ENCODING_PAGE & Page = pLoad->pPages[dwPageIndex];
+    PCASC_CKEY_ENTRY pCKeyEntry = pLoad->pCKeyEntries + Page.FirstEntry;
+    PFILE_CKEY_ENTRY pFileEntry;
+    LPBYTE pbFileEntry = pLoad->pbCKeyPages + (size_t)dwPageIndex * EnHeader.CKeyPageSize;
+
+    for(size_t i = 0; i < Page.EntryCount; i++, pCKeyEntry++)
+    {
+        pFileEntry = (PFILE_CKEY_ENTRY)pbFileEntry;
+        InitCKeyEntry(pLoad->hs, pCKeyEntry, pFileEntry);
+        pbFileEntry = pbFileEntry + 2 + 4 + EnHeader.CKeyLength + (pFileEntry->EKeyCount * EnHeader.EKeyLength);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Phase 3: Insert the page's CKey entries to both maps
+static DWORD InsertEncodingCKeyPage_Worker(void * pvContext, DWORD dwPageIndex)
+{
+    CASC_ENCODING_LOAD * pLoad = (CASC_ENCODING_LOAD *)pvContext;
+    CASC_ENCODING_PAGE & Page = pLoad->pPages[dwPageIndex];
+    PCASC_CKEY_ENTRY pCKeyEntry = pLoad->pCKeyEntries + Page.FirstEntry;
+    TCascStorage * hs = pLoad->hs;
+
+    for(size_t i = 0; i < Page.EntryCount; i++, pCKeyEntry++)
+    {
+        if(hs->CKeyMap.InsertObject_Concurrent(pCKeyEntry, pCKeyEntry->CKey))
+            Page.NewCKeys++;
+        if(hs->EKeyMap.InsertObject_Concurrent(pCKeyEntry, pCKeyEntry->EKey))
+            Page.NewEKeys++;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Loads the CKey pages using multiple threads. The result is the same
+// as if the pages were loaded one-by-one by LoadEncodingCKeyPages
+static DWORD LoadEncodingCKeyPages_Parallel(TCascStorage * hs, CASC_ENCODING_HEADER & EnHeader, PFILE_CKEY_PAGE pPageHeader, LPBYTE pbCKeyPage, LPBYTE pbEncodingEnd)
+{
+    CASC_ENCODING_LOAD Load;
+    size_t TotalEntries = 0;
+    size_t NewCKeys = 0;
+    size_t NewEKeys = 0;
+    DWORD dwPageCount = EnHeader.CKeyPageCount;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Verify all pages first
+    for(DWORD i = 0; i < dwPageCount; i++)
+    {
+        if((dwErrCode = CheckEncodingCKeyPage(EnHeader, pPageHeader + i, pbCKeyPage + (size_t)i * EnHeader.CKeyPageSize, pbEncodingEnd)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // Allocate the array of page information
+    if(dwPageCount == 0)
+        return ERROR_SUCCESS;
+    if((Load.pPages = CASC_ALLOC_ZERO<CASC_ENCODING_PAGE>(dwPageCount)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    Load.hs = hs;
+    Load.pEnHeader = &EnHeader;
+    Load.pbCKeyPages = pbCKeyPage;
+    Load.pCKeyEntries = NULL;
+
+    // Phase 1: Count the entries in each page and assign each page its slice of the CKey array
+    dwErrCode = CascRunParallel(CountEncodingCKeyPage_Worker, &Load, dwPageCount, hs->dwThreadCount);
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        for(DWORD i = 0; i < dwPageCount; i++)
+        {
+            Load.pPages[i].FirstEntry = TotalEntries;
+            TotalEntries += Load.pPages[i].EntryCount;
+        }
+
+        // If the CKey array or the maps can't hold all entries, we let the single-threaded loading
+        // handle the situation. DO NOT ALLOW enlarge array here, because the pointers to the entries must stay valid
+        if((hs->CKeyMap.ItemCount() + TotalEntries) < hs->CKeyMap.HashTableSize() && (hs->EKeyMap.ItemCount() + TotalEntries) < hs->EKeyMap.HashTableSize())
+            Load.pCKeyEntries = (PCASC_CKEY_ENTRY)hs->CKeyArray.Insert(TotalEntries, false);
+        if(Load.pCKeyEntries == NULL)
+        {
+            CASC_FREE(Load.pPages);
+            return LoadEncodingCKeyPages(hs, EnHeader, pPageHeader, pbCKeyPage, pbEncodingEnd);
+        }
+    }
+
+    // Phase 2: Fill the CKey entries
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        dwErrCode = CascRunParallel(LoadEncodingCKeyPage_Worker, &Load, dwPageCount, hs->dwThreadCount);
+    }
+
+    // Phase 3: Insert the CKey entries to the maps
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        dwErrCode = CascRunParallel(InsertEncodingCKeyPage_Worker, &Load, dwPageCount, hs->dwThreadCount);
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            for(DWORD i = 0; i < dwPageCount; i++)
+            {
+                NewCKeys += Load.pPages[i].NewCKeys;
+                NewEKeys += Load.pPages[i].NewEKeys;
+            }
+
+            hs->CKeyMap.AddItemCount(NewCKeys);
+            hs->EKeyMap.AddItemCount(NewEKeys);
+        }
+    }
+
+    CASC_FREE(Load.pPages);
+    return dwErrCode;
+}
+
+// Finds the CKey in the loaded ENCODING manifest and prepares the CKey entry
+// the same way as InsertCKeyEntry(PFILE_CKEY_ENTRY) does
+static bool FindEncodingCKeyEntry(
+    TCascStorage * hs,
+    CASC_ENCODING_HEADER & EnHeader,
+    PFILE_CKEY_PAGE pPageHeader,
+    LPBYTE pbCKeyPages,
+    LPBYTE pbEncodingEnd,
+    LPBYTE pbCKey,
+    CASC_CKEY_ENTRY & CKeyEntry)
+{
+    PFILE_CKEY_ENTRY pFileEntry;
+    LPBYTE pbFileEntry;
+    LPBYTE pbEndOfPage;
+    DWORD nMinIndex = 0;
+    DWORD nMaxIndex = EnHeader.CKeyPageCount;
+
+    // The pages are sorted by their first CKey. Find the last page whose first CKey is not greater
+    while(nMinIndex < nMaxIndex)
+    {
+        DWORD nMidIndex = (nMinIndex + nMaxIndex) / 2;
+
+        if(memcmp(pPageHeader[nMidIndex].FirstKey, pbCKey, MD5_HASH_SIZE) <= 0)
+            nMinIndex = nMidIndex + 1;
+        else
+            nMaxIndex = nMidIndex;
+    }
+
+    // Check whether the page is within the file
+    if(nMinIndex == 0)
+        return false;
+    pbFileEntry = pbCKeyPages + (size_t)(nMinIndex - 1) * EnHeader.CKeyPageSize;
+    pbEndOfPage = pbFileEntry + EnHeader.CKeyPageSize;
+    if(pbEndOfPage > pbEncodingEnd)
+        return false;
+
+    // Search the entries of the page
+    while((pbFileEntry + sizeof(FILE_CKEY_ENTRY)) <= pbEndOfPage)
+    {
+        pFileEntry = (PFILE_CKEY_ENTRY)pbFileEntry;
+        if(pFileEntry->EKeyCount == 0)
+            break;
+
+        if(!memcmp(pFileEntry->CKey, pbCKey, MD5_HASH_SIZE))
+        {
+            CKeyEntry.Init();
+            return InitCKeyEntry(hs, &CKeyEntry, pFileEntry);
+        }
+
+        pbFileEntry = pbFileEntry + 2 + 4 + EnHeader.CKeyLength + (pFileEntry->EKeyCount * EnHeader.EKeyLength);
+    }
+
+    return false;
+}
+
+static void PrefetchManifest_Thread(void * pvParam)
+{
+    CASC_PREFETCH * pPrefetch = (CASC_PREFETCH *)pvParam;
+
+    pPrefetch->dwErrCode = LoadInternalFileToMemory(pPrefetch->hs, &pPrefetch->CKeyEntry, pPrefetch->FileData);
+}
+
+// Starts loading a manifest file in a background thread. Only done for local storages,
+// because online storages may need to download the file, which invokes the progress callback
+static void PrefetchManifest(
+    TCascStorage * hs,
+    CASC_PREFETCH & Prefetch,
+    CASC_ENCODING_HEADER & EnHeader,
+    PFILE_CKEY_PAGE pPageHeader,
+    LPBYTE pbCKeyPages,
+    LPBYTE pbEncodingEnd,
+    CASC_CKEY_ENTRY & CKeyEntry)
+{
+    if(hs->dwThreadCount > 1 && (hs->dwFeatures & CASC_FEATURE_ONLINE) == 0 && (CKeyEntry.Flags & CASC_CE_HAS_CKEY))
+    {
+        if(FindEncodingCKeyEntry(hs, EnHeader, pPageHeader, pbCKeyPages, pbEncodingEnd, CKeyEntry.CKey, Prefetch.CKeyEntry))
+        {
+            Prefetch.hs = hs;
+            CascCreateThread(Prefetch.Thread, PrefetchManifest_Thread, &Prefetch);
+        }
+    }
+}
+
+// Gives the prefetched manifest file, if it has been loaded for the same CKey entry
+static bool GetPrefetchedManifest(CASC_PREFETCH & Prefetch, PCASC_CKEY_ENTRY pCKeyEntry, CASC_BLOB & FileData)
+{
+    // Wait until the file is loaded
+    CascWaitForThread(Prefetch.Thread);
+
+    // The prefetched file must have the same EKey and size
+    if(Prefetch.hs != NULL && Prefetch.dwErrCode == ERROR_SUCCESS && pCKeyEntry != NULL)
+    {
+        if(!memcmp(Prefetch.CKeyEntry.EKey, pCKeyEntry->EKey, MD5_HASH_SIZE) && Prefetch.CKeyEntry.ContentSize == pCKeyEntry->ContentSize)
+        {
+            FileData.MoveFrom(Prefetch.FileData);
+            Prefetch.hs = NULL;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static DWORD LoadEncodingManifest(TCascStorage * hs, CASC_PREFETCH & PrefetchDownload, CASC_PREFETCH & PrefetchRoot)
 {
     CASC_CKEY_ENTRY & CKeyEntry = hs->EncodingCKey;
     CASC_BLOB EncodingFile;
@@ -465,40 +844,15 @@ static DWORD LoadEncodingManifest(TCascStorage * hs)
             LPBYTE pbEncodingEnd = EncodingFile.pbData + EncodingFile.cbData;
             LPBYTE pbCKeyPage = (LPBYTE)(pPageHeader + EnHeader.CKeyPageCount);
 
-            // Go through all CKey pages and verify them
-            for(DWORD i = 0; i < EnHeader.CKeyPageCount; i++)
-            {
-                // Check if there is enough space in the buffer
-                if((pbCKeyPage + EnHeader.CKeyPageSize) > pbEncodingEnd)
-                {
-                    dwErrCode = ERROR_FILE_CORRUPT;
-                    break;
-                }
-
-                // Check the hash of the entire segment
-                // Note that verifying takes considerable time of the storage loading
-//              if(!VerifyDataBlockHash(pbCKeyPage, EnHeader.CKeyPageSize, pEncodingSegment->SegmentHash))
-//              {
-//                  dwErrCode = ERROR_FILE_CORRUPT;
-//                  break;
-//              }
+            // Let the DOWNLOAD and ROOT manifests load in background while we parse the ENCODING
+            PrefetchManifest(hs, PrefetchDownload, EnHeader, pPageHeader, pbCKeyPage, pbEncodingEnd, hs->DownloadCKey);
+            PrefetchManifest(hs, PrefetchRoot, EnHeader, pPageHeader, pbCKeyPage, pbEncodingEnd, (hs->VfsRoot.ContentSize != CASC_INVALID_SIZE) ? hs->VfsRoot : hs->RootFile);
 
-                // Check if the CKey matches with the expected first value
-                if(memcmp(((PFILE_CKEY_ENTRY)pbCKeyPage)->CKey, pPageHeader[i].FirstKey, MD5_HASH_SIZE))
-                {
-                    dwErrCode = ERROR_FILE_CORRUPT;
-                    break;
-                }
-
-                // Load the entire page of CKey entries.
-                // This operation will never fail, because all memory is already pre-allocated
-                dwErrCode = LoadEncodingCKeyPage(hs, EnHeader, pbCKeyPage, pbCKeyPage + EnHeader.CKeyPageSize);
-                if(dwErrCode != ERROR_SUCCESS)
-                    break;
-
-                // Move to the next CKey page
-                pbCKeyPage += EnHeader.CKeyPageSize;
-            }
+            // Load all CKey pages, using multiple threads if allowed
+            if(hs->dwThreadCount > 1)
+                dwErrCode = LoadEncodingCKeyPages_Parallel(hs, EnHeader, pPageHeader, pbCKeyPage, pbEncodingEnd);
+            else
+                dwErrCode = LoadEncodingCKeyPages(hs, EnHeader, pPageHeader, pbCKeyPage, pbEncodingEnd);
         }
 
         // All CKey->EKey entries from the text build files need to be copied to the CKey array
@@ -746,7 +1100,7 @@ static int LoadDownloadManifest(TCascStorage * hs, CASC_DOWNLOAD_HEADER & DlHead
     return dwErrCode;
 }
 
-static int LoadDownloadManifest(TCascStorage * hs)
+static int LoadDownloadManifest(TCascStorage * hs, CASC_PREFETCH & Prefetch)
 {
     PCASC_CKEY_ENTRY pCKeyEntry = FindCKeyEntry_CKey(hs, hs->DownloadCKey.CKey);
     CASC_BLOB DownloadFile;
@@ -756,8 +1110,9 @@ static int LoadDownloadManifest(TCascStorage * hs)
     if(InvokeProgressCallback(hs, "Loading DOWNLOAD manifest", NULL, 0, 0))
         return ERROR_CANCELLED;
 
-    // Load the entire DOWNLOAD file to memory
-    dwErrCode = LoadInternalFileToMemory(hs, pCKeyEntry, DownloadFile);
+    // Load the entire DOWNLOAD file to memory, unless it has already been prefetched
+    if(!GetPrefetchedManifest(Prefetch, pCKeyEntry, DownloadFile))
+        dwErrCode = LoadInternalFileToMemory(hs, pCKeyEntry, DownloadFile);
     if(dwErrCode == ERROR_SUCCESS && DownloadFile.cbData != 0)
     {
         CASC_DOWNLOAD_HEADER DlHeader;
@@ -775,6 +1130,280 @@ static int LoadDownloadManifest(TCascStorage * hs)
     return dwErrCode;
 }
 
+//-----------------------------------------------------------------------------
+// Storage snapshot. Contains the state of the storage after loading the ENCODING and
+// DOWNLOAD manifests. The index files are mapped even if the snapshot is used, so the
+// snapshot only stores the values derived from them. Only supported for local storages.
+
+static bool GetStorageStamp(TCascStorage * hs, LPBYTE StorageStamp)
+{
+    MD5_CTX md5_ctx;
+
+    // Online storages don't have local index files
+    if(hs->dwFeatures & CASC_FEATURE_ONLINE)
+        return false;
+    if(hs->BuildFileType != CascBuildInfo && hs->BuildFileType != CascBuildDb)
+        return false;
+    if(hs->CdnBuildKey.cbData == 0)
+        return false;
+
+    // Hash the build, config and the state of the index files
+    MD5_Init(&md5_ctx);
+    MD5_Update(&md5_ctx, hs->CdnBuildKey.pbData, (unsigned long)hs->CdnBuildKey.cbData);
+    MD5_Update(&md5_ctx, hs->CdnConfigKey.pbData, (unsigned long)hs->CdnConfigKey.cbData);
+    if(HashLocalIndexFiles(hs, md5_ctx) != ERROR_SUCCESS)
+        return false;
+    MD5_Final(StorageStamp, &md5_ctx);
+    return true;
+}
+
+static bool ReadSnapshotData(TFileStream * pStream, ULONGLONG & ByteOffset, void * pvBuffer, size_t cbLength)
+{
+    LPBYTE pbBuffer = (LPBYTE)pvBuffer;
+
+    while(cbLength != 0)
+    {
+        DWORD dwBytesToRead = (DWORD)CASCLIB_MIN(cbLength, CASC_SNAPSHOT_BLOCK_SIZE);
+
+        if(!FileStream_Read(pStream, &ByteOffset, pbBuffer, dwBytesToRead))
+            return false;
+
+        ByteOffset += dwBytesToRead;
+        pbBuffer += dwBytesToRead;
+        cbLength -= dwBytesToRead;
+    }
+    return true;
+}
+
+static bool WriteSnapshotData(TFileStream * pStream, ULONGLONG & ByteOffset, const void * pvBuffer, size_t cbLength)
+{
+    const BYTE * pbBuffer = (const BYTE *)pvBuffer;
+
+    while(cbLength != 0)
+    {
+        DWORD dwBytesToWrite = (DWORD)CASCLIB_MIN(cbLength, CASC_SNAPSHOT_BLOCK_SIZE);
+
+        if(!FileStream_Write(pStream, &ByteOffset, pbBuffer, dwBytesToWrite))
+            return false;
+
+        ByteOffset += dwBytesToWrite;
+        pbBuffer += dwBytesToWrite;
+        cbLength -= dwBytesToWrite;
+    }
+    return true;
+}
+
+static bool ReadSnapshotMap(TFileStream * pStream, ULONGLONG & ByteOffset, CASC_MAP & Map, PCASC_CKEY_ENTRY pCKeyEntries, size_t nCKeyEntries)
+{
+    PDWORD SlotArray;
+    size_t nHashTableSize = Map.HashTableSize();
+    bool bResult = false;
+
+    if((SlotArray = CASC_ALLOC<DWORD>(nHashTableSize)) != NULL)
+    {
+        if(ReadSnapshotData(pStream, ByteOffset, SlotArray, nHashTableSize * sizeof(DWORD)))
+        {
+            // Verify all slots before the map is modified
+            bResult = true;
+            for(size_t i = 0; i < nHashTableSize; i++)
+            {
+                if(SlotArray[i] > nCKeyEntries)
+                {
+                    bResult = false;
+                    break;
+                }
+            }
+
+            // Restore the map
+            for(size_t i = 0; bResult && i < nHashTableSize; i++)
+            {
+                if(SlotArray[i] != 0)
+                {
+                    Map.SetItemAt(i, pCKeyEntries + SlotArray[i] - 1);
+                }
+            }
+        }
+        CASC_FREE(SlotArray);
+    }
+    return bResult;
+}
+
+static bool WriteSnapshotMap(TFileStream * pStream, ULONGLONG & ByteOffset, CASC_MAP & Map, PCASC_CKEY_ENTRY pCKeyEntries)
+{
+    PDWORD SlotArray;
+    size_t nHashTableSize = Map.HashTableSize();
+    bool bResult = false;
+
+    if((SlotArray = CASC_ALLOC<DWORD>(nHashTableSize)) != NULL)
+    {
+        for(size_t i = 0; i < nHashTableSize; i++)
+        {
+            PCASC_CKEY_ENTRY pCKeyEntry = (PCASC_CKEY_ENTRY)Map.ItemAt(i);
+            SlotArray[i] = (pCKeyEntry != NULL) ? (DWORD)(pCKeyEntry - pCKeyEntries + 1) : 0;
+        }
+
+        bResult = WriteSnapshotData(pStream, ByteOffset, SlotArray, nHashTableSize * sizeof(DWORD));
+        CASC_FREE(SlotArray);
+    }
+    return bResult;
+}
+
+static bool LoadStorageSnapshot(TCascStorage * hs, LPCTSTR szSnapshotFile, LPBYTE StorageStamp)
+{
+    CASC_SNAPSHOT_HEADER SnapHeader;
+    PCASC_CKEY_ENTRY pCKeyEntries = NULL;
+    TFileStream * pStream;
+    ULONGLONG FileSize = 0;
+    ULONGLONG ByteOffset = 0;
+    bool bResult = false;
+
+    // The snapshot is loaded into empty storage structures
+    assert(hs->CKeyArray.ItemCount() == 0 && hs->CKeyMap.ItemCount() == 0 && hs->EKeyMap.ItemCount() == 0);
+
+    // Open the snapshot file. Note that we don't map the file, because it can be truncated by another process
+    pStream = FileStream_OpenFile(szSnapshotFile, STREAM_FLAG_READ_ONLY | STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+    if(pStream == NULL)
+        return false;
+
+    // Load and verify the snapshot header
+    FileStream_GetSize(pStream, &FileSize);
+    if(ReadSnapshotData(pStream, ByteOffset, &SnapHeader, sizeof(CASC_SNAPSHOT_HEADER)))
+    {
+        if(SnapHeader.Signature == CASC_SNAPSHOT_SIGNATURE &&
+           SnapHeader.Version == CASC_SNAPSHOT_VERSION &&
+           SnapHeader.HeaderSize == sizeof(CASC_SNAPSHOT_HEADER) &&
+           SnapHeader.CKeyEntrySize == sizeof(CASC_CKEY_ENTRY) &&
+           SnapHeader.FileSize == FileSize &&
+           SnapHeader.CKeyEntryCount <= hs->CKeyArray.ItemCountMax() &&
+           SnapHeader.CKeyMapSize == hs->CKeyMap.HashTableSize() &&
+           SnapHeader.EKeyMapSize == hs->EKeyMap.HashTableSize() &&
+           !memcmp(SnapHeader.StorageStamp, StorageStamp, MD5_HASH_SIZE))
+        {
+            bResult = true;
+        }
+    }
+
+    // Load the array of CKey entries
+    if(bResult)
+    {
+        size_t nCKeyEntries = (size_t)SnapHeader.CKeyEntryCount;
+
+        bResult = false;
+        if((pCKeyEntries = (PCASC_CKEY_ENTRY)hs->CKeyArray.Insert(nCKeyEntries, false)) != NULL)
+        {
+            if(ReadSnapshotData(pStream, ByteOffset, pCKeyEntries, nCKeyEntries * sizeof(CASC_CKEY_ENTRY)))
+            {
+                if(ReadSnapshotMap(pStream, ByteOffset, hs->CKeyMap, pCKeyEntries, nCKeyEntries))
+                {
+                    bResult = ReadSnapshotMap(pStream, ByteOffset, hs->EKeyMap, pCKeyEntries, nCKeyEntries);
+                }
+            }
+        }
+    }
+
+    // Load the tags
+    if(bResult && SnapHeader.TagEntryCount != 0)
+    {
+        size_t nTagEntryCount = (size_t)SnapHeader.TagEntryCount;
+        size_t nTagEntrySize = (size_t)SnapHeader.TagEntrySize;
+        void * pvTagEntries;
+
+        bResult = false;
+        if(nTagEntrySize >= sizeof(CASC_TAG_ENTRY2) && hs->TagsArray.Create(nTagEntrySize, nTagEntryCount) == ERROR_SUCCESS)
+        {
+            if((pvTagEntries = hs->TagsArray.Insert(nTagEntryCount)) != NULL)
+            {
+                bResult = ReadSnapshotData(pStream, ByteOffset, pvTagEntries, nTagEntryCount * nTagEntrySize);
+            }
+        }
+    }
+
+    // Restore the rest of the storage state
+    if(bResult)
+    {
+        hs->EncodingCKey = SnapHeader.EncodingCKey;
+        hs->FileOffsetBits = SnapHeader.FileOffsetBits;
+        hs->EKeyLength = SnapHeader.EKeyLength;
+        hs->LocalFiles = (size_t)SnapHeader.LocalFiles;
+        hs->TotalFiles = (size_t)SnapHeader.TotalFiles;
+        hs->dwFeatures |= (SnapHeader.dwFeatures & CASC_FEATURE_TAGS);
+    }
+    else
+    {
+        // The snapshot is invalid. Revert the storage to the state before loading
+        if(hs->CKeyArray.ItemCount() != 0)
+        {
+            hs->CKeyArray.Reset();
+            hs->CKeyMap.Reset();
+            hs->EKeyMap.Reset();
+        }
+        hs->TagsArray.Free();
+    }
+
+    FileStream_Close(pStream);
+    return bResult;
+}
+
+static void SaveStorageSnapshot(TCascStorage * hs, LPCTSTR szSnapshotFile, LPBYTE StorageStamp)
+{
+    CASC_SNAPSHOT_HEADER SnapHeader = {};
+    CASC_PATH<TCHAR> TempPath(szSnapshotFile, NULL);
+    PCASC_CKEY_ENTRY pCKeyEntries = (PCASC_CKEY_ENTRY)hs->CKeyArray.ItemArray();
+    TFileStream * pStream;
+    ULONGLONG ByteOffset = sizeof(CASC_SNAPSHOT_HEADER);
+    bool bResult;
+
+    // Prepare the snapshot header
+    SnapHeader.Signature = CASC_SNAPSHOT_SIGNATURE;
+    SnapHeader.Version = CASC_SNAPSHOT_VERSION;
+    SnapHeader.HeaderSize = sizeof(CASC_SNAPSHOT_HEADER);
+    SnapHeader.CKeyEntrySize = sizeof(CASC_CKEY_ENTRY);
+    memcpy(SnapHeader.StorageStamp, StorageStamp, MD5_HASH_SIZE);
+    SnapHeader.CKeyEntryCount = hs->CKeyArray.ItemCount();
+    SnapHeader.CKeyMapSize = hs->CKeyMap.HashTableSize();
+    SnapHeader.EKeyMapSize = hs->EKeyMap.HashTableSize();
+    SnapHeader.TagEntrySize = hs->TagsArray.ItemSize();
+    SnapHeader.TagEntryCount = hs->TagsArray.ItemCount();
+    SnapHeader.LocalFiles = hs->LocalFiles;
+    SnapHeader.TotalFiles = hs->TotalFiles;
+    SnapHeader.EncodingCKey = hs->EncodingCKey;
+    SnapHeader.FileOffsetBits = hs->FileOffsetBits;
+    SnapHeader.EKeyLength = (DWORD)hs->EKeyLength;
+    SnapHeader.dwFeatures = (hs->dwFeatures & CASC_FEATURE_TAGS);
+
+    // Create the snapshot under a temporary name. The existing snapshot
+    // is only replaced when the new one has been completely written
+    TempPath.AppendString(_T(".tmp"), false);
+    pStream = FileStream_CreateFile(TempPath, STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+    if(pStream != NULL)
+    {
+        // Write the data first. The header goes last, so an incomplete snapshot is never accepted
+        bResult = WriteSnapshotData(pStream, ByteOffset, pCKeyEntries, hs->CKeyArray.ItemCount() * sizeof(CASC_CKEY_ENTRY));
+        if(bResult)
+            bResult = WriteSnapshotMap(pStream, ByteOffset, hs->CKeyMap, pCKeyEntries);
+        if(bResult)
+            bResult = WriteSnapshotMap(pStream, ByteOffset, hs->EKeyMap, pCKeyEntries);
+        if(bResult && SnapHeader.TagEntryCount != 0)
+            bResult = WriteSnapshotData(pStream, ByteOffset, hs->TagsArray.ItemArray(), (size_t)(SnapHeader.TagEntryCount * SnapHeader.TagEntrySize));
+
+        // Write the header
+        if(bResult)
+        {
+            SnapHeader.FileSize = ByteOffset;
+            ByteOffset = 0;
+            bResult = WriteSnapshotData(pStream, ByteOffset, &SnapHeader, sizeof(CASC_SNAPSHOT_HEADER));
+        }
+
+        // Replace the old snapshot with the new one. Delete the new one on failure
+        if(bResult)
+            bResult = FileStream_Rename(pStream, szSnapshotFile);
+        else
+            FileStream_Close(pStream);
+        if(bResult == false)
+            _tremove(TempPath);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // INSTALL manifest. This is a replacement for ROOT, if loading ROOT fails
 // https://wowdev.wiki/TACT#Install_manifest
@@ -841,7 +1470,7 @@ static bool InsertWellKnownFile(TCascStorage * hs, const char * szFileName, CASC
     return false;
 }
 
-static int LoadBuildManifest(TCascStorage * hs, DWORD dwLocaleMask)
+static int LoadBuildManifest(TCascStorage * hs, DWORD dwLocaleMask, CASC_PREFETCH & Prefetch)
 {
     PCASC_CKEY_ENTRY pCKeyEntry = &hs->RootFile;
     TRootHandler * pOldRootHandler = NULL;
@@ -866,9 +1495,12 @@ static int LoadBuildManifest(TCascStorage * hs, DWORD dwLocaleMask)
 
 __LoadRootFile:
 
-    // Load the entire ROOT file to memory
+    // Load the entire ROOT file to memory, unless it has already been prefetched
     pCKeyEntry = FindCKeyEntry_CKey(hs, pCKeyEntry->CKey);
-    dwErrCode = LoadInternalFileToMemory(hs, pCKeyEntry, RootFile);
+    if(GetPrefetchedManifest(Prefetch, pCKeyEntry, RootFile))
+        dwErrCode = ERROR_SUCCESS;
+    else
+        dwErrCode = LoadInternalFileToMemory(hs, pCKeyEntry, RootFile);
     if(dwErrCode == ERROR_SUCCESS)
     {
         // Ignore ROOT files that contain just a MD5 hash
@@ -1085,14 +1717,37 @@ static bool GetStoragePathProduct(TCascStorage * hs, void * pvStorageInfo, size_
     return (szBuffer != NULL);
 }
 
+static bool GetStorageFrameCacheInfo(TCascStorage * hs, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded)
+{
+    PCASC_FRAME_CACHE_INFO pCacheInfo;
+
+    // Verify whether we have enough space in the buffer
+    pCacheInfo = (PCASC_FRAME_CACHE_INFO)ProbeOutputBuffer(pvStorageInfo, cbStorageInfo, sizeof(CASC_FRAME_CACHE_INFO), pcbLengthNeeded);
+    if(pCacheInfo != NULL)
+    {
+        // If the frame cache is disabled, all values are zero
+        memset(pCacheInfo, 0, sizeof(CASC_FRAME_CACHE_INFO));
+        hs->FrameCache.GetInfo(pCacheInfo);
+    }
+
+    return (pCacheInfo != NULL);
+}
+
 static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, LPCTSTR szMainFile, CBLD_TYPE BuildFileType, DWORD dwFeatures)
 {
+    CASC_PREFETCH PrefetchDownload;
+    CASC_PREFETCH PrefetchRoot;
+    LPCTSTR szSnapshotFile = NULL;
     LPCTSTR szCdnHostUrl = NULL;
     LPCTSTR szCodeName = NULL;
     LPCTSTR szRegion = NULL;
     LPCTSTR szBuildKey = NULL;
+    size_t FrameCacheSize = 0;
+    DWORD dwThreadCount = 0;
     DWORD dwLocaleMask = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
+    BYTE StorageStamp[MD5_HASH_SIZE];
+    bool bSnapshotLoaded = false;
 
     // Pass the argument array to the storage
     hs->pArgs = pArgs;
@@ -1116,9 +1771,20 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, L
     if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szBuildKey), &szBuildKey) && szBuildKey != NULL)
         hs->szBuildKey = CascNewStrT2A(szBuildKey);
 
+    // Create the cache of decoded frames (optional)
+    if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, FrameCacheSize), &FrameCacheSize) && FrameCacheSize != 0)
+        dwErrCode = hs->FrameCache.Create(FrameCacheSize);
+
+    // Extract the number of threads for loading the storage (optional)
+    if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, dwThreadCount), &dwThreadCount) && dwThreadCount > 1)
+        hs->dwThreadCount = dwThreadCount;
+
+    // Extract the name of the snapshot file (optional)
+    ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szSnapshotFile), &szSnapshotFile);
+
     // Merge features
     hs->dwFeatures |= (dwFeatures & (CASC_FEATURE_DATA_ARCHIVES | CASC_FEATURE_DATA_FILES | CASC_FEATURE_ONLINE));
-    hs->dwFeatures |= (pArgs->dwFlags & CASC_FEATURE_FORCE_DOWNLOAD);
+    hs->dwFeatures |= (pArgs->dwFlags & (CASC_FEATURE_FORCE_DOWNLOAD | CASC_FEATURE_MAP_DATA_FILES | CASC_FEATURE_PARALLEL_DECODE));
     hs->dwFeatures |= (BuildFileType == CascVersions) ? CASC_FEATURE_ONLINE : 0;
     hs->BuildFileType = BuildFileType;
 
@@ -1130,7 +1796,7 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, L
     hs->szRootPath = RootPath.New(true);
 
     // If either of the root path or build file is known, it's an error
-    if(hs->szRootPath == NULL || hs->szMainFile == NULL)
+    if(dwErrCode == ERROR_SUCCESS && (hs->szRootPath == NULL || hs->szMainFile == NULL))
     {
         dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
     }
@@ -1194,22 +1860,36 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, L
         dwErrCode = InitCKeyArray(hs);
     }
 
-    // Pre-load the local index files
+    // Pre-load the local index files. This is also done with a snapshot,
+    // because EKey entries are looked up in the index files later
     if(dwErrCode == ERROR_SUCCESS)
     {
         dwErrCode = LoadIndexFiles(hs);
     }
 
+    // If there is a valid snapshot of the storage, load it instead of ENCODING and DOWNLOAD
+    if(dwErrCode == ERROR_SUCCESS && szSnapshotFile != NULL)
+    {
+        if(GetStorageStamp(hs, StorageStamp))
+            bSnapshotLoaded = LoadStorageSnapshot(hs, szSnapshotFile, StorageStamp);
+        else
+            szSnapshotFile = NULL;
+    }
+
     // Load the ENCODING manifest
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSnapshotLoaded == false)
     {
-        dwErrCode = LoadEncodingManifest(hs);
+        dwErrCode = LoadEncodingManifest(hs, PrefetchDownload, PrefetchRoot);
     }
 
     // We need to load the DOWNLOAD manifest
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSnapshotLoaded == false)
     {
-        dwErrCode = LoadDownloadManifest(hs);
+        dwErrCode = LoadDownloadManifest(hs, PrefetchDownload);
+
+        // Save the snapshot for the next time. Failure to save it is not an error
+        if(dwErrCode == ERROR_SUCCESS && szSnapshotFile != NULL)
+            SaveStorageSnapshot(hs, szSnapshotFile, StorageStamp);
     }
 
     // Load the build manifest ("ROOT" file)
@@ -1222,7 +1902,7 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, L
         dwLocaleMask = (dwLocaleMask != 0) ? dwLocaleMask : hs->dwDefaultLocale;
 
         // Continue loading the manifest
-        dwErrCode = LoadBuildManifest(hs, dwLocaleMask);
+        dwErrCode = LoadBuildManifest(hs, dwLocaleMask, PrefetchRoot);
 
         // If we fail to load the ROOT file, we take the file names from the INSTALL manifest
         // Beware on low memory condition - in that case, we cannot guarantee a consistent state of the root file
@@ -1253,8 +1933,10 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs, L
         dwErrCode = CascLoadEncryptionKeys(hs);
     }
 
-    // Cleanup and exit
-    FreeIndexFiles(hs);
+    // Cleanup and exit. The prefetch threads must finish before the storage is used.
+    // The index files stay mapped, so that EKey entries can be looked up later.
+    CascWaitForThread(PrefetchDownload.Thread);
+    CascWaitForThread(PrefetchRoot.Thread);
     hs->pArgs = NULL;
     return dwErrCode;
 }
@@ -1522,6 +2204,9 @@ bool WINAPI CascGetStorageInfo(
         case CascStoragePathProduct:
             return GetStoragePathProduct(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
 
+        case CascStorageFrameCacheInfo:
+            return GetStorageFrameCacheInfo(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
+
         default:
             SetCascError(ERROR_INVALID_PARAMETER);
             return false;
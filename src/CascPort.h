@@ -89,6 +89,7 @@
   #include <wchar.h>
   #include <cassert>
   #include <errno.h>
+  #include <time.h>
   #include <pthread.h>
   #include <netdb.h>
 
@@ -140,6 +141,7 @@
   #include <wchar.h>
   #include <assert.h>
   #include <errno.h>
+  #include <time.h>
   #include <pthread.h>
   #include <netdb.h>
 
@@ -225,6 +227,8 @@
   #define stat64  stat
   #define fstat64 fstat
   #define lseek64 lseek
+  #define pread64 pread
+  #define pwrite64 pwrite
   #define ftruncate64 ftruncate
   #define off64_t off_t
   #define O_LARGEFILE 0
@@ -353,6 +357,21 @@ inline DWORD CascInterlockedDecrement(DWORD * PtrValue)
 #endif
 }
 
+inline void * CascInterlockedCompareExchangePointer(void ** PtrTarget, void * pvExchange, void * pvComparand)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return InterlockedCompareExchangePointer(PtrTarget, pvExchange, pvComparand);
+#elif defined(__GNUC__)
+    return __sync_val_compare_and_swap(PtrTarget, pvComparand, pvExchange);
+#else
+    void * pvOldValue = *PtrTarget;
+
+    if(pvOldValue == pvComparand)
+        *PtrTarget = pvExchange;
+    return pvOldValue;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Lock functions
 
@@ -364,6 +383,13 @@ typedef RTL_CRITICAL_SECTION CASC_LOCK;
 #define CascLock(Lock)          EnterCriticalSection(&Lock);
 #define CascUnlock(Lock)        LeaveCriticalSection(&Lock);
 
+typedef CONDITION_VARIABLE CASC_COND;
+#define CascInitCond(Cond)      InitializeConditionVariable(&Cond);
+#define CascFreeCond(Cond)      /* Nothing to free */
+#define CascWaitCond(Cond, Lock) SleepConditionVariableCS(&Cond, &Lock, INFINITE);
+#define CascSignalCond(Cond)    WakeConditionVariable(&Cond);
+#define CascBroadcastCond(Cond) WakeAllConditionVariable(&Cond);
+
 #else
 
 typedef pthread_mutex_t CASC_LOCK;
@@ -372,6 +398,13 @@ typedef pthread_mutex_t CASC_LOCK;
 #define CascLock(Lock)          pthread_mutex_lock(&Lock);
 #define CascUnlock(Lock)        pthread_mutex_unlock(&Lock);
 
+typedef pthread_cond_t CASC_COND;
+#define CascInitCond(Cond)      pthread_cond_init(&Cond, NULL);
+#define CascFreeCond(Cond)      pthread_cond_destroy(&Cond);
+#define CascWaitCond(Cond, Lock) pthread_cond_wait(&Cond, &Lock);
+#define CascSignalCond(Cond)    pthread_cond_signal(&Cond);
+#define CascBroadcastCond(Cond) pthread_cond_broadcast(&Cond);
+
 #endif
 
 //-----------------------------------------------------------------------------
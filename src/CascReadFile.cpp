@@ -12,6 +12,23 @@
 #include "CascLib.h"
 #include "CascCommon.h"
 
+//-----------------------------------------------------------------------------
+// Local defines
+
+// Minimum size of a stored ('N') frame that is worth loading directly to the output buffer
+#define CASC_DIRECT_FRAME_SIZE  0x4000
+
+// Batch reading: Maximum gap between two files that are still read by one read operation,
+// and maximum size of such read operation
+#define CASC_BATCH_MAX_GAP      0x10000
+#define CASC_BATCH_MAX_READ     0x1000000
+
+// Asynchronous reading: Minimum number of threads that decode the loaded frames
+#define CASC_ASYNC_MIN_THREADS  2
+
+// Parallel decoding: Minimum content size of a file span whose frames are decoded by multiple threads
+#define CASC_PARALLEL_MIN_SIZE  0x100000
+
 //-----------------------------------------------------------------------------
 // Local functions
 
@@ -50,9 +67,16 @@ static DWORD OpenDataStream(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, PCASC_CKE
             // Create the full path of the data file
             CASC_PATH<TCHAR> DataFile(hs->szIndexPath, szPlainName, NULL);
 
+            // If the caller wants it, we map the data file to memory. The frames are then
+            // decoded directly from the mapped view. If the mapping fails (e.g. no address space
+            // on 32-bit platforms), we fall back to normal file reading
+            if(hs->dwFeatures & CASC_FEATURE_MAP_DATA_FILES)
+                pStream = FileStream_OpenFile(DataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_MAP);
+
             // Open the data stream with read+write sharing to prevent Battle.net agent
             // detecting a corruption and redownloading the entire package
-            pStream = FileStream_OpenFile(DataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_FILE);
+            if(pStream == NULL)
+                pStream = FileStream_OpenFile(DataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_FILE);
             hs->DataFiles[dwArchiveIndex] = pStream;
         }
 
@@ -75,7 +99,8 @@ static DWORD OpenDataStream(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, PCASC_CKE
             dwErrCode = FetchCascFile(hs, PathType, pCKeyEntry->EKey, NULL, LocalPath, &ArchiveInfo);
             if(dwErrCode == ERROR_SUCCESS)
             {
-                pStream = FileStream_OpenFile(LocalPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+                // Sparse archives have a bitmap of blocks that have already been downloaded
+                pStream = FileStream_OpenFile(LocalPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT | STREAM_FLAG_USE_BITMAP);
                 if(pStream != NULL)
                 {
                     // Initialize information about the position and size of the file in archive
@@ -537,13 +562,56 @@ static DWORD EnsureFileSpanFramesLoaded(TCascFile * hf)
     return ERROR_SUCCESS;
 }
 
+// Gives the encoded data of a file span. If the data file is memory-mapped, the function
+// gives pointer to the mapped view. Otherwise, it allocates buffer and loads the data.
+// The returned buffer must be released by FreeEncodedData
+static LPBYTE LoadEncodedData(TFileStream * pStream, ULONGLONG ByteOffset, DWORD cbEncoded, DWORD & dwErrCode)
+{
+    LPBYTE pbEncoded;
+
+    // Is the data file mapped? If yes, we just use the pointer to the data
+    if((pbEncoded = FileStream_GetMappedData(pStream, ByteOffset, cbEncoded)) != NULL)
+    {
+        dwErrCode = ERROR_SUCCESS;
+        return pbEncoded;
+    }
+
+    // Allocate buffer for the encoded data
+    if((pbEncoded = CASC_ALLOC<BYTE>(cbEncoded)) == NULL)
+    {
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+
+    // Load the encoded data
+    if(!FileStream_Read(pStream, &ByteOffset, pbEncoded, cbEncoded))
+    {
+        dwErrCode = GetCascError();
+        CASC_FREE(pbEncoded);
+        return NULL;
+    }
+
+    dwErrCode = ERROR_SUCCESS;
+    return pbEncoded;
+}
+
+static void FreeEncodedData(TFileStream * pStream, ULONGLONG ByteOffset, DWORD cbEncoded, LPBYTE pbEncoded)
+{
+    // Only free the buffer if it's not a pointer to mapped view
+    if(pbEncoded != NULL && pbEncoded != FileStream_GetMappedData(pStream, ByteOffset, cbEncoded))
+    {
+        CASC_FREE(pbEncoded);
+    }
+}
+
 static DWORD DecodeFileFrame(
     TCascFile * hf,
     PCASC_CKEY_ENTRY pCKeyEntry,
     PCASC_FILE_FRAME pFrame,
     LPBYTE pbEncoded,
     LPBYTE pbDecoded,
-    DWORD FrameIndex)
+    DWORD FrameIndex,
+    bool bHashVerified = false)
 {
     TCascStorage * hs = hf->hs;
     LPBYTE pbWorkBuffer = NULL;
@@ -572,8 +640,8 @@ static DWORD DecodeFileFrame(
         return ERROR_SUCCESS;
     }
 
-    // Shall we verify the frame integrity?
-    if(hf->bVerifyIntegrity)
+    // Shall we verify the frame integrity? The caller may have done it already
+    if(hf->bVerifyIntegrity && !bHashVerified)
     {
         if(!CascVerifyDataBlockHash(pbEncoded, pFrame->EncodedSize, pFrame->FrameHash.Value))
             return ERROR_FILE_CORRUPT;
@@ -659,6 +727,431 @@ static DWORD DecodeFileFrame(
     return dwErrCode;
 }
 
+// Stored ('N') frames are exactly one byte larger than their content
+static bool IsDirectFrame(PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_FRAME pFrame)
+{
+    if(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA)
+        return true;
+    return (pFrame->EncodedSize == pFrame->ContentSize + 1) && (pFrame->ContentSize >= CASC_DIRECT_FRAME_SIZE);
+}
+
+// Verifies a stored frame whose signature byte was loaded separately from its content
+static bool VerifyStoredFrameHash(PCASC_FILE_FRAME pFrame, BYTE Signature, LPBYTE pbDecoded)
+{
+    MD5_CTX md5_ctx;
+    BYTE md5_digest[MD5_HASH_SIZE];
+
+    // Don't verify the frame if the MD5 is not valid
+    if(!CascIsValidMD5(pFrame->FrameHash.Value))
+        return true;
+
+    MD5_Init(&md5_ctx);
+    MD5_Update(&md5_ctx, &Signature, sizeof(BYTE));
+    MD5_Update(&md5_ctx, pbDecoded, (unsigned long)(pFrame->ContentSize));
+    MD5_Final(md5_digest, &md5_ctx);
+    return (memcmp(md5_digest, pFrame->FrameHash.Value, MD5_HASH_SIZE) == 0);
+}
+
+// Loads a stored ('N') frame directly to the output buffer, so the data is only copied once.
+// The signature byte is read on its own, the frame content goes straight to pbDecoded.
+static DWORD ReadStoredFrameDirect(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, PCASC_FILE_FRAME pFrame, LPBYTE pbDecoded, DWORD FrameIndex)
+{
+    ULONGLONG ByteOffset = pFrame->DataFileOffset;
+    LPBYTE pbEncoded;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    BYTE Signature = 0;
+
+    // Load the signature of the frame
+    if(!FileStream_Read(pFileSpan->pStream, &ByteOffset, &Signature, sizeof(BYTE)))
+        return GetCascError();
+
+    // Not a stored frame? Load the entire frame and decode it normally
+    if(Signature != 'N')
+    {
+        if((pbEncoded = LoadEncodedData(pFileSpan->pStream, pFrame->DataFileOffset, pFrame->EncodedSize, dwErrCode)) != NULL)
+        {
+            dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFrame, pbEncoded, pbDecoded, FrameIndex);
+            FreeEncodedData(pFileSpan->pStream, pFrame->DataFileOffset, pFrame->EncodedSize, pbEncoded);
+        }
+        return dwErrCode;
+    }
+
+    // Load the frame content. The data land exactly where they belong
+    ByteOffset = pFrame->DataFileOffset + 1;
+    if(!FileStream_Read(pFileSpan->pStream, &ByteOffset, pbDecoded, pFrame->ContentSize))
+        return GetCascError();
+
+    // Shall we verify the frame integrity?
+    if(hf->bVerifyIntegrity && !VerifyStoredFrameHash(pFrame, Signature, pbDecoded))
+        return ERROR_FILE_CORRUPT;
+    return ERROR_SUCCESS;
+}
+
+// Decodes one file frame to the output buffer, copying the data as few times as possible:
+// - Frames in memory-mapped data files are decoded directly from the mapped view
+// - Plain data are loaded directly to the output buffer
+// - Stored frames are loaded directly to the output buffer
+// - Other frames are loaded to a temporary buffer and decoded from there
+static DWORD LoadFileFrame(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, PCASC_FILE_FRAME pFrame, LPBYTE pbDecoded, DWORD FrameIndex)
+{
+    LPBYTE pbEncoded;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Memory-mapped data files need no special handling
+    if(FileStream_GetMappedData(pFileSpan->pStream, pFrame->DataFileOffset, pFrame->EncodedSize) == NULL)
+    {
+        // Plain data can be loaded directly
+        if(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA)
+        {
+            if(!FileStream_Read(pFileSpan->pStream, &pFrame->DataFileOffset, pbDecoded, pFrame->ContentSize))
+                return GetCascError();
+            return ERROR_SUCCESS;
+        }
+
+        // Stored frames are loaded directly
+        if(IsDirectFrame(pCKeyEntry, pFrame))
+        {
+            return ReadStoredFrameDirect(hf, pCKeyEntry, pFileSpan, pFrame, pbDecoded, FrameIndex);
+        }
+    }
+
+    // Load the frame to the encoded buffer, or get pointer to the mapped data
+    if((pbEncoded = LoadEncodedData(pFileSpan->pStream, pFrame->DataFileOffset, pFrame->EncodedSize, dwErrCode)) != NULL)
+    {
+        dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFrame, pbEncoded, pbDecoded, FrameIndex);
+        FreeEncodedData(pFileSpan->pStream, pFrame->DataFileOffset, pFrame->EncodedSize, pbEncoded);
+    }
+    return dwErrCode;
+}
+
+// Frames are cached by EKey, so we need one. Plain data are read directly from the data file.
+// Files opened by CascOpenLocalFile have no storage, hence no cache
+static bool IsFrameCacheable(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry)
+{
+    return hf->hs != NULL && hf->hs->FrameCache.IsEnabled() && (pCKeyEntry->Flags & (CASC_CE_HAS_EKEY | CASC_CE_PLAIN_DATA)) == CASC_CE_HAS_EKEY;
+}
+
+// Gives one decoded file frame. Looks to the frame cache first, if enabled
+static DWORD ReadFileFrame(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, PCASC_FILE_FRAME pFrame, LPBYTE pbDecoded, DWORD FrameIndex)
+{
+    DWORD dwErrCode;
+
+    // Is the frame in the storage-wide frame cache?
+    if(IsFrameCacheable(hf, pCKeyEntry))
+    {
+        if(hf->hs->FrameCache.LoadFrame(pCKeyEntry->EKey, FrameIndex, pbDecoded, pFrame->ContentSize, hf->bVerifyIntegrity))
+            return ERROR_SUCCESS;
+    }
+
+    // Load and decode the frame
+    dwErrCode = LoadFileFrame(hf, pCKeyEntry, pFileSpan, pFrame, pbDecoded, FrameIndex);
+
+    // Insert the decoded frame to the cache. Frames which were zeroed
+    // due to a missing decryption key must not get to the cache
+    if(dwErrCode == ERROR_SUCCESS && IsFrameCacheable(hf, pCKeyEntry) && !hf->bOvercomeEncrypted)
+    {
+        hf->hs->FrameCache.InsertFrame(pCKeyEntry->EKey, FrameIndex, pbDecoded, pFrame->ContentSize, hf->bVerifyIntegrity);
+    }
+    return dwErrCode;
+}
+
+// Finds the frame containing the given file offset. The frames are sorted by their offsets
+static PCASC_FILE_FRAME FindFileFrame(PCASC_FILE_SPAN pFileSpan, ULONGLONG FileOffset)
+{
+    PCASC_FILE_FRAME pFrames = pFileSpan->pFrames;
+    DWORD nMinIndex = 0;
+    DWORD nMaxIndex = pFileSpan->FrameCount;
+
+    while(nMinIndex < nMaxIndex)
+    {
+        DWORD nMidIndex = nMinIndex + (nMaxIndex - nMinIndex) / 2;
+
+        if(FileOffset < pFrames[nMidIndex].StartOffset)
+            nMaxIndex = nMidIndex;
+        else if(FileOffset >= pFrames[nMidIndex].EndOffset)
+            nMinIndex = nMidIndex + 1;
+        else
+            return pFrames + nMidIndex;
+    }
+
+    // Not found
+    return NULL;
+}
+
+// Finds the frame containing the given file offset. Sequential reads usually
+// need the most recently read frame or the one after it, so check these first
+static PCASC_FILE_FRAME FindFileFrame(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, ULONGLONG FileOffset)
+{
+    PCASC_FILE_FRAME pFrameHint = hf->pFrameHint;
+    PCASC_FILE_FRAME pFrameEnd = pFileSpan->pFrames + pFileSpan->FrameCount;
+
+    // Is the hint within this span?
+    if(pFileSpan->pFrames <= pFrameHint && pFrameHint < pFrameEnd)
+    {
+        if(pFrameHint->StartOffset <= FileOffset && FileOffset < pFrameHint->EndOffset)
+            return pFrameHint;
+        if(++pFrameHint < pFrameEnd && pFrameHint->StartOffset <= FileOffset && FileOffset < pFrameHint->EndOffset)
+            return pFrameHint;
+    }
+
+    // Binary search for all other cases
+    return FindFileFrame(pFileSpan, FileOffset);
+}
+
+// Checks whether a file span contains frames that are better read one-by-one
+static bool HasDirectFrames(PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan)
+{
+    for(DWORD i = 0; i < pFileSpan->FrameCount; i++)
+    {
+        if(IsDirectFrame(pCKeyEntry, pFileSpan->pFrames + i))
+            return true;
+    }
+    return false;
+}
+
+// Creates the decoding threads on first use. The threads are shared by all parallel
+// and asynchronous reads from the storage
+static CASC_WORK_QUEUE * EnsureDecodeQueue(TCascStorage * hs)
+{
+    DWORD dwThreadCount = CASCLIB_MAX(hs->dwThreadCount, CascGetProcessorCount());
+
+    CascLock(hs->StorageLock);
+    if(hs->pDecodeQueue == NULL)
+        hs->pDecodeQueue = CascCreateWorkQueue(CASCLIB_MAX(dwThreadCount, CASC_ASYNC_MIN_THREADS));
+    CascUnlock(hs->StorageLock);
+
+    return hs->pDecodeQueue;
+}
+
+// Frames of one file span that are decoded by multiple threads. The reading thread decodes
+// frames as well, so the read completes even if all decoding threads are busy
+struct CASC_DECODE_JOB
+{
+    TCascFile * hf;                                 // The file being read
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the span
+    PCASC_FILE_SPAN pFileSpan;                      // The file span
+    LPBYTE pbEncoded;                               // Encoded frames of the span
+    LPBYTE pbBuffer;                                // Output buffer for the content of the span
+    ULONGLONG ByteOffset;                           // Offset of the encoded frames in the data file
+    CASC_LOCK Lock;                                 // Protects dwFramesDone, dwFailedFrame, dwErrCode, dwHelpers and bClosed
+    CASC_COND Cond;                                 // Signalled when all frames are decoded and when the last helper leaves
+    DWORD dwFrameCount;                             // Copy of the frame count. Late helpers must not touch the file span
+    DWORD dwNextFrame;                              // Next frame to be decoded
+    DWORD dwFramesDone;                             // Number of frames decoded so far
+    DWORD dwFailedFrame;                            // Lowest index of a frame that failed to decode
+    DWORD dwErrCode;                                // Error code of that frame
+    DWORD dwHelpers;                                // Number of helpers that are decoding frames right now
+    DWORD dwRefs;                                   // The reading thread plus one per posted work item
+    bool bClosed;                                   // The reading thread has returned, helpers must not start
+};
+
+static void ReleaseDecodeJob(CASC_DECODE_JOB * pDecode)
+{
+    if(CascInterlockedDecrement(&pDecode->dwRefs) == 0)
+    {
+        CascFreeCond(pDecode->Cond);
+        CascFreeLock(pDecode->Lock);
+        CASC_FREE(pDecode);
+    }
+}
+
+// Decodes frames until there are none left. Each frame goes straight to its position in the output buffer
+static void DecodeParallelFrames(CASC_DECODE_JOB * pDecode)
+{
+    PCASC_FILE_FRAME pFileFrame;
+    DWORD FrameIndex;
+    DWORD dwErrCode;
+    bool bFrameNeeded;
+
+    // Check the frame count in the job. The file span is only valid while there are frames left
+    while((FrameIndex = CascInterlockedIncrement(&pDecode->dwNextFrame) - 1) < pDecode->dwFrameCount)
+    {
+        PCASC_FILE_SPAN pFileSpan = pDecode->pFileSpan;
+
+        // Frames after a failed frame are not needed
+        CascLock(pDecode->Lock);
+        bFrameNeeded = (FrameIndex < pDecode->dwFailedFrame);
+        CascUnlock(pDecode->Lock);
+
+        pFileFrame = pFileSpan->pFrames + FrameIndex;
+        dwErrCode = ERROR_SUCCESS;
+        if(bFrameNeeded)
+        {
+            dwErrCode = DecodeFileFrame(pDecode->hf,
+                                        pDecode->pCKeyEntry,
+                                        pFileFrame,
+                                        pDecode->pbEncoded + (size_t)(pFileFrame->DataFileOffset - pDecode->ByteOffset),
+                                        pDecode->pbBuffer + (size_t)(pFileFrame->StartOffset - pFileSpan->StartOffset),
+                                        FrameIndex);
+        }
+
+        CascLock(pDecode->Lock);
+        if(dwErrCode != ERROR_SUCCESS && FrameIndex < pDecode->dwFailedFrame)
+        {
+            pDecode->dwFailedFrame = FrameIndex;
+            pDecode->dwErrCode = dwErrCode;
+        }
+        if(++pDecode->dwFramesDone == pDecode->dwFrameCount)
+            CascSignalCond(pDecode->Cond);
+        CascUnlock(pDecode->Lock);
+    }
+}
+
+static void DecodeParallelFrames_Work(void * pvParam)
+{
+    CASC_DECODE_JOB * pDecode = (CASC_DECODE_JOB *)pvParam;
+    bool bClosed;
+
+    // Helpers that start after the reading thread has returned only release the structure
+    CascLock(pDecode->Lock);
+    if((bClosed = pDecode->bClosed) == false)
+        pDecode->dwHelpers++;
+    CascUnlock(pDecode->Lock);
+
+    if(bClosed == false)
+    {
+        DecodeParallelFrames(pDecode);
+
+        // The reading thread waits for the last helper
+        CascLock(pDecode->Lock);
+        if(--pDecode->dwHelpers == 0)
+            CascSignalCond(pDecode->Cond);
+        CascUnlock(pDecode->Lock);
+    }
+    ReleaseDecodeJob(pDecode);
+}
+
+// Decodes the frames of a file span by multiple threads. Returns the index of the first frame
+// that failed to decode, FrameCount if all frames were decoded, or CASC_INVALID_INDEX if the threads
+// are not available
+static DWORD DecodeSpanFramesParallel(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, LPBYTE pbEncoded, LPBYTE pbBuffer, DWORD & dwErrCode)
+{
+    CASC_WORK_QUEUE * pDecodeQueue;
+    CASC_DECODE_JOB * pDecode;
+    DWORD dwHelperCount = CASCLIB_MIN(CascGetProcessorCount(), pFileSpan->FrameCount) - 1;
+    DWORD dwFailedFrame;
+
+    // Get the decoding threads and prepare the work. With one processor, there is nothing to gain
+    if(dwHelperCount == 0 || (pDecodeQueue = EnsureDecodeQueue(hf->hs)) == NULL)
+        return CASC_INVALID_INDEX;
+    if((pDecode = CASC_ALLOC<CASC_DECODE_JOB>(1)) == NULL)
+        return CASC_INVALID_INDEX;
+
+    pDecode->hf = hf;
+    pDecode->pCKeyEntry = pCKeyEntry;
+    pDecode->pFileSpan = pFileSpan;
+    pDecode->pbEncoded = pbEncoded;
+    pDecode->pbBuffer = pbBuffer;
+    pDecode->ByteOffset = pFileSpan->ArchiveOffs + pFileSpan->HeaderSize;
+    pDecode->dwFrameCount = pFileSpan->FrameCount;
+    pDecode->dwNextFrame = 0;
+    pDecode->dwFramesDone = 0;
+    pDecode->dwFailedFrame = pFileSpan->FrameCount;
+    pDecode->dwErrCode = ERROR_SUCCESS;
+    pDecode->dwHelpers = 0;
+    pDecode->dwRefs = 1;
+    pDecode->bClosed = false;
+    CascInitLock(pDecode->Lock);
+    CascInitCond(pDecode->Cond);
+
+    // Post the helpers. Helpers that start late find no work or the job closed, and just release the structure
+    for(DWORD i = 0; i < dwHelperCount; i++)
+    {
+        CascInterlockedIncrement(&pDecode->dwRefs);
+        if(!CascPostWork(pDecodeQueue, DecodeParallelFrames_Work, pDecode))
+        {
+            CascInterlockedDecrement(&pDecode->dwRefs);
+            break;
+        }
+    }
+
+    // Decode frames on this thread as well, then wait until the helpers finish theirs.
+    // Helpers still in the queue are not waited for, because this thread may be one of the
+    // decoding threads itself (asynchronous reads). Closing the job keeps them from starting
+    DecodeParallelFrames(pDecode);
+    CascLock(pDecode->Lock);
+    pDecode->bClosed = true;
+    while(pDecode->dwFramesDone < pDecode->dwFrameCount || pDecode->dwHelpers != 0)
+        CascWaitCond(pDecode->Cond, pDecode->Lock);
+    dwFailedFrame = pDecode->dwFailedFrame;
+    dwErrCode = pDecode->dwErrCode;
+    CascUnlock(pDecode->Lock);
+
+    ReleaseDecodeJob(pDecode);
+    return dwFailedFrame;
+}
+
+// Verifies the hashes of up to CASC_HASH_BATCH_SIZE frames at once, using the multi-buffer MD5.
+// pbEncoded points to the encoded data of the first frame. Returns the index after the last
+// verified frame. If a frame doesn't match its hash, its index is given in dwFailedFrame
+static DWORD VerifySpanFrames(PCASC_FILE_SPAN pFileSpan, DWORD FrameIndex, LPBYTE pbEncoded, DWORD & dwFailedFrame)
+{
+    PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames + FrameIndex;
+    const void * DataBlocks[CASC_HASH_BATCH_SIZE];
+    size_t BlockSizes[CASC_HASH_BATCH_SIZE];
+    LPBYTE ExpectedHashes[CASC_HASH_BATCH_SIZE];
+    DWORD dwFrameCount = CASCLIB_MIN(pFileSpan->FrameCount - FrameIndex, CASC_HASH_BATCH_SIZE);
+    size_t nFailedBlock;
+
+    for(DWORD i = 0; i < dwFrameCount; i++, pFileFrame++)
+    {
+        DataBlocks[i] = pbEncoded;
+        BlockSizes[i] = pFileFrame->EncodedSize;
+        ExpectedHashes[i] = pFileFrame->FrameHash.Value;
+        pbEncoded += pFileFrame->EncodedSize;
+    }
+
+    nFailedBlock = CascVerifyDataBlockHashes(DataBlocks, BlockSizes, ExpectedHashes, dwFrameCount);
+    if(nFailedBlock < dwFrameCount)
+        dwFailedFrame = FrameIndex + (DWORD)nFailedBlock;
+    return FrameIndex + dwFrameCount;
+}
+
+// Decodes all frames of a file span whose encoded data are in memory.
+// Returns the number of bytes decoded before the first frame that failed
+static DWORD DecodeSpanFrames(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, LPBYTE pbEncoded, LPBYTE pbBuffer, DWORD & dwErrCode)
+{
+    PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames;
+    LPBYTE pbSaveBuffer = pbBuffer;
+    DWORD dwVerifiedEnd = 0;
+    DWORD dwFailedFrame;
+
+    // Large spans can be decoded by multiple threads, if the caller wants so
+    if(hf->bParallelDecode && hf->hs != NULL && pFileSpan->FrameCount > 1 && (pFileSpan->EndOffset - pFileSpan->StartOffset) >= CASC_PARALLEL_MIN_SIZE)
+    {
+        dwFailedFrame = DecodeSpanFramesParallel(hf, pCKeyEntry, pFileSpan, pbEncoded, pbBuffer, dwErrCode);
+        if(dwFailedFrame < pFileSpan->FrameCount)
+            return (DWORD)(pFileSpan->pFrames[dwFailedFrame].StartOffset - pFileSpan->StartOffset);
+        if(dwFailedFrame == pFileSpan->FrameCount)
+            return (DWORD)(pFileSpan->EndOffset - pFileSpan->StartOffset);
+    }
+
+    // Decode the frames one-by-one
+    dwFailedFrame = CASC_INVALID_INDEX;
+    for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount; FrameIndex++, pFileFrame++)
+    {
+        // Verify the hashes of the next group of frames at once
+        if(hf->bVerifyIntegrity && FrameIndex >= dwVerifiedEnd)
+        {
+            dwVerifiedEnd = VerifySpanFrames(pFileSpan, FrameIndex, pbEncoded, dwFailedFrame);
+        }
+
+        // Decode the file frame
+        if(FrameIndex == dwFailedFrame)
+            dwErrCode = ERROR_FILE_CORRUPT;
+        else
+            dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFileFrame, pbEncoded, pbBuffer, FrameIndex, hf->bVerifyIntegrity);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+
+        // Move pointers
+        pbEncoded += pFileFrame->EncodedSize;
+        pbBuffer += pFileFrame->ContentSize;
+    }
+
+    return (DWORD)(pbBuffer - pbSaveBuffer);
+}
+
 static bool GetFileFullInfo(TCascFile * hf, void * pvFileInfo, size_t cbFileInfo, size_t * pcbLengthNeeded)
 {
     PCASC_FILE_FULL_INFO pFileInfo;
@@ -778,41 +1271,42 @@ static DWORD ReadFile_WholeFile(TCascFile * hf, LPBYTE pbBuffer)
     PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
     LPBYTE pbSaveBuffer = pbBuffer;
     LPBYTE pbEncoded;
-    LPBYTE pbEncodedPtr;
     DWORD dwErrCode;
 
     for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount; SpanIndex++, pCKeyEntry++, pFileSpan++)
     {
+        PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames;
         ULONGLONG ByteOffset = pFileSpan->ArchiveOffs + pFileSpan->HeaderSize;
         DWORD EncodedSize = pCKeyEntry->EncodedSize - pFileSpan->HeaderSize;
 
-        // Allocate the buffer for the entire encoded span
-        pbEncodedPtr = pbEncoded = CASC_ALLOC<BYTE>(EncodedSize);
-        if(pbEncoded == NULL)
-        {
-            SetCascError(ERROR_NOT_ENOUGH_MEMORY);
-            return 0;
-        }
-
-        // Load the encoded buffer
-        if(FileStream_Read(pFileSpan->pStream, &ByteOffset, pbEncoded, EncodedSize))
+        // If the span contains stored frames and it's not memory-mapped, we read the frames
+        // one-by-one, so the stored frames can be loaded directly to the output buffer.
+        // The same applies if the frames can be served from the frame cache.
+        // When verifying, hashing all frames together is worth more than saving the copy
+        if(IsFrameCacheable(hf, pCKeyEntry) || (!hf->bVerifyIntegrity && FileStream_GetMappedData(pFileSpan->pStream, ByteOffset, EncodedSize) == NULL && HasDirectFrames(pCKeyEntry, pFileSpan)))
         {
-            PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames;
-
             for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount; FrameIndex++, pFileFrame++)
             {
                 // Decode the file frame
-                dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFileFrame, pbEncodedPtr, pbBuffer, FrameIndex);
+                dwErrCode = ReadFileFrame(hf, pCKeyEntry, pFileSpan, pFileFrame, pbBuffer, FrameIndex);
                 if(dwErrCode != ERROR_SUCCESS)
                     break;
-
-                // Move pointers
-                pbEncodedPtr += pFileFrame->EncodedSize;
                 pbBuffer += pFileFrame->ContentSize;
             }
+            continue;
         }
 
-        CASC_FREE(pbEncoded);
+        // Load the entire encoded span, or get pointer to the mapped data
+        pbEncoded = LoadEncodedData(pFileSpan->pStream, ByteOffset, EncodedSize, dwErrCode);
+        if(pbEncoded == NULL)
+        {
+            SetCascError(dwErrCode);
+            break;
+        }
+
+        // Decode all frames of the span
+        pbBuffer += DecodeSpanFrames(hf, pCKeyEntry, pFileSpan, pbEncoded, pbBuffer, dwErrCode);
+        FreeEncodedData(pFileSpan->pStream, ByteOffset, EncodedSize, pbEncoded);
     }
 
     // Give the amount of bytes read
@@ -825,7 +1319,6 @@ static DWORD ReadFile_FrameCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Sta
     PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
     PCASC_FILE_FRAME pFileFrame = NULL;
     LPBYTE pbSaveBuffer = pbBuffer;
-    LPBYTE pbEncoded = NULL;
     LPBYTE pbDecoded = NULL;
     DWORD dwBytesRead = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
@@ -836,10 +1329,18 @@ static DWORD ReadFile_FrameCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Sta
     {
         if(pFileSpan->StartOffset <= StartOffset && StartOffset < pFileSpan->EndOffset)
         {
-            for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount; FrameIndex++)
+            // Locate the frame where the read starts. The following frames are read sequentially
+            if((pFileFrame = FindFileFrame(hf, pFileSpan, StartOffset)) == NULL)
+            {
+                SetCascError(ERROR_FILE_CORRUPT);
+                return 0;
+            }
+
+            for(DWORD FrameIndex = (DWORD)(pFileFrame - pFileSpan->pFrames); FrameIndex < pFileSpan->FrameCount; FrameIndex++)
             {
                 // Get the current file frame
                 pFileFrame = pFileSpan->pFrames + FrameIndex;
+                hf->pFrameHint = pFileFrame;
 
                 // Check the frame byte range
                 if(pFileFrame->StartOffset <= StartOffset && StartOffset < pFileFrame->EndOffset)
@@ -869,35 +1370,21 @@ static DWORD ReadFile_FrameCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Sta
                         pbDecoded = pbBuffer;
                     }
 
-                    // Allocate the encoded frame
-                    if((pbEncoded = CASC_ALLOC<BYTE>(pFileFrame->EncodedSize)) == NULL)
-                    {
-                        CASC_FREE(pbDecoded);
-                        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
-                        return 0;
-                    }
-
-                    // Load the frame to the encoded buffer
-                    if(FileStream_Read(pFileSpan->pStream, &pFileFrame->DataFileOffset, pbEncoded, pFileFrame->EncodedSize))
+                    // Load and decode the frame. If we decode to the caller's buffer,
+                    // stored frames are loaded directly
+                    dwErrCode = ReadFileFrame(hf, pCKeyEntry, pFileSpan, pFileFrame, pbDecoded, FrameIndex);
+                    if(dwErrCode == ERROR_SUCCESS)
                     {
                         ULONGLONG EndOfCopy = CASCLIB_MIN(pFileFrame->EndOffset, EndOffset);
                         DWORD dwBytesToCopy = (DWORD)(EndOfCopy - StartOffset);
 
-                        // Decode the frame
-                        dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFileFrame, pbEncoded, pbDecoded, FrameIndex);
-                        if(dwErrCode == ERROR_SUCCESS)
-                        {
-                            // Copy the data
-                            if(pbDecoded != pbBuffer)
-                                memcpy(pbBuffer, pbDecoded + (DWORD)(StartOffset - pFileFrame->StartOffset), dwBytesToCopy);
-                            StartOffset += dwBytesToCopy;
-                            pbBuffer += dwBytesToCopy;
-                        }
+                        // Copy the data
+                        if(pbDecoded != pbBuffer)
+                            memcpy(pbBuffer, pbDecoded + (DWORD)(StartOffset - pFileFrame->StartOffset), dwBytesToCopy);
+                        StartOffset += dwBytesToCopy;
+                        pbBuffer += dwBytesToCopy;
                     }
 
-                    // Free the encoded buffer
-                    CASC_FREE(pbEncoded);
-
                     // If we are at the end of the read area, break all loops
                     if(dwErrCode != ERROR_SUCCESS || StartOffset >= EndOffset)
                         goto __WorkComplete;
@@ -934,45 +1421,674 @@ static DWORD ReadFile_FrameCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Sta
     return (DWORD)(pbBuffer - pbSaveBuffer);
 }
 
-// No cache at all. The entire file will be read directly to the user buffer
-static DWORD ReadFile_NonCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset)
+// No cache. Only the frames covering the requested range are loaded, using one read per file span.
+// Frames that are entirely in the range are decoded directly to the user buffer
+static DWORD ReadFile_FrameRange(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset)
 {
-    // Reading the whole file?
-    if(StartOffset == 0 && EndOffset == hf->ContentSize)
-    {
-        return ReadFile_WholeFile(hf, pbBuffer);
-    }
+    PCASC_CKEY_ENTRY pCKeyEntry = hf->pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
+    PCASC_FILE_FRAME pFirstFrame;
+    PCASC_FILE_FRAME pLastFrame;
+    PCASC_FILE_FRAME pFileFrame;
+    ULONGLONG ByteOffset;
+    LPBYTE pbSaveBuffer = pbBuffer;
+    LPBYTE pbEncoded;
+    LPBYTE pbDecoded;
+    DWORD dwBytesToCopy;
+    DWORD EncodedSize;
+    DWORD dwErrCode = ERROR_SUCCESS;
 
-    // Reading just a part of the file?
-    else
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount && StartOffset < EndOffset; SpanIndex++, pCKeyEntry++, pFileSpan++)
     {
-        assert(false);
-    }
+        // Skip the spans that are not in the range
+        if(StartOffset < pFileSpan->StartOffset || StartOffset >= pFileSpan->EndOffset)
+            continue;
+
+        // Locate the first and the last frame of the range
+        pFirstFrame = FindFileFrame(pFileSpan, StartOffset);
+        pLastFrame = FindFileFrame(pFileSpan, CASCLIB_MIN(EndOffset, pFileSpan->EndOffset) - 1);
+        if(pFirstFrame == NULL || pLastFrame == NULL)
+        {
+            dwErrCode = ERROR_FILE_CORRUPT;
+            break;
+        }
 
-    return 0;
-}
+        // Plain data: Just read the requested part of the span
+        if(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA)
+        {
+            ByteOffset = pFirstFrame->DataFileOffset + (StartOffset - pFirstFrame->StartOffset);
+            dwBytesToCopy = (DWORD)(CASCLIB_MIN(EndOffset, pFileSpan->EndOffset) - StartOffset);
+            if(!FileStream_Read(pFileSpan->pStream, &ByteOffset, pbBuffer, dwBytesToCopy))
+            {
+                dwErrCode = GetCascError();
+                break;
+            }
 
-//-----------------------------------------------------------------------------
-// Public functions
+            StartOffset += dwBytesToCopy;
+            pbBuffer += dwBytesToCopy;
+            continue;
+        }
 
-bool WINAPI CascGetFileInfo(HANDLE hFile, CASC_FILE_INFO_CLASS InfoClass, void * pvFileInfo, size_t cbFileInfo, size_t * pcbLengthNeeded)
-{
-    TCascFile * hf;
-    LPBYTE pbOutputValue = NULL;
-    LPBYTE pbInfoValue = NULL;
-    size_t cbInfoValue = 0;
+        // Load the encoded data of all frames in the range with one read.
+        // The encoded frames are stored one after another in the data file.
+        // If the frames can be in the frame cache, we load the frames one-by-one
+        ByteOffset = pFirstFrame->DataFileOffset;
+        EncodedSize = (DWORD)(pLastFrame->DataFileOffset + pLastFrame->EncodedSize - ByteOffset);
+        pbEncoded = NULL;
+        if(!IsFrameCacheable(hf, pCKeyEntry))
+        {
+            if((pbEncoded = LoadEncodedData(pFileSpan->pStream, ByteOffset, EncodedSize, dwErrCode)) == NULL)
+                break;
+        }
 
-    // Validate the file handle
-    if((hf = TCascFile::IsValid(hFile)) == NULL)
-    {
-        SetCascError(ERROR_INVALID_HANDLE);
-        return false;
-    }
+        // Decode all frames in the range
+        for(pFileFrame = pFirstFrame; pFileFrame <= pLastFrame; pFileFrame++)
+        {
+            DWORD FrameIndex = (DWORD)(pFileFrame - pFileSpan->pFrames);
 
-    // Differentiate between info classes
-    switch(InfoClass)
-    {
-        case CascFileContentKey:
+            // Only the edge frames, which are not read entirely, need a temporary buffer
+            dwBytesToCopy = (DWORD)(CASCLIB_MIN(pFileFrame->EndOffset, EndOffset) - StartOffset);
+            pbDecoded = pbBuffer;
+            if(pFileFrame->StartOffset < StartOffset || EndOffset < pFileFrame->EndOffset)
+            {
+                if((pbDecoded = CASC_ALLOC<BYTE>(pFileFrame->ContentSize)) == NULL)
+                {
+                    dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+                    break;
+                }
+            }
+
+            // Decode the frame
+            if(pbEncoded != NULL)
+                dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFileFrame, pbEncoded + (DWORD)(pFileFrame->DataFileOffset - ByteOffset), pbDecoded, FrameIndex);
+            else
+                dwErrCode = ReadFileFrame(hf, pCKeyEntry, pFileSpan, pFileFrame, pbDecoded, FrameIndex);
+
+            // Copy the part of the edge frame
+            if(pbDecoded != pbBuffer)
+            {
+                if(dwErrCode == ERROR_SUCCESS)
+                    memcpy(pbBuffer, pbDecoded + (DWORD)(StartOffset - pFileFrame->StartOffset), dwBytesToCopy);
+                CASC_FREE(pbDecoded);
+            }
+
+            // Move pointers
+            if(dwErrCode != ERROR_SUCCESS)
+                break;
+            StartOffset += dwBytesToCopy;
+            pbBuffer += dwBytesToCopy;
+        }
+
+        // Free the encoded buffer
+        FreeEncodedData(pFileSpan->pStream, ByteOffset, EncodedSize, pbEncoded);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+
+    // Return the number of bytes read. Always set LastError.
+    SetCascError(dwErrCode);
+    return (DWORD)(pbBuffer - pbSaveBuffer);
+}
+
+// No cache at all. The requested data will be read directly to the user buffer
+static DWORD ReadFile_NonCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset)
+{
+    // Reading the whole file?
+    if(StartOffset == 0 && EndOffset == hf->ContentSize)
+    {
+        return ReadFile_WholeFile(hf, pbBuffer);
+    }
+
+    // Reading just a part of the file
+    return ReadFile_FrameRange(hf, pbBuffer, StartOffset, EndOffset);
+}
+
+//-----------------------------------------------------------------------------
+// Batch reading
+
+// One file of the batch read
+struct CASC_BATCH_ENTRY
+{
+    const CASC_BATCH_ITEM * pItem;                  // The item passed by the caller
+    HANDLE hFile;                                   // Handle of the open file
+    DWORD ArchiveIndex;                             // Index of the data file ("data.###")
+    DWORD ArchiveOffs;                              // Offset of the encoded file in the data file
+    DWORD EncodedSize;                              // Encoded size of the file
+    bool bSequential;                               // If true, the file is read in storage order together with its neighbors
+};
+
+// Decoded data of the files, reused by all files of the batch
+struct CASC_BATCH_BUFFER
+{
+    LPBYTE pbData;
+    size_t cbData;
+};
+
+// Files read in storage order go first, sorted by their position in the data files.
+// The other files follow in the order given by the caller
+static int CompareBatchEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    const CASC_BATCH_ENTRY * pEntry1 = (const CASC_BATCH_ENTRY *)pvEntry1;
+    const CASC_BATCH_ENTRY * pEntry2 = (const CASC_BATCH_ENTRY *)pvEntry2;
+
+    if(pEntry1->bSequential != pEntry2->bSequential)
+        return pEntry1->bSequential ? -1 : 1;
+
+    if(pEntry1->bSequential)
+    {
+        if(pEntry1->ArchiveIndex != pEntry2->ArchiveIndex)
+            return (pEntry1->ArchiveIndex < pEntry2->ArchiveIndex) ? -1 : 1;
+        if(pEntry1->ArchiveOffs != pEntry2->ArchiveOffs)
+            return (pEntry1->ArchiveOffs < pEntry2->ArchiveOffs) ? -1 : 1;
+    }
+
+    return (pEntry1->pItem < pEntry2->pItem) ? -1 : (pEntry1->pItem > pEntry2->pItem) ? 1 : 0;
+}
+
+static LPBYTE EnsureBatchBuffer(CASC_BATCH_BUFFER & Buffer, ULONGLONG cbNeeded)
+{
+    // Check for overflow on 32-bit platforms
+    if(cbNeeded != (size_t)cbNeeded)
+        return NULL;
+
+    // Enlarge the buffer, if needed. Keep at least one byte allocated
+    if(cbNeeded > Buffer.cbData || Buffer.pbData == NULL)
+    {
+        CASC_FREE(Buffer.pbData);
+        Buffer.cbData = 0;
+
+        if((Buffer.pbData = CASC_ALLOC<BYTE>(CASCLIB_MAX((size_t)cbNeeded, 1))) == NULL)
+            return NULL;
+        Buffer.cbData = (size_t)cbNeeded;
+    }
+
+    return Buffer.pbData;
+}
+
+// Resolves the file: opens it and determines whether it can be read in storage order.
+// These are single-span files present in the local data files
+static DWORD OpenBatchEntry(TCascStorage * hs, CASC_BATCH_ENTRY & BatchEntry)
+{
+    const CASC_BATCH_ITEM * pItem = BatchEntry.pItem;
+    PCASC_CKEY_ENTRY pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan;
+    TCascFile * hf;
+    DWORD dwErrCode;
+
+    // Open the file
+    if(!CascOpenFile((HANDLE)hs, pItem->pvFileName, pItem->dwLocaleFlags, pItem->dwOpenFlags, &BatchEntry.hFile))
+        return GetCascError();
+    hf = TCascFile::IsValid(BatchEntry.hFile);
+    pCKeyEntry = hf->pCKeyEntry;
+    pFileSpan = hf->pFileSpan;
+
+    // Only single-span local files with known encoded size are read in storage order
+    if(hf->SpanCount == 1 && (pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL) && pCKeyEntry->EncodedSize != CASC_INVALID_SIZE)
+    {
+        // Make sure that the data file is open
+        if(pFileSpan->pStream == NULL)
+        {
+            dwErrCode = OpenDataStream(hf, pFileSpan, pCKeyEntry, false);
+            if(dwErrCode != ERROR_SUCCESS)
+                return dwErrCode;
+        }
+
+        // Files larger than one merged read are read as normal
+        if(pCKeyEntry->EncodedSize <= CASC_BATCH_MAX_READ)
+        {
+            BatchEntry.ArchiveIndex = pFileSpan->ArchiveIndex;
+            BatchEntry.ArchiveOffs = pFileSpan->ArchiveOffs;
+            BatchEntry.EncodedSize = pCKeyEntry->EncodedSize;
+            BatchEntry.bSequential = true;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Loads the frames of the file span from the encoded data of the entire file
+static DWORD LoadSpanFramesFromBuffer(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry, LPBYTE pbEncoded, size_t cbEncoded)
+{
+    size_t cbHeaderSize = 0;
+    DWORD dwErrCode;
+
+    // Parse the BLTE header
+    dwErrCode = ParseBlteHeader(pFileSpan, pFileSpan->ArchiveOffs, pbEncoded, cbEncoded, &cbHeaderSize);
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        // The frame headers must be within the encoded data
+        pFileSpan->HeaderSize = (DWORD)(cbHeaderSize + (pFileSpan->FrameCount * sizeof(BLTE_FRAME)));
+        if(pFileSpan->HeaderSize > cbEncoded)
+            return ERROR_BAD_FORMAT;
+
+        // Load the array of frame headers
+        return LoadSpanFrames(pFileSpan, pCKeyEntry, pFileSpan->ArchiveOffs + cbHeaderSize, pbEncoded + cbHeaderSize, pbEncoded + cbEncoded, cbHeaderSize);
+    }
+
+    // Special treatment for plain files ("PATCH"), same like in LoadEncodedHeaderAndSpanFrames
+    if(pCKeyEntry->EncodedSize == pCKeyEntry->ContentSize)
+        return LoadSpanFramesForPlainFile(pFileSpan, pCKeyEntry);
+    return dwErrCode;
+}
+
+// Decodes a single-span file from its encoded data, which are already in memory
+static DWORD DecodeBatchEntry(CASC_BATCH_ENTRY & BatchEntry, LPBYTE pbEncoded, CASC_BATCH_BUFFER & Decoded)
+{
+    TCascFile * hf = TCascFile::IsValid(BatchEntry.hFile);
+    PCASC_CKEY_ENTRY pCKeyEntry = hf->pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
+    PCASC_FILE_FRAME pFileFrame;
+    LPBYTE pbDecoded;
+    LPBYTE pbFrame;
+    DWORD dwErrCode;
+
+    // Load the file frames from the encoded data
+    if(pFileSpan->pFrames == NULL)
+    {
+        // If the content size is not known yet, it will be given by the frames
+        if(hf->ContentSize == CASC_INVALID_SIZE64)
+            pFileSpan->StartOffset = pFileSpan->EndOffset = 0;
+
+        dwErrCode = LoadSpanFramesFromBuffer(pFileSpan, pCKeyEntry, pbEncoded, BatchEntry.EncodedSize);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+
+        if(hf->ContentSize == CASC_INVALID_SIZE64)
+        {
+            hf->ContentSize = pFileSpan->EndOffset = pCKeyEntry->ContentSize;
+            hf->EncodedSize = pCKeyEntry->EncodedSize;
+        }
+    }
+
+    // Allocate the buffer for the decoded data
+    if((pbDecoded = EnsureBatchBuffer(Decoded, hf->ContentSize)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Decode all file frames
+    pFileFrame = pFileSpan->pFrames;
+    for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount; FrameIndex++, pFileFrame++)
+    {
+        // Plain files have one frame that covers the entire file
+        pbFrame = pbEncoded;
+        if(!(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA))
+        {
+            // The frame must be within the encoded data
+            if(pFileFrame->DataFileOffset < BatchEntry.ArchiveOffs || (pFileFrame->DataFileOffset - BatchEntry.ArchiveOffs + pFileFrame->EncodedSize) > BatchEntry.EncodedSize)
+                return ERROR_BAD_FORMAT;
+            pbFrame = pbEncoded + (size_t)(pFileFrame->DataFileOffset - BatchEntry.ArchiveOffs);
+        }
+
+        // The frame must be within the decoded data
+        if((pFileFrame->StartOffset + pFileFrame->ContentSize) > hf->ContentSize)
+            return ERROR_BAD_FORMAT;
+
+        dwErrCode = DecodeFileFrame(hf, pCKeyEntry, pFileFrame, pbFrame, pbDecoded + (size_t)pFileFrame->StartOffset, FrameIndex);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Reads the entire file using CascReadFile. Used for files that are not read in storage order
+static DWORD ReadBatchEntry(CASC_BATCH_ENTRY & BatchEntry, CASC_BATCH_BUFFER & Decoded)
+{
+    TCascFile * hf = TCascFile::IsValid(BatchEntry.hFile);
+    ULONGLONG BytesRead = 0;
+    LPBYTE pbDecoded;
+    DWORD dwBytesToRead;
+    DWORD dwBytesRead;
+    DWORD dwErrCode;
+
+    // Make sure we know the file size
+    if((dwErrCode = EnsureFileSpanFramesLoaded(hf)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((pbDecoded = EnsureBatchBuffer(Decoded, hf->ContentSize)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Read the file in pieces of at most 2 GB
+    while(BytesRead < hf->ContentSize)
+    {
+        dwBytesToRead = (DWORD)CASCLIB_MIN(hf->ContentSize - BytesRead, 0x80000000);
+        if(!CascReadFile(BatchEntry.hFile, pbDecoded + (size_t)BytesRead, dwBytesToRead, &dwBytesRead))
+            return GetCascError();
+        if(dwBytesRead != dwBytesToRead)
+            return ERROR_HANDLE_EOF;
+        BytesRead += dwBytesRead;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Gives the file to the callback and closes the file. Returns true if the caller cancelled the batch
+static bool CompleteBatchEntry(CASC_BATCH_ENTRY & BatchEntry, DWORD dwErrCode, CASC_BATCH_BUFFER & Decoded, PFNBATCHCALLBACK PfnCallback, void * PtrUserParam)
+{
+    TCascFile * hf = TCascFile::IsValid(BatchEntry.hFile);
+    ULONGLONG cbFileData = (dwErrCode == ERROR_SUCCESS) ? hf->ContentSize : 0;
+    const void * pvFileData = (dwErrCode == ERROR_SUCCESS) ? Decoded.pbData : NULL;
+    bool bCancelled;
+
+    bCancelled = PfnCallback(PtrUserParam, BatchEntry.pItem, dwErrCode, pvFileData, cbFileData);
+
+    // Close the file
+    if(BatchEntry.hFile != NULL)
+        CascCloseFile(BatchEntry.hFile);
+    BatchEntry.hFile = NULL;
+    return bCancelled;
+}
+
+// Finds the group of files that are read by one read operation.
+// The files must be in the same data file and there must only be small gaps between them
+static size_t GetBatchGroup(CASC_BATCH_ENTRY * BatchEntries, size_t nStartIndex, size_t nEntryCount, ULONGLONG & GroupStart, ULONGLONG & GroupEnd)
+{
+    CASC_BATCH_ENTRY & FirstEntry = BatchEntries[nStartIndex];
+    size_t nIndex;
+
+    GroupStart = FirstEntry.ArchiveOffs;
+    GroupEnd = GroupStart + FirstEntry.EncodedSize;
+
+    for(nIndex = nStartIndex + 1; nIndex < nEntryCount; nIndex++)
+    {
+        CASC_BATCH_ENTRY & BatchEntry = BatchEntries[nIndex];
+        ULONGLONG EntryEnd = (ULONGLONG)BatchEntry.ArchiveOffs + BatchEntry.EncodedSize;
+
+        if(!BatchEntry.bSequential || BatchEntry.ArchiveIndex != FirstEntry.ArchiveIndex)
+            break;
+        if(BatchEntry.ArchiveOffs > (GroupEnd + CASC_BATCH_MAX_GAP))
+            break;
+        if((CASCLIB_MAX(GroupEnd, EntryEnd) - GroupStart) > CASC_BATCH_MAX_READ)
+            break;
+
+        GroupEnd = CASCLIB_MAX(GroupEnd, EntryEnd);
+    }
+
+    return nIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Asynchronous reading
+
+struct CASC_ASYNC_READ;
+
+// Part of an asynchronous read that belongs to one file span.
+// The encoded frames of a span are loaded by a single read operation
+struct CASC_ASYNC_SPAN
+{
+    CASC_ASYNC_READ * pRead;                        // The read operation this span belongs to
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the span
+    PCASC_FILE_SPAN pFileSpan;                      // The file span
+    PCASC_FILE_FRAME pFirstFrame;                   // First frame of the requested range
+    PCASC_FILE_FRAME pLastFrame;                    // Last frame of the requested range
+    ULONGLONG StartOffset;                          // Part of the file content that is read from this span
+    ULONGLONG EndOffset;
+    ULONGLONG ByteOffset;                           // Offset of the encoded frames in the data file
+    LPBYTE pbEncoded;                               // Encoded frames (loaded or mapped). NULL for plain data
+    LPBYTE pbBuffer;                                // Part of the caller's buffer that belongs to this span
+    DWORD EncodedSize;                              // Size of the encoded frames
+    DWORD dwErrCode;                                // Result of loading and decoding the span
+};
+
+struct CASC_ASYNC_READ
+{
+    TCascFile * hf;                                 // The file being read. Referenced until the callback returns
+    PFNREADCALLBACK PfnCallback;                    // Callback to be called when the read is complete
+    void * PtrUserParam;                            // Parameter for the callback
+    DWORD dwBytesToRead;                            // Number of bytes read if all spans succeed
+    DWORD dwPending;                                // Number of incomplete spans, plus one for the submitting thread
+    DWORD SpanCount;                                // Number of spans in the range
+    CASC_ASYNC_SPAN Spans[1];                       // Array of spans, with variable length
+};
+
+// Creates the I/O engine and the decoding threads on the first asynchronous read
+static DWORD EnsureAsyncEngine(TCascStorage * hs)
+{
+    DWORD dwThreadCount = CASCLIB_MAX(hs->dwThreadCount, CASC_ASYNC_MIN_THREADS);
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    CascLock(hs->StorageLock);
+    if(hs->pFileIo == NULL)
+        hs->pFileIo = FileStream_CreateIo(dwThreadCount);
+    if(hs->pFileIo == NULL)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    CascUnlock(hs->StorageLock);
+
+    // The decoding threads are shared with parallel reads
+    if(dwErrCode == ERROR_SUCCESS && EnsureDecodeQueue(hs) == NULL)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    return dwErrCode;
+}
+
+// Runs the work on a decoding thread. If that fails, we do the work right away
+static void PostAsyncWork(CASC_ASYNC_READ * pRead, PFNCASCWORK PfnWork, void * pvParam)
+{
+    if(!CascPostWork(pRead->hf->hs->pDecodeQueue, PfnWork, pvParam))
+    {
+        PfnWork(pvParam);
+    }
+}
+
+// Calls the caller's callback and frees the read operation. The callback may close the file
+static void FinishAsyncRead(void * pvParam)
+{
+    CASC_ASYNC_READ * pRead = (CASC_ASYNC_READ *)pvParam;
+    TCascFile * hf = pRead->hf;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Get the first error, if any
+    for(DWORD i = 0; i < pRead->SpanCount; i++)
+    {
+        if(pRead->Spans[i].dwErrCode != ERROR_SUCCESS)
+        {
+            dwErrCode = pRead->Spans[i].dwErrCode;
+            break;
+        }
+    }
+
+    pRead->PfnCallback(pRead->PtrUserParam, (HANDLE)hf, dwErrCode, (dwErrCode == ERROR_SUCCESS) ? pRead->dwBytesToRead : 0);
+    CASC_FREE(pRead);
+
+    // Release the reference taken by CascReadFileAsync. If the caller has closed the file, it is deleted now
+    hf->Release();
+}
+
+// Decodes the frames of one span to the caller's buffer. Runs on a decoding thread
+static void DecodeAsyncSpan(void * pvParam)
+{
+    CASC_ASYNC_SPAN * pSpan = (CASC_ASYNC_SPAN *)pvParam;
+    CASC_ASYNC_READ * pRead = pSpan->pRead;
+    PCASC_FILE_FRAME pFileFrame;
+    ULONGLONG StartOffset = pSpan->StartOffset;
+    ULONGLONG EndOffset = pSpan->EndOffset;
+    LPBYTE pbBuffer = pSpan->pbBuffer;
+    LPBYTE pbDecoded;
+    DWORD dwBytesToCopy;
+
+    // Decode all frames in the range. Plain data have been loaded to the buffer already
+    if(pSpan->dwErrCode == ERROR_SUCCESS && pSpan->pbEncoded != NULL)
+    {
+        for(pFileFrame = pSpan->pFirstFrame; pFileFrame <= pSpan->pLastFrame; pFileFrame++)
+        {
+            DWORD FrameIndex = (DWORD)(pFileFrame - pSpan->pFileSpan->pFrames);
+
+            // Only the edge frames, which are not read entirely, need a temporary buffer
+            dwBytesToCopy = (DWORD)(CASCLIB_MIN(pFileFrame->EndOffset, EndOffset) - StartOffset);
+            pbDecoded = pbBuffer;
+            if(pFileFrame->StartOffset < StartOffset || EndOffset < pFileFrame->EndOffset)
+            {
+                if((pbDecoded = CASC_ALLOC<BYTE>(pFileFrame->ContentSize)) == NULL)
+                {
+                    pSpan->dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+                    break;
+                }
+            }
+
+            // Decode the frame
+            pSpan->dwErrCode = DecodeFileFrame(pRead->hf, pSpan->pCKeyEntry, pFileFrame, pSpan->pbEncoded + (DWORD)(pFileFrame->DataFileOffset - pSpan->ByteOffset), pbDecoded, FrameIndex);
+
+            // Copy the part of the edge frame
+            if(pbDecoded != pbBuffer)
+            {
+                if(pSpan->dwErrCode == ERROR_SUCCESS)
+                    memcpy(pbBuffer, pbDecoded + (DWORD)(StartOffset - pFileFrame->StartOffset), dwBytesToCopy);
+                CASC_FREE(pbDecoded);
+            }
+
+            // Move pointers
+            if(pSpan->dwErrCode != ERROR_SUCCESS)
+                break;
+            StartOffset += dwBytesToCopy;
+            pbBuffer += dwBytesToCopy;
+        }
+    }
+
+    // Free the encoded buffer
+    FreeEncodedData(pSpan->pFileSpan->pStream, pSpan->ByteOffset, pSpan->EncodedSize, pSpan->pbEncoded);
+    pSpan->pbEncoded = NULL;
+
+    // The last span completes the read operation. We are on a decoding thread already
+    if(CascInterlockedDecrement(&pRead->dwPending) == 0)
+        FinishAsyncRead(pRead);
+}
+
+// Called by the I/O engine when the data of the span have been loaded
+static void OnAsyncSpanLoaded(void * pvContext, DWORD dwErrCode)
+{
+    CASC_ASYNC_SPAN * pSpan = (CASC_ASYNC_SPAN *)pvContext;
+    CASC_ASYNC_READ * pRead = pSpan->pRead;
+
+    // Encoded frames need decoding. Decoding also frees the encoded buffer.
+    // Don't block the I/O thread with it, as it would stop completing other reads
+    pSpan->dwErrCode = dwErrCode;
+    if(pSpan->pbEncoded != NULL)
+    {
+        PostAsyncWork(pRead, DecodeAsyncSpan, pSpan);
+        return;
+    }
+
+    // Plain data are complete now
+    if(CascInterlockedDecrement(&pRead->dwPending) == 0)
+        PostAsyncWork(pRead, FinishAsyncRead, pRead);
+}
+
+// Starts loading the data of one span
+static void StartAsyncSpan(TCascStorage * hs, CASC_ASYNC_SPAN * pSpan)
+{
+    PCASC_FILE_FRAME pFirstFrame = pSpan->pFirstFrame;
+    PCASC_FILE_FRAME pLastFrame = pSpan->pLastFrame;
+    TFileStream * pStream = pSpan->pFileSpan->pStream;
+
+    // Plain data: Read the requested part of the span directly to the caller's buffer
+    if(pSpan->pCKeyEntry->Flags & CASC_CE_PLAIN_DATA)
+    {
+        pSpan->ByteOffset = pFirstFrame->DataFileOffset + (pSpan->StartOffset - pFirstFrame->StartOffset);
+        pSpan->EncodedSize = (DWORD)(pSpan->EndOffset - pSpan->StartOffset);
+        if(!FileStream_ReadAsync(hs->pFileIo, pStream, pSpan->ByteOffset, pSpan->pbBuffer, pSpan->EncodedSize, OnAsyncSpanLoaded, pSpan))
+            OnAsyncSpanLoaded(pSpan, GetCascError());
+        return;
+    }
+
+    // The encoded frames of the range are stored one after another in the data file
+    pSpan->ByteOffset = pFirstFrame->DataFileOffset;
+    pSpan->EncodedSize = (DWORD)(pLastFrame->DataFileOffset + pLastFrame->EncodedSize - pSpan->ByteOffset);
+
+    // Mapped data files need no I/O at all
+    if((pSpan->pbEncoded = FileStream_GetMappedData(pStream, pSpan->ByteOffset, pSpan->EncodedSize)) != NULL)
+    {
+        OnAsyncSpanLoaded(pSpan, ERROR_SUCCESS);
+        return;
+    }
+
+    // Allocate buffer for the encoded frames and start loading them
+    if((pSpan->pbEncoded = CASC_ALLOC<BYTE>(pSpan->EncodedSize)) == NULL)
+    {
+        OnAsyncSpanLoaded(pSpan, ERROR_NOT_ENOUGH_MEMORY);
+        return;
+    }
+    if(!FileStream_ReadAsync(hs->pFileIo, pStream, pSpan->ByteOffset, pSpan->pbEncoded, pSpan->EncodedSize, OnAsyncSpanLoaded, pSpan))
+        OnAsyncSpanLoaded(pSpan, GetCascError());
+}
+
+// Prepares the async read operation for the given range of the file
+static CASC_ASYNC_READ * CreateAsyncRead(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset, DWORD & dwErrCode)
+{
+    CASC_ASYNC_READ * pRead;
+    CASC_ASYNC_SPAN * pSpan;
+    PCASC_CKEY_ENTRY pCKeyEntry = hf->pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
+    DWORD SpanCount = 0;
+
+    // Count the spans that are in the range
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount; SpanIndex++)
+    {
+        if(pFileSpan[SpanIndex].StartOffset < EndOffset && StartOffset < pFileSpan[SpanIndex].EndOffset)
+            SpanCount++;
+    }
+
+    // Allocate the read operation
+    if((pRead = (CASC_ASYNC_READ *)CASC_ALLOC<BYTE>(sizeof(CASC_ASYNC_READ) + SpanCount * sizeof(CASC_ASYNC_SPAN))) == NULL)
+    {
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        return NULL;
+    }
+    memset(pRead, 0, sizeof(CASC_ASYNC_READ) + SpanCount * sizeof(CASC_ASYNC_SPAN));
+    pRead->hf = hf;
+    pRead->dwBytesToRead = (DWORD)(EndOffset - StartOffset);
+
+    // Fill the spans
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount && StartOffset < EndOffset; SpanIndex++, pCKeyEntry++, pFileSpan++)
+    {
+        // Skip the spans that are not in the range
+        if(StartOffset < pFileSpan->StartOffset || StartOffset >= pFileSpan->EndOffset)
+            continue;
+        pSpan = pRead->Spans + pRead->SpanCount;
+
+        // Locate the first and the last frame of the range
+        pSpan->pRead = pRead;
+        pSpan->pCKeyEntry = pCKeyEntry;
+        pSpan->pFileSpan = pFileSpan;
+        pSpan->StartOffset = StartOffset;
+        pSpan->EndOffset = CASCLIB_MIN(EndOffset, pFileSpan->EndOffset);
+        pSpan->pFirstFrame = FindFileFrame(pFileSpan, pSpan->StartOffset);
+        pSpan->pLastFrame = FindFileFrame(pFileSpan, pSpan->EndOffset - 1);
+        if(pSpan->pFirstFrame == NULL || pSpan->pLastFrame == NULL)
+        {
+            dwErrCode = ERROR_FILE_CORRUPT;
+            CASC_FREE(pRead);
+            return NULL;
+        }
+
+        // Move to the next part of the buffer
+        pSpan->pbBuffer = pbBuffer;
+        pbBuffer += (DWORD)(pSpan->EndOffset - pSpan->StartOffset);
+        StartOffset = pSpan->EndOffset;
+        pRead->SpanCount++;
+    }
+
+    dwErrCode = ERROR_SUCCESS;
+    return pRead;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+bool WINAPI CascGetFileInfo(HANDLE hFile, CASC_FILE_INFO_CLASS InfoClass, void * pvFileInfo, size_t cbFileInfo, size_t * pcbLengthNeeded)
+{
+    TCascFile * hf;
+    LPBYTE pbOutputValue = NULL;
+    LPBYTE pbInfoValue = NULL;
+    size_t cbInfoValue = 0;
+
+    // Validate the file handle
+    if((hf = TCascFile::IsValid(hFile)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // Differentiate between info classes
+    switch(InfoClass)
+    {
+        case CascFileContentKey:
 
             // Do we have content key at all?
             if(hf->pCKeyEntry == NULL || (hf->pCKeyEntry->Flags & CASC_CE_HAS_CKEY) == 0)
@@ -1033,15 +2149,16 @@ bool WINAPI CascSetFileFlags(HANDLE hFile, DWORD dwOpenFlags)
         return false;
     }
 
-    // Currently, only CASC_OVERCOME_ENCRYPTED can be changed
-    if(dwOpenFlags & ~CASC_OVERCOME_ENCRYPTED)
+    // Currently, only CASC_OVERCOME_ENCRYPTED and CASC_PARALLEL_DECODE can be changed
+    if(dwOpenFlags & ~(CASC_OVERCOME_ENCRYPTED | CASC_PARALLEL_DECODE))
     {
         SetCascError(ERROR_INVALID_PARAMETER);
         return false;
     }
 
-    // Set "overcome encrypted" flag. Will apply on next CascReadFile
+    // Set the flags. Will apply on next CascReadFile
     hf->bOvercomeEncrypted = (dwOpenFlags & CASC_OVERCOME_ENCRYPTED) ? true : false;
+    hf->bParallelDecode    = (dwOpenFlags & CASC_PARALLEL_DECODE) ? true : false;
     return true;
 }
 
@@ -1279,7 +2396,7 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
     // Perform the cache-strategy-specific read
     switch(hf->CacheStrategy)
     {
-        // No caching at all. The entire file will be read directly to the user buffer
+        // No caching at all. The requested range will be read directly to the user buffer
         // Used for loading internal files, where we need to read the whole file
         case CascCacheNothing:
             dwBytesRead2 = ReadFile_NonCached(hf, pbBuffer, StartOffset, EndOffset);
@@ -1287,8 +2404,13 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
 
         // Read as many frames as we can. The last loaded frame, if not read entirely,
         // will stay in the cache - We expect the next read to continue from that offset.
+        // Reading the whole file with parallel decoding or with verification doesn't need the cache.
+        // The frames are then decoded (and their hashes verified) by groups
         case CascCacheLastFrame:
-            dwBytesRead2 = ReadFile_FrameCached(hf, pbBuffer, StartOffset, EndOffset);
+            if((hf->bParallelDecode || hf->bVerifyIntegrity) && StartOffset == 0 && EndOffset == hf->ContentSize)
+                dwBytesRead2 = ReadFile_NonCached(hf, pbBuffer, StartOffset, EndOffset);
+            else
+                dwBytesRead2 = ReadFile_FrameCached(hf, pbBuffer, StartOffset, EndOffset);
             break;
     }
 
@@ -1312,3 +2434,180 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
         return (dwBytesToRead == 0);
     }
 }
+
+bool WINAPI CascReadFilesBatch(HANDLE hStorage, const CASC_BATCH_ITEM * pItems, size_t nItemCount, PFNBATCHCALLBACK PfnCallback, void * PtrUserParam)
+{
+    CASC_BATCH_BUFFER Encoded = {NULL, 0};
+    CASC_BATCH_BUFFER Decoded = {NULL, 0};
+    CASC_BATCH_ENTRY * BatchEntries;
+    TCascStorage * hs;
+    ULONGLONG GroupStart = 0;
+    ULONGLONG GroupEnd = 0;
+    LPBYTE pbGroup;
+    size_t nGroupEnd;
+    size_t nEntryCount = 0;
+    bool bCancelled = false;
+    DWORD dwErrCode;
+
+    // Validate the storage handle and the parameters
+    if((hs = TCascStorage::IsValid(hStorage)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+    if((pItems == NULL && nItemCount != 0) || PfnCallback == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Allocate the array of batch entries
+    if((BatchEntries = CASC_ALLOC<CASC_BATCH_ENTRY>(CASCLIB_MAX(nItemCount, 1))) == NULL)
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+
+    // Resolve all files. Files that failed to open are reported right away
+    for(size_t i = 0; i < nItemCount && bCancelled == false; i++)
+    {
+        CASC_BATCH_ENTRY & BatchEntry = BatchEntries[nEntryCount];
+
+        memset(&BatchEntry, 0, sizeof(CASC_BATCH_ENTRY));
+        BatchEntry.pItem = pItems + i;
+
+        if((dwErrCode = OpenBatchEntry(hs, BatchEntry)) == ERROR_SUCCESS)
+            nEntryCount++;
+        else
+            bCancelled = CompleteBatchEntry(BatchEntry, dwErrCode, Decoded, PfnCallback, PtrUserParam);
+    }
+
+    // Sort the files by their position in the data files
+    qsort(BatchEntries, nEntryCount, sizeof(CASC_BATCH_ENTRY), CompareBatchEntries);
+
+    // Read the files. Neighboring files are read by one read operation
+    for(size_t i = 0; i < nEntryCount && bCancelled == false; i = nGroupEnd)
+    {
+        // Files that can't be read in storage order are read one by one
+        if(BatchEntries[i].bSequential == false)
+        {
+            dwErrCode = ReadBatchEntry(BatchEntries[i], Decoded);
+            bCancelled = CompleteBatchEntry(BatchEntries[i], dwErrCode, Decoded, PfnCallback, PtrUserParam);
+            nGroupEnd = i + 1;
+            continue;
+        }
+
+        // Get the encoded data of the whole group. If the data file is memory-mapped, we use the mapped view
+        TCascFile * hf = TCascFile::IsValid(BatchEntries[i].hFile);
+        TFileStream * pStream = hf->pFileSpan->pStream;
+
+        nGroupEnd = GetBatchGroup(BatchEntries, i, nEntryCount, GroupStart, GroupEnd);
+        if((pbGroup = FileStream_GetMappedData(pStream, GroupStart, (DWORD)(GroupEnd - GroupStart))) == NULL)
+        {
+            if((pbGroup = EnsureBatchBuffer(Encoded, GroupEnd - GroupStart)) != NULL)
+            {
+                if(!FileStream_Read(pStream, &GroupStart, pbGroup, (DWORD)(GroupEnd - GroupStart)))
+                    pbGroup = NULL;
+            }
+        }
+
+        // Decode all files of the group. If the group read failed, we read the files one by one
+        for(size_t j = i; j < nGroupEnd && bCancelled == false; j++)
+        {
+            CASC_BATCH_ENTRY & BatchEntry = BatchEntries[j];
+
+            if(pbGroup != NULL)
+                dwErrCode = DecodeBatchEntry(BatchEntry, pbGroup + (size_t)(BatchEntry.ArchiveOffs - GroupStart), Decoded);
+            else
+                dwErrCode = ReadBatchEntry(BatchEntry, Decoded);
+            bCancelled = CompleteBatchEntry(BatchEntry, dwErrCode, Decoded, PfnCallback, PtrUserParam);
+        }
+    }
+
+    // Close the files that were not processed due to cancellation
+    for(size_t i = 0; i < nEntryCount; i++)
+    {
+        if(BatchEntries[i].hFile != NULL)
+            CascCloseFile(BatchEntries[i].hFile);
+    }
+
+    // Free the buffers
+    CASC_FREE(Encoded.pbData);
+    CASC_FREE(Decoded.pbData);
+    CASC_FREE(BatchEntries);
+
+    if(bCancelled)
+        SetCascError(ERROR_CANCELLED);
+    return (bCancelled == false);
+}
+
+bool WINAPI CascReadFileAsync(HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PFNREADCALLBACK PfnCallback, void * PtrUserParam)
+{
+    CASC_ASYNC_READ * pRead;
+    ULONGLONG StartOffset = ByteOffset;
+    ULONGLONG EndOffset = ByteOffset;
+    TCascFile * hf;
+    DWORD dwErrCode;
+
+    // The buffer and the callback must be valid
+    if((pvBuffer == NULL && dwBytesToRead != 0) || PfnCallback == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Validate the file handle
+    if((hf = TCascFile::IsValid(hFile)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // The I/O engine belongs to the storage. Files opened by CascOpenLocalFile have none
+    if(hf->hs == NULL)
+    {
+        SetCascError(ERROR_NOT_SUPPORTED);
+        return false;
+    }
+
+    // Load the file frames and the asynchronous engine. This is done synchronously,
+    // the frame headers are needed to know where the data are
+    if(hf->ContentSize != 0)
+    {
+        if((dwErrCode = EnsureFileSpanFramesLoaded(hf)) != ERROR_SUCCESS)
+        {
+            SetCascError(dwErrCode);
+            return false;
+        }
+    }
+    if((dwErrCode = EnsureAsyncEngine(hf->hs)) != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+
+    // Cut the range to the file size. Reading at or beyond end of the file gives zero bytes
+    if(StartOffset < hf->ContentSize)
+        EndOffset = CASCLIB_MIN(StartOffset + dwBytesToRead, hf->ContentSize);
+
+    // Prepare the read operation
+    if((pRead = CreateAsyncRead(hf, (LPBYTE)pvBuffer, StartOffset, EndOffset, dwErrCode)) == NULL)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+    pRead->PfnCallback = PfnCallback;
+    pRead->PtrUserParam = PtrUserParam;
+    pRead->dwPending = pRead->SpanCount + 1;
+
+    // The caller may close the file before the read completes. Keep it alive until the callback returns
+    hf->AddRef();
+
+    // Start loading all spans. The callback is always called on a worker thread,
+    // even if all the spans were completed before we got here
+    for(DWORD i = 0; i < pRead->SpanCount; i++)
+        StartAsyncSpan(hf->hs, pRead->Spans + i);
+    if(CascInterlockedDecrement(&pRead->dwPending) == 0)
+        PostAsyncWork(pRead, FinishAsyncRead, pRead);
+    return true;
+}
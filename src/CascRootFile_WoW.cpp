@@ -90,6 +90,164 @@ typedef struct _FILE_ROOT_GROUP
 
 } FILE_ROOT_GROUP, *PFILE_ROOT_GROUP;
 
+//-----------------------------------------------------------------------------
+// Parallel resolving of the listfile names
+
+#define WOW_LISTFILE_CHUNK_LINES    0x1000      // Number of listfile lines resolved by one work item
+#define WOW_LISTFILE_WINDOW_CHUNKS  0x40        // Number of chunks loaded from the listfile at once
+#define WOW_LISTFILE_MAX_PENDING    0x400       // Number of folder hashes calculated at once by a work item
+#define WOW_LISTFILE_PREFETCH       8           // How many lines ahead the file nodes are prefetched when naming them
+
+// One line loaded from the listfile
+typedef struct _WOW_LISTFILE_LINE
+{
+    const char * szFileName;                    // Pointer to the file name in the listfile. Not zero-terminated
+    size_t nLength;                             // Length of the file name, in chars
+    size_t nNodeIndex;                          // Index of the file node to be named, or CASC_INVALID_SIZE_T
+    size_t nHashIndex;                          // Index of the path hashes in the chunk, or CASC_INVALID_SIZE_T
+    DWORD FileDataId;                           // File data ID (WoW 8.2.0+ only)
+} WOW_LISTFILE_LINE, *PWOW_LISTFILE_LINE;
+
+// One chunk of listfile lines, resolved by a single work item
+typedef struct _WOW_LISTFILE_CHUNK
+{
+    CASC_ARRAY PathHashes;                      // Path hashes of all resolved lines (see CASC_FILE_TREE::GetPathHashLengths)
+    size_t nFirstLine;                          // Index of the first line of the chunk
+    size_t nLineCount;                          // Number of lines in the chunk
+} WOW_LISTFILE_CHUNK, *PWOW_LISTFILE_CHUNK;
+
+// Folder hashes that wait to be calculated
+typedef struct _WOW_PENDING_HASHES
+{
+    const char * NormNames[WOW_LISTFILE_MAX_PENDING];
+    size_t NameLengths[WOW_LISTFILE_MAX_PENDING];
+    size_t HashIndexes[WOW_LISTFILE_MAX_PENDING];   // Where to store the hash in the chunk's PathHashes
+    size_t nCount;
+} WOW_PENDING_HASHES, *PWOW_PENDING_HASHES;
+
+// Shared state of all work items
+typedef struct _WOW_LISTFILE_LOAD
+{
+    CASC_FILE_TREE * pFileTree;                 // The file tree. Read-only while the work items are running
+    PWOW_LISTFILE_LINE pLines;                  // Lines of the current window
+    PWOW_LISTFILE_CHUNK pChunks;                // Chunks of the current window
+    ROOT_FORMAT RootFormat;
+} WOW_LISTFILE_LOAD, *PWOW_LISTFILE_LOAD;
+
+static void FlushPendingHashes(PWOW_LISTFILE_CHUNK pChunk, PWOW_PENDING_HASHES pPending)
+{
+    ULONGLONG NameHashes[WOW_LISTFILE_MAX_PENDING];
+    PULONGLONG PathHashes = (PULONGLONG)pChunk->PathHashes.ItemArray();
+
+    CalcNormNameHashes(pPending->NormNames, pPending->NameLengths, NameHashes, pPending->nCount);
+    for(size_t i = 0; i < pPending->nCount; i++)
+        PathHashes[pPending->HashIndexes[i]] = NameHashes[i];
+    pPending->nCount = 0;
+}
+
+// Finds the file nodes for one chunk of lines and calculates the hashes needed by SetNodeFileName.
+// The file tree is not changed here; the names are assigned by the calling thread afterwards.
+static DWORD ResolveListFileChunk_Worker(void * pvContext, DWORD dwChunkIndex)
+{
+    PWOW_LISTFILE_LOAD pLoad = (PWOW_LISTFILE_LOAD)pvContext;
+    PWOW_LISTFILE_CHUNK pChunk = pLoad->pChunks + dwChunkIndex;
+    PWOW_LISTFILE_LINE pLines;
+    PWOW_LISTFILE_LINE pLine;
+    PCASC_FILE_NODE pFileNode;
+    WOW_PENDING_HASHES Pending;
+    const char * NormNames[CASC_NAME_BATCH_SIZE];
+    ULONGLONG NameHashes[CASC_NAME_BATCH_SIZE];
+    size_t NameLengths[CASC_NAME_BATCH_SIZE];
+    size_t LineIndexes[CASC_NAME_BATCH_SIZE];
+    size_t HashLengths[MAX_PATH];
+    char NormBuffer[CASC_NAME_BATCH_SIZE][MAX_PATH];
+    char szFileName[MAX_PATH];
+    void * pvHashes;
+
+    pChunk->PathHashes.Reset();
+    Pending.nCount = 0;
+
+    for(size_t nStart = 0; nStart < pChunk->nLineCount; nStart += CASC_NAME_BATCH_SIZE)
+    {
+        size_t nCount = CASCLIB_MIN(pChunk->nLineCount - nStart, CASC_NAME_BATCH_SIZE);
+        size_t nNameCount = 0;
+
+        // Normalize the names of the batch. Lines that are too long are ignored, same like in ApplyListFile
+        pLines = pLoad->pLines + pChunk->nFirstLine + nStart;
+        for(size_t i = 0; i < nCount; i++)
+        {
+            pLines[i].nNodeIndex = CASC_INVALID_SIZE_T;
+            pLines[i].nHashIndex = CASC_INVALID_SIZE_T;
+
+            if(pLines[i].nLength < MAX_PATH)
+            {
+                memcpy(szFileName, pLines[i].szFileName, pLines[i].nLength);
+                szFileName[pLines[i].nLength] = 0;
+
+                NormNames[nNameCount] = NormBuffer[nNameCount];
+                NameLengths[nNameCount] = NormalizeFileName_UpperBkSlash(NormBuffer[nNameCount], szFileName, MAX_PATH);
+                LineIndexes[nNameCount++] = i;
+            }
+        }
+
+        // Hash the full names of the whole batch at once
+        CalcNormNameHashes(NormNames, NameLengths, NameHashes, nNameCount);
+
+        // Find the file nodes. For WoW 8.2.0+, the file name hash must also match (see TRootHandler_WoW::ApplyListFile).
+        // Only take nodes that have no name yet
+        for(size_t i = 0; i < nNameCount; i++)
+        {
+            pLine = pLines + LineIndexes[i];
+            if(pLoad->RootFormat == RootFormatWoW_v2)
+            {
+                pFileNode = pLoad->pFileTree->FindById(pLine->FileDataId);
+                if(pFileNode != NULL && pFileNode->FileNameHash && pFileNode->FileNameHash != NameHashes[i])
+                    pFileNode = NULL;
+            }
+            else
+            {
+                pFileNode = pLoad->pFileTree->Find(NameHashes[i]);
+            }
+
+            if(pFileNode != NULL && pFileNode->NameLength == 0)
+                pLine->nNodeIndex = pLoad->pFileTree->IndexOf(pFileNode);
+        }
+
+        // Reserve space for the path hashes of the found nodes.
+        // If this fails, SetNodeFileName will calculate them itself
+        for(size_t i = 0; i < nNameCount; i++)
+        {
+            size_t nHashCount;
+
+            pLine = pLines + LineIndexes[i];
+            if(pLine->nNodeIndex == CASC_INVALID_SIZE_T)
+                continue;
+
+            nHashCount = CASC_FILE_TREE::GetPathHashLengths(NormNames[i], NameLengths[i], HashLengths);
+            if((Pending.nCount + nHashCount) > WOW_LISTFILE_MAX_PENDING)
+                FlushPendingHashes(pChunk, &Pending);
+            if((pvHashes = pChunk->PathHashes.Insert(nHashCount)) != NULL)
+            {
+                pLine->nHashIndex = pChunk->PathHashes.IndexOf(pvHashes);
+
+                // The folder hashes are calculated later, the hash of the full name is known already
+                for(size_t j = 0; j < nHashCount - 1; j++)
+                {
+                    Pending.NormNames[Pending.nCount] = NormNames[i];
+                    Pending.NameLengths[Pending.nCount] = HashLengths[j];
+                    Pending.HashIndexes[Pending.nCount++] = pLine->nHashIndex + j;
+                }
+                ((PULONGLONG)pvHashes)[nHashCount - 1] = NameHashes[i];
+            }
+        }
+
+        // The normalized names are only valid for the current batch
+        FlushPendingHashes(pChunk, &Pending);
+    }
+
+    return ERROR_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 // TRootHandler_WoW interface / implementation
 
@@ -511,80 +669,213 @@ struct TRootHandler_WoW : public TFileTreeRoot
         return dwErrCode;
     }
 
-    // Search for files
-    PCASC_CKEY_ENTRY Search(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
+    // Loads up to CASC_NAME_BATCH_SIZE names from the listfile. If FileDataIds is NULL,
+    // the listfile only contains names. Lines that are too long to fit in the buffer are ignored
+    size_t LoadListFileNames(void * pvListFile, char (*FileNames)[MAX_PATH], PDWORD FileDataIds)
     {
-        // If we have a listfile, we'll feed the listfile entries to the file tree
-        if(pSearch->pCache != NULL && pSearch->bListFileUsed == false)
+        size_t nNameCount = 0;
+        size_t nLength;
+
+        while(nNameCount < CASC_NAME_BATCH_SIZE)
         {
-            PCASC_FILE_NODE pFileNode;
-            ULONGLONG FileNameHash;
-            size_t nLength;
-            DWORD FileDataId = CASC_INVALID_ID;
-            char szFileName[MAX_PATH];
+            // Retrieve the next line from the list file
+            if(FileDataIds != NULL)
+                nLength = ListFile_GetNext(pvListFile, FileNames[nNameCount], MAX_PATH, &FileDataIds[nNameCount]);
+            else
+                nLength = ListFile_GetNextLine(pvListFile, FileNames[nNameCount], MAX_PATH);
 
-            if(RootFormat == RootFormatWoW_v2)
+            if(nLength == 0)
             {
-                // Keep going through the listfile
-                for(;;)
-                {
-                    // Retrieve the next line from the list file. Ignore lines that are too long to fit in the buffer
-                    nLength = ListFile_GetNext(pSearch->pCache, szFileName, _countof(szFileName), &FileDataId);
-                    if(nLength == 0)
-                    {
-                        if(GetCascError() == ERROR_INSUFFICIENT_BUFFER)
-                            continue;
-                        break;
-                    }
+                if(GetCascError() == ERROR_INSUFFICIENT_BUFFER)
+                    continue;
+                break;
+            }
+            nNameCount++;
+        }
+        return nNameCount;
+    }
 
-                    //
-                    // Several files were renamed around WoW build 50893 (10.1.7). Example:
-                    //
-                    //  * 2965132; interface/icons/inv_helm_armor_explorer_d_01.blp     file name hash = 0x770b8d2dc4d940aa
-                    //  * 2965132; interface/icons/inv_armor_explorer_d_01_helm.blp     file name hash = 0xf47ec17f4a1e49a2
-                    //
-                    // For that reason, we also need to check whether the file name hash matches
-                    //
+    // Feeds the listfile names to the file tree. The names are loaded and hashed in batches of CASC_NAME_BATCH_SIZE
+    void ApplyListFile(void * pvListFile)
+    {
+        const char * FileNamePtrs[CASC_NAME_BATCH_SIZE];
+        char FileNames[CASC_NAME_BATCH_SIZE][MAX_PATH];
+        PCASC_FILE_NODE pFileNode;
+        size_t nNameCount;
 
-                    // BREAKIF(FileDataId == 2965132);
+        if(RootFormat == RootFormatWoW_v2)
+        {
+            ULONGLONG FileNameHashes[CASC_NAME_BATCH_SIZE];
+            DWORD FileDataIds[CASC_NAME_BATCH_SIZE];
 
-                    if((pFileNode = FileTree.FindById(FileDataId)) != NULL)
+            // Keep going through the listfile
+            while((nNameCount = LoadListFileNames(pvListFile, FileNames, FileDataIds)) != 0)
+            {
+                //
+                // Several files were renamed around WoW build 50893 (10.1.7). Example:
+                //
+                //  * 2965132; interface/icons/inv_helm_armor_explorer_d_01.blp     file name hash = 0x770b8d2dc4d940aa
+                //  * 2965132; interface/icons/inv_armor_explorer_d_01_helm.blp     file name hash = 0xf47ec17f4a1e49a2
+                //
+                // For that reason, we also need to check whether the file name hash matches
+                //
+
+                // Hash the names of the whole batch at once
+                for(size_t i = 0; i < nNameCount; i++)
+                    FileNamePtrs[i] = FileNames[i];
+                CalcFileNameHashes(FileNamePtrs, FileNameHashes, nNameCount);
+
+                for(size_t i = 0; i < nNameCount; i++)
+                {
+                    // BREAKIF(FileDataIds[i] == 2965132);
+
+                    if((pFileNode = FileTree.FindById(FileDataIds[i])) != NULL)
                     {
                         if(pFileNode->NameLength == 0)
                         {
-                            if(pFileNode->FileNameHash && pFileNode->FileNameHash != CalcFileNameHash(szFileName))
+                            if(pFileNode->FileNameHash && pFileNode->FileNameHash != FileNameHashes[i])
                                 continue;
-                            FileTree.SetNodeFileName(pFileNode, szFileName);
+                            FileTree.SetNodeFileName(pFileNode, FileNames[i]);
                         }
                     }
                 }
             }
-            else
+        }
+        else
+        {
+            size_t NodeIndexes[CASC_NAME_BATCH_SIZE];
+
+            // Keep going through the listfile
+            while((nNameCount = LoadListFileNames(pvListFile, FileNames, NULL)) != 0)
             {
-                // Keep going through the listfile
-                for(;;)
+                // Find the file nodes by file name hashes
+                for(size_t i = 0; i < nNameCount; i++)
+                    FileNamePtrs[i] = FileNames[i];
+                FileTree.FindByNames(FileNamePtrs, NodeIndexes, nNameCount);
+
+                // Assign the names to the nodes that don't have one yet. SetNodeFileName may insert
+                // folder nodes and move the node table, so each node is retrieved right before use
+                for(size_t i = 0; i < nNameCount; i++)
                 {
-                    // Retrieve the next line from the list file. Ignore lines that are too long to fit in the buffer
-                    nLength = ListFile_GetNextLine(pSearch->pCache, szFileName, _countof(szFileName));
-                    if(nLength == 0)
+                    if(NodeIndexes[i] != CASC_INVALID_SIZE_T && (pFileNode = FileTree.ItemAt(NodeIndexes[i])) != NULL && pFileNode->NameLength == 0)
                     {
-                        if(GetCascError() == ERROR_INSUFFICIENT_BUFFER)
-                            continue;
-                        break;
+                        WriteVerifiedFileName(0, FileNames[i]);
+                        FileTree.SetNodeFileName(pFileNode, FileNames[i]);
                     }
+                }
+            }
+        }
+    }
 
-                    // Calculate the hash of the file name
-                    FileNameHash = CalcFileNameHash(szFileName);
+    // Loads up to one window of lines from the listfile. Returns the number of lines loaded
+    size_t LoadListFileWindow(void * pvListFile, PWOW_LISTFILE_LINE pLines)
+    {
+        const char * szLineBegin;
+        const char * szLineEnd;
+        size_t nLineCount = 0;
+        size_t nLength;
+        DWORD FileDataId = CASC_INVALID_ID;
+
+        while(nLineCount < WOW_LISTFILE_CHUNK_LINES * WOW_LISTFILE_WINDOW_CHUNKS)
+        {
+            // Same stop conditions like LoadListFileNames. Lines that are too long are skipped by the workers
+            if(RootFormat == RootFormatWoW_v2)
+                nLength = ListFile_GetNext(pvListFile, &szLineBegin, &szLineEnd, &FileDataId);
+            else
+                nLength = ListFile_GetNextLine(pvListFile, &szLineBegin, &szLineEnd);
+            if(nLength == 0)
+                break;
 
-                    // Try to find the file node by file name hash
-                    pFileNode = FileTree.Find(FileNameHash);
-                    if(pFileNode != NULL && pFileNode->NameLength == 0)
+            pLines[nLineCount].szFileName = szLineBegin;
+            pLines[nLineCount].nLength = nLength;
+            pLines[nLineCount].FileDataId = FileDataId;
+            nLineCount++;
+        }
+        return nLineCount;
+    }
+
+    // Feeds the listfile names to the file tree using multiple threads. The listfile is loaded in windows
+    // of lines; the file nodes are looked up by the worker threads and the names are then assigned
+    // in the listfile order, so the file tree is exactly the same like the one from ApplyListFile
+    DWORD ApplyListFile_Parallel(void * pvListFile, DWORD dwThreadCount)
+    {
+        WOW_LISTFILE_LOAD Load;
+        PCASC_FILE_NODE pFileNode;
+        PULONGLONG PathHashes;
+        char szFileName[MAX_PATH];
+        size_t nLineCount;
+        DWORD dwChunkCount;
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        // Allocate the lines and chunks for one window
+        Load.pFileTree = &FileTree;
+        Load.pLines = CASC_ALLOC<WOW_LISTFILE_LINE>(WOW_LISTFILE_CHUNK_LINES * WOW_LISTFILE_WINDOW_CHUNKS);
+        Load.pChunks = new WOW_LISTFILE_CHUNK[WOW_LISTFILE_WINDOW_CHUNKS];
+        Load.RootFormat = RootFormat;
+        if(Load.pLines == NULL || Load.pChunks == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+        for(DWORD i = 0; i < WOW_LISTFILE_WINDOW_CHUNKS && dwErrCode == ERROR_SUCCESS; i++)
+            dwErrCode = Load.pChunks[i].PathHashes.Create<ULONGLONG>(WOW_LISTFILE_CHUNK_LINES * 4);
+
+        // Keep going through the listfile
+        while(dwErrCode == ERROR_SUCCESS && (nLineCount = LoadListFileWindow(pvListFile, Load.pLines)) != 0)
+        {
+            // Split the window to chunks
+            dwChunkCount = (DWORD)((nLineCount + WOW_LISTFILE_CHUNK_LINES - 1) / WOW_LISTFILE_CHUNK_LINES);
+            for(DWORD i = 0; i < dwChunkCount; i++)
+            {
+                Load.pChunks[i].nFirstLine = (size_t)i * WOW_LISTFILE_CHUNK_LINES;
+                Load.pChunks[i].nLineCount = CASCLIB_MIN(nLineCount - Load.pChunks[i].nFirstLine, WOW_LISTFILE_CHUNK_LINES);
+            }
+
+            // Find the file nodes on all threads
+            CascRunParallel(ResolveListFileChunk_Worker, &Load, dwChunkCount, dwThreadCount);
+
+            // Assign the names in the listfile order. A file node may have been named
+            // by an earlier line, and the node table may have been reallocated since
+            for(size_t i = 0; i < nLineCount; i++)
+            {
+                PWOW_LISTFILE_CHUNK pChunk = Load.pChunks + (i / WOW_LISTFILE_CHUNK_LINES);
+                PWOW_LISTFILE_LINE pLine = Load.pLines + i;
+
+                // Load the file node of one of the next lines to the cache
+                if((i + WOW_LISTFILE_PREFETCH) < nLineCount && pLine[WOW_LISTFILE_PREFETCH].nNodeIndex != CASC_INVALID_SIZE_T)
+                    CascPrefetch(FileTree.ItemAt(pLine[WOW_LISTFILE_PREFETCH].nNodeIndex));
+
+                if(pLine->nNodeIndex != CASC_INVALID_SIZE_T)
+                {
+                    pFileNode = FileTree.ItemAt(pLine->nNodeIndex);
+                    if(pFileNode->NameLength == 0)
                     {
-                        WriteVerifiedFileName(0, szFileName);
-                        FileTree.SetNodeFileName(pFileNode, szFileName);
+                        memcpy(szFileName, pLine->szFileName, pLine->nLength);
+                        szFileName[pLine->nLength] = 0;
+
+                        if(RootFormat == RootFormatWoW_v1)
+                        {
+                            WriteVerifiedFileName(0, szFileName);
+                        }
+                        PathHashes = (PULONGLONG)pChunk->PathHashes.ItemAt(pLine->nHashIndex);
+                        FileTree.SetNodeFileName(pFileNode, szFileName, PathHashes);
                     }
                 }
             }
+        }
+
+        delete [] Load.pChunks;
+        CASC_FREE(Load.pLines);
+        return dwErrCode;
+    }
+
+    // Search for files
+    PCASC_CKEY_ENTRY Search(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
+    {
+        // If we have a listfile, we'll feed the listfile entries to the file tree.
+        // With multiple threads, the file nodes are found in parallel
+        if(pSearch->pCache != NULL && pSearch->bListFileUsed == false)
+        {
+            if(pSearch->hs->dwThreadCount <= 1 || ApplyListFile_Parallel(pSearch->pCache, pSearch->hs->dwThreadCount) != ERROR_SUCCESS)
+                ApplyListFile(pSearch->pCache);
             pSearch->bListFileUsed = true;
         }
 
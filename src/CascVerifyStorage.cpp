@@ -0,0 +1,625 @@
+/*****************************************************************************/
+/* CascVerifyStorage.cpp             Copyright (c) CascLib contributors 2024 */
+/*---------------------------------------------------------------------------*/
+/* Verifying the local storage, one data file at a time                      */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.24  1.00  ---  The first version of CascVerifyStorage.cpp           */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+// Size of one read operation from the data file. Larger spans are read at once
+#define CASC_VERIFY_WINDOW      0x1000000
+
+// Size of the part of BLTE_ENCODED_HEADER that precedes the "BLTE" signature
+#define CASC_VERIFY_EXHEADER    FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature)
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// One span in a data file
+struct CASC_VERIFY_ENTRY
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the span
+    DWORD ArchiveIndex;                             // Index of the data file ("data.###")
+    DWORD ArchiveOffs;                              // Offset of the span in the data file
+    DWORD FrameIndex;                               // The first bad frame (CASC_VERIFY_BAD_FRAME)
+    DWORD dwProblem;                                // CASC_VERIFY_XXX, zero if the span is fine
+    DWORD dwErrCode;                                // Error code for CASC_VERIFY_DECODE_FAILED
+};
+
+// One data file. All spans of the data file are verified by one thread
+struct CASC_VERIFY_SEGMENT
+{
+    ULONGLONG TotalSize;                            // Total encoded size of the spans
+    ULONGLONG BytesVerified;                        // Statistics of the data file
+    size_t SpansVerified;
+    size_t SpansCorrupt;
+    size_t SpansMissing;
+    size_t SpansNotDecoded;
+    size_t nFirstEntry;                             // The first span of the data file
+    size_t nEndEntry;                               // End of the spans of the data file
+    DWORD ArchiveIndex;                             // Index of the data file ("data.###")
+};
+
+struct CASC_VERIFY
+{
+    TCascStorage * hs;                              // The storage
+    PCASC_VERIFY_ARGS pArgs;                        // Arguments passed by the caller
+    CASC_VERIFY_ENTRY * pEntries;                   // All local spans, sorted by their position in the data files
+    CASC_VERIFY_SEGMENT * pSegments;                // Data files, the largest first
+    CASC_LOCK CallbackLock;                         // Only one thread calls the callback at a time
+    size_t nEntries;                                // Number of spans
+    DWORD dwSegments;                               // Number of data files
+    DWORD dwCancelled;                              // Nonzero if the caller cancelled the verification
+};
+
+// State of the thread that verifies one data file. Blocks of data (BLTE headers and frames)
+// are collected from the loaded window and their MD5 is verified by CascVerifyDataBlockHashes
+struct CASC_VERIFY_WORKER
+{
+    CASC_VERIFY * pVerify;                          // The verification this worker belongs to
+    CASC_VERIFY_SEGMENT * pSegment;                 // The data file being verified
+    TFileStream * pStream;                          // The data file
+    ULONGLONG FileSize;                             // Size of the data file
+    ULONGLONG WindowOffs;                           // Offset of the loaded part of the data file
+    size_t cbWindow;                                // Length of the loaded part of the data file
+    CASC_BLOB Window;                               // Buffer for the loaded part of the data file
+    CASC_BLOB Content;                              // Buffer for the decoded content (CASC_VERIFY_CONTENT)
+    size_t nFinalEntry;                             // The first span that has not been finished yet
+
+    const void * DataBlocks[CASC_HASH_BATCH_SIZE];  // Blocks waiting for verification
+    size_t BlockSizes[CASC_HASH_BATCH_SIZE];
+    LPBYTE ExpectedHashes[CASC_HASH_BATCH_SIZE];
+    size_t BlockEntries[CASC_HASH_BATCH_SIZE];      // Span of each block
+    DWORD BlockFrames[CASC_HASH_BATCH_SIZE];        // Frame of each block. CASC_INVALID_INDEX for BLTE header
+    size_t nBlocks;
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static int CompareVerifyEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    const CASC_VERIFY_ENTRY * pEntry1 = (const CASC_VERIFY_ENTRY *)pvEntry1;
+    const CASC_VERIFY_ENTRY * pEntry2 = (const CASC_VERIFY_ENTRY *)pvEntry2;
+
+    if(pEntry1->ArchiveIndex != pEntry2->ArchiveIndex)
+        return (pEntry1->ArchiveIndex < pEntry2->ArchiveIndex) ? -1 : 1;
+    if(pEntry1->ArchiveOffs != pEntry2->ArchiveOffs)
+        return (pEntry1->ArchiveOffs < pEntry2->ArchiveOffs) ? -1 : 1;
+    return 0;
+}
+
+// The largest data files go first, so that no thread gets a large file at the end
+static int CompareVerifySegments(const void * pvSegment1, const void * pvSegment2)
+{
+    const CASC_VERIFY_SEGMENT * pSegment1 = (const CASC_VERIFY_SEGMENT *)pvSegment1;
+    const CASC_VERIFY_SEGMENT * pSegment2 = (const CASC_VERIFY_SEGMENT *)pvSegment2;
+
+    if(pSegment1->TotalSize != pSegment2->TotalSize)
+        return (pSegment1->TotalSize > pSegment2->TotalSize) ? -1 : 1;
+    return (pSegment1->ArchiveIndex < pSegment2->ArchiveIndex) ? -1 : 1;
+}
+
+// Creates the array of all local spans, sorted by their position in the data files
+static DWORD CreateVerifyEntries(CASC_VERIFY * pVerify)
+{
+    TCascStorage * hs = pVerify->hs;
+    CASC_VERIFY_ENTRY * pEntry;
+    ULONGLONG FileOffsetMask = ((ULONGLONG)1 << hs->FileOffsetBits) - 1;
+    size_t nItemCount = hs->CKeyArray.ItemCount();
+
+    if((pVerify->pEntries = CASC_ALLOC<CASC_VERIFY_ENTRY>(CASCLIB_MAX(nItemCount, 1))) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pEntry = pVerify->pEntries;
+
+    for(size_t i = 0; i < nItemCount; i++)
+    {
+        PCASC_CKEY_ENTRY pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.ItemAt(i);
+
+        // Only the files that are present in the data files
+        if((pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL) == 0)
+            continue;
+        if(pCKeyEntry->StorageOffset == CASC_INVALID_OFFS64 || pCKeyEntry->EncodedSize == CASC_INVALID_SIZE)
+            continue;
+        if((pCKeyEntry->StorageOffset >> hs->FileOffsetBits) >= CASC_MAX_DATA_FILES)
+            continue;
+
+        pEntry->pCKeyEntry = pCKeyEntry;
+        pEntry->ArchiveIndex = (DWORD)(pCKeyEntry->StorageOffset >> hs->FileOffsetBits);
+        pEntry->ArchiveOffs = (DWORD)(pCKeyEntry->StorageOffset & FileOffsetMask);
+        pEntry->FrameIndex = CASC_INVALID_INDEX;
+        pEntry->dwProblem = 0;
+        pEntry->dwErrCode = ERROR_SUCCESS;
+        pEntry++;
+    }
+
+    pVerify->nEntries = (pEntry - pVerify->pEntries);
+    qsort(pVerify->pEntries, pVerify->nEntries, sizeof(CASC_VERIFY_ENTRY), CompareVerifyEntries);
+    return ERROR_SUCCESS;
+}
+
+// Creates one segment for each data file that contains at least one span
+static DWORD CreateVerifySegments(CASC_VERIFY * pVerify)
+{
+    CASC_VERIFY_ENTRY * pEntries = pVerify->pEntries;
+    CASC_VERIFY_SEGMENT * pSegment;
+    DWORD dwSegments = 0;
+
+    // Count the data files
+    for(size_t i = 0; i < pVerify->nEntries; i++)
+    {
+        if(i == 0 || pEntries[i].ArchiveIndex != pEntries[i - 1].ArchiveIndex)
+            dwSegments++;
+    }
+
+    // Allocate and fill the segments
+    if((pVerify->pSegments = CASC_ALLOC_ZERO<CASC_VERIFY_SEGMENT>(CASCLIB_MAX(dwSegments, 1))) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pSegment = pVerify->pSegments - 1;
+
+    for(size_t i = 0; i < pVerify->nEntries; i++)
+    {
+        if(i == 0 || pEntries[i].ArchiveIndex != pEntries[i - 1].ArchiveIndex)
+        {
+            pSegment++;
+            pSegment->ArchiveIndex = pEntries[i].ArchiveIndex;
+            pSegment->nFirstEntry = i;
+        }
+
+        pSegment->TotalSize += pEntries[i].pCKeyEntry->EncodedSize;
+        pSegment->nEndEntry = i + 1;
+    }
+
+    pVerify->dwSegments = dwSegments;
+    qsort(pVerify->pSegments, dwSegments, sizeof(CASC_VERIFY_SEGMENT), CompareVerifySegments);
+    return ERROR_SUCCESS;
+}
+
+static void SetSpanProblem(CASC_VERIFY_ENTRY & Entry, DWORD dwProblem, DWORD FrameIndex = CASC_INVALID_INDEX, DWORD dwErrCode = ERROR_FILE_CORRUPT)
+{
+    // Keep the first problem found
+    if(Entry.dwProblem == 0)
+    {
+        Entry.dwProblem = dwProblem;
+        Entry.FrameIndex = FrameIndex;
+        Entry.dwErrCode = dwErrCode;
+    }
+}
+
+static void ReportSpanProblem(CASC_VERIFY * pVerify, CASC_VERIFY_ENTRY & Entry)
+{
+    PCASC_VERIFY_ARGS pArgs = pVerify->pArgs;
+    PCASC_CKEY_ENTRY pCKeyEntry = Entry.pCKeyEntry;
+    CASC_VERIFY_SPAN Span;
+
+    if(pArgs->PfnCallback != NULL)
+    {
+        memset(&Span, 0, sizeof(CASC_VERIFY_SPAN));
+        if(pCKeyEntry->Flags & CASC_CE_HAS_CKEY)
+            memcpy(Span.CKey, pCKeyEntry->CKey, MD5_HASH_SIZE);
+        memcpy(Span.EKey, pCKeyEntry->EKey, MD5_HASH_SIZE);
+        Span.ArchiveIndex = Entry.ArchiveIndex;
+        Span.ArchiveOffs = Entry.ArchiveOffs;
+        Span.EncodedSize = pCKeyEntry->EncodedSize;
+        Span.FrameIndex = Entry.FrameIndex;
+        Span.dwProblem = Entry.dwProblem;
+        Span.dwErrCode = Entry.dwErrCode;
+
+        CascLock(pVerify->CallbackLock);
+        if(pVerify->dwCancelled == 0 && pArgs->PfnCallback(pArgs->PtrUserParam, &Span))
+            CascInterlockedIncrement(&pVerify->dwCancelled);
+        CascUnlock(pVerify->CallbackLock);
+    }
+}
+
+// Decodes the whole file by the normal read path and compares MD5 of the content with the CKey.
+// The span has just been read from the data file, so the data should still be in the system cache
+static void VerifySpanContent(CASC_VERIFY_WORKER & Worker, CASC_VERIFY_ENTRY & Entry)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry = Entry.pCKeyEntry;
+    ULONGLONG FileSize = 0;
+    ULONGLONG BytesRead = 0;
+    HANDLE hFile = NULL;
+    DWORD dwBytesToRead;
+    DWORD dwBytesRead;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    BYTE ContentHash[MD5_HASH_SIZE];
+
+    // We need the CKey. Files with more spans have the CKey of the entire content,
+    // the other spans may be in another data files
+    if((pCKeyEntry->Flags & CASC_CE_HAS_CKEY) == 0 || (pCKeyEntry->Flags & CASC_CE_FILE_SPAN) || pCKeyEntry->SpanCount != 1)
+    {
+        Worker.pSegment->SpansNotDecoded++;
+        return;
+    }
+
+    // Open the file and read its entire content
+    if(!OpenFileByCKeyEntry(Worker.pVerify->hs, pCKeyEntry, 0, &hFile))
+    {
+        SetSpanProblem(Entry, CASC_VERIFY_DECODE_FAILED, CASC_INVALID_INDEX, GetCascError());
+        return;
+    }
+    SetCacheStrategy(hFile, CascCacheNothing);
+
+    // Make sure that the buffer is large enough
+    if(!CascGetFileSize64(hFile, &FileSize))
+        dwErrCode = GetCascError();
+    if(dwErrCode == ERROR_SUCCESS && FileSize != (size_t)FileSize)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    if(dwErrCode == ERROR_SUCCESS && (FileSize > Worker.Content.cbData || Worker.Content.pbData == NULL))
+        dwErrCode = Worker.Content.SetSize((size_t)FileSize);
+
+    // Read the file. The number of bytes per call is limited to 0x80000000 (2 GB)
+    while(dwErrCode == ERROR_SUCCESS && BytesRead < FileSize)
+    {
+        dwBytesToRead = (DWORD)CASCLIB_MIN(FileSize - BytesRead, 0x80000000);
+        if(!CascReadFile(hFile, Worker.Content.pbData + (size_t)BytesRead, dwBytesToRead, &dwBytesRead))
+            dwErrCode = GetCascError();
+        else if(dwBytesRead != dwBytesToRead)
+            dwErrCode = ERROR_HANDLE_EOF;
+        BytesRead += dwBytesRead;
+    }
+    CascCloseFile(hFile);
+
+    // Files encrypted by an unknown key can't be checked. That is not a corruption
+    if(dwErrCode == ERROR_FILE_ENCRYPTED)
+    {
+        Worker.pSegment->SpansNotDecoded++;
+        return;
+    }
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        CascHash_MD5(Worker.Content.pbData, (size_t)FileSize, ContentHash);
+        if(memcmp(ContentHash, pCKeyEntry->CKey, MD5_HASH_SIZE))
+            SetSpanProblem(Entry, CASC_VERIFY_BAD_CKEY);
+    }
+    else
+    {
+        SetSpanProblem(Entry, CASC_VERIFY_DECODE_FAILED, CASC_INVALID_INDEX, dwErrCode);
+    }
+}
+
+// Finishes all spans before the given one. Their blocks must have been verified already
+static void FinishSpans(CASC_VERIFY_WORKER & Worker, size_t nEndEntry)
+{
+    CASC_VERIFY * pVerify = Worker.pVerify;
+    CASC_VERIFY_SEGMENT * pSegment = Worker.pSegment;
+
+    for(size_t i = Worker.nFinalEntry; i < nEndEntry; i++)
+    {
+        CASC_VERIFY_ENTRY & Entry = pVerify->pEntries[i];
+
+        // Decode the span and check its CKey
+        if(Entry.dwProblem == 0 && (pVerify->pArgs->dwFlags & CASC_VERIFY_CONTENT))
+            VerifySpanContent(Worker, Entry);
+
+        // Update the statistics
+        pSegment->BytesVerified += Entry.pCKeyEntry->EncodedSize;
+        pSegment->SpansVerified++;
+
+        // Report the problem to the caller
+        if(Entry.dwProblem != 0)
+        {
+            if(Entry.dwProblem == CASC_VERIFY_MISSING_SEGMENT || Entry.dwProblem == CASC_VERIFY_MISSING_SPAN)
+                pSegment->SpansMissing++;
+            else
+                pSegment->SpansCorrupt++;
+            ReportSpanProblem(pVerify, Entry);
+        }
+    }
+
+    Worker.nFinalEntry = nEndEntry;
+}
+
+// Verifies MD5 of all collected blocks and finishes the spans before the given one
+static void FlushBlocks(CASC_VERIFY_WORKER & Worker, size_t nEndEntry)
+{
+    size_t nFailed;
+    size_t nBlock = 0;
+
+    while(nBlock < Worker.nBlocks)
+    {
+        // Find the first block that doesn't match
+        nFailed = nBlock + CascVerifyDataBlockHashes(Worker.DataBlocks + nBlock,
+                                                     Worker.BlockSizes + nBlock,
+                                                     Worker.ExpectedHashes + nBlock,
+                                                     Worker.nBlocks - nBlock);
+        if(nFailed >= Worker.nBlocks)
+            break;
+
+        // Mark the span as corrupt and continue after the bad block
+        CASC_VERIFY_ENTRY & Entry = Worker.pVerify->pEntries[Worker.BlockEntries[nFailed]];
+        if(Worker.BlockFrames[nFailed] == CASC_INVALID_INDEX)
+            SetSpanProblem(Entry, CASC_VERIFY_BAD_EKEY);
+        else
+            SetSpanProblem(Entry, CASC_VERIFY_BAD_FRAME, Worker.BlockFrames[nFailed]);
+        nBlock = nFailed + 1;
+    }
+
+    Worker.nBlocks = 0;
+    FinishSpans(Worker, nEndEntry);
+}
+
+static void QueueBlock(CASC_VERIFY_WORKER & Worker, size_t nEntry, DWORD FrameIndex, LPBYTE pbBlock, size_t cbBlock, LPBYTE ExpectedHash)
+{
+    // If the batch is full, verify it first. The spans before this one can be finished
+    if(Worker.nBlocks >= CASC_HASH_BATCH_SIZE)
+        FlushBlocks(Worker, nEntry);
+
+    Worker.DataBlocks[Worker.nBlocks] = pbBlock;
+    Worker.BlockSizes[Worker.nBlocks] = cbBlock;
+    Worker.ExpectedHashes[Worker.nBlocks] = ExpectedHash;
+    Worker.BlockEntries[Worker.nBlocks] = nEntry;
+    Worker.BlockFrames[Worker.nBlocks] = FrameIndex;
+    Worker.nBlocks++;
+}
+
+// The EKey is MD5 of the BLTE header. If the header has no frame table,
+// the EKey is MD5 of the entire BLTE data
+static void QueueHeaderBlock(CASC_VERIFY_WORKER & Worker, size_t nEntry, LPBYTE pbBlock, size_t cbBlock)
+{
+    CASC_VERIFY_ENTRY & Entry = Worker.pVerify->pEntries[nEntry];
+    PCASC_CKEY_ENTRY pCKeyEntry = Entry.pCKeyEntry;
+    BYTE HeaderHash[MD5_HASH_SIZE];
+
+    // Entries that only come from the index files have partial EKey
+    if(pCKeyEntry->Flags & CASC_CE_HAS_EKEY_PARTIAL)
+    {
+        CascHash_MD5(pbBlock, cbBlock, HeaderHash);
+        if(memcmp(HeaderHash, pCKeyEntry->EKey, Worker.pVerify->hs->EKeyLength))
+            SetSpanProblem(Entry, CASC_VERIFY_BAD_EKEY);
+        return;
+    }
+
+    QueueBlock(Worker, nEntry, CASC_INVALID_INDEX, pbBlock, cbBlock, pCKeyEntry->EKey);
+}
+
+// Checks the BLTE header of the span and collects the header and all frames for verification
+static void QueueSpan(CASC_VERIFY_WORKER & Worker, size_t nEntry)
+{
+    CASC_VERIFY_ENTRY & Entry = Worker.pVerify->pEntries[nEntry];
+    PBLTE_FRAME pFrame;
+    LPBYTE pbSpan = Worker.Window.pbData + (size_t)(Entry.ArchiveOffs - Worker.WindowOffs);
+    LPBYTE pbBlte = pbSpan + CASC_VERIFY_EXHEADER;
+    LPBYTE pbFrameData;
+    LPBYTE pbSpanEnd = pbSpan + Entry.pCKeyEntry->EncodedSize;
+    DWORD HeaderSize;
+    DWORD FrameCount;
+    DWORD EncodedSize;
+
+    // There must be at least the encoded header and the BLTE signature with the header size
+    if((pbBlte + FIELD_OFFSET(BLTE_HEADER, MustBe0F)) > pbSpanEnd || ConvertBytesToInteger_4_LE(pbBlte) != BLTE_HEADER_SIGNATURE)
+    {
+        SetSpanProblem(Entry, CASC_VERIFY_BAD_HEADER);
+        return;
+    }
+
+    // Without the frame table, the entire BLTE data is one frame
+    HeaderSize = ConvertBytesToInteger_4(pbBlte + 4);
+    if(HeaderSize == 0)
+    {
+        QueueHeaderBlock(Worker, nEntry, pbBlte, (pbSpanEnd - pbBlte));
+        return;
+    }
+
+    // Verify the frame table
+    if((pbBlte + FIELD_OFFSET(BLTE_HEADER, MustBe0F) + sizeof(DWORD)) > pbSpanEnd || pbBlte[8] != 0x0F)
+    {
+        SetSpanProblem(Entry, CASC_VERIFY_BAD_HEADER);
+        return;
+    }
+    FrameCount = ConvertBytesToInteger_3(pbBlte + 9);
+    if(HeaderSize != (0x0C + FrameCount * sizeof(BLTE_FRAME)) || (pbBlte + HeaderSize) > pbSpanEnd)
+    {
+        SetSpanProblem(Entry, CASC_VERIFY_BAD_HEADER);
+        return;
+    }
+    QueueHeaderBlock(Worker, nEntry, pbBlte, HeaderSize);
+
+    // Queue all frames. Their sizes must exactly fill the span
+    pFrame = (PBLTE_FRAME)(pbBlte + 0x0C);
+    pbFrameData = pbBlte + HeaderSize;
+    for(DWORD i = 0; i < FrameCount; i++, pFrame++)
+    {
+        EncodedSize = ConvertBytesToInteger_4(pFrame->EncodedSize);
+        if(EncodedSize > (size_t)(pbSpanEnd - pbFrameData))
+        {
+            SetSpanProblem(Entry, CASC_VERIFY_BAD_HEADER);
+            return;
+        }
+
+        QueueBlock(Worker, nEntry, i, pbFrameData, EncodedSize, pFrame->FrameHash.Value);
+        pbFrameData += EncodedSize;
+    }
+
+    if(pbFrameData != pbSpanEnd)
+        SetSpanProblem(Entry, CASC_VERIFY_BAD_HEADER);
+}
+
+// Makes sure that the entire span is loaded. The data file is read sequentially
+// by large blocks, so most of the spans are already there
+static DWORD LoadSpan(CASC_VERIFY_WORKER & Worker, size_t nEntry)
+{
+    CASC_VERIFY_ENTRY & Entry = Worker.pVerify->pEntries[nEntry];
+    ULONGLONG SpanEnd = (ULONGLONG)Entry.ArchiveOffs + Entry.pCKeyEntry->EncodedSize;
+    ULONGLONG ByteOffset = Entry.ArchiveOffs;
+    size_t cbToRead;
+    DWORD dwErrCode;
+
+    // Is the span already loaded?
+    if(Entry.ArchiveOffs >= Worker.WindowOffs && SpanEnd <= (Worker.WindowOffs + Worker.cbWindow))
+        return ERROR_SUCCESS;
+
+    // Is the span in the data file at all?
+    if(SpanEnd > Worker.FileSize)
+        return ERROR_HANDLE_EOF;
+
+    // The blocks queued so far point to the window. Verify them before the window is reused
+    FlushBlocks(Worker, nEntry);
+    Worker.cbWindow = 0;
+
+    // Read the window, starting at the span
+    cbToRead = (size_t)CASCLIB_MIN(CASCLIB_MAX(CASC_VERIFY_WINDOW, Entry.pCKeyEntry->EncodedSize), Worker.FileSize - ByteOffset);
+    if(cbToRead > Worker.Window.cbData || Worker.Window.pbData == NULL)
+    {
+        if((dwErrCode = Worker.Window.SetSize(cbToRead)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+    if(!FileStream_Read(Worker.pStream, &ByteOffset, Worker.Window.pbData, (DWORD)cbToRead))
+        return GetCascError();
+
+    Worker.WindowOffs = Entry.ArchiveOffs;
+    Worker.cbWindow = cbToRead;
+    return ERROR_SUCCESS;
+}
+
+static DWORD VerifySegment(void * pvContext, DWORD dwItemIndex)
+{
+    CASC_VERIFY_WORKER Worker;
+    CASC_VERIFY * pVerify = (CASC_VERIFY *)pvContext;
+    CASC_VERIFY_SEGMENT * pSegment = pVerify->pSegments + dwItemIndex;
+    TCHAR szPlainName[0x80];
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Initialize the worker
+    Worker.pVerify = pVerify;
+    Worker.pSegment = pSegment;
+    Worker.FileSize = 0;
+    Worker.WindowOffs = 0;
+    Worker.cbWindow = 0;
+    Worker.nFinalEntry = pSegment->nFirstEntry;
+    Worker.nBlocks = 0;
+
+    // Open the data file. We don't want STREAM_FLAG_FILL_MISSING, because missing data is what we look for
+    CascStrPrintf(szPlainName, _countof(szPlainName), _T("data.%03u"), pSegment->ArchiveIndex);
+    CASC_PATH<TCHAR> DataFile(pVerify->hs->szIndexPath, szPlainName, NULL);
+    Worker.pStream = FileStream_OpenFile(DataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+    if(Worker.pStream != NULL)
+        FileStream_GetSize(Worker.pStream, &Worker.FileSize);
+
+    // Verify all spans in the order in which they are in the data file
+    for(size_t i = pSegment->nFirstEntry; i < pSegment->nEndEntry; i++)
+    {
+        CASC_VERIFY_ENTRY & Entry = pVerify->pEntries[i];
+
+        if(pVerify->dwCancelled)
+        {
+            dwErrCode = ERROR_CANCELLED;
+            break;
+        }
+
+        if(Worker.pStream == NULL)
+        {
+            SetSpanProblem(Entry, CASC_VERIFY_MISSING_SEGMENT, CASC_INVALID_INDEX, ERROR_FILE_NOT_FOUND);
+            continue;
+        }
+
+        if((dwErrCode = LoadSpan(Worker, i)) != ERROR_SUCCESS)
+        {
+            if(dwErrCode == ERROR_NOT_ENOUGH_MEMORY)
+                break;
+            SetSpanProblem(Entry, CASC_VERIFY_MISSING_SPAN, CASC_INVALID_INDEX, dwErrCode);
+            dwErrCode = ERROR_SUCCESS;
+            continue;
+        }
+
+        QueueSpan(Worker, i);
+    }
+
+    // Verify the rest of the blocks and finish all spans
+    if(dwErrCode == ERROR_SUCCESS)
+        FlushBlocks(Worker, pSegment->nEndEntry);
+    FileStream_Close(Worker.pStream);
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+bool WINAPI CascVerifyStorage(HANDLE hStorage, PCASC_VERIFY_ARGS pArgs, PCASC_VERIFY_REPORT pReport)
+{
+    CASC_VERIFY Verify;
+    ULONGLONG StartTime = CascGetTickCount();
+    DWORD dwThreadCount = 0;
+    DWORD dwErrCode;
+
+    // Validate the storage handle and the parameters
+    if((Verify.hs = TCascStorage::IsValid(hStorage)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+    if(pArgs == NULL || pArgs->Size < sizeof(CASC_VERIFY_ARGS))
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Only local storages have data files
+    if(Verify.hs->dwFeatures & CASC_FEATURE_ONLINE)
+    {
+        SetCascError(ERROR_NOT_SUPPORTED);
+        return false;
+    }
+
+    // Initialize the verification
+    Verify.pArgs = pArgs;
+    Verify.pEntries = NULL;
+    Verify.pSegments = NULL;
+    Verify.nEntries = 0;
+    Verify.dwSegments = 0;
+    Verify.dwCancelled = 0;
+    CascInitLock(Verify.CallbackLock);
+
+    // Collect the spans and split them to data files
+    dwErrCode = CreateVerifyEntries(&Verify);
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = CreateVerifySegments(&Verify);
+
+    // Each data file is verified by one thread
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        dwThreadCount = (pArgs->dwThreadCount != 0) ? pArgs->dwThreadCount : CascGetProcessorCount();
+        dwThreadCount = CASCLIB_MIN(dwThreadCount, CASCLIB_MAX(Verify.dwSegments, 1));
+        dwErrCode = CascRunParallel(VerifySegment, &Verify, Verify.dwSegments, dwThreadCount);
+    }
+    if(dwErrCode == ERROR_SUCCESS && Verify.dwCancelled)
+        dwErrCode = ERROR_CANCELLED;
+
+    // Give the report to the caller
+    if(pReport != NULL)
+    {
+        memset(pReport, 0, sizeof(CASC_VERIFY_REPORT));
+        for(DWORD i = 0; i < Verify.dwSegments; i++)
+        {
+            pReport->BytesVerified += Verify.pSegments[i].BytesVerified;
+            pReport->SpansVerified += Verify.pSegments[i].SpansVerified;
+            pReport->SpansCorrupt += Verify.pSegments[i].SpansCorrupt;
+            pReport->SpansMissing += Verify.pSegments[i].SpansMissing;
+            pReport->SpansNotDecoded += Verify.pSegments[i].SpansNotDecoded;
+        }
+        pReport->ElapsedMs = CascGetTickCount() - StartTime;
+        pReport->BytesPerSecond = (pReport->BytesVerified * 1000) / CASCLIB_MAX(pReport->ElapsedMs, 1);
+        pReport->dwSegmentCount = Verify.dwSegments;
+        pReport->dwThreadCount = dwThreadCount;
+    }
+
+    // Free all buffers
+    CascFreeLock(Verify.CallbackLock);
+    CASC_FREE(Verify.pSegments);
+    CASC_FREE(Verify.pEntries);
+
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
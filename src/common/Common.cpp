@@ -12,6 +12,16 @@
 #include "../CascLib.h"
 #include "../CascCommon.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// File names are normalized 16 characters at once if the compiler targets SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CASC_NORMALIZE_SSE2
+#endif
+
 //-----------------------------------------------------------------------------
 // Conversion to uppercase/lowercase
 
@@ -77,7 +87,12 @@ unsigned char IntToHexChar[] = "0123456789abcdef";
 //-----------------------------------------------------------------------------
 // GetCascError/SetCascError support for non-Windows platform
 
-static DWORD dwLastError = ERROR_SUCCESS;
+// The last error is per-thread, like GetLastError() on Windows
+#if defined(_MSC_VER)
+static __declspec(thread) DWORD dwLastError = ERROR_SUCCESS;
+#else
+static __thread DWORD dwLastError = ERROR_SUCCESS;
+#endif
 
 DWORD GetCascError()
 {
@@ -426,14 +441,70 @@ size_t NormalizeFileName(const unsigned char * NormTable, char * szNormName, con
     return i;
 }
 
+#ifdef CASC_NORMALIZE_SSE2
+// Same as NormalizeFileName, but flips the case of letters from chLetterA to chLetterA+25
+// and converts chSlashFrom to chSlashTo 16 characters at once. The rest goes through the table
+static size_t NormalizeFileName_SSE2(const unsigned char * NormTable, char * szNormName, const char * szFileName, size_t cchMaxChars, char chLetterA, char chSlashFrom, char chSlashTo)
+{
+    __m128i LetterMin = _mm_set1_epi8((char)(chLetterA - 1));
+    __m128i LetterMax = _mm_set1_epi8((char)(chLetterA + 26));
+    __m128i SlashFrom = _mm_set1_epi8(chSlashFrom);
+    __m128i SlashBits = _mm_set1_epi8((char)(chSlashFrom ^ chSlashTo));
+    __m128i CaseBit = _mm_set1_epi8(0x20);
+    size_t nLength = strlen(szFileName);
+    size_t i = 0;
+
+    // Cut the name the same way like NormalizeFileName does
+    nLength = CASCLIB_MIN(nLength, cchMaxChars);
+
+    // The comparisons are signed, so characters above 0x7F are never letters.
+    // The last chunk overlaps the previous one, if the length is not a multiple of 16
+    if(nLength >= 16)
+    {
+        for(;;)
+        {
+            __m128i Chars = _mm_loadu_si128((const __m128i *)(szFileName + i));
+            __m128i Letters = _mm_and_si128(_mm_cmpgt_epi8(Chars, LetterMin), _mm_cmplt_epi8(Chars, LetterMax));
+            __m128i Slashes = _mm_cmpeq_epi8(Chars, SlashFrom);
+
+            Chars = _mm_xor_si128(Chars, _mm_and_si128(Letters, CaseBit));
+            Chars = _mm_xor_si128(Chars, _mm_and_si128(Slashes, SlashBits));
+            _mm_storeu_si128((__m128i *)(szNormName + i), Chars);
+
+            if((i + 16) >= nLength)
+                break;
+            i = CASCLIB_MIN(i + 16, nLength - 16);
+        }
+    }
+    else
+    {
+        // Short names are normalized by the table
+        for(; i < nLength; i++)
+            szNormName[i] = NormTable[(BYTE)szFileName[i]];
+    }
+
+    // Terminate the string
+    szNormName[nLength] = 0;
+    return nLength;
+}
+#endif
+
 size_t NormalizeFileName_UpperBkSlash(char * szNormName, const char * szFileName, size_t cchMaxChars)
 {
+#ifdef CASC_NORMALIZE_SSE2
+    return NormalizeFileName_SSE2(AsciiToUpperTable_BkSlash, szNormName, szFileName, cchMaxChars, 'a', '/', '\\');
+#else
     return NormalizeFileName(AsciiToUpperTable_BkSlash, szNormName, szFileName, cchMaxChars);
+#endif
 }
 
 size_t NormalizeFileName_LowerSlash(char * szNormName, const char * szFileName, size_t cchMaxChars)
 {
+#ifdef CASC_NORMALIZE_SSE2
+    return NormalizeFileName_SSE2(AsciiToLowerTable_Slash, szNormName, szFileName, cchMaxChars, 'A', '\\', '/');
+#else
     return NormalizeFileName(AsciiToLowerTable_Slash, szNormName, szFileName, cchMaxChars);
+#endif
 }
 
 ULONGLONG CalcNormNameHash(const char * szNormName, size_t nLength)
@@ -458,6 +529,27 @@ ULONGLONG CalcFileNameHash(const char * szFileName)
     return CalcNormNameHash(szNormName, nLength);
 }
 
+void CalcFileNameHashes(const char ** FileNames, ULONGLONG * NameHashes, size_t nNameCount)
+{
+    char NormNames[CASC_NAME_BATCH_SIZE][MAX_PATH+1];
+    const char * NormNamePtrs[CASC_NAME_BATCH_SIZE];
+    size_t NameLengths[CASC_NAME_BATCH_SIZE];
+
+    // Normalize a batch of names and hash them all at once
+    for(size_t nStart = 0; nStart < nNameCount; nStart += CASC_NAME_BATCH_SIZE)
+    {
+        size_t nCount = CASCLIB_MIN(nNameCount - nStart, CASC_NAME_BATCH_SIZE);
+
+        for(size_t i = 0; i < nCount; i++)
+        {
+            NameLengths[i] = NormalizeFileName_UpperBkSlash(NormNames[i], FileNames[nStart + i], MAX_PATH);
+            NormNamePtrs[i] = NormNames[i];
+        }
+
+        CalcNormNameHashes(NormNamePtrs, NameLengths, NameHashes + nStart, nCount);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // File name utilities
 
@@ -601,6 +693,42 @@ bool CascVerifyDataBlockHash(void * pvDataBlock, size_t cbDataBlock, LPBYTE expe
     return (memcmp(md5_digest, expected_md5, MD5_HASH_SIZE) == 0);
 }
 
+// Verifies the MD5 of multiple data blocks. Returns the index of the first block
+// whose MD5 doesn't match, or nBlockCount if all blocks are OK
+size_t CascVerifyDataBlockHashes(const void ** DataBlocks, const size_t * BlockSizes, LPBYTE * ExpectedHashes, size_t nBlockCount)
+{
+    const void * BatchBlocks[CASC_HASH_BATCH_SIZE];
+    size_t BatchSizes[CASC_HASH_BATCH_SIZE];
+    size_t BatchIndexes[CASC_HASH_BATCH_SIZE];
+    BYTE md5_hashes[CASC_HASH_BATCH_SIZE * MD5_HASH_SIZE];
+    size_t nBatchCount;
+    size_t nIndex = 0;
+
+    while(nIndex < nBlockCount)
+    {
+        // Blocks without valid MD5 are not verified
+        for(nBatchCount = 0; nIndex < nBlockCount && nBatchCount < CASC_HASH_BATCH_SIZE; nIndex++)
+        {
+            if(CascIsValidMD5(ExpectedHashes[nIndex]))
+            {
+                BatchBlocks[nBatchCount] = DataBlocks[nIndex];
+                BatchSizes[nBatchCount] = BlockSizes[nIndex];
+                BatchIndexes[nBatchCount++] = nIndex;
+            }
+        }
+
+        // Hash all blocks at once and compare the hashes
+        CascHash_MD5_Multi(BatchBlocks, BatchSizes, md5_hashes, nBatchCount);
+        for(size_t i = 0; i < nBatchCount; i++)
+        {
+            if(memcmp(md5_hashes + i * MD5_HASH_SIZE, ExpectedHashes[BatchIndexes[i]], MD5_HASH_SIZE))
+                return BatchIndexes[i];
+        }
+    }
+
+    return nBlockCount;
+}
+
 void CascHash_MD5(const void * pvDataBlock, size_t cbDataBlock, LPBYTE md5_hash)
 {
     MD5_CTX md5_ctx;
@@ -618,3 +746,384 @@ void CascHash_SHA1(const void * pvDataBlock, size_t cbDataBlock, LPBYTE sha1_has
     SHA1_Update(&sha1_ctx, pvDataBlock, (u32)(cbDataBlock));
     SHA1_Final(&sha1_ctx, sha1_hash);
 }
+
+//-----------------------------------------------------------------------------
+// Worker threads
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+static DWORD WINAPI CascThreadEntry(LPVOID pvParam)
+{
+    CASC_THREAD * pThread = (CASC_THREAD *)pvParam;
+
+    pThread->PfnThread(pThread->pvParam);
+    return 0;
+}
+#else
+static void * CascThreadEntry(void * pvParam)
+{
+    CASC_THREAD * pThread = (CASC_THREAD *)pvParam;
+
+    pThread->PfnThread(pThread->pvParam);
+    return NULL;
+}
+#endif
+
+bool CascCreateThread(CASC_THREAD & Thread, PFNCASCTHREAD PfnThread, void * pvParam)
+{
+    // Fill the thread structure. It must stay valid until the thread is joined
+    Thread.PfnThread = PfnThread;
+    Thread.pvParam = pvParam;
+    Thread.bRunning = false;
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    Thread.hThread = CreateThread(NULL, 0, CascThreadEntry, &Thread, 0, NULL);
+    Thread.bRunning = (Thread.hThread != NULL);
+#else
+    Thread.bRunning = (pthread_create(&Thread.hThread, NULL, CascThreadEntry, &Thread) == 0);
+#endif
+
+    return Thread.bRunning;
+}
+
+void CascWaitForThread(CASC_THREAD & Thread)
+{
+    if(Thread.bRunning)
+    {
+#ifdef CASCLIB_PLATFORM_WINDOWS
+        WaitForSingleObject(Thread.hThread, INFINITE);
+        CloseHandle(Thread.hThread);
+        Thread.hThread = NULL;
+#else
+        pthread_join(Thread.hThread, NULL);
+#endif
+        Thread.bRunning = false;
+    }
+}
+
+// Shared state of all threads running in CascRunParallel
+struct CASC_PARALLEL_RUN
+{
+    PFNCASCWORKITEM PfnWorkItem;
+    void * pvContext;
+    CASC_LOCK Lock;
+    DWORD dwItemCount;
+    DWORD dwNextItem;
+    DWORD dwErrCode;
+};
+
+static void CascParallelWorker(void * pvParam)
+{
+    CASC_PARALLEL_RUN * pRun = (CASC_PARALLEL_RUN *)pvParam;
+    DWORD dwItemIndex;
+    DWORD dwErrCode;
+
+    for(;;)
+    {
+        // Claim the next work item. Stop if all items are done or if someone failed
+        CascLock(pRun->Lock);
+        dwItemIndex = pRun->dwNextItem;
+        if(dwItemIndex >= pRun->dwItemCount || pRun->dwErrCode != ERROR_SUCCESS)
+        {
+            CascUnlock(pRun->Lock);
+            break;
+        }
+        pRun->dwNextItem++;
+        CascUnlock(pRun->Lock);
+
+        // Process the work item
+        if((dwErrCode = pRun->PfnWorkItem(pRun->pvContext, dwItemIndex)) != ERROR_SUCCESS)
+        {
+            CascLock(pRun->Lock);
+            if(pRun->dwErrCode == ERROR_SUCCESS)
+                pRun->dwErrCode = dwErrCode;
+            CascUnlock(pRun->Lock);
+            break;
+        }
+    }
+}
+
+DWORD CascRunParallel(PFNCASCWORKITEM PfnWorkItem, void * pvContext, DWORD dwItemCount, DWORD dwThreadCount)
+{
+    CASC_PARALLEL_RUN Run;
+    CASC_THREAD * pThreads = NULL;
+    DWORD dwThreadsCreated = 0;
+
+    // Fill the shared state
+    Run.PfnWorkItem = PfnWorkItem;
+    Run.pvContext = pvContext;
+    Run.dwItemCount = dwItemCount;
+    Run.dwNextItem = 0;
+    Run.dwErrCode = ERROR_SUCCESS;
+    CascInitLock(Run.Lock);
+
+    // Don't create more threads than there are work items.
+    // The calling thread works too, so we need one thread less.
+    dwThreadCount = CASCLIB_MIN(dwThreadCount, dwItemCount);
+    if(dwThreadCount > 1 && (pThreads = CASC_ALLOC<CASC_THREAD>(dwThreadCount - 1)) != NULL)
+    {
+        // If creating a thread fails, we simply go on with fewer threads
+        for(DWORD i = 0; i < dwThreadCount - 1; i++)
+        {
+            if(!CascCreateThread(pThreads[dwThreadsCreated], CascParallelWorker, &Run))
+                break;
+            dwThreadsCreated++;
+        }
+    }
+
+    // Work on the calling thread as well
+    CascParallelWorker(&Run);
+
+    // Wait for all threads to finish
+    for(DWORD i = 0; i < dwThreadsCreated; i++)
+        CascWaitForThread(pThreads[i]);
+    CASC_FREE(pThreads);
+
+    CascFreeLock(Run.Lock);
+    return Run.dwErrCode;
+}
+
+DWORD CascGetProcessorCount()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    SYSTEM_INFO si = {0};
+
+    GetSystemInfo(&si);
+    return CASCLIB_MAX(si.dwNumberOfProcessors, 1);
+#else
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (nProcessors > 0) ? (DWORD)nProcessors : 1;
+#endif
+}
+
+ULONGLONG CascGetTickCount()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return GetTickCount64();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((ULONGLONG)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+DWORD CascGetCpuFeatures()
+{
+    static DWORD dwCpuFeatures = CASC_INVALID_ID;
+
+    // Benign race: all threads detect the same value
+    if(dwCpuFeatures == CASC_INVALID_ID)
+    {
+        DWORD dwFeatures = 0;
+
+#if defined(_MSC_VER) && defined(CASC_CAN_USE_AVX2)
+        int CpuInfo[4];
+
+        // Check whether the OS saves the YMM (and ZMM) registers
+        __cpuid(CpuInfo, 0);
+        if(CpuInfo[0] >= 7)
+        {
+            __cpuid(CpuInfo, 1);
+            if((CpuInfo[2] & (1 << 27)) && (CpuInfo[2] & (1 << 28)))
+            {
+                ULONGLONG Xcr0 = _xgetbv(0);
+
+                __cpuidex(CpuInfo, 7, 0);
+                if((Xcr0 & 0x06) == 0x06 && (CpuInfo[1] & (1 << 5)))
+                    dwFeatures |= CASC_CPU_AVX2;
+                if((Xcr0 & 0xE6) == 0xE6 && (CpuInfo[1] & (1 << 16)))
+                    dwFeatures |= CASC_CPU_AVX512;
+            }
+        }
+#elif defined(CASC_CAN_USE_AVX2)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            dwFeatures |= CASC_CPU_AVX2;
+#ifdef CASC_CAN_USE_AVX512
+        if(__builtin_cpu_supports("avx512f"))
+            dwFeatures |= CASC_CPU_AVX512;
+#endif
+#endif
+        dwCpuFeatures = dwFeatures;
+    }
+    return dwCpuFeatures;
+}
+
+//-----------------------------------------------------------------------------
+// Work queue
+
+struct CASC_WORK_ITEM
+{
+    CASC_WORK_ITEM * pNext;
+    PFNCASCWORK PfnWork;
+    void * pvParam;
+};
+
+struct CASC_WORK_QUEUE
+{
+    CASC_LOCK Lock;                                 // Protects the item list and the shutdown flag
+    CASC_COND Cond;                                 // Signalled when an item is posted or on shutdown
+    CASC_WORK_ITEM * pFirst;                        // First item to be processed
+    CASC_WORK_ITEM * pLast;                         // Last posted item
+    CASC_THREAD * pThreads;                         // Array of worker threads
+    DWORD dwThreadCount;                            // Number of running worker threads
+    DWORD dwRefs;                                   // The owner plus one reference per running worker
+    bool bShutdown;                                 // If true, workers exit once the queue is empty
+};
+
+static bool IsCurrentThread(CASC_THREAD & Thread)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return (Thread.bRunning && GetThreadId(Thread.hThread) == GetCurrentThreadId());
+#else
+    return (Thread.bRunning && pthread_equal(Thread.hThread, pthread_self()));
+#endif
+}
+
+static void DetachThread(CASC_THREAD & Thread)
+{
+    if(Thread.bRunning)
+    {
+#ifdef CASCLIB_PLATFORM_WINDOWS
+        CloseHandle(Thread.hThread);
+        Thread.hThread = NULL;
+#else
+        pthread_detach(Thread.hThread);
+#endif
+        Thread.bRunning = false;
+    }
+}
+
+static void ReleaseWorkQueue(CASC_WORK_QUEUE * pQueue)
+{
+    if(CascInterlockedDecrement(&pQueue->dwRefs) == 0)
+    {
+        assert(pQueue->pFirst == NULL);
+        CascFreeCond(pQueue->Cond);
+        CascFreeLock(pQueue->Lock);
+        CASC_FREE(pQueue->pThreads);
+        CASC_FREE(pQueue);
+    }
+}
+
+static void CascWorkQueueWorker(void * pvParam)
+{
+    CASC_WORK_QUEUE * pQueue = (CASC_WORK_QUEUE *)pvParam;
+    CASC_WORK_ITEM * pItem;
+
+    CascLock(pQueue->Lock);
+    for(;;)
+    {
+        // Wait for an item. On shutdown, the queue is drained before the worker exits
+        while(pQueue->pFirst == NULL && pQueue->bShutdown == false)
+            CascWaitCond(pQueue->Cond, pQueue->Lock);
+        if((pItem = pQueue->pFirst) == NULL)
+            break;
+
+        // Unlink the item from the queue
+        if((pQueue->pFirst = pItem->pNext) == NULL)
+            pQueue->pLast = NULL;
+        CascUnlock(pQueue->Lock);
+
+        // Process the item without holding the lock
+        pItem->PfnWork(pItem->pvParam);
+        CASC_FREE(pItem);
+
+        CascLock(pQueue->Lock);
+    }
+    CascUnlock(pQueue->Lock);
+
+    // The queue may have been freed by its owner in the meantime
+    ReleaseWorkQueue(pQueue);
+}
+
+CASC_WORK_QUEUE * CascCreateWorkQueue(DWORD dwThreadCount)
+{
+    CASC_WORK_QUEUE * pQueue;
+
+    // Allocate and initialize the queue
+    if((pQueue = CASC_ALLOC<CASC_WORK_QUEUE>(1)) != NULL)
+    {
+        memset(pQueue, 0, sizeof(CASC_WORK_QUEUE));
+        CascInitLock(pQueue->Lock);
+        CascInitCond(pQueue->Cond);
+        pQueue->dwRefs = 1;
+
+        // Start the worker threads. If creating a thread fails, we go on with fewer threads
+        if((pQueue->pThreads = CASC_ALLOC<CASC_THREAD>(dwThreadCount)) != NULL)
+        {
+            for(DWORD i = 0; i < dwThreadCount; i++)
+            {
+                CascInterlockedIncrement(&pQueue->dwRefs);
+                if(!CascCreateThread(pQueue->pThreads[i], CascWorkQueueWorker, pQueue))
+                {
+                    CascInterlockedDecrement(&pQueue->dwRefs);
+                    break;
+                }
+                pQueue->dwThreadCount++;
+            }
+        }
+
+        // A queue without workers would never process anything
+        if(pQueue->dwThreadCount == 0)
+        {
+            ReleaseWorkQueue(pQueue);
+            pQueue = NULL;
+        }
+    }
+
+    return pQueue;
+}
+
+bool CascPostWork(CASC_WORK_QUEUE * pQueue, PFNCASCWORK PfnWork, void * pvParam)
+{
+    CASC_WORK_ITEM * pItem;
+
+    // Allocate the work item
+    if((pItem = CASC_ALLOC<CASC_WORK_ITEM>(1)) == NULL)
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+
+    // Fill the work item
+    pItem->pNext = NULL;
+    pItem->PfnWork = PfnWork;
+    pItem->pvParam = pvParam;
+
+    // Append it to the end of the queue and wake up one worker
+    CascLock(pQueue->Lock);
+    if(pQueue->pLast != NULL)
+        pQueue->pLast->pNext = pItem;
+    else
+        pQueue->pFirst = pItem;
+    pQueue->pLast = pItem;
+    CascSignalCond(pQueue->Cond);
+    CascUnlock(pQueue->Lock);
+    return true;
+}
+
+void CascFreeWorkQueue(CASC_WORK_QUEUE * pQueue)
+{
+    if(pQueue != NULL)
+    {
+        // Tell the workers to exit once all items are done
+        CascLock(pQueue->Lock);
+        pQueue->bShutdown = true;
+        CascBroadcastCond(pQueue->Cond);
+        CascUnlock(pQueue->Lock);
+
+        // Wait for the workers. If we are called from a work item,
+        // we cannot wait for ourselves; the current worker exits after the item returns.
+        for(DWORD i = 0; i < pQueue->dwThreadCount; i++)
+        {
+            if(IsCurrentThread(pQueue->pThreads[i]))
+                DetachThread(pQueue->pThreads[i]);
+            else
+                CascWaitForThread(pQueue->pThreads[i]);
+        }
+
+        ReleaseWorkQueue(pQueue);
+    }
+}
@@ -377,6 +377,12 @@ size_t NormalizeFileName_LowerSlash(char * szNormName, const char * szFileName,
 ULONGLONG CalcNormNameHash(const char * szNormName, size_t nLength);
 ULONGLONG CalcFileNameHash(const char * szFileName);
 
+// Batched name hashing (jenkins/lookup3_mb.cpp). Gives the same hashes as CalcNormNameHash and CalcFileNameHash
+#define CASC_NAME_BATCH_SIZE    64              // Number of names normalized and hashed at once by CalcFileNameHashes
+
+void CalcNormNameHashes(const char ** NormNames, const size_t * NameLengths, ULONGLONG * NameHashes, size_t nNameCount);
+void CalcFileNameHashes(const char ** FileNames, ULONGLONG * NameHashes, size_t nNameCount);
+
 //-----------------------------------------------------------------------------
 // String conversion functions
 
@@ -607,6 +613,83 @@ void CascHash_MD5(const void * pvDataBlock, size_t cbDataBlock, LPBYTE md5_hash)
 void CascHash_SHA1(const void * pvDataBlock, size_t cbDataBlock, LPBYTE sha1_hash);
 bool CascVerifyDataBlockHash(void * pvDataBlock, size_t cbDataBlock, LPBYTE expected_md5);
 
+// Multi-buffer MD5 (hashes/md5_mb.cpp). Hashes multiple independent data blocks at once
+#define CASC_HASH_BATCH_SIZE    64              // Number of blocks verified at once by CascVerifyDataBlockHashes
+
+void CascHash_MD5_Multi(const void ** DataBlocks, const size_t * BlockSizes, LPBYTE md5_hashes, size_t nBlockCount);
+size_t CascVerifyDataBlockHashes(const void ** DataBlocks, const size_t * BlockSizes, LPBYTE * ExpectedHashes, size_t nBlockCount);
+
+//-----------------------------------------------------------------------------
+// Worker threads
+
+typedef void (*PFNCASCTHREAD)(void * pvParam);
+
+// Worker function for CascRunParallel. Called once for each work item
+typedef DWORD (*PFNCASCWORKITEM)(void * pvContext, DWORD dwItemIndex);
+
+struct CASC_THREAD
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    HANDLE hThread;                                 // Handle of the running thread
+#else
+    pthread_t hThread;                              // ID of the running thread
+#endif
+    PFNCASCTHREAD PfnThread;                        // Thread function
+    void * pvParam;                                 // Parameter for the thread function
+    bool bRunning;                                  // If true, the thread has been started and not joined yet
+};
+
+bool CascCreateThread(CASC_THREAD & Thread, PFNCASCTHREAD PfnThread, void * pvParam);
+void CascWaitForThread(CASC_THREAD & Thread);
+
+// Calls PfnWorkItem for all items from 0 to (dwItemCount-1), using up to dwThreadCount threads
+// (the calling thread included). Returns the first error reported by a work item.
+DWORD CascRunParallel(PFNCASCWORKITEM PfnWorkItem, void * pvContext, DWORD dwItemCount, DWORD dwThreadCount);
+
+// Returns the number of logical processors in the system
+DWORD CascGetProcessorCount();
+
+// Returns a millisecond timer for measuring time intervals
+ULONGLONG CascGetTickCount();
+
+//-----------------------------------------------------------------------------
+// CPU features
+
+// Instruction sets that are compiled in and selected at runtime. Functions using them
+// must be marked by CASC_TARGET_AVX2 or CASC_TARGET_AVX512
+#if (defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))) || (defined(_M_X64) && defined(_MSC_VER) && (_MSC_VER >= 1700))
+#define CASC_CAN_USE_AVX2
+#endif
+
+#if (defined(__x86_64__) && ((defined(__GNUC__) && (__GNUC__ >= 5)) || defined(__clang__))) || (defined(_M_X64) && defined(_MSC_VER) && (_MSC_VER >= 1910))
+#define CASC_CAN_USE_AVX512
+#endif
+
+#ifdef _MSC_VER
+#define CASC_TARGET_AVX2
+#define CASC_TARGET_AVX512
+#else
+#define CASC_TARGET_AVX2    __attribute__((target("avx2")))
+#define CASC_TARGET_AVX512  __attribute__((target("avx512f")))
+#endif
+
+#define CASC_CPU_AVX2       0x00000001          // AVX2 is supported by the CPU and the OS
+#define CASC_CPU_AVX512     0x00000002          // AVX-512F is supported by the CPU and the OS
+
+// Returns CASC_CPU_XXX flags of the instruction sets that can be used
+DWORD CascGetCpuFeatures();
+
+// Work function for a work queue. Called on one of the worker threads
+typedef void (*PFNCASCWORK)(void * pvParam);
+
+// Queue of work items that are processed in FIFO order by a fixed set of worker threads.
+// The queue may be freed by one of its own work items; that worker is then detached.
+struct CASC_WORK_QUEUE;
+
+CASC_WORK_QUEUE * CascCreateWorkQueue(DWORD dwThreadCount);
+bool CascPostWork(CASC_WORK_QUEUE * pQueue, PFNCASCWORK PfnWork, void * pvParam);
+void CascFreeWorkQueue(CASC_WORK_QUEUE * pQueue);                 // Finishes all posted work items
+
 //-----------------------------------------------------------------------------
 // Argument structure versioning
 // Safely retrieves field value from a structure
@@ -23,9 +23,8 @@ static const CASC_CSV_LINE NullLine;
 
 static char * NextLine_Default(void * /* pvUserData */, char * szLine)
 {
-    // Find the end of the line
-    while(szLine[0] != 0 && szLine[0] != 0x0A && szLine[0] != 0x0D)
-        szLine++;
+    // Find the end of the line. The C runtime scans by words or vectors
+    szLine += strcspn(szLine, "\r\n");
 
     // Terminate the line
     while(szLine[0] == 0x0A || szLine[0] == 0x0D)
@@ -38,11 +37,10 @@ static char * NextLine_Default(void * /* pvUserData */, char * szLine)
 static char * NextColumn_Default(void * /* pvUserData */, char * szColumn)
 {
     // Find the end of the column
-    while(szColumn[0] != 0 && szColumn[0] != '|')
-        szColumn++;
+    szColumn = strchr(szColumn, '|');
 
     // Terminate the column
-    if(szColumn[0] == '|')
+    if(szColumn != NULL)
     {
         *szColumn++ = 0;
         return szColumn;
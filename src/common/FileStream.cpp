@@ -21,6 +21,16 @@
 #pragma warning(disable: 4800)                  // 'BOOL' : forcing value to bool 'true' or 'false' (performance warning)
 #endif
 
+// io_uring is used through raw system calls, so we don't depend on liburing
+#if defined(CASC_USE_IO_URING) && defined(CASCLIB_PLATFORM_LINUX)
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define CASC_HAVE_IO_URING
+#endif
+#endif
+
 //-----------------------------------------------------------------------------
 // Local functions - platform-specific functions
 
@@ -158,83 +168,99 @@ static bool BaseFile_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStr
     return true;
 }
 
-static bool BaseFile_Read(
-    TFileStream * pStream,                  // Pointer to an open stream
-    ULONGLONG * pByteOffset,                // Pointer to file byte offset. If NULL, it reads from the current position
-    void * pvBuffer,                        // Pointer to data to be read
-    DWORD dwBytesToRead)                    // Number of bytes to read from the file
+// Performs a positional read from the file. Does not use nor change the file position
+// kept by the operating system, so multiple threads may call this on the same handle
+// without any synchronization.
+static bool BaseFile_ReadAt(TFileStream * pStream, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PDWORD PtrBytesRead)
 {
-    DWORD dwBytesRead = 0;                  // Must be set by platform-specific code
-
-    // Synchronize the access to the TFileStream structure
-    CascLock(pStream->Lock);
-    {
-        ULONGLONG ByteOffset = GetByteOffset(pByteOffset, pStream->Base.File.FilePos);
+    DWORD dwBytesRead = 0;
 
 #ifdef CASCLIB_PLATFORM_WINDOWS
+    {
+        // Note: We no longer support Windows 9x.
+        // Thus, we can use the OVERLAPPED structure to specify
+        // file offset to read from file. This allows us to skip
+        // one system call to SetFilePointer
+        if(dwBytesToRead != 0)
         {
-            // Note: We no longer support Windows 9x.
-            // Thus, we can use the OVERLAPPED structure to specify
-            // file offset to read from file. This allows us to skip
-            // one system call to SetFilePointer
-
-            // Update the byte offset
-            pStream->Base.File.FilePos = ByteOffset;
+            OVERLAPPED Overlapped = {0};
 
-            // Read the data
-            if(dwBytesToRead != 0)
+            Overlapped.OffsetHigh = (DWORD)(ByteOffset >> 32);
+            Overlapped.Offset = (DWORD)ByteOffset;
+            if(!ReadFile(pStream->Base.File.hFile, pvBuffer, dwBytesToRead, &dwBytesRead, &Overlapped))
             {
-                OVERLAPPED Overlapped;
-
-                Overlapped.OffsetHigh = (DWORD)(ByteOffset >> 32);
-                Overlapped.Offset = (DWORD)ByteOffset;
-                Overlapped.hEvent = NULL;
-                if(!ReadFile(pStream->Base.File.hFile, pvBuffer, dwBytesToRead, &dwBytesRead, &Overlapped))
-                {
-                    CascUnlock(pStream->Lock);
+                // Reading past the end of the file is not an error for us
+                if(GetLastError() != ERROR_HANDLE_EOF)
                     return false;
-                }
             }
         }
+    }
 #endif
 
 #if defined(CASCLIB_PLATFORM_MAC) || defined(CASCLIB_PLATFORM_LINUX)
-        {
-            ssize_t bytes_read;
+    {
+        ssize_t bytes_read;
 
-            // If the byte offset is different from the current file position,
-            // we have to update the file position
-            if(ByteOffset != pStream->Base.File.FilePos)
+        // The pread() may return less data than requested, even if not at the end of the file
+        while(dwBytesRead < dwBytesToRead)
+        {
+            bytes_read = pread64((intptr_t)pStream->Base.File.hFile,
+                                 (LPBYTE)pvBuffer + dwBytesRead,
+                                 (size_t)(dwBytesToRead - dwBytesRead),
+                                 (off64_t)(ByteOffset + dwBytesRead));
+            if(bytes_read == -1)
             {
-                if(lseek64((intptr_t)pStream->Base.File.hFile, (off64_t)(ByteOffset), SEEK_SET) == (off64_t)-1)
-                {
-                    CascUnlock(pStream->Lock);
-                    SetCascError(errno);
-                    return false;
-                }
-                pStream->Base.File.FilePos = ByteOffset;
+                if(errno == EINTR)
+                    continue;
+                SetCascError(errno);
+                return false;
             }
 
-            // Perform the read operation
-            if(dwBytesToRead != 0)
-            {
-                bytes_read = read((intptr_t)pStream->Base.File.hFile, pvBuffer, (size_t)dwBytesToRead);
-                if(bytes_read == -1)
-                {
-                    CascUnlock(pStream->Lock);
-                    SetCascError(errno);
-                    return false;
-                }
-
-                dwBytesRead = (DWORD)(size_t)bytes_read;
-            }
+            // End of the file
+            if(bytes_read == 0)
+                break;
+            dwBytesRead += (DWORD)(size_t)bytes_read;
         }
+    }
 #endif
 
-        // Increment the current file position by number of bytes read
-        pStream->Base.File.FilePos = ByteOffset + dwBytesRead;
+    PtrBytesRead[0] = dwBytesRead;
+    return true;
+}
+
+static bool BaseFile_Read(
+    TFileStream * pStream,                  // Pointer to an open stream
+    ULONGLONG * pByteOffset,                // Pointer to file byte offset. If NULL, it reads from the current position
+    void * pvBuffer,                        // Pointer to data to be read
+    DWORD dwBytesToRead)                    // Number of bytes to read from the file
+{
+    DWORD dwBytesRead = 0;                  // Must be set by platform-specific code
+
+    // Reads with explicit byte offset are lock-free. They don't touch the shared
+    // file position, so multiple threads can read the same data file at once.
+    if(pByteOffset != NULL)
+    {
+        if(!BaseFile_ReadAt(pStream, pByteOffset[0], pvBuffer, dwBytesToRead, &dwBytesRead))
+            return false;
+    }
+    else
+    {
+        // Reading from the current position needs to synchronize the access to FilePos
+        CascLock(pStream->Lock);
+        {
+            ULONGLONG ByteOffset = pStream->Base.File.FilePos;
+
+            if(!BaseFile_ReadAt(pStream, ByteOffset, pvBuffer, dwBytesToRead, &dwBytesRead))
+            {
+                CascUnlock(pStream->Lock);
+                return false;
+            }
+
+            // Increment the current file position by number of bytes read
+            pStream->Base.File.FilePos = ByteOffset + dwBytesRead;
+        }
+        CascUnlock(pStream->Lock);
     }
-    CascUnlock(pStream->Lock);
 
     // If the number of bytes read doesn't match to required amount, return false
     // However, Blizzard's CASC handlers read encoded data so that if less than expected
@@ -302,21 +328,9 @@ static bool BaseFile_Write(TFileStream * pStream, ULONGLONG * pByteOffset, const
         {
             ssize_t bytes_written;
 
-            // If the byte offset is different from the current file position,
-            // we have to update the file position
-            if(ByteOffset != pStream->Base.File.FilePos)
-            {
-                if(lseek64((intptr_t)pStream->Base.File.hFile, (off64_t)(ByteOffset), SEEK_SET) == (off64_t)-1)
-                {
-                    CascUnlock(pStream->Lock);
-                    SetCascError(errno);
-                    return false;
-                }
-                pStream->Base.File.FilePos = ByteOffset;
-            }
-
-            // Perform the read operation
-            bytes_written = write((intptr_t)pStream->Base.File.hFile, pvBuffer, (size_t)dwBytesToWrite);
+            // Perform the positional write operation. Since the reads don't move
+            // the system file pointer anymore, we can't rely on it here either
+            bytes_written = pwrite64((intptr_t)pStream->Base.File.hFile, pvBuffer, (size_t)dwBytesToWrite, (off64_t)(ByteOffset));
             if(bytes_written == -1)
             {
                 CascUnlock(pStream->Lock);
@@ -406,16 +420,16 @@ static bool BaseFile_GetPos(TFileStream * pStream, ULONGLONG * pByteOffset)
 }
 
 // Renames the file pointed by pStream so that it contains data from pNewStream
-static bool BaseFile_Replace(TFileStream * pStream, TFileStream * pNewStream)
+static bool BaseFile_Rename(LPCTSTR szFileName, LPCTSTR szNewFileName)
 {
 #ifdef CASCLIB_PLATFORM_WINDOWS
-    // Rename the new file to the old stream's file
-    return (bool)MoveFileEx(pNewStream->szFileName, pStream->szFileName, MOVEFILE_COPY_ALLOWED | MOVEFILE_REPLACE_EXISTING);
+    // Rename the file, replace the existing one
+    return (bool)MoveFileEx(szFileName, szNewFileName, MOVEFILE_COPY_ALLOWED | MOVEFILE_REPLACE_EXISTING);
 #endif
 
 #if defined(CASCLIB_PLATFORM_MAC) || defined(CASCLIB_PLATFORM_LINUX)
     // "rename" on Linux also works if the target file exists
-    if(rename(pNewStream->szFileName, pStream->szFileName) == -1)
+    if(rename(szFileName, szNewFileName) == -1)
     {
         SetCascError(errno);
         return false;
@@ -425,6 +439,12 @@ static bool BaseFile_Replace(TFileStream * pStream, TFileStream * pNewStream)
 #endif
 }
 
+static bool BaseFile_Replace(TFileStream * pStream, TFileStream * pNewStream)
+{
+    // Rename the new file to the old stream's file
+    return BaseFile_Rename(pNewStream->szFileName, pStream->szFileName);
+}
+
 static void BaseFile_Close(TFileStream * pStream)
 {
     // Synchronize the access to multiple threads
@@ -472,11 +492,10 @@ static bool BaseMap_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStre
     HANDLE hMap;
     bool bResult = false;
 
-    // Keep compiler happy
-    dwStreamFlags = dwStreamFlags;
+    DWORD dwWriteShare = (dwStreamFlags & STREAM_FLAG_WRITE_SHARE) ? FILE_SHARE_WRITE : 0;
 
     // Open the file for read access
-    hFile = CreateFile(szFileName, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    hFile = CreateFile(szFileName, FILE_READ_DATA, FILE_SHARE_READ | dwWriteShare, NULL, OPEN_EXISTING, 0, NULL);
     if(hFile != INVALID_HANDLE_VALUE)
     {
         // Retrieve file size. Don't allow mapping file of a zero size.
@@ -522,6 +541,9 @@ static bool BaseMap_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStre
     intptr_t handle;
     bool bResult = false;
 
+    // Keep compiler happy
+    CASCLIB_UNUSED(dwStreamFlags);
+
     // Open the file
     handle = open(szFileName, O_RDONLY);
     if(handle != -1)
@@ -529,9 +551,12 @@ static bool BaseMap_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStre
         // Get the file size
         if(fstat64(handle, &fileinfo) != -1)
         {
-            pStream->Base.Map.pbFile = (LPBYTE)mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
-            if(pStream->Base.Map.pbFile != NULL)
+            // Don't allow mapping file of a zero size. Note that mmap returns MAP_FAILED on error
+            void * pvFile = (fileinfo.st_size != 0) ? mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, handle, 0) : MAP_FAILED;
+            if(pvFile != MAP_FAILED)
             {
+                pStream->Base.Map.pbFile = (LPBYTE)pvFile;
+
                 // time_t is number of seconds since 1.1.1970, UTC.
                 // 1 second = 10000000 (decimal) in FILETIME
                 // Set the start to 1.1.1970 00:00:00
@@ -562,20 +587,35 @@ static bool BaseMap_Read(
     DWORD dwBytesToRead)                    // Number of bytes to read from the file
 {
     ULONGLONG ByteOffset = GetByteOffset(pByteOffset, pStream->Base.Map.FilePos);
+    DWORD dwBytesRead = 0;
 
     // Do we have to read anything at all?
     if(dwBytesToRead != 0)
     {
-        // Don't allow reading past file size
-        if((ByteOffset + dwBytesToRead) > pStream->Base.Map.FileSize)
-            return false;
+        // Determine how much data is available in the mapped view
+        if(ByteOffset < pStream->Base.Map.FileSize)
+            dwBytesRead = (DWORD)CASCLIB_MIN(pStream->Base.Map.FileSize - ByteOffset, dwBytesToRead);
+
+        // Copy the available data
+        memcpy(pvBuffer, pStream->Base.Map.pbFile + (size_t)ByteOffset, dwBytesRead);
+
+        // The rest can be filled with zeros, if the caller wants it
+        if(dwBytesRead < dwBytesToRead)
+        {
+            if((pStream->dwFlags & STREAM_FLAG_FILL_MISSING) == 0)
+            {
+                SetCascError(ERROR_HANDLE_EOF);
+                return false;
+            }
 
-        // Copy the required data
-        memcpy(pvBuffer, pStream->Base.Map.pbFile + (size_t)ByteOffset, dwBytesToRead);
+            memset((LPBYTE)pvBuffer + dwBytesRead, 0, (dwBytesToRead - dwBytesRead));
+        }
     }
 
-    // Move the current file position
-    pStream->Base.Map.FilePos += dwBytesToRead;
+    // Move the current file position. Reads with explicit offset don't move it,
+    // so that multiple threads can read the mapped file at the same time
+    if(pByteOffset == NULL)
+        pStream->Base.Map.FilePos = ByteOffset + dwBytesToRead;
     return true;
 }
 
@@ -670,16 +710,69 @@ static DWORD BaseHttp_ParseURL(TFileStream * pStream, LPCTSTR szFileName, int *
 //-----------------------------------------------------------------------------
 // Local functions - base HTTP file support
 
-static bool BaseHttp_Download(TFileStream * pStream)
+// Sends the request to the server and receives the decoded response data.
+// If pByteOffset is not NULL, only the given range of the file is requested.
+// Note that the server may ignore the range and send the entire file
+static DWORD BaseHttp_SendRequest(TFileStream * pStream, ULONGLONG * pByteOffset, DWORD dwBytesToRead, CASC_MIME_RESPONSE & MimeResponse, CASC_BLOB & FileData)
 {
-    CASC_MIME_RESPONSE MimeResponse;
-    CASC_BLOB FileData;
     CASC_MIME Mime;
     const char * request_mask = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: Keep-Alive\r\n\r\n";
+    const char * range_mask = "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%llu-%llu\r\nConnection: Keep-Alive\r\n\r\n";
     char * server_response;
     char * fileName = pStream->Base.Socket.fileName;
-    char request[0x100];
+    char request[0x200];
     size_t request_length = 0;
+    DWORD dwErrCode = ERROR_BAD_FORMAT;
+
+    // Construct the request, either HTTP or Ribbit (https://wowdev.wiki/Ribbit).
+    // Note that Ribbit requests don't start with slash and don't support ranges
+    if((pStream->dwFlags & BASE_PROVIDER_MASK) == BASE_PROVIDER_RIBBIT)
+    {
+        if(fileName[0] == '/')
+            fileName++;
+        request_mask = "%s\r\n";
+        pByteOffset = NULL;
+    }
+
+    // Construct the request
+    if(pByteOffset != NULL)
+    {
+        ULONGLONG RangeBegin = pByteOffset[0];
+        ULONGLONG RangeEnd = RangeBegin + dwBytesToRead - 1;
+
+        request_length = CascStrPrintf(request, _countof(request), range_mask, fileName, pStream->Base.Socket.hostName, (unsigned long long)RangeBegin, (unsigned long long)RangeEnd);
+    }
+    else
+    {
+        request_length = CascStrPrintf(request, _countof(request), request_mask, fileName, pStream->Base.Socket.hostName);
+    }
+
+    // Send the request and receive decoded response
+    server_response = pStream->Base.Socket.pSocket->ReadResponse(request, request_length, MimeResponse);
+    if(server_response != NULL)
+    {
+        // Decode the MIME document and move the data from MIME to the caller
+        if((dwErrCode = Mime.Load(server_response, MimeResponse)) == ERROR_SUCCESS)
+            dwErrCode = Mime.GiveAway(FileData);
+
+        // Free the buffer
+        CASC_FREE(server_response);
+    }
+    return dwErrCode;
+}
+
+static void BaseHttp_SetFileData(TFileStream * pStream, CASC_BLOB & FileData)
+{
+    pStream->Base.Socket.fileData = FileData.pbData;
+    pStream->Base.Socket.fileDataLength = FileData.cbData;
+    pStream->Base.Socket.fileSize = FileData.cbData;
+    FileData.Reset();
+}
+
+static bool BaseHttp_Download(TFileStream * pStream)
+{
+    CASC_MIME_RESPONSE MimeResponse;
+    CASC_BLOB FileData;
     DWORD dwErrCode = ERROR_SUCCESS;
 
     // If we already have the data, it's success
@@ -687,37 +780,64 @@ static bool BaseHttp_Download(TFileStream * pStream)
     {
         // Reset the file data length as well
         pStream->Base.Socket.fileDataLength = 0;
-        dwErrCode = ERROR_BAD_FORMAT;
 
-        // Construct the request, either HTTP or Ribbit (https://wowdev.wiki/Ribbit).
-        // Note that Ribbit requests don't start with slash
-        if((pStream->dwFlags & BASE_PROVIDER_MASK) == BASE_PROVIDER_RIBBIT)
+        // Download the entire file
+        if((dwErrCode = BaseHttp_SendRequest(pStream, NULL, 0, MimeResponse, FileData)) == ERROR_SUCCESS)
         {
-            if(fileName[0] == '/')
-                fileName++;
-            request_mask = "%s\r\n";
+            BaseHttp_SetFileData(pStream, FileData);
+            pStream->Base.Socket.fileDataPos = 0;
         }
+    }
 
-        // Send the request and receive decoded response
-        request_length = CascStrPrintf(request, _countof(request), request_mask, fileName, pStream->Base.Socket.hostName);
-        server_response = pStream->Base.Socket.pSocket->ReadResponse(request, request_length, MimeResponse);
-        if(server_response != NULL)
+    // Process error codes
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
+
+// Downloads a range of the file. If the server doesn't support ranges and sends
+// the entire file instead, the file data is kept and the STREAM_FLAG_RANGE_ACCESS is cleared.
+// The caller must then take the data from the downloaded file
+static bool BaseHttp_DownloadRange(TFileStream * pStream, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PDWORD PtrBytesRead)
+{
+    CASC_MIME_RESPONSE MimeResponse;
+    CASC_BLOB FileData;
+    DWORD dwErrCode;
+
+    // Don't bother asking for data past the end of the file
+    if(pStream->Base.Socket.fileSize != CASC_INVALID_SIZE64 && ByteOffset >= pStream->Base.Socket.fileSize)
+    {
+        PtrBytesRead[0] = 0;
+        return true;
+    }
+
+    // Send the range request
+    if((dwErrCode = BaseHttp_SendRequest(pStream, &ByteOffset, dwBytesToRead, MimeResponse, FileData)) == ERROR_SUCCESS)
+    {
+        // Did the server send the part of the file that we asked for?
+        if(MimeResponse.http_code == 206)
         {
-            // Decode the MIME document
-            if((dwErrCode = Mime.Load(server_response, MimeResponse)) == ERROR_SUCCESS)
+            // Verify that this is really the range that we asked for
+            if(MimeResponse.crange_presence == FieldPresencePresent && MimeResponse.range_offset == ByteOffset)
             {
-                // Move the data from MIME to HTTP stream
-                if((dwErrCode = Mime.GiveAway(FileData)) == ERROR_SUCCESS)
-                {
-                    pStream->Base.Socket.fileData = FileData.pbData;
-                    pStream->Base.Socket.fileDataLength = FileData.cbData;
-                    pStream->Base.Socket.fileDataPos = 0;
-                    FileData.Reset();
-                }
-            }
+                // Remember the file size, if the server sent it
+                if(MimeResponse.range_total != CASC_INVALID_SIZE64)
+                    pStream->Base.Socket.fileSize = MimeResponse.range_total;
 
-            // Free the buffer
-            CASC_FREE(server_response);
+                // The range is shorter than requested if it reaches the end of the file
+                PtrBytesRead[0] = (DWORD)CASCLIB_MIN(FileData.cbData, dwBytesToRead);
+                memcpy(pvBuffer, FileData.pbData, PtrBytesRead[0]);
+            }
+            else
+            {
+                dwErrCode = ERROR_BAD_FORMAT;
+            }
+        }
+        else
+        {
+            // The server ignored the range. Keep the entire file and serve the reads from it
+            BaseHttp_SetFileData(pStream, FileData);
+            pStream->dwFlags &= ~STREAM_FLAG_RANGE_ACCESS;
         }
     }
 
@@ -733,6 +853,13 @@ static bool BaseHttp_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStr
     DWORD dwErrCode;
     int portNum = ((dwStreamFlags & BASE_PROVIDER_MASK) == BASE_PROVIDER_RIBBIT) ? CASC_PORT_RIBBIT : CASC_PORT_HTTP;
 
+    // The file size is unknown until we get the data
+    pStream->Base.Socket.fileSize = CASC_INVALID_SIZE64;
+
+    // Ranges are only supported by HTTP
+    if((dwStreamFlags & BASE_PROVIDER_MASK) != BASE_PROVIDER_HTTP)
+        pStream->dwFlags &= ~STREAM_FLAG_RANGE_ACCESS;
+
     // Extract the server part
     if((dwErrCode = BaseHttp_ParseURL(pStream, szFileName, &portNum)) == ERROR_SUCCESS)
     {
@@ -757,6 +884,7 @@ static bool BaseHttp_Read(
 {
     ULONGLONG ByteOffset = GetByteOffset(pByteOffset, pStream->Base.Socket.fileDataPos);
     bool bCanReadTheWholeRange = true;
+    bool bRangeDownloaded = false;
 
     // Synchronize the access to the TFileStream structure
     CascLock(pStream->Lock);
@@ -764,32 +892,56 @@ static bool BaseHttp_Read(
         // Do we have to read anything at all?
         if(dwBytesToRead != 0)
         {
-            // Make sure that we have the file downloaded
-            if(!BaseHttp_Download(pStream))
+            // If the stream is read by ranges, we only download the requested range
+            if((pStream->dwFlags & STREAM_FLAG_RANGE_ACCESS) && pStream->Base.Socket.fileData == NULL)
             {
-                CascUnlock(pStream->Lock);
-                return false;
+                DWORD dwBytesRead = 0;
+
+                if(!BaseHttp_DownloadRange(pStream, ByteOffset, pvBuffer, dwBytesToRead, &dwBytesRead))
+                {
+                    CascUnlock(pStream->Lock);
+                    return false;
+                }
+
+                // If the server supports ranges, we have the data in the buffer
+                if(pStream->dwFlags & STREAM_FLAG_RANGE_ACCESS)
+                {
+                    bCanReadTheWholeRange = (dwBytesRead == dwBytesToRead);
+                    bRangeDownloaded = true;
+                    dwBytesToRead = dwBytesRead;
+                }
             }
 
-            // Are we trying to read more than available?
-            if(ByteOffset <= pStream->Base.Socket.fileDataLength)
+            // Otherwise, take the data from the downloaded file
+            if(bRangeDownloaded == false)
             {
-                if((ByteOffset + dwBytesToRead) > pStream->Base.Socket.fileDataLength)
+                // Make sure that we have the file downloaded
+                if(!BaseHttp_Download(pStream))
+                {
+                    CascUnlock(pStream->Lock);
+                    return false;
+                }
+
+                // Are we trying to read more than available?
+                if(ByteOffset <= pStream->Base.Socket.fileDataLength)
+                {
+                    if((ByteOffset + dwBytesToRead) > pStream->Base.Socket.fileDataLength)
+                    {
+                        bCanReadTheWholeRange = false;
+                        dwBytesToRead = (DWORD)(pStream->Base.Socket.fileDataLength - ByteOffset);
+                    }
+                }
+                else
                 {
                     bCanReadTheWholeRange = false;
-                    dwBytesToRead = (DWORD)(pStream->Base.Socket.fileDataLength - ByteOffset);
+                    dwBytesToRead = 0;
                 }
-            }
-            else
-            {
-                bCanReadTheWholeRange = false;
-                dwBytesToRead = 0;
-            }
 
-            // Copy the data
-            if(dwBytesToRead != 0)
-            {
-                memcpy(pvBuffer, pStream->Base.Socket.fileData + ByteOffset, dwBytesToRead);
+                // Copy the data
+                if(dwBytesToRead != 0)
+                {
+                    memcpy(pvBuffer, pStream->Base.Socket.fileData + ByteOffset, dwBytesToRead);
+                }
             }
         }
 
@@ -807,13 +959,28 @@ static bool BaseHttp_Read(
 // Gives the current file size
 static bool BaseHttp_GetSize(TFileStream * pStream, ULONGLONG * pFileSize)
 {
-    bool bResult;
+    bool bResult = true;
 
     // Synchronize the access to the TFileStream structure
     CascLock(pStream->Lock);
     {
-        // Make sure that we have the file data
-        if((bResult = BaseHttp_Download(pStream)) != false)
+        // If the stream is read by ranges, ask for the first byte.
+        // The server sends the total file size in the "Content-Range" field
+        if((pStream->dwFlags & STREAM_FLAG_RANGE_ACCESS) && pStream->Base.Socket.fileSize == CASC_INVALID_SIZE64)
+        {
+            DWORD dwBytesRead = 0;
+            BYTE OneByte = 0;
+
+            bResult = BaseHttp_DownloadRange(pStream, 0, &OneByte, 1, &dwBytesRead);
+        }
+
+        // If we know the file size, give it to the caller.
+        // Otherwise, make sure that we have the file data
+        if(bResult && pStream->Base.Socket.fileSize != CASC_INVALID_SIZE64)
+        {
+            *pFileSize = pStream->Base.Socket.fileSize;
+        }
+        else if((bResult = BaseHttp_Download(pStream)) != false)
         {
             *pFileSize = pStream->Base.Socket.fileDataLength;
         }
@@ -1073,7 +1240,8 @@ static TFileStream * AllocateFileStream(
         }
 
         // Open the master file
-        pMaster = FileStream_OpenFile(szNextFile + 1, STREAM_FLAG_READ_ONLY);
+        // Master streams are always read by blocks, so we only need to download ranges
+        pMaster = FileStream_OpenFile(szNextFile + 1, STREAM_FLAG_READ_ONLY | STREAM_FLAG_RANGE_ACCESS);
     }
 
     // Allocate the stream structure for the given stream type
@@ -1332,7 +1500,8 @@ static bool FlatStream_CreateMirror(TBlockStream * pStream)
         return false;
 
     // Retrieve the master file size, block count and bitmap size
-    FileStream_GetSize(pStream->pMaster, &MasterSize);
+    if(!FileStream_GetSize(pStream->pMaster, &MasterSize) || MasterSize == 0)
+        return false;
     dwBlockCount = (DWORD)((MasterSize + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE);
     dwBitmapSize = (DWORD)((dwBlockCount + 7) / 8);
 
@@ -1751,7 +1920,8 @@ static bool PartStream_CreateMirror(TBlockStream * pStream)
         return false;
 
     // Retrieve the master file size, block count and bitmap size
-    FileStream_GetSize(pStream->pMaster, &MasterSize);
+    if(!FileStream_GetSize(pStream->pMaster, &MasterSize) || MasterSize == 0)
+        return false;
     dwBlockCount = (DWORD)((MasterSize + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE);
     dwBitmapSize = (DWORD)(dwBlockCount * sizeof(PART_FILE_MAP_ENTRY));
 
@@ -2621,6 +2791,28 @@ bool FileStream_Read(TFileStream * pStream, ULONGLONG * pByteOffset, void * pvBu
     return pStream->StreamRead(pStream, pByteOffset, pvBuffer, dwBytesToRead);
 }
 
+/**
+ * Returns pointer to the data of a memory-mapped stream. The caller can read
+ * the data directly, without copying them to its own buffer. Returns NULL
+ * if the stream is not mapped or the requested range is not entirely in the file.
+ *
+ * \a pStream Pointer to an open stream
+ * \a ByteOffset File offset of the data
+ * \a dwLength Number of bytes that the caller wants to access
+ */
+LPBYTE FileStream_GetMappedData(TFileStream * pStream, ULONGLONG ByteOffset, DWORD dwLength)
+{
+    // Only flat mapped streams, without any file bitmap
+    if(pStream != NULL && pStream->StreamRead == BaseMap_Read)
+    {
+        if(ByteOffset < pStream->Base.Map.FileSize && dwLength <= (pStream->Base.Map.FileSize - ByteOffset))
+        {
+            return pStream->Base.Map.pbFile + (size_t)ByteOffset;
+        }
+    }
+    return NULL;
+}
+
 /**
  * This function writes data to the stream
  *
@@ -2763,6 +2955,33 @@ bool FileStream_Replace(TFileStream * pStream, TFileStream * pNewStream)
  *
  * \a pStream Pointer to an open stream
  */
+/**
+ * Closes the stream and renames its file. If a file with the new name exists,
+ * it is replaced. The stream is closed even if the rename fails.
+ * Used for committing a file that has been written under a temporary name.
+ *
+ * \a pStream Pointer to an open stream
+ * \a szNewFileName New name of the file
+ */
+bool FileStream_Rename(TFileStream * pStream, LPCTSTR szNewFileName)
+{
+    bool bResult = false;
+
+    // Only supported on flat files
+    if((pStream->dwFlags & STREAM_PROVIDERS_MASK) == (STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE))
+    {
+        pStream->BaseClose(pStream);
+        bResult = BaseFile_Rename(pStream->szFileName, szNewFileName);
+    }
+    else
+    {
+        SetCascError(ERROR_NOT_SUPPORTED);
+    }
+
+    FileStream_Close(pStream);
+    return bResult;
+}
+
 void FileStream_Close(TFileStream * pStream)
 {
     // Check if the stream structure is allocated at all
@@ -2788,3 +3007,441 @@ void FileStream_Close(TFileStream * pStream)
         CASC_FREE(pStream);
     }
 }
+
+//-----------------------------------------------------------------------------
+// Asynchronous reading
+
+#define STREAM_IO_QUEUE_DEPTH   64              // Maximum number of reads submitted to io_uring at once
+
+// One asynchronous read request
+struct TStreamReadAsync
+{
+    struct TFileStreamIo * pIo;                 // The engine that performs the read
+    TFileStream * pStream;                      // Stream to read from
+    ULONGLONG ByteOffset;                       // Offset of the data in the stream
+    LPBYTE pbBuffer;                            // Buffer to read the data into
+    DWORD dwBytesToRead;                        // Total number of bytes to read
+    DWORD dwBytesRead;                          // Number of bytes read so far (io_uring only)
+    STREAM_READ_COMPLETE PfnComplete;           // Completion callback
+    void * pvContext;                           // Parameter for the completion callback
+#ifdef CASC_HAVE_IO_URING
+    struct iovec IoVec;                         // Buffer descriptor for IORING_OP_READV
+#endif
+};
+
+#ifdef CASC_HAVE_IO_URING
+
+// Submission and completion rings shared with the kernel
+struct TIoUring
+{
+    int fd;                                     // File descriptor of the io_uring instance
+    void * pvSqRing;                            // Mapped submission ring
+    void * pvCqRing;                            // Mapped completion ring. Same as pvSqRing on newer kernels
+    struct io_uring_sqe * pSqes;                // Mapped array of submission entries
+    size_t cbSqRing;
+    size_t cbCqRing;
+    size_t cbSqes;
+
+    unsigned * pSqHead;                         // Consumed by the kernel
+    unsigned * pSqTail;                         // Produced by us, under the lock
+    unsigned * pSqArray;
+    unsigned SqMask;
+    unsigned * pCqHead;                         // Consumed by the completion thread
+    unsigned * pCqTail;                         // Produced by the kernel
+    struct io_uring_cqe * pCqes;
+    unsigned CqMask;
+
+    CASC_LOCK Lock;                             // Protects the submission ring and dwInFlight
+    CASC_COND Cond;                             // Signalled when a read completes
+    CASC_THREAD Thread;                         // The thread processing completions
+    DWORD dwQueueDepth;                         // Maximum number of reads in flight
+    DWORD dwInFlight;                           // Number of submitted reads that did not complete yet
+};
+
+#endif  // CASC_HAVE_IO_URING
+
+struct TFileStreamIo
+{
+    CASC_WORK_QUEUE * pWorkers;                 // Threads for blocking reads
+    CASC_LOCK BlockLock;                        // Serializes reads from block-oriented streams
+#ifdef CASC_HAVE_IO_URING
+    TIoUring * pRing;                           // NULL if io_uring is not available
+#endif
+};
+
+// Finishes the read request. Short reads are handled the same way as in BaseFile_Read
+static void CompleteReadAsync(TStreamReadAsync * pRequest, DWORD dwErrCode)
+{
+    if(dwErrCode == ERROR_SUCCESS && pRequest->dwBytesRead < pRequest->dwBytesToRead)
+    {
+        if(pRequest->pStream->dwFlags & STREAM_FLAG_FILL_MISSING)
+            memset(pRequest->pbBuffer + pRequest->dwBytesRead, 0, pRequest->dwBytesToRead - pRequest->dwBytesRead);
+        else
+            dwErrCode = ERROR_HANDLE_EOF;
+    }
+
+    pRequest->PfnComplete(pRequest->pvContext, dwErrCode);
+    CASC_FREE(pRequest);
+}
+
+// Blocking read on one of the worker threads
+static void ReadAsync_Worker(void * pvParam)
+{
+    TStreamReadAsync * pRequest = (TStreamReadAsync *)pvParam;
+    TFileStream * pStream = pRequest->pStream;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bBlockStream;
+
+    // Flat files and mapped files can be read by multiple threads at once.
+    // Block-oriented streams (e.g. partially downloaded files) update their bitmaps
+    bBlockStream = (pStream->StreamRead != BaseFile_Read && pStream->StreamRead != BaseMap_Read);
+    if(bBlockStream)
+        CascLock(pRequest->pIo->BlockLock);
+
+    if(FileStream_Read(pStream, &pRequest->ByteOffset, pRequest->pbBuffer, pRequest->dwBytesToRead))
+        pRequest->dwBytesRead = pRequest->dwBytesToRead;
+    else
+        dwErrCode = GetCascError();
+
+    if(bBlockStream)
+        CascUnlock(pRequest->pIo->BlockLock);
+    CompleteReadAsync(pRequest, dwErrCode);
+}
+
+#ifdef CASC_HAVE_IO_URING
+
+static int IoUring_Enter(int fd, unsigned ToSubmit, unsigned MinComplete, unsigned Flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, ToSubmit, MinComplete, Flags, NULL, 0);
+}
+
+// Puts the read to the submission ring. The caller must own the lock and a free slot
+static void IoUring_PushRead(TIoUring * pRing, TStreamReadAsync * pRequest)
+{
+    struct io_uring_sqe * pSqe;
+    unsigned SqTail = pRing->pSqTail[0];
+    unsigned SqIndex = SqTail & pRing->SqMask;
+
+    // We read the rest of the data that have not been read yet
+    pRequest->IoVec.iov_base = pRequest->pbBuffer + pRequest->dwBytesRead;
+    pRequest->IoVec.iov_len = pRequest->dwBytesToRead - pRequest->dwBytesRead;
+
+    // Fill the submission entry
+    pSqe = pRing->pSqes + SqIndex;
+    memset(pSqe, 0, sizeof(struct io_uring_sqe));
+    pSqe->opcode = IORING_OP_READV;
+    pSqe->fd = (int)(intptr_t)pRequest->pStream->Base.File.hFile;
+    pSqe->off = pRequest->ByteOffset + pRequest->dwBytesRead;
+    pSqe->addr = (__u64)(uintptr_t)(&pRequest->IoVec);
+    pSqe->len = 1;
+    pSqe->user_data = (__u64)(uintptr_t)pRequest;
+
+    // Publish the entry to the kernel and submit it
+    pRing->pSqArray[SqIndex] = SqIndex;
+    __atomic_store_n(pRing->pSqTail, SqTail + 1, __ATOMIC_RELEASE);
+    while(IoUring_Enter(pRing->fd, 1, 0, 0) < 0 && errno == EINTR);
+}
+
+// Handles one completed read. Called on the completion thread
+static void IoUring_Complete(TIoUring * pRing, TStreamReadAsync * pRequest, int nResult)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Interrupted read or partial read: submit the rest again. The request keeps its slot
+    if(nResult == -EINTR || nResult == -EAGAIN || (nResult > 0 && (pRequest->dwBytesRead + (DWORD)nResult) < pRequest->dwBytesToRead))
+    {
+        if(nResult > 0)
+            pRequest->dwBytesRead += (DWORD)nResult;
+
+        CascLock(pRing->Lock);
+        IoUring_PushRead(pRing, pRequest);
+        CascUnlock(pRing->Lock);
+        return;
+    }
+
+    // Any other error: Let the synchronous read determine it
+    if(nResult < 0)
+    {
+        ULONGLONG ByteOffset = pRequest->ByteOffset + pRequest->dwBytesRead;
+
+        if(FileStream_Read(pRequest->pStream, &ByteOffset, pRequest->pbBuffer + pRequest->dwBytesRead, pRequest->dwBytesToRead - pRequest->dwBytesRead))
+            pRequest->dwBytesRead = pRequest->dwBytesToRead;
+        else
+            dwErrCode = GetCascError();
+    }
+    else
+    {
+        // Zero means end of the file
+        pRequest->dwBytesRead += (DWORD)nResult;
+    }
+
+    // Release the slot
+    CascLock(pRing->Lock);
+    pRing->dwInFlight--;
+    CascBroadcastCond(pRing->Cond);
+    CascUnlock(pRing->Lock);
+
+    CompleteReadAsync(pRequest, dwErrCode);
+}
+
+static void IoUring_CompletionThread(void * pvParam)
+{
+    TIoUring * pRing = (TIoUring *)pvParam;
+    struct io_uring_cqe * pCqe;
+    unsigned CqHead;
+    unsigned ToSubmit;
+    __u64 UserData;
+    int nResult;
+
+    for(;;)
+    {
+        // Are there any completions?
+        CqHead = pRing->pCqHead[0];
+        if(CqHead == __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE))
+        {
+            // Wait for at least one. Also submit entries that may have been left
+            // in the submission ring by a failed io_uring_enter
+            ToSubmit = __atomic_load_n(pRing->pSqTail, __ATOMIC_ACQUIRE) - __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+            IoUring_Enter(pRing->fd, ToSubmit, 1, IORING_ENTER_GETEVENTS);
+            continue;
+        }
+
+        // Consume the completion entry
+        pCqe = pRing->pCqes + (CqHead & pRing->CqMask);
+        UserData = pCqe->user_data;
+        nResult = pCqe->res;
+        __atomic_store_n(pRing->pCqHead, CqHead + 1, __ATOMIC_RELEASE);
+
+        // A no-op without request means that the ring is being closed
+        if(UserData == 0)
+            break;
+        IoUring_Complete(pRing, (TStreamReadAsync *)(uintptr_t)UserData, nResult);
+    }
+}
+
+static void IoUring_Free(TIoUring * pRing)
+{
+    if(pRing != NULL)
+    {
+        if(pRing->pSqes != NULL && pRing->pSqes != MAP_FAILED)
+            munmap(pRing->pSqes, pRing->cbSqes);
+        if(pRing->pvCqRing != NULL && pRing->pvCqRing != MAP_FAILED && pRing->pvCqRing != pRing->pvSqRing)
+            munmap(pRing->pvCqRing, pRing->cbCqRing);
+        if(pRing->pvSqRing != NULL && pRing->pvSqRing != MAP_FAILED)
+            munmap(pRing->pvSqRing, pRing->cbSqRing);
+        if(pRing->fd >= 0)
+            close(pRing->fd);
+
+        CascFreeCond(pRing->Cond);
+        CascFreeLock(pRing->Lock);
+        CASC_FREE(pRing);
+    }
+}
+
+// Creates the io_uring instance. Returns NULL if the kernel doesn't support it
+// or if it's not allowed (e.g. by a seccomp filter in a container)
+static TIoUring * IoUring_Create(DWORD dwQueueDepth)
+{
+    struct io_uring_params Params;
+    TIoUring * pRing;
+    LPBYTE pbSqRing;
+    LPBYTE pbCqRing;
+
+    // Allocate and initialize the ring structure
+    if((pRing = CASC_ALLOC<TIoUring>(1)) == NULL)
+        return NULL;
+    memset(pRing, 0, sizeof(TIoUring));
+    CascInitLock(pRing->Lock);
+    CascInitCond(pRing->Cond);
+
+    // Create the io_uring instance. The completion ring has twice as many entries
+    // as the submission ring, so it never overflows
+    memset(&Params, 0, sizeof(struct io_uring_params));
+    if((pRing->fd = (int)syscall(__NR_io_uring_setup, dwQueueDepth, &Params)) < 0)
+    {
+        IoUring_Free(pRing);
+        return NULL;
+    }
+
+    // Map the rings to our address space
+    pRing->cbSqRing = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    pRing->cbCqRing = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if(Params.features & IORING_FEAT_SINGLE_MMAP)
+        pRing->cbSqRing = pRing->cbCqRing = CASCLIB_MAX(pRing->cbSqRing, pRing->cbCqRing);
+#endif
+    pRing->pvSqRing = mmap(NULL, pRing->cbSqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQ_RING);
+    pRing->pvCqRing = pRing->pvSqRing;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if((Params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+#endif
+        pRing->pvCqRing = mmap(NULL, pRing->cbCqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_CQ_RING);
+    pRing->cbSqes = Params.sq_entries * sizeof(struct io_uring_sqe);
+    pRing->pSqes = (struct io_uring_sqe *)mmap(NULL, pRing->cbSqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQES);
+    if(pRing->pvSqRing == MAP_FAILED || pRing->pvCqRing == MAP_FAILED || pRing->pSqes == MAP_FAILED)
+    {
+        IoUring_Free(pRing);
+        return NULL;
+    }
+
+    // Get pointers to the ring members
+    pbSqRing = (LPBYTE)pRing->pvSqRing;
+    pbCqRing = (LPBYTE)pRing->pvCqRing;
+    pRing->pSqHead  = (unsigned *)(pbSqRing + Params.sq_off.head);
+    pRing->pSqTail  = (unsigned *)(pbSqRing + Params.sq_off.tail);
+    pRing->pSqArray = (unsigned *)(pbSqRing + Params.sq_off.array);
+    pRing->SqMask   = *(unsigned *)(pbSqRing + Params.sq_off.ring_mask);
+    pRing->pCqHead  = (unsigned *)(pbCqRing + Params.cq_off.head);
+    pRing->pCqTail  = (unsigned *)(pbCqRing + Params.cq_off.tail);
+    pRing->pCqes    = (struct io_uring_cqe *)(pbCqRing + Params.cq_off.cqes);
+    pRing->CqMask   = *(unsigned *)(pbCqRing + Params.cq_off.ring_mask);
+    pRing->dwQueueDepth = CASCLIB_MIN(dwQueueDepth, Params.sq_entries);
+
+    // Start the thread that processes the completions
+    if(!CascCreateThread(pRing->Thread, IoUring_CompletionThread, pRing))
+    {
+        IoUring_Free(pRing);
+        return NULL;
+    }
+
+    return pRing;
+}
+
+static void IoUring_Close(TIoUring * pRing)
+{
+    struct io_uring_sqe * pSqe;
+    unsigned SqTail;
+    unsigned SqIndex;
+
+    // Wait until all reads are complete
+    CascLock(pRing->Lock);
+    while(pRing->dwInFlight != 0)
+        CascWaitCond(pRing->Cond, pRing->Lock);
+
+    // Submit a no-op without request. This tells the completion thread to exit
+    SqTail = pRing->pSqTail[0];
+    SqIndex = SqTail & pRing->SqMask;
+    pSqe = pRing->pSqes + SqIndex;
+    memset(pSqe, 0, sizeof(struct io_uring_sqe));
+    pSqe->opcode = IORING_OP_NOP;
+    pRing->pSqArray[SqIndex] = SqIndex;
+    __atomic_store_n(pRing->pSqTail, SqTail + 1, __ATOMIC_RELEASE);
+    while(IoUring_Enter(pRing->fd, 1, 0, 0) < 0 && errno == EINTR);
+    CascUnlock(pRing->Lock);
+
+    // Wait for the completion thread and free the ring
+    CascWaitForThread(pRing->Thread);
+    IoUring_Free(pRing);
+}
+
+#endif  // CASC_HAVE_IO_URING
+
+/**
+ * Creates an engine for asynchronous reads
+ *
+ * \a dwThreadCount Number of threads for reads that can't use io_uring
+ */
+TFileStreamIo * FileStream_CreateIo(DWORD dwThreadCount)
+{
+    TFileStreamIo * pIo;
+
+    if((pIo = CASC_ALLOC<TFileStreamIo>(1)) != NULL)
+    {
+        memset(pIo, 0, sizeof(TFileStreamIo));
+        CascInitLock(pIo->BlockLock);
+
+        // Create the worker threads. These are needed even with io_uring,
+        // because not all streams are flat files
+        if((pIo->pWorkers = CascCreateWorkQueue(CASCLIB_MAX(dwThreadCount, 1))) == NULL)
+        {
+            CascFreeLock(pIo->BlockLock);
+            CASC_FREE(pIo);
+            return NULL;
+        }
+
+#ifdef CASC_HAVE_IO_URING
+        // If io_uring is not available, we simply use the worker threads
+        pIo->pRing = IoUring_Create(STREAM_IO_QUEUE_DEPTH);
+#endif
+    }
+
+    return pIo;
+}
+
+/**
+ * Starts reading data from the stream. When the read is complete, PfnComplete
+ * is called with ERROR_SUCCESS or an error code. Reads beyond the end of the file
+ * behave the same way as in FileStream_Read. If the function fails, the callback
+ * is not called.
+ *
+ * \a pIo Engine created by FileStream_CreateIo
+ * \a pStream Pointer to an open stream. Must stay open until the read completes
+ * \a ByteOffset File offset to read from
+ * \a pvBuffer Buffer for the data. Must stay valid until the read completes
+ * \a dwBytesToRead Number of bytes to read
+ * \a PfnComplete Completion callback
+ * \a pvContext Parameter for the completion callback
+ */
+bool FileStream_ReadAsync(TFileStreamIo * pIo, TFileStream * pStream, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, STREAM_READ_COMPLETE PfnComplete, void * pvContext)
+{
+    TStreamReadAsync * pRequest;
+
+    // Allocate and fill the request
+    if((pRequest = CASC_ALLOC<TStreamReadAsync>(1)) == NULL)
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+    memset(pRequest, 0, sizeof(TStreamReadAsync));
+    pRequest->pIo = pIo;
+    pRequest->pStream = pStream;
+    pRequest->ByteOffset = ByteOffset;
+    pRequest->pbBuffer = (LPBYTE)pvBuffer;
+    pRequest->dwBytesToRead = dwBytesToRead;
+    pRequest->PfnComplete = PfnComplete;
+    pRequest->pvContext = pvContext;
+
+#ifdef CASC_HAVE_IO_URING
+    // Flat local files are read by io_uring. If the ring is full, we wait for a free slot
+    if(pIo->pRing != NULL && pStream->StreamRead == BaseFile_Read && dwBytesToRead != 0)
+    {
+        TIoUring * pRing = pIo->pRing;
+
+        CascLock(pRing->Lock);
+        while(pRing->dwInFlight >= pRing->dwQueueDepth)
+            CascWaitCond(pRing->Cond, pRing->Lock);
+        pRing->dwInFlight++;
+        IoUring_PushRead(pRing, pRequest);
+        CascUnlock(pRing->Lock);
+        return true;
+    }
+#endif
+
+    // All other reads are done by the worker threads
+    if(!CascPostWork(pIo->pWorkers, ReadAsync_Worker, pRequest))
+    {
+        CASC_FREE(pRequest);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Waits for all pending reads and frees the engine.
+ * Must not be called from a completion callback.
+ *
+ * \a pIo Engine created by FileStream_CreateIo
+ */
+void FileStream_FreeIo(TFileStreamIo * pIo)
+{
+    if(pIo != NULL)
+    {
+#ifdef CASC_HAVE_IO_URING
+        if(pIo->pRing != NULL)
+            IoUring_Close(pIo->pRing);
+#endif
+        CascFreeWorkQueue(pIo->pWorkers);
+        CascFreeLock(pIo->BlockLock);
+        CASC_FREE(pIo);
+    }
+}
@@ -30,6 +30,7 @@
 #define STREAM_FLAG_WRITE_SHARE     0x00000200  // Allow write sharing when open for write
 #define STREAM_FLAG_USE_BITMAP      0x00000400  // If the file has a file bitmap, load it and use it
 #define STREAM_FLAG_FILL_MISSING    0x00000800  // If less than expected was read from the file, fill the missing part with zeros
+#define STREAM_FLAG_RANGE_ACCESS    0x00001000  // (HTTP) Only download the requested ranges, if the server supports it
 #define STREAM_OPTIONS_MASK         0x0000FF00  // Mask for stream options
 
 #define STREAM_PROVIDERS_MASK       0x000000FF  // Mask to get stream providers
@@ -178,6 +179,7 @@ union TBaseProviderData
         char * fileName;                    // Name of the remote resource
         size_t fileDataLength;              // Length of the file data, in bytes
         size_t fileDataPos;                 // Current position in the data
+        ULONGLONG fileSize;                 // Size of the remote file, if known from a range response
     } Socket;
 };
 
@@ -257,6 +259,7 @@ size_t FileStream_Prefix(LPCTSTR szFileName, DWORD * pdwProvider);
 bool FileStream_SetCallback(TFileStream * pStream, STREAM_DOWNLOAD_CALLBACK pfnCallback, void * pvUserData);
 
 bool FileStream_Read(TFileStream * pStream, ULONGLONG * pByteOffset, void * pvBuffer, DWORD dwBytesToRead);
+LPBYTE FileStream_GetMappedData(TFileStream * pStream, ULONGLONG ByteOffset, DWORD dwLength);
 bool FileStream_Write(TFileStream * pStream, ULONGLONG * pByteOffset, const void * pvBuffer, DWORD dwBytesToWrite);
 bool FileStream_SetSize(TFileStream * pStream, ULONGLONG NewFileSize);
 bool FileStream_GetSize(TFileStream * pStream, ULONGLONG * pFileSize);
@@ -264,7 +267,22 @@ bool FileStream_GetPos(TFileStream * pStream, ULONGLONG * pByteOffset);
 bool FileStream_GetTime(TFileStream * pStream, ULONGLONG * pFT);
 bool FileStream_GetFlags(TFileStream * pStream, PDWORD pdwStreamFlags);
 bool FileStream_Replace(TFileStream * pStream, TFileStream * pNewStream);
+bool FileStream_Rename(TFileStream * pStream, LPCTSTR szNewFileName);
 void FileStream_Close(TFileStream * pStream);
 
+//-----------------------------------------------------------------------------
+// Asynchronous reading. On Linux, reads from flat files are submitted to io_uring
+// (if compiled with CASC_USE_IO_URING and supported by the kernel). All other reads
+// are performed by a pool of threads.
+
+// Called when an asynchronous read is complete. Called on an I/O thread, so it should not block
+typedef void (*STREAM_READ_COMPLETE)(void * pvContext, DWORD dwErrCode);
+
+struct TFileStreamIo;
+
+TFileStreamIo * FileStream_CreateIo(DWORD dwThreadCount);
+bool FileStream_ReadAsync(TFileStreamIo * pIo, TFileStream * pStream, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, STREAM_READ_COMPLETE PfnComplete, void * pvContext);
+void FileStream_FreeIo(TFileStreamIo * pIo);                    // Waits for all pending reads
+
 
 #endif // __FILESTREAM_H__
@@ -555,13 +555,53 @@ PCASC_FILE_NODE CASC_FILE_TREE::FindById(DWORD FileDataId)
     return pFileNode;
 }
 
-bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName)
+void CASC_FILE_TREE::FindByNames(const char ** FileNames, size_t * NodeIndexes, size_t nNameCount)
+{
+    ULONGLONG FileNameHashes[CASC_NAME_BATCH_SIZE];
+    PCASC_FILE_NODE pFileNode;
+
+    for(size_t nStart = 0; nStart < nNameCount; nStart += CASC_NAME_BATCH_SIZE)
+    {
+        size_t nCount = CASCLIB_MIN(nNameCount - nStart, CASC_NAME_BATCH_SIZE);
+
+        // Hash the batch of names, then look up the nodes
+        CalcFileNameHashes(FileNames + nStart, FileNameHashes, nCount);
+        for(size_t i = 0; i < nCount; i++)
+        {
+            pFileNode = (PCASC_FILE_NODE)NameMap.FindObject(&FileNameHashes[i]);
+            NodeIndexes[nStart + i] = (pFileNode != NULL) ? NodeTable.IndexOf(pFileNode) : CASC_INVALID_SIZE_T;
+        }
+    }
+}
+
+size_t CASC_FILE_TREE::GetPathHashLengths(const char * szFileName, size_t nLength, size_t * HashLengths)
+{
+    size_t nHashCount = 0;
+
+    // Use the same lengths like SetNodeFileName does
+    for(size_t i = 0; i < nLength; i++)
+    {
+        BYTE Separator = PathSeparators[(BYTE)szFileName[i]];
+
+        if(Separator != 0)
+        {
+            HashLengths[nHashCount++] = (Separator == 0x02) ? (i + 1) : i;
+        }
+    }
+
+    // The last one is the full name
+    HashLengths[nHashCount++] = nLength;
+    return nHashCount;
+}
+
+bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName, const ULONGLONG * PathHashes)
 {
     ULONGLONG FileNameHash = 0;
     PCASC_FILE_NODE pFolderNode = NULL;
     CASC_PATH<char> PathBuffer;
     LPCSTR szNodeBegin = szFileName;
     size_t nFileNode = NodeTable.IndexOf(pFileNode);
+    size_t nHashIndex = 0;
     size_t i;
     DWORD Parent = 0;
 
@@ -575,19 +615,19 @@ bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szF
 
         // Is there a path separator, such as '\\' or '/'?
         // Also support TVFS "mount points", like "DivideAndConquer.w3m:war3map.doo"
-        if(PathSeparators[chOneChar])
+        if(PathSeparators[(BYTE)chOneChar])
         {
             size_t nHashLength = i;
 
             // If there is a reparse point mark (':'), we need to include it as part of the name
-            if(PathSeparators[chOneChar] == 0x02)
+            if(PathSeparators[(BYTE)chOneChar] == 0x02)
             {
                 PathBuffer.AppendChar(chOneChar);
                 nHashLength++;
             }
 
             // Calculate hash of the file name up to the end of the node name
-            FileNameHash = CalcNormNameHash(PathBuffer, nHashLength);
+            FileNameHash = (PathHashes != NULL) ? PathHashes[nHashIndex++] : CalcNormNameHash(PathBuffer, nHashLength);
 
             // If the entry is not there yet, create new one
             if((pFolderNode = Find(FileNameHash)) == NULL)
@@ -636,14 +676,15 @@ bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szF
             szNodeBegin = szFileName + i + 1;
 
             // If the separator character was already appended, skip the rest of the loop
-            if(PathSeparators[chOneChar] == 0x02)
+            if(PathSeparators[(BYTE)chOneChar] == 0x02)
             {
                 continue;
             }
         }
 
-        // Append the character, if not appended yet
-        PathBuffer.AppendChar(AsciiToUpperTable_BkSlash[chOneChar]);
+        // Append the character, if not appended yet. Not needed if we have the hashes already
+        if(PathHashes == NULL)
+            PathBuffer.AppendChar(AsciiToUpperTable_BkSlash[(BYTE)chOneChar]);
     }
 
     // If anything left, this is gonna be our node name
@@ -659,7 +700,7 @@ bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szF
         // Also insert the node to the hash table so CascOpenFile can find it
         if(pFileNode->FileNameHash == 0)
         {
-            pFileNode->FileNameHash = CalcNormNameHash(PathBuffer, i);
+            pFileNode->FileNameHash = (PathHashes != NULL) ? PathHashes[nHashIndex] : CalcNormNameHash(PathBuffer, i);
             InsertToNameMap(pFileNode);
         }
     }
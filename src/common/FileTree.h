@@ -62,8 +62,17 @@ class CASC_FILE_TREE
     PCASC_FILE_NODE Find(ULONGLONG FileNameHash);
     PCASC_FILE_NODE FindById(DWORD FileDataId);
 
-    // Assigns a file name to the node
-    bool SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName);
+    // Finds multiple files by their full paths. The names are hashed in batches. Gives node indexes
+    // (CASC_INVALID_SIZE_T if not found), because inserting new nodes may move the existing ones
+    void FindByNames(const char ** FileNames, size_t * NodeIndexes, size_t nNameCount);
+
+    // Assigns a file name to the node. If PathHashes is not NULL, it contains the precalculated
+    // name hashes of all lengths returned by GetPathHashLengths
+    bool SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName, const ULONGLONG * PathHashes = NULL);
+
+    // Retrieves the lengths of the normalized name that SetNodeFileName calculates hashes of;
+    // one for each folder on the path, followed by the full length. HashLengths must have (nLength + 1) items
+    static size_t GetPathHashLengths(const char * szFileName, size_t nLength, size_t * HashLengths);
 
     // Returns the number of items in the tree
     size_t GetMaxFileIndex();
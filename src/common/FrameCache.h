@@ -0,0 +1,264 @@
+/*****************************************************************************/
+/* FrameCache.h                      Copyright (c) CascLib contributors 2024 */
+/*---------------------------------------------------------------------------*/
+/* Storage-wide LRU cache of decoded file frames                             */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 15.10.24  1.00  ---  The first version of FrameCache.h                    */
+/*****************************************************************************/
+
+#ifndef __CASC_FRAME_CACHE_H__
+#define __CASC_FRAME_CACHE_H__
+
+//-----------------------------------------------------------------------------
+// Structures
+
+#define CASC_FRAME_CACHE_AVG_FRAME      0x00004000  // Expected average size of a frame. Used for sizing the hash table
+
+// One cached frame. The decoded frame data follow the structure
+typedef struct _CASC_FRAME_CACHE_ENTRY
+{
+    struct _CASC_FRAME_CACHE_ENTRY * pHashNext; // Next entry in the same hash bucket
+    struct _CASC_FRAME_CACHE_ENTRY * pPrev;     // Previous (more recently used) entry in the LRU list
+    struct _CASC_FRAME_CACHE_ENTRY * pNext;     // Next (less recently used) entry in the LRU list
+    BYTE EKey[MD5_HASH_SIZE];                   // EKey of the file span
+    DWORD FrameIndex;                           // Index of the frame within the file span
+    DWORD cbData;                               // Length of the decoded data
+    bool bVerified;                             // If true, the frame hash has been verified when the frame was decoded
+
+} CASC_FRAME_CACHE_ENTRY, *PCASC_FRAME_CACHE_ENTRY;
+
+//-----------------------------------------------------------------------------
+// Frame cache implementation
+
+class CASC_FRAME_CACHE
+{
+    public:
+
+    CASC_FRAME_CACHE()
+    {
+        CascInitLock(m_Lock);
+        m_HashTable = NULL;
+        m_HashTableSize = 0;
+        m_pFirst = m_pLast = NULL;
+        m_MaxSize = m_CurrentSize = 0;
+        m_Hits = m_Misses = m_Evictions = 0;
+        m_FrameCount = 0;
+    }
+
+    ~CASC_FRAME_CACHE()
+    {
+        Free();
+        CascFreeLock(m_Lock);
+    }
+
+    DWORD Create(size_t MaxSize)
+    {
+        size_t HashTableSize = MIN_HASH_TABLE_SIZE;
+
+        // The cache must not be created twice
+        assert(m_HashTable == NULL);
+
+        // Size the hash table for the expected number of frames
+        while(HashTableSize < (MaxSize / CASC_FRAME_CACHE_AVG_FRAME))
+            HashTableSize <<= 1;
+
+        // Allocate the hash table
+        if((m_HashTable = CASC_ALLOC_ZERO<PCASC_FRAME_CACHE_ENTRY>(HashTableSize)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        m_HashTableSize = HashTableSize;
+        m_MaxSize = MaxSize;
+        return ERROR_SUCCESS;
+    }
+
+    // Copies the decoded frame to the buffer, if it's in the cache
+    // If bNeedVerified is set, frames that were not verified are not accepted
+    bool LoadFrame(LPBYTE EKey, DWORD FrameIndex, LPBYTE pbBuffer, DWORD cbBuffer, bool bNeedVerified)
+    {
+        PCASC_FRAME_CACHE_ENTRY pEntry;
+        bool bResult = false;
+
+        if(m_HashTable != NULL)
+        {
+            CascLock(m_Lock);
+
+            pEntry = FindEntry(EKey, FrameIndex);
+            if(pEntry != NULL && pEntry->cbData == cbBuffer && (pEntry->bVerified || !bNeedVerified))
+            {
+                memcpy(pbBuffer, pEntry + 1, cbBuffer);
+                UnlinkEntry(pEntry);
+                LinkEntryFirst(pEntry);
+                bResult = true;
+                m_Hits++;
+            }
+            else
+            {
+                m_Misses++;
+            }
+
+            CascUnlock(m_Lock);
+        }
+        return bResult;
+    }
+
+    // Inserts a copy of the decoded frame to the cache. Evicts least recently used frames if needed.
+    // Frames bigger than 1/4 of the cache are not cached, so they don't flush the entire cache
+    void InsertFrame(LPBYTE EKey, DWORD FrameIndex, LPBYTE pbData, DWORD cbData, bool bVerified)
+    {
+        PCASC_FRAME_CACHE_ENTRY pEntry;
+
+        if(m_HashTable != NULL && cbData <= (m_MaxSize / 4))
+        {
+            // Prepare the new entry outside of the lock
+            if((pEntry = (PCASC_FRAME_CACHE_ENTRY)CASC_ALLOC<BYTE>(sizeof(CASC_FRAME_CACHE_ENTRY) + cbData)) == NULL)
+                return;
+            memcpy(pEntry->EKey, EKey, MD5_HASH_SIZE);
+            memcpy(pEntry + 1, pbData, cbData);
+            pEntry->FrameIndex = FrameIndex;
+            pEntry->cbData = cbData;
+            pEntry->bVerified = bVerified;
+
+            CascLock(m_Lock);
+
+            // If another thread has inserted the same frame in the meantime, replace it
+            RemoveEntry(FindEntry(EKey, FrameIndex));
+
+            // Make space for the new frame
+            while(m_pLast != NULL && (m_CurrentSize + cbData) > m_MaxSize)
+            {
+                RemoveEntry(m_pLast);
+                m_Evictions++;
+            }
+
+            // Insert the new entry to the hash table and to the head of the LRU list
+            pEntry->pHashNext = m_HashTable[HashToIndex(EKey, FrameIndex)];
+            m_HashTable[HashToIndex(EKey, FrameIndex)] = pEntry;
+            LinkEntryFirst(pEntry);
+            m_CurrentSize += cbData;
+            m_FrameCount++;
+
+            CascUnlock(m_Lock);
+        }
+    }
+
+    void GetInfo(PCASC_FRAME_CACHE_INFO pInfo)
+    {
+        CascLock(m_Lock);
+        pInfo->Hits = m_Hits;
+        pInfo->Misses = m_Misses;
+        pInfo->Evictions = m_Evictions;
+        pInfo->CurrentSize = m_CurrentSize;
+        pInfo->MaxSize = m_MaxSize;
+        pInfo->FrameCount = m_FrameCount;
+        CascUnlock(m_Lock);
+    }
+
+    bool IsEnabled()
+    {
+        return (m_HashTable != NULL);
+    }
+
+    void Free()
+    {
+        PCASC_FRAME_CACHE_ENTRY pNext;
+
+        // Free all cached frames
+        for(PCASC_FRAME_CACHE_ENTRY pEntry = m_pFirst; pEntry != NULL; pEntry = pNext)
+        {
+            pNext = pEntry->pNext;
+            CASC_FREE(pEntry);
+        }
+
+        // Free the hash table
+        CASC_FREE(m_HashTable);
+        m_HashTableSize = 0;
+        m_pFirst = m_pLast = NULL;
+        m_CurrentSize = 0;
+        m_FrameCount = 0;
+    }
+
+    protected:
+
+    size_t HashToIndex(LPBYTE EKey, DWORD FrameIndex)
+    {
+        // The EKey is a hash already, so we only mix in the frame index
+        return (ConvertBytesToInteger_4_LE(EKey) ^ (FrameIndex * 0x9E3779B1)) & (m_HashTableSize - 1);
+    }
+
+    PCASC_FRAME_CACHE_ENTRY FindEntry(LPBYTE EKey, DWORD FrameIndex)
+    {
+        PCASC_FRAME_CACHE_ENTRY pEntry;
+
+        for(pEntry = m_HashTable[HashToIndex(EKey, FrameIndex)]; pEntry != NULL; pEntry = pEntry->pHashNext)
+        {
+            if(pEntry->FrameIndex == FrameIndex && !memcmp(pEntry->EKey, EKey, MD5_HASH_SIZE))
+                return pEntry;
+        }
+        return NULL;
+    }
+
+    // Removes the entry from the hash table and from the LRU list, then frees it
+    void RemoveEntry(PCASC_FRAME_CACHE_ENTRY pEntry)
+    {
+        PCASC_FRAME_CACHE_ENTRY * ppEntry;
+
+        if(pEntry != NULL)
+        {
+            // Remove the entry from its hash bucket
+            for(ppEntry = &m_HashTable[HashToIndex(pEntry->EKey, pEntry->FrameIndex)]; ppEntry[0] != NULL; ppEntry = &ppEntry[0]->pHashNext)
+            {
+                if(ppEntry[0] == pEntry)
+                {
+                    ppEntry[0] = pEntry->pHashNext;
+                    break;
+                }
+            }
+
+            // Remove the entry from the LRU list
+            UnlinkEntry(pEntry);
+            m_CurrentSize -= pEntry->cbData;
+            m_FrameCount--;
+            CASC_FREE(pEntry);
+        }
+    }
+
+    void UnlinkEntry(PCASC_FRAME_CACHE_ENTRY pEntry)
+    {
+        if(pEntry->pPrev != NULL)
+            pEntry->pPrev->pNext = pEntry->pNext;
+        else
+            m_pFirst = pEntry->pNext;
+
+        if(pEntry->pNext != NULL)
+            pEntry->pNext->pPrev = pEntry->pPrev;
+        else
+            m_pLast = pEntry->pPrev;
+    }
+
+    void LinkEntryFirst(PCASC_FRAME_CACHE_ENTRY pEntry)
+    {
+        pEntry->pPrev = NULL;
+        pEntry->pNext = m_pFirst;
+        if(m_pFirst != NULL)
+            m_pFirst->pPrev = pEntry;
+        else
+            m_pLast = pEntry;
+        m_pFirst = pEntry;
+    }
+
+    CASC_LOCK m_Lock;                           // Lock for multi-threaded access
+    PCASC_FRAME_CACHE_ENTRY * m_HashTable;      // Hash table of (EKey, FrameIndex) -> cached frame
+    PCASC_FRAME_CACHE_ENTRY m_pFirst;           // Most recently used frame
+    PCASC_FRAME_CACHE_ENTRY m_pLast;            // Least recently used frame
+    size_t m_HashTableSize;                     // Size of the hash table, in entries. Always a power of two.
+    size_t m_MaxSize;                           // Maximum total size of the cached frames, in bytes
+    size_t m_CurrentSize;                       // Current total size of the cached frames, in bytes
+    size_t m_FrameCount;                        // Number of frames in the cache
+    ULONGLONG m_Hits;                           // Number of frames found in the cache
+    ULONGLONG m_Misses;                         // Number of frames not found in the cache
+    ULONGLONG m_Evictions;                      // Number of frames evicted from the cache
+};
+
+#endif // __CASC_FRAME_CACHE_H__
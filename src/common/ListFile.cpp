@@ -17,14 +17,20 @@
 
 #define LISTFILE_FLAG_USES_FILEDATAID   0x0001   // A new CSV format, containing FileDataId; FullFileName
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define LISTFILE_SCAN_SSE2
+#endif
+
 typedef struct _LISTFILE_CACHE
 {
     char * pBegin;                              // The begin of the listfile cache
     char * pPos;                                // Current position in the cache
     char * pEnd;                                // The last character in the file cache
+    TFileStream * pStream;                      // If not NULL, the cache points to the memory-mapped listfile
     DWORD Flags;
 
-    // Followed by the cache (variable length)
+    // Followed by the cache (variable length), unless the listfile is memory-mapped
 
 } LISTFILE_CACHE, *PLISTFILE_CACHE;
 
@@ -43,6 +49,7 @@ static PLISTFILE_CACHE ListFile_CreateCache(DWORD dwFileSize)
         pCache->pBegin =
         pCache->pPos   = (char *)(pCache + 1);
         pCache->pEnd   = pCache->pBegin + dwFileSize;
+        pCache->pStream = NULL;
         pCache->Flags  = 0;
     }
 
@@ -50,6 +57,44 @@ static PLISTFILE_CACHE ListFile_CreateCache(DWORD dwFileSize)
     return pCache;
 }
 
+// Creates the listfile cache that points to the memory-mapped listfile. This saves a copy of the entire listfile
+static PLISTFILE_CACHE ListFile_CreateMappedCache(LPCTSTR szListFile)
+{
+    PLISTFILE_CACHE pCache = NULL;
+    TFileStream * pStream;
+    ULONGLONG FileSize = 0;
+    LPBYTE pbFileData;
+
+    // Open the listfile as memory-mapped file
+    pStream = FileStream_OpenFile(szListFile, STREAM_FLAG_READ_ONLY | STREAM_PROVIDER_FLAT | BASE_PROVIDER_MAP);
+    if(pStream != NULL)
+    {
+        // Only take the listfile if the entire file is mapped
+        FileStream_GetSize(pStream, &FileSize);
+        if(0 < FileSize && FileSize <= 0x30000000)
+        {
+            if((pbFileData = FileStream_GetMappedData(pStream, 0, (DWORD)FileSize)) != NULL)
+            {
+                if((pCache = CASC_ALLOC<LISTFILE_CACHE>(1)) != NULL)
+                {
+                    // The mapped view is read-only. The listfile functions never write to the cache
+                    pCache->pBegin =
+                    pCache->pPos   = (char *)pbFileData;
+                    pCache->pEnd   = pCache->pBegin + (size_t)FileSize;
+                    pCache->pStream = pStream;
+                    pCache->Flags  = 0;
+                    return pCache;
+                }
+            }
+        }
+
+        // Close the file stream
+        FileStream_Close(pStream);
+    }
+
+    return NULL;
+}
+
 static char * ListFile_SkipSpaces(PLISTFILE_CACHE pCache)
 {
     // Skip newlines, spaces, tabs and another non-printable stuff
@@ -60,6 +105,42 @@ static char * ListFile_SkipSpaces(PLISTFILE_CACHE pCache)
     return pCache->pPos;
 }
 
+inline bool ListFile_IsSpecialChar(char chOneChar)
+{
+    // Note: the 0x85 char came from Overwatch build 24919
+    return (chOneChar == '\x0A' || chOneChar == '\x0D' || chOneChar == '\x85' || chOneChar == '~');
+}
+
+// Finds the first end-of-line character ('\x0A', '\x0D' or '\x85') or the first '~'.
+// Returns pointer to the found character or szEnd, if there is none
+static char * ListFile_FindSpecialChar(char * szPtr, char * szEnd)
+{
+#ifdef LISTFILE_SCAN_SSE2
+    __m128i CharLF = _mm_set1_epi8('\x0A');
+    __m128i CharCR = _mm_set1_epi8('\x0D');
+    __m128i Char85 = _mm_set1_epi8('\x85');
+    __m128i Tilde  = _mm_set1_epi8('~');
+
+    // Check 16 characters at once. Never read past the end of the listfile, it may be memory-mapped
+    while((szEnd - szPtr) >= 16)
+    {
+        __m128i Chars = _mm_loadu_si128((const __m128i *)szPtr);
+        __m128i Found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Chars, CharLF), _mm_cmpeq_epi8(Chars, CharCR)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(Chars, Char85), _mm_cmpeq_epi8(Chars, Tilde)));
+        DWORD dwMask = (DWORD)_mm_movemask_epi8(Found);
+
+        if(dwMask != 0)
+            return szPtr + CascLowestSetBit(dwMask);
+        szPtr += 16;
+    }
+#endif
+
+    // Check the rest one by one
+    while(szPtr < szEnd && !ListFile_IsSpecialChar(szPtr[0]))
+        szPtr++;
+    return szPtr;
+}
+
 static void ListFile_CheckFormat(PLISTFILE_CACHE pCache)
 {
     const size_t nSizeLimit = 0x20;
@@ -129,6 +210,13 @@ void * ListFile_OpenExternal(LPCTSTR szListFile)
     TFileStream * pStream;
     ULONGLONG FileSize = 0;
 
+    // Map the external listfile to memory, if possible
+    if((pCache = ListFile_CreateMappedCache(szListFile)) != NULL)
+    {
+        ListFile_CheckFormat(pCache);
+        return pCache;
+    }
+
     // Open the external listfile
     pStream = FileStream_OpenFile(szListFile, STREAM_FLAG_READ_ONLY);
     if(pStream != NULL)
@@ -196,25 +284,20 @@ size_t ListFile_GetNextLine(void * pvListFile, const char ** pszLineBegin, const
     // Remember the begin of the line
     szLineBegin = ListFile_SkipSpaces(pCache);
 
-    // Copy the remaining characters
-    while(pCache->pPos < pCache->pEnd)
+    // Find the end of the line
+    while((pCache->pPos = ListFile_FindSpecialChar(pCache->pPos, pCache->pEnd)) < pCache->pEnd)
     {
         // If we have found a newline, stop loading
-        // Note: the 0x85 char came from Overwatch build 24919
-        if(pCache->pPos[0] == '\x0A' || pCache->pPos[0] == '\x0D' || pCache->pPos[0] == '\x85')
+        if(pCache->pPos[0] != '~')
             break;
 
         // Blizzard listfiles can also contain information about patch:
         // Pass1\Files\MacOS\unconditional\user\Background Downloader.app\Contents\Info.plist~Patch(Data#frFR#base-frFR,1326)
-        if(pCache->pPos[0] == '~')
-            szExtraString = pCache->pPos;
-
-        // Move the position by one character forward
-        pCache->pPos++;
+        szExtraString = pCache->pPos++;
     }
 
-    // Remember the end of the line
-    szLineEnd = (szExtraString != NULL && szExtraString[0] == '~' && szExtraString[1] == 'P') ? szExtraString : pCache->pPos;
+    // Remember the end of the line. A '~' may be the last byte of a mapped listfile
+    szLineEnd = (szExtraString != NULL && (szExtraString + 1) < pCache->pEnd && szExtraString[1] == 'P') ? szExtraString : pCache->pPos;
 
     // Give the caller the positions of the begin and end of the line
     pszLineBegin[0] = szLineBegin;
@@ -298,6 +381,39 @@ size_t ListFile_GetNext(void * pvListFile, char * szBuffer, size_t nMaxChars, PD
     return nLength;
 }
 
+size_t ListFile_GetNext(void * pvListFile, const char ** pszLineBegin, const char ** pszLineEnd, PDWORD PtrFileDataId)
+{
+    PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
+    const char * szTemp;
+
+    // Same like the function above, but the line is not copied
+    for(;;)
+    {
+        DWORD FileDataId = CASC_INVALID_ID;
+
+        // If this is a CSV-format listfile, we need to extract the FileDataId
+        // Lines that contain bogus data, invalid numbers or too big values will be skipped
+        if(pCache->Flags & LISTFILE_FLAG_USES_FILEDATAID)
+        {
+            DWORD dwErrCode = ListFile_GetFileDataId(pCache, &FileDataId);
+
+            if(dwErrCode == ERROR_NO_MORE_FILES)
+                return 0;
+
+            // If there was an error, skip the current line
+            if(dwErrCode != ERROR_SUCCESS || FileDataId == CASC_INVALID_ID)
+            {
+                ListFile_GetNextLine(pvListFile, &szTemp, &szTemp);
+                continue;
+            }
+        }
+
+        // Give the file data id and the line to the caller
+        PtrFileDataId[0] = FileDataId;
+        return ListFile_GetNextLine(pvListFile, pszLineBegin, pszLineEnd);
+    }
+}
+
 LPBYTE ListFile_GetData(void * pvListFile, PDWORD PtrDataSize)
 {
     PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
@@ -317,3 +433,16 @@ LPBYTE ListFile_GetData(void * pvListFile, PDWORD PtrDataSize)
     return pbData;
 }
 
+void ListFile_Free(void * pvListFile)
+{
+    PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
+
+    if(pCache != NULL)
+    {
+        // Unmap the listfile, if it was memory-mapped
+        if(pCache->pStream != NULL)
+            FileStream_Close(pCache->pStream);
+        CASC_FREE(pCache);
+    }
+}
+
@@ -70,9 +70,91 @@ inline DWORD CalcHashValue_String(const char * szString, const char * szStringEn
     return dwHash;
 }
 
+//-----------------------------------------------------------------------------
+// Group probing helpers. For each slot, the map keeps one control byte, which is
+// either CASC_MAP_EMPTY or a 7-bit tag taken from the hash value. Control bytes
+// of 16 consecutive slots are compared at once, using SSE2 or NEON if available
+
+#define CASC_MAP_GROUP_SIZE     16              // Number of control bytes compared at once
+#define CASC_MAP_BATCH_SIZE     16              // Number of keys prefetched at once by FindObjects
+#define CASC_MAP_EMPTY          0x80            // Control byte of an empty slot
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CASC_MAP_SSE2
+#elif (defined(__aarch64__) && defined(__ARM_NEON)) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CASC_MAP_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Returns bit mask of the control bytes in the group that are equal to the value
+inline DWORD CascMatchGroup(const BYTE * pbGroup, BYTE Value)
+{
+#if defined(CASC_MAP_SSE2)
+    __m128i Group = _mm_loadu_si128((const __m128i *)pbGroup);
+    return (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(Group, _mm_set1_epi8((char)Value)));
+#elif defined(CASC_MAP_NEON)
+    static const BYTE BitValues[CASC_MAP_GROUP_SIZE] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    uint8x16_t Match = vandq_u8(vceqq_u8(vld1q_u8(pbGroup), vdupq_n_u8(Value)), vld1q_u8(BitValues));
+    return (DWORD)vaddv_u8(vget_low_u8(Match)) | ((DWORD)vaddv_u8(vget_high_u8(Match)) << 8);
+#else
+    DWORD dwMask = 0;
+
+    for(DWORD i = 0; i < CASC_MAP_GROUP_SIZE; i++)
+        dwMask |= (pbGroup[i] == Value) ? (1 << i) : 0;
+    return dwMask;
+#endif
+}
+
+// Returns the index of the lowest set bit. The value must not be zero
+inline DWORD CascLowestSetBit(DWORD dwValue)
+{
+#if defined(_MSC_VER)
+    unsigned long dwIndex = 0;
+
+    _BitScanForward(&dwIndex, dwValue);
+    return dwIndex;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (DWORD)__builtin_ctz(dwValue);
+#else
+    DWORD dwIndex = 0;
+
+    while((dwValue & 1) == 0)
+    {
+        dwValue >>= 1;
+        dwIndex++;
+    }
+    return dwIndex;
+#endif
+}
+
+// Hints the CPU to load the memory to the cache
+inline void CascPrefetch(const void * pvAddress)
+{
+#if defined(_MSC_VER) && defined(CASC_MAP_SSE2)
+    _mm_prefetch((const char *)pvAddress, _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(pvAddress);
+#else
+    CASCLIB_UNUSED(pvAddress);
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Map implementation
 
+// One slot of the hash table. The beginning of the key is stored in the slot
+// so that most mismatches are resolved without touching the object
+struct CASC_MAP_SLOT
+{
+    ULONGLONG KeyPrefix;                        // The first 8 bytes of the key. Zero for string maps
+    void * pvObject;                            // Pointer to the object. NULL if the slot is empty
+};
+
 class CASC_MAP
 {
     public:
@@ -81,6 +163,7 @@ class CASC_MAP
     {
         PfnCalcHashValue = NULL;
         m_HashTable = NULL;
+        m_CtrlBytes = NULL;
         m_HashTableSize = 0;
         m_ItemCount = 0;
         m_KeyOffset = 0;
@@ -127,35 +210,30 @@ class CASC_MAP
         if(m_HashTableSize == 0)
             return ERROR_NOT_ENOUGH_MEMORY;
 
-        // Allocate new map for the objects
-        m_HashTable = (void **)CASC_ALLOC_ZERO<void *>(m_HashTableSize);
-        return (m_HashTable != NULL) ? ERROR_SUCCESS : ERROR_NOT_ENOUGH_MEMORY;
+        // Allocate new map for the objects. The control bytes of the first group
+        // are repeated after the end, so that any group can be loaded at once
+        m_HashTable = CASC_ALLOC_ZERO<CASC_MAP_SLOT>(m_HashTableSize);
+        m_CtrlBytes = CASC_ALLOC<BYTE>(m_HashTableSize + CASC_MAP_GROUP_SIZE);
+        if(m_HashTable == NULL || m_CtrlBytes == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        memset(m_CtrlBytes, CASC_MAP_EMPTY, m_HashTableSize + CASC_MAP_GROUP_SIZE);
+        return ERROR_SUCCESS;
     }
 
     void * FindObject(void * pvKey, PDWORD PtrIndex = NULL)
     {
-        void * pvObject;
         DWORD dwHashIndex;
 
         // Verify pointer to the map
         if(m_HashTable != NULL)
         {
-            // Construct the hash index
-            dwHashIndex = HashToIndex(PfnCalcHashValue(pvKey, m_KeyLength));
-
             // Search the hash table
-            while((pvObject = m_HashTable[dwHashIndex]) != NULL)
+            if(FindSlot_Key(pvKey, PfnCalcHashValue(pvKey, m_KeyLength), dwHashIndex))
             {
-                // Compare the hash
-                if(CompareObject_Key(pvObject, pvKey))
-                {
-                    if(PtrIndex != NULL)
-                        PtrIndex[0] = dwHashIndex;
-                    return pvObject;
-                }
-
-                // Move to the next entry
-                dwHashIndex = HashToIndex(dwHashIndex + 1);
+                if(PtrIndex != NULL)
+                    PtrIndex[0] = dwHashIndex;
+                return m_HashTable[dwHashIndex].pvObject;
             }
         }
 
@@ -163,9 +241,46 @@ class CASC_MAP
         return NULL;
     }
 
+    // Searches multiple objects at once. The hash values of several keys are calculated first
+    // and their slots are prefetched, so the cache misses of the lookups overlap.
+    // Returns the number of found objects. Objects that were not found are set to NULL
+    size_t FindObjects(void ** PtrKeys, void ** PtrObjects, size_t nCount)
+    {
+        DWORD HashValues[CASC_MAP_BATCH_SIZE];
+        DWORD dwHashIndex;
+        size_t nFound = 0;
+
+        for(size_t nStart = 0; nStart < nCount; nStart += CASC_MAP_BATCH_SIZE)
+        {
+            size_t nBatchSize = CASCLIB_MIN(nCount - nStart, CASC_MAP_BATCH_SIZE);
+
+            // Calculate the hashes and prefetch the slots
+            for(size_t i = 0; i < nBatchSize && m_HashTable != NULL; i++)
+            {
+                HashValues[i] = PfnCalcHashValue(PtrKeys[nStart + i], m_KeyLength);
+                CascPrefetch(m_CtrlBytes + HashToIndex(HashValues[i]));
+                CascPrefetch(m_HashTable + HashToIndex(HashValues[i]));
+            }
+
+            // Perform the lookups
+            for(size_t i = 0; i < nBatchSize; i++)
+            {
+                PtrObjects[nStart + i] = NULL;
+
+                if(m_HashTable != NULL && FindSlot_Key(PtrKeys[nStart + i], HashValues[i], dwHashIndex))
+                {
+                    PtrObjects[nStart + i] = m_HashTable[dwHashIndex].pvObject;
+                    nFound++;
+                }
+            }
+        }
+
+        return nFound;
+    }
+
     bool InsertObject(void * pvNewObject, void * pvKey)
     {
-        void * pvExistingObject;
+        DWORD dwHashValue;
         DWORD dwHashIndex;
 
         // Verify pointer to the map
@@ -175,51 +290,88 @@ class CASC_MAP
             if((m_ItemCount + 1) >= m_HashTableSize)
                 return false;
 
+            // Check if hash being inserted conflicts with an existing hash
+            dwHashValue = PfnCalcHashValue(pvKey, m_KeyLength);
+            if(FindSlot_Key(pvKey, dwHashValue, dwHashIndex))
+                return false;
+
+            // Insert at the first free position
+            SetSlot(dwHashIndex, pvNewObject, dwHashValue, GetKeyPrefix(pvKey));
+            m_ItemCount++;
+            return true;
+        }
+
+        // Failed
+        return false;
+    }
+
+    // Inserts the object to the map. Can be called from multiple threads at once,
+    // but not together with any other function that modifies the map.
+    // If the key is already in the map, the object with lower address is kept,
+    // so the result is the same as if the objects were inserted in order of their addresses.
+    // Returns true if a new item was added. The caller must then call AddItemCount.
+    bool InsertObject_Concurrent(void * pvNewObject, void * pvKey)
+    {
+        void * pvExistingObject;
+        DWORD dwHashValue;
+        DWORD dwHashIndex;
+
+        // Verify pointer to the map
+        if(m_HashTable != NULL)
+        {
             // Construct the hash index
-            dwHashIndex = HashToIndex(PfnCalcHashValue(pvKey, m_KeyLength));
+            dwHashValue = PfnCalcHashValue(pvKey, m_KeyLength);
+            dwHashIndex = HashToIndex(dwHashValue);
 
-            // Search the hash table
-            while((pvExistingObject = m_HashTable[dwHashIndex]) != NULL)
+            // The control bytes are only written by the thread that took the slot,
+            // so the slots are probed one by one, using the object pointers
+            for(;;)
             {
-                // Check if hash being inserted conflicts with an existing hash
+                // Try to take a free slot
+                pvExistingObject = CascInterlockedCompareExchangePointer(&m_HashTable[dwHashIndex].pvObject, pvNewObject, NULL);
+                if(pvExistingObject == NULL)
+                {
+                    SetSlotKey(dwHashIndex, dwHashValue, GetKeyPrefix(pvKey));
+                    return true;
+                }
+
+                // If the slot has the same key, keep the object with lower address
                 if(CompareObject_Key(pvExistingObject, pvKey))
+                {
+                    while(pvNewObject < pvExistingObject)
+                    {
+                        void * pvOldObject = CascInterlockedCompareExchangePointer(&m_HashTable[dwHashIndex].pvObject, pvNewObject, pvExistingObject);
+                        if(pvOldObject == pvExistingObject)
+                            break;
+                        pvExistingObject = pvOldObject;
+                    }
                     return false;
+                }
 
                 // Move to the next entry
                 dwHashIndex = HashToIndex(dwHashIndex + 1);
             }
-
-            // Insert at that position
-            m_HashTable[dwHashIndex] = pvNewObject;
-            m_ItemCount++;
-            return true;
         }
 
         // Failed
         return false;
     }
 
+    void AddItemCount(size_t nItemCount)
+    {
+        m_ItemCount += nItemCount;
+    }
+
     const char * FindString(const char * szString, const char * szStringEnd)
     {
-        const char * szExistingString;
         DWORD dwHashIndex;
 
         // Verify pointer to the map
         if(m_HashTable != NULL)
         {
-            // Construct the main index
-            dwHashIndex = HashToIndex(CalcHashValue_String(szString, szStringEnd));
-
             // Search the hash table
-            while((szExistingString = (const char *)m_HashTable[dwHashIndex]) != NULL)
-            {
-                // Compare the hash
-                if(CompareObject_String(szExistingString, szString, szStringEnd))
-                    return szExistingString;
-
-                // Move to the next entry
-                dwHashIndex = HashToIndex(dwHashIndex + 1);
-            }
+            if(FindSlot_String(szString, szStringEnd, CalcHashValue_String(szString, szStringEnd), dwHashIndex))
+                return (const char *)m_HashTable[dwHashIndex].pvObject;
         }
 
         // Not found, sorry
@@ -228,8 +380,8 @@ class CASC_MAP
 
     bool InsertString(const char * szString, bool bCutExtension)
     {
-        const char * szExistingString;
         const char * szStringEnd = NULL;
+        DWORD dwHashValue;
         DWORD dwHashIndex;
 
         // Verify pointer to the map
@@ -245,22 +397,13 @@ class CASC_MAP
             else
                 szStringEnd = szString + strlen(szString);
 
-            // Construct the hash index
-            dwHashIndex = HashToIndex(CalcHashValue_String(szString, szStringEnd));
-
-            // Search the hash table
-            while((szExistingString = (const char *)m_HashTable[dwHashIndex]) != NULL)
-            {
-                // Check if hash being inserted conflicts with an existing hash
-                if(CompareObject_String(szExistingString, szString, szStringEnd))
-                    return false;
-
-                // Move to the next entry
-                dwHashIndex = HashToIndex(dwHashIndex + 1);
-            }
+            // Check if hash being inserted conflicts with an existing hash
+            dwHashValue = CalcHashValue_String(szString, szStringEnd);
+            if(FindSlot_String(szString, szStringEnd, dwHashValue, dwHashIndex))
+                return false;
 
-            // Insert at that position
-            m_HashTable[dwHashIndex] = (void *)szString;
+            // Insert at the first free position
+            SetSlot(dwHashIndex, (void *)szString, dwHashValue, 0);
             m_ItemCount++;
             return true;
         }
@@ -272,7 +415,25 @@ class CASC_MAP
     void * ItemAt(size_t nIndex)
     {
         assert(nIndex < m_HashTableSize);
-        return m_HashTable[nIndex];
+        return m_HashTable[nIndex].pvObject;
+    }
+
+    // Restores an item of a map that has been saved using ItemAt.
+    // The map must have the same hash table size as the saved one.
+    void SetItemAt(size_t nIndex, void * pvObject)
+    {
+        void * pvKey;
+
+        assert(nIndex < m_HashTableSize);
+        assert(m_HashTable[nIndex].pvObject == NULL);
+        assert(PfnCalcHashValue != NULL);
+
+        if(pvObject != NULL)
+        {
+            pvKey = (LPBYTE)pvObject + m_KeyOffset;
+            SetSlot((DWORD)nIndex, pvObject, PfnCalcHashValue(pvKey, m_KeyLength), GetKeyPrefix(pvKey));
+            m_ItemCount++;
+        }
     }
 
     size_t HashTableSize()
@@ -290,10 +451,21 @@ class CASC_MAP
         return (m_HashTable && m_HashTableSize);
     }
 
+    // Removes all items, but keeps the hash table allocated
+    void Reset()
+    {
+        if(m_HashTable != NULL)
+            memset(m_HashTable, 0, m_HashTableSize * sizeof(CASC_MAP_SLOT));
+        if(m_CtrlBytes != NULL)
+            memset(m_CtrlBytes, CASC_MAP_EMPTY, m_HashTableSize + CASC_MAP_GROUP_SIZE);
+        m_ItemCount = 0;
+    }
+
     void Free()
     {
         PfnCalcHashValue = NULL;
         CASC_FREE(m_HashTable);
+        CASC_FREE(m_CtrlBytes);
         m_HashTableSize = 0;
     }
 
@@ -304,6 +476,119 @@ class CASC_MAP
         return HashValue & (m_HashTableSize - 1);
     }
 
+    // The tag is taken from the upper bits of the hash, as the lower bits are used for the index
+    BYTE HashToTag(DWORD HashValue)
+    {
+        return (BYTE)(HashValue >> 25);
+    }
+
+    ULONGLONG GetKeyPrefix(const void * pvKey)
+    {
+        ULONGLONG KeyPrefix;
+
+        memcpy(&KeyPrefix, pvKey, sizeof(ULONGLONG));
+        return KeyPrefix;
+    }
+
+    // Searches the slot with the given key. If found, returns true and the index of the slot.
+    // If not found, returns false and the index of the first free slot where the key would be inserted.
+    // The slots are probed in the same order as with plain linear probing, just 16 slots at once
+    bool FindSlot_Key(void * pvKey, DWORD dwHashValue, DWORD & dwSlotIndex)
+    {
+        ULONGLONG KeyPrefix = GetKeyPrefix(pvKey);
+        DWORD dwHashIndex = HashToIndex(dwHashValue);
+        DWORD dwMatch;
+        DWORD dwEmpty;
+
+        // The slot is likely to be checked, so let its load overlap with the load of the control bytes
+        CascPrefetch(m_HashTable + dwHashIndex);
+
+        for(;;)
+        {
+            // Only the slots before the first empty slot are relevant
+            dwMatch = CascMatchGroup(m_CtrlBytes + dwHashIndex, HashToTag(dwHashValue));
+            dwEmpty = CascMatchGroup(m_CtrlBytes + dwHashIndex, CASC_MAP_EMPTY);
+            dwMatch &= (dwEmpty & (0 - dwEmpty)) - 1;
+
+            // Check all slots with matching tag
+            while(dwMatch != 0)
+            {
+                dwSlotIndex = HashToIndex(dwHashIndex + CascLowestSetBit(dwMatch));
+
+                // The whole key is compared only if it's longer than the prefix
+                if(m_HashTable[dwSlotIndex].KeyPrefix == KeyPrefix)
+                {
+                    if(m_KeyLength == sizeof(ULONGLONG) || CompareObject_Key(m_HashTable[dwSlotIndex].pvObject, pvKey))
+                        return true;
+                }
+                dwMatch &= (dwMatch - 1);
+            }
+
+            // Reached the end of the chain?
+            if(dwEmpty != 0)
+            {
+                dwSlotIndex = HashToIndex(dwHashIndex + CascLowestSetBit(dwEmpty));
+                return false;
+            }
+
+            // Move to the next group
+            dwHashIndex = HashToIndex(dwHashIndex + CASC_MAP_GROUP_SIZE);
+        }
+    }
+
+    bool FindSlot_String(const char * szString, const char * szStringEnd, DWORD dwHashValue, DWORD & dwSlotIndex)
+    {
+        DWORD dwHashIndex = HashToIndex(dwHashValue);
+        DWORD dwMatch;
+        DWORD dwEmpty;
+
+        for(;;)
+        {
+            // Only the slots before the first empty slot are relevant
+            dwMatch = CascMatchGroup(m_CtrlBytes + dwHashIndex, HashToTag(dwHashValue));
+            dwEmpty = CascMatchGroup(m_CtrlBytes + dwHashIndex, CASC_MAP_EMPTY);
+            dwMatch &= (dwEmpty & (0 - dwEmpty)) - 1;
+
+            // Check all slots with matching tag
+            while(dwMatch != 0)
+            {
+                dwSlotIndex = HashToIndex(dwHashIndex + CascLowestSetBit(dwMatch));
+                if(CompareObject_String((const char *)m_HashTable[dwSlotIndex].pvObject, szString, szStringEnd))
+                    return true;
+                dwMatch &= (dwMatch - 1);
+            }
+
+            // Reached the end of the chain?
+            if(dwEmpty != 0)
+            {
+                dwSlotIndex = HashToIndex(dwHashIndex + CascLowestSetBit(dwEmpty));
+                return false;
+            }
+
+            // Move to the next group
+            dwHashIndex = HashToIndex(dwHashIndex + CASC_MAP_GROUP_SIZE);
+        }
+    }
+
+    void SetSlot(DWORD dwSlotIndex, void * pvObject, DWORD dwHashValue, ULONGLONG KeyPrefix)
+    {
+        m_HashTable[dwSlotIndex].pvObject = pvObject;
+        SetSlotKey(dwSlotIndex, dwHashValue, KeyPrefix);
+    }
+
+    // Sets the key prefix and the control byte of an occupied slot
+    void SetSlotKey(DWORD dwSlotIndex, DWORD dwHashValue, ULONGLONG KeyPrefix)
+    {
+        BYTE Tag = HashToTag(dwHashValue);
+
+        m_HashTable[dwSlotIndex].KeyPrefix = KeyPrefix;
+        m_CtrlBytes[dwSlotIndex] = Tag;
+
+        // Keep the copy of the first group's control bytes up to date
+        if(dwSlotIndex < CASC_MAP_GROUP_SIZE)
+            m_CtrlBytes[m_HashTableSize + dwSlotIndex] = Tag;
+    }
+
     bool CompareObject_Key(void * pvObject, void * pvKey)
     {
         LPBYTE pbObjectKey = (LPBYTE)pvObject + m_KeyOffset;
@@ -346,7 +631,8 @@ class CASC_MAP
     }
 
     PFNHASHFUNC PfnCalcHashValue;
-    void ** m_HashTable;                        // Hash table
+    CASC_MAP_SLOT * m_HashTable;                // Hash table
+    LPBYTE m_CtrlBytes;                         // Control bytes (tags) of the hash table slots. Has CASC_MAP_GROUP_SIZE extra items.
     size_t m_HashTableSize;                     // Size of the hash table, in entries. Always a power of two.
     size_t m_ItemCount;                         // Number of objects in the map
     size_t m_KeyOffset;                         // How far is the hash from the begin of the objects (in bytes)
@@ -37,6 +37,19 @@ static size_t DecodeValueInt32(const char * string, const char * string_end)
     return result;
 }
 
+static ULONGLONG DecodeValueInt64(const char * string, const char * string_end)
+{
+    ULONGLONG result = 0;
+
+    while(string < string_end && isdigit(string[0]))
+    {
+        result = (result * 10) + (string[0] - '0');
+        string++;
+    }
+
+    return result;
+}
+
 static const char * GetContentLengthValue(const char * response, const char * end)
 {
     const char * ptr;
@@ -48,6 +61,18 @@ static const char * GetContentLengthValue(const char * response, const char * en
     return NULL;
 }
 
+// Example: "Content-Range: bytes 16384-32767/10485760"
+static const char * GetContentRangeValue(const char * response, const char * end)
+{
+    const char * ptr;
+
+    if((ptr = strstr(response, "Content-Range: bytes ")) != NULL && ptr < end)
+        return ptr;
+    if((ptr = strstr(response, "content-range: bytes ")) != NULL && ptr < end)
+        return ptr;
+    return NULL;
+}
+
 bool CASC_MIME_RESPONSE::ParseResponse(const char * response, size_t length, bool final)
 {
     const char * ptr;
@@ -73,7 +98,8 @@ bool CASC_MIME_RESPONSE::ParseResponse(const char * response, size_t length, boo
         {
             const char * http_ptr = (response + header_offset);
 
-            if(!_strnicmp(http_ptr, "HTTP/1.1 ", 9))
+            // Accept both "HTTP/1.1" and "HTTP/1.0"
+            if(!_strnicmp(http_ptr, "HTTP/1.", 7) && http_ptr[8] == ' ')
             {
                 http_presence = FieldPresencePresent;
                 http_code = DecodeValueInt32(response + 9, response + 13);
@@ -100,6 +126,29 @@ bool CASC_MIME_RESPONSE::ParseResponse(const char * response, size_t length, boo
             }
         }
 
+        // Determine the presence of content range. The total size may be "*" if not known
+        if(crange_presence == FieldPresenceUnknown && header_length != CASC_INVALID_SIZE_T)
+        {
+            const char * crange_ptr = GetContentRangeValue(response + header_offset, response + header_length);
+            const char * header_end = response + header_length;
+
+            if(crange_ptr != NULL)
+            {
+                range_offset = DecodeValueInt64(crange_ptr + 21, header_end);
+                crange_presence = FieldPresencePresent;
+
+                // Skip the end of the range and the slash
+                while(crange_ptr < header_end && crange_ptr[0] != '/' && crange_ptr[0] != '\r')
+                    crange_ptr++;
+                if(crange_ptr < header_end && crange_ptr[0] == '/' && isdigit(crange_ptr[1]))
+                    range_total = DecodeValueInt64(crange_ptr + 1, header_end);
+            }
+            else
+            {
+                crange_presence = FieldPresenceNotPresent;
+            }
+        }
+
         // Update the length
         response_length = length;
     }
@@ -654,8 +703,9 @@ DWORD CASC_MIME::Load(char * data, CASC_MIME_RESPONSE & MimeResponse)
     // Special handling of HTTP responses
     if(MimeResponse.http_presence == FieldPresencePresent)
     {
-        // Avoid parsing of failed HTTP requests
-        if(MimeResponse.http_code != 200)
+        // Avoid parsing of failed HTTP requests.
+        // Note that "206 Partial Content" is a response to a range request
+        if(MimeResponse.http_code != 200 && MimeResponse.http_code != 206)
             return ERROR_FILE_NOT_FOUND;
 
         // Directly setup the root item
@@ -45,7 +45,8 @@ struct CASC_MIME_RESPONSE
         header_offset = header_length = CASC_INVALID_SIZE_T;
         content_offset = content_length = CASC_INVALID_SIZE_T;
         http_code = CASC_INVALID_SIZE_T;
-        clength_presence = http_presence = FieldPresenceUnknown;
+        clength_presence = http_presence = crange_presence = FieldPresenceUnknown;
+        range_offset = range_total = CASC_INVALID_SIZE64;
         response_length = 0;
     }
 
@@ -57,7 +58,10 @@ struct CASC_MIME_RESPONSE
     size_t content_offset;              // Offset of the content
     size_t content_length;              // Length of the content, if known
     size_t http_code;                   // HTTP code, if present
+    ULONGLONG range_offset;             // Offset of the first byte of a partial response ("206 Partial Content")
+    ULONGLONG range_total;              // Total size of the remote file, if sent in "Content-Range"
     CASC_PRESENCE clength_presence;     // State of the "content length" field
+    CASC_PRESENCE crange_presence;      // State of the "content range" field
     CASC_PRESENCE http_presence;        // Presence of the "HTTP" field
 };
 
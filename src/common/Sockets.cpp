@@ -21,6 +21,7 @@
 // Local variables
 
 #define BUFFER_INITIAL_SIZE 0x8000
+#define BUFFER_STREAM_SIZE  0x10000
 
 #ifndef INVALID_SOCKET
 #define INVALID_SOCKET (SOCKET)(-1)             // Not defined in Linux
@@ -161,6 +162,158 @@ char * CASC_SOCKET::ReadResponse(const char * request, size_t request_length, CA
     return server_response;
 }
 
+// Sends the request and receives the response until the complete header is in the buffer.
+// If the server has closed the keep-alive connection in the meantime, reconnects and tries once more
+DWORD CASC_SOCKET::SendRequestReceiveHeader(const char * request, size_t request_length, char * buffer, size_t buffer_length, CASC_MIME_RESPONSE & MimeResponse, size_t & total_received)
+{
+    DWORD dwErrCode = ERROR_NETWORK_NOT_AVAILABLE;
+    int bytes_received;
+
+    for(DWORD dwAttempt = 0; dwAttempt < 2; dwAttempt++)
+    {
+        // Reset the response
+        MimeResponse = CASC_MIME_RESPONSE();
+        total_received = 0;
+
+        // Reconnect, if this is a retry or if the previous response has closed the connection
+        if(dwAttempt > 0 || sock == SocketToHandle(INVALID_SOCKET))
+        {
+            if(sock != SocketToHandle(INVALID_SOCKET))
+                closesocket(HandleToSocket(sock));
+            if((sock = CreateAndConnect(remoteItem)) == SocketToHandle(INVALID_SOCKET))
+                break;
+        }
+
+        // Send the request to the remote host
+        if(send(HandleToSocket(sock), request, (int)request_length, MSG_NOSIGNAL) == SOCKET_ERROR)
+            continue;
+
+        // Receive the data until we have the entire header
+        while(total_received < buffer_length)
+        {
+            // Return value 0 means "connection closed", -1 means an error
+            bytes_received = recv(HandleToSocket(sock), buffer + total_received, (int)(buffer_length - total_received), 0);
+            if(bytes_received <= 0)
+                break;
+
+            // Append the number of bytes received. Also terminate response with zero
+            total_received += bytes_received;
+            buffer[total_received] = 0;
+
+            // Parse the MIME response. We only need the header
+            MimeResponse.ParseResponse(buffer, total_received, false);
+            if(MimeResponse.header_length != CASC_INVALID_SIZE_T)
+                return (MimeResponse.http_presence == FieldPresencePresent) ? ERROR_SUCCESS : ERROR_BAD_FORMAT;
+        }
+
+        // Header larger than the buffer
+        if(total_received == buffer_length)
+            return ERROR_BAD_FORMAT;
+
+        // Only retry if the server has closed the connection without sending anything
+        if(total_received != 0)
+            break;
+    }
+
+    return dwErrCode;
+}
+
+// Sends the request and writes the content of the HTTP response to the stream.
+// Unlike ReadResponse, the response is never loaded into memory as a whole.
+// The connection is kept open for the next request, unless the server has closed it
+DWORD CASC_SOCKET::ReadResponseToStream(const char * request, size_t request_length, TFileStream * pStream)
+{
+    CASC_MIME_RESPONSE MimeResponse;
+    ULONGLONG BytesRemaining = CASC_INVALID_SIZE64;
+    size_t total_received = 0;
+    size_t chunk_offset = 0;
+    size_t chunk_length;
+    char * buffer;
+    DWORD dwErrCode;
+    bool bKeepConnection = false;
+    int bytes_received;
+
+    // Pre-set the result length
+    if(request_length == 0)
+        request_length = strlen(request);
+
+    // Allocate buffer for receiving the data
+    if((buffer = CASC_ALLOC<char>(BUFFER_STREAM_SIZE + 1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Lock the socket
+    CascLock(Lock);
+
+    // Send the request and receive the header
+    dwErrCode = SendRequestReceiveHeader(request, request_length, buffer, BUFFER_STREAM_SIZE, MimeResponse, total_received);
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        // If the server didn't send the content length, the content ends when the connection is closed
+        if(MimeResponse.clength_presence == FieldPresencePresent)
+            BytesRemaining = MimeResponse.content_length;
+        chunk_offset = MimeResponse.content_offset;
+
+        // Failed responses are received as well, so that the connection remains usable
+        if(MimeResponse.http_code != 200)
+            dwErrCode = ERROR_FILE_NOT_FOUND;
+
+        // Process the content, starting with the part that came together with the header
+        for(;;)
+        {
+            chunk_length = total_received - chunk_offset;
+            if(chunk_length > BytesRemaining)
+                chunk_length = (size_t)BytesRemaining;
+
+            // Write the chunk to the stream
+            if(chunk_length != 0 && dwErrCode == ERROR_SUCCESS)
+            {
+                if(!FileStream_Write(pStream, NULL, buffer + chunk_offset, (DWORD)chunk_length))
+                {
+                    dwErrCode = GetCascError();
+                    break;
+                }
+            }
+
+            // Are we finished?
+            if(BytesRemaining != CASC_INVALID_SIZE64)
+            {
+                BytesRemaining -= chunk_length;
+                if(BytesRemaining == 0)
+                {
+                    bKeepConnection = true;
+                    break;
+                }
+            }
+
+            // Receive the next part of the content
+            chunk_length = (size_t)CASCLIB_MIN(BytesRemaining, BUFFER_STREAM_SIZE);
+            bytes_received = recv(HandleToSocket(sock), buffer, (int)chunk_length, 0);
+            if(bytes_received <= 0)
+            {
+                // Without content length, closed connection is the end of the data
+                if(BytesRemaining != CASC_INVALID_SIZE64 && dwErrCode == ERROR_SUCCESS)
+                    dwErrCode = ERROR_NETWORK_NOT_AVAILABLE;
+                break;
+            }
+
+            total_received = bytes_received;
+            chunk_offset = 0;
+        }
+    }
+
+    // If the connection is in an unknown state, close it. It will be reopened by the next request
+    if(bKeepConnection == false && sock != SocketToHandle(INVALID_SOCKET))
+    {
+        closesocket(HandleToSocket(sock));
+        sock = SocketToHandle(INVALID_SOCKET);
+    }
+
+    // Unlock the socket
+    CascUnlock(Lock);
+    CASC_FREE(buffer);
+    return dwErrCode;
+}
+
 DWORD CASC_SOCKET::AddRef()
 {
     return CascInterlockedIncrement(&dwRefCount);
@@ -366,6 +519,30 @@ CASC_SOCKET_CACHE::~CASC_SOCKET_CACHE()
     PurgeAll();
 }
 
+// Returns a connected socket from the cache. If there is none, connects a new one
+PCASC_SOCKET CASC_SOCKET_CACHE::Connect(const char * hostName, unsigned portNum)
+{
+    PCASC_SOCKET pSocket;
+
+    // Try to find the item in the cache
+    if((pSocket = Find(hostName, portNum)) != NULL)
+    {
+        pSocket->AddRef();
+    }
+    else
+    {
+        // Create new socket and connect it to the remote host
+        pSocket = CASC_SOCKET::Connect(hostName, portNum);
+
+        // Insert it to the cache, if it's a HTTP connection.
+        // Ribbit servers close the connection after each response
+        if(pSocket != NULL && pSocket->portNum != CASC_PORT_RIBBIT)
+            pSocket = InsertSocket(pSocket);
+    }
+
+    return pSocket;
+}
+
 PCASC_SOCKET CASC_SOCKET_CACHE::Find(const char * hostName, unsigned portNum)
 {
     PCASC_SOCKET pSocket;
@@ -481,24 +658,7 @@ void CASC_SOCKET_CACHE::PurgeAll()
 
 PCASC_SOCKET sockets_connect(const char * hostName, unsigned portNum)
 {
-    PCASC_SOCKET pSocket;
-
-    // Try to find the item in the cache
-    if((pSocket = SocketCache.Find(hostName, portNum)) != NULL)
-    {
-        pSocket->AddRef();
-    }
-    else
-    {
-        // Create new socket and connect it to the remote host
-        pSocket = CASC_SOCKET::Connect(hostName, portNum);
-
-        // Insert it to the cache, if it's a HTTP connection
-        if(pSocket != NULL && pSocket->portNum == CASC_PORT_HTTP)
-            pSocket = SocketCache.InsertSocket(pSocket);
-    }
-
-    return pSocket;
+    return SocketCache.Connect(hostName, portNum);
 }
 
 void sockets_set_caching(bool caching)
@@ -45,6 +45,7 @@ class CASC_SOCKET
     public:
 
     char * ReadResponse(const char * request, size_t request_length, CASC_MIME_RESPONSE & MimeResponse);
+    DWORD ReadResponseToStream(const char * request, size_t request_length, struct TFileStream * pStream);
     DWORD AddRef();
     void Release();
 
@@ -58,6 +59,9 @@ class CASC_SOCKET
     static PCASC_SOCKET New(PADDRINFO remoteList, PADDRINFO remoteItem, const char * hostName, unsigned portNum, HANDLE sock);
     static PCASC_SOCKET Connect(const char * hostName, unsigned portNum);
 
+    // Sends the request and receives the complete response header
+    DWORD SendRequestReceiveHeader(const char * request, size_t request_length, char * buffer, size_t buffer_length, CASC_MIME_RESPONSE & MimeResponse, size_t & total_received);
+
     // Frees all resources and deletes the socket
     void Delete();
 
@@ -88,6 +92,7 @@ class CASC_SOCKET_CACHE
     CASC_SOCKET_CACHE();
     ~CASC_SOCKET_CACHE();
 
+    PCASC_SOCKET Connect(const char * hostName, unsigned portNum);
     PCASC_SOCKET Find(const char * hostName, unsigned portNum);
     PCASC_SOCKET InsertSocket(PCASC_SOCKET pSocket);
     void UnlinkSocket(PCASC_SOCKET pSocket);
@@ -0,0 +1,437 @@
+/*****************************************************************************/
+/* md5_mb.cpp                        Copyright (c) CascLib contributors 2024 */
+/*---------------------------------------------------------------------------*/
+/* Multi-buffer MD5: Hashes 4, 8 or 16 independent data blocks at once,      */
+/* each one in its own lane of SSE2, AVX2 or AVX-512 vector                  */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.24  1.00  ---  The first version of md5_mb.cpp                      */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Instruction sets. SSE2 is used if the compiler targets it, AVX2 and AVX-512
+// are compiled for x64 and used if the CPU supports them. On other platforms,
+// the blocks are hashed one-by-one by the scalar MD5
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CASC_MD5_SSE2
+#endif
+
+#if defined(CASC_CAN_USE_AVX2) || defined(CASC_CAN_USE_AVX512)
+#include <immintrin.h>
+#endif
+
+#define MD5_MAX_LANES           16              // Lanes of AVX-512 vector
+#define MD5_CHUNK_SIZE          0x40            // MD5 processes the data in 64-byte chunks
+#define MD5_LANE_FREE           ((size_t)-1)    // Block index of a free lane
+
+//-----------------------------------------------------------------------------
+// The MD5 compression function for any vector type. The functions, the order
+// of the steps and the constants are the same as in md5.cpp. Each function
+// defines MD5_VECTOR and the operations MD5_ADD, MD5_AND, MD5_OR, MD5_XOR,
+// MD5_NOT, MD5_ROL, MD5_SET1, MD5_LOAD and MD5_STORE before using it
+
+#define MD5_F(x, y, z)          MD5_XOR(z, MD5_AND(x, MD5_XOR(y, z)))
+#define MD5_G(x, y, z)          MD5_XOR(y, MD5_AND(z, MD5_XOR(x, y)))
+#define MD5_H(x, y, z)          MD5_XOR(MD5_XOR(x, y), z)
+#define MD5_I(x, y, z)          MD5_XOR(y, MD5_OR(x, MD5_NOT(z)))
+
+#define MD5_STEP(f, a, b, c, d, n, t, s) \
+    a = MD5_ADD(a, MD5_ADD(f(b, c, d), MD5_ADD(W[n], MD5_SET1(t)))); \
+    a = MD5_ADD(MD5_ROL(a, s), b)
+
+// State holds words a, b, c, d of all lanes, Words holds 16 words of the chunk of all lanes.
+// Both are stored word-by-word, e.g. State[1 * LANES + 2] is the word b of lane 2
+#define MD5_COMPRESS(State, Words, LANES)                   \
+{                                                           \
+    MD5_VECTOR W[0x10];                                     \
+    MD5_VECTOR a = MD5_LOAD(State + 0 * LANES);             \
+    MD5_VECTOR b = MD5_LOAD(State + 1 * LANES);             \
+    MD5_VECTOR c = MD5_LOAD(State + 2 * LANES);             \
+    MD5_VECTOR d = MD5_LOAD(State + 3 * LANES);             \
+                                                            \
+    for(DWORD i = 0; i < 0x10; i++)                         \
+        W[i] = MD5_LOAD(Words + i * LANES);                 \
+                                                            \
+    MD5_STEP(MD5_F, a, b, c, d,  0, 0xd76aa478,  7); \
+    MD5_STEP(MD5_F, d, a, b, c,  1, 0xe8c7b756, 12); \
+    MD5_STEP(MD5_F, c, d, a, b,  2, 0x242070db, 17); \
+    MD5_STEP(MD5_F, b, c, d, a,  3, 0xc1bdceee, 22); \
+    MD5_STEP(MD5_F, a, b, c, d,  4, 0xf57c0faf,  7); \
+    MD5_STEP(MD5_F, d, a, b, c,  5, 0x4787c62a, 12); \
+    MD5_STEP(MD5_F, c, d, a, b,  6, 0xa8304613, 17); \
+    MD5_STEP(MD5_F, b, c, d, a,  7, 0xfd469501, 22); \
+    MD5_STEP(MD5_F, a, b, c, d,  8, 0x698098d8,  7); \
+    MD5_STEP(MD5_F, d, a, b, c,  9, 0x8b44f7af, 12); \
+    MD5_STEP(MD5_F, c, d, a, b, 10, 0xffff5bb1, 17); \
+    MD5_STEP(MD5_F, b, c, d, a, 11, 0x895cd7be, 22); \
+    MD5_STEP(MD5_F, a, b, c, d, 12, 0x6b901122,  7); \
+    MD5_STEP(MD5_F, d, a, b, c, 13, 0xfd987193, 12); \
+    MD5_STEP(MD5_F, c, d, a, b, 14, 0xa679438e, 17); \
+    MD5_STEP(MD5_F, b, c, d, a, 15, 0x49b40821, 22); \
+    MD5_STEP(MD5_G, a, b, c, d,  1, 0xf61e2562,  5); \
+    MD5_STEP(MD5_G, d, a, b, c,  6, 0xc040b340,  9); \
+    MD5_STEP(MD5_G, c, d, a, b, 11, 0x265e5a51, 14); \
+    MD5_STEP(MD5_G, b, c, d, a,  0, 0xe9b6c7aa, 20); \
+    MD5_STEP(MD5_G, a, b, c, d,  5, 0xd62f105d,  5); \
+    MD5_STEP(MD5_G, d, a, b, c, 10, 0x02441453,  9); \
+    MD5_STEP(MD5_G, c, d, a, b, 15, 0xd8a1e681, 14); \
+    MD5_STEP(MD5_G, b, c, d, a,  4, 0xe7d3fbc8, 20); \
+    MD5_STEP(MD5_G, a, b, c, d,  9, 0x21e1cde6,  5); \
+    MD5_STEP(MD5_G, d, a, b, c, 14, 0xc33707d6,  9); \
+    MD5_STEP(MD5_G, c, d, a, b,  3, 0xf4d50d87, 14); \
+    MD5_STEP(MD5_G, b, c, d, a,  8, 0x455a14ed, 20); \
+    MD5_STEP(MD5_G, a, b, c, d, 13, 0xa9e3e905,  5); \
+    MD5_STEP(MD5_G, d, a, b, c,  2, 0xfcefa3f8,  9); \
+    MD5_STEP(MD5_G, c, d, a, b,  7, 0x676f02d9, 14); \
+    MD5_STEP(MD5_G, b, c, d, a, 12, 0x8d2a4c8a, 20); \
+    MD5_STEP(MD5_H, a, b, c, d,  5, 0xfffa3942,  4); \
+    MD5_STEP(MD5_H, d, a, b, c,  8, 0x8771f681, 11); \
+    MD5_STEP(MD5_H, c, d, a, b, 11, 0x6d9d6122, 16); \
+    MD5_STEP(MD5_H, b, c, d, a, 14, 0xfde5380c, 23); \
+    MD5_STEP(MD5_H, a, b, c, d,  1, 0xa4beea44,  4); \
+    MD5_STEP(MD5_H, d, a, b, c,  4, 0x4bdecfa9, 11); \
+    MD5_STEP(MD5_H, c, d, a, b,  7, 0xf6bb4b60, 16); \
+    MD5_STEP(MD5_H, b, c, d, a, 10, 0xbebfbc70, 23); \
+    MD5_STEP(MD5_H, a, b, c, d, 13, 0x289b7ec6,  4); \
+    MD5_STEP(MD5_H, d, a, b, c,  0, 0xeaa127fa, 11); \
+    MD5_STEP(MD5_H, c, d, a, b,  3, 0xd4ef3085, 16); \
+    MD5_STEP(MD5_H, b, c, d, a,  6, 0x04881d05, 23); \
+    MD5_STEP(MD5_H, a, b, c, d,  9, 0xd9d4d039,  4); \
+    MD5_STEP(MD5_H, d, a, b, c, 12, 0xe6db99e5, 11); \
+    MD5_STEP(MD5_H, c, d, a, b, 15, 0x1fa27cf8, 16); \
+    MD5_STEP(MD5_H, b, c, d, a,  2, 0xc4ac5665, 23); \
+    MD5_STEP(MD5_I, a, b, c, d,  0, 0xf4292244,  6); \
+    MD5_STEP(MD5_I, d, a, b, c,  7, 0x432aff97, 10); \
+    MD5_STEP(MD5_I, c, d, a, b, 14, 0xab9423a7, 15); \
+    MD5_STEP(MD5_I, b, c, d, a,  5, 0xfc93a039, 21); \
+    MD5_STEP(MD5_I, a, b, c, d, 12, 0x655b59c3,  6); \
+    MD5_STEP(MD5_I, d, a, b, c,  3, 0x8f0ccc92, 10); \
+    MD5_STEP(MD5_I, c, d, a, b, 10, 0xffeff47d, 15); \
+    MD5_STEP(MD5_I, b, c, d, a,  1, 0x85845dd1, 21); \
+    MD5_STEP(MD5_I, a, b, c, d,  8, 0x6fa87e4f,  6); \
+    MD5_STEP(MD5_I, d, a, b, c, 15, 0xfe2ce6e0, 10); \
+    MD5_STEP(MD5_I, c, d, a, b,  6, 0xa3014314, 15); \
+    MD5_STEP(MD5_I, b, c, d, a, 13, 0x4e0811a1, 21); \
+    MD5_STEP(MD5_I, a, b, c, d,  4, 0xf7537e82,  6); \
+    MD5_STEP(MD5_I, d, a, b, c, 11, 0xbd3af235, 10); \
+    MD5_STEP(MD5_I, c, d, a, b,  2, 0x2ad7d2bb, 15); \
+    MD5_STEP(MD5_I, b, c, d, a,  9, 0xeb86d391, 21); \
+                                                            \
+    MD5_STORE(State + 0 * LANES, MD5_ADD(a, MD5_LOAD(State + 0 * LANES)));  \
+    MD5_STORE(State + 1 * LANES, MD5_ADD(b, MD5_LOAD(State + 1 * LANES)));  \
+    MD5_STORE(State + 2 * LANES, MD5_ADD(c, MD5_LOAD(State + 2 * LANES)));  \
+    MD5_STORE(State + 3 * LANES, MD5_ADD(d, MD5_LOAD(State + 3 * LANES)));  \
+}
+
+// Compresses one chunk in each lane
+typedef void (*PFN_MD5_COMPRESS)(DWORD * State, const DWORD * Words);
+
+// One block being hashed in a lane
+struct MD5_LANE
+{
+    const BYTE * pbData;                            // The data block
+    size_t cbData;                                  // Length of the data block
+    size_t cbHashed;                                // Number of bytes hashed so far
+    size_t cbTotal;                                 // Length of the data block, including the padding
+    size_t nBlockIndex;                             // Index of the block, or MD5_LANE_FREE
+    BYTE Padding[MD5_CHUNK_SIZE * 2];               // The last one or two chunks, with the padding
+};
+
+//-----------------------------------------------------------------------------
+// Compression functions
+
+#ifdef CASC_MD5_SSE2
+
+#define MD5_VECTOR              __m128i
+#define MD5_ADD(x, y)           _mm_add_epi32(x, y)
+#define MD5_AND(x, y)           _mm_and_si128(x, y)
+#define MD5_OR(x, y)            _mm_or_si128(x, y)
+#define MD5_XOR(x, y)           _mm_xor_si128(x, y)
+#define MD5_NOT(x)              _mm_xor_si128(x, _mm_set1_epi32(-1))
+#define MD5_ROL(x, n)           _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define MD5_SET1(x)             _mm_set1_epi32((int)(x))
+#define MD5_LOAD(p)             _mm_loadu_si128((const __m128i *)(p))
+#define MD5_STORE(p, x)         _mm_storeu_si128((__m128i *)(p), x)
+
+static void MD5_Compress_SSE2(DWORD * State, const DWORD * Words)
+{
+    MD5_COMPRESS(State, Words, 4);
+}
+
+#undef MD5_VECTOR
+#undef MD5_ADD
+#undef MD5_AND
+#undef MD5_OR
+#undef MD5_XOR
+#undef MD5_NOT
+#undef MD5_ROL
+#undef MD5_SET1
+#undef MD5_LOAD
+#undef MD5_STORE
+
+#endif  // CASC_MD5_SSE2
+
+#if defined(CASC_MD5_SSE2) && defined(CASC_CAN_USE_AVX2)
+
+#define MD5_VECTOR              __m256i
+#define MD5_ADD(x, y)           _mm256_add_epi32(x, y)
+#define MD5_AND(x, y)           _mm256_and_si256(x, y)
+#define MD5_OR(x, y)            _mm256_or_si256(x, y)
+#define MD5_XOR(x, y)           _mm256_xor_si256(x, y)
+#define MD5_NOT(x)              _mm256_xor_si256(x, _mm256_set1_epi32(-1))
+#define MD5_ROL(x, n)           _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define MD5_SET1(x)             _mm256_set1_epi32((int)(x))
+#define MD5_LOAD(p)             _mm256_loadu_si256((const __m256i *)(p))
+#define MD5_STORE(p, x)         _mm256_storeu_si256((__m256i *)(p), x)
+
+CASC_TARGET_AVX2
+static void MD5_Compress_AVX2(DWORD * State, const DWORD * Words)
+{
+    MD5_COMPRESS(State, Words, 8);
+}
+
+#undef MD5_VECTOR
+#undef MD5_ADD
+#undef MD5_AND
+#undef MD5_OR
+#undef MD5_XOR
+#undef MD5_NOT
+#undef MD5_ROL
+#undef MD5_SET1
+#undef MD5_LOAD
+#undef MD5_STORE
+
+#endif  // CASC_CAN_USE_AVX2
+
+#if defined(CASC_MD5_SSE2) && defined(CASC_CAN_USE_AVX512)
+
+// AVX-512 has the rotation instruction
+#define MD5_VECTOR              __m512i
+#define MD5_ADD(x, y)           _mm512_add_epi32(x, y)
+#define MD5_AND(x, y)           _mm512_and_si512(x, y)
+#define MD5_OR(x, y)            _mm512_or_si512(x, y)
+#define MD5_XOR(x, y)           _mm512_xor_si512(x, y)
+#define MD5_NOT(x)              _mm512_xor_si512(x, _mm512_set1_epi32(-1))
+#define MD5_ROL(x, n)           _mm512_rol_epi32(x, n)
+#define MD5_SET1(x)             _mm512_set1_epi32((int)(x))
+#define MD5_LOAD(p)             _mm512_loadu_si512((const void *)(p))
+#define MD5_STORE(p, x)         _mm512_storeu_si512((void *)(p), x)
+
+CASC_TARGET_AVX512
+static void MD5_Compress_AVX512(DWORD * State, const DWORD * Words)
+{
+    MD5_COMPRESS(State, Words, 16);
+}
+
+#undef MD5_VECTOR
+#undef MD5_ADD
+#undef MD5_AND
+#undef MD5_OR
+#undef MD5_XOR
+#undef MD5_NOT
+#undef MD5_ROL
+#undef MD5_SET1
+#undef MD5_LOAD
+#undef MD5_STORE
+
+#endif  // CASC_CAN_USE_AVX512
+
+#ifdef CASC_MD5_SSE2
+
+// Scalar version, for finishing the last block when the other lanes are empty
+#define MD5_VECTOR              DWORD
+#define MD5_ADD(x, y)           ((x) + (y))
+#define MD5_AND(x, y)           ((x) & (y))
+#define MD5_OR(x, y)            ((x) | (y))
+#define MD5_XOR(x, y)           ((x) ^ (y))
+#define MD5_NOT(x)              (~(x))
+#define MD5_ROL(x, n)           Rol32(x, n)
+#define MD5_SET1(x)             (x)
+#define MD5_LOAD(p)             (*(p))
+#define MD5_STORE(p, x)         (*(p) = (x))
+
+static void MD5_Compress_Scalar(DWORD * State, const DWORD * Words)
+{
+    MD5_COMPRESS(State, Words, 1);
+}
+
+#undef MD5_VECTOR
+#undef MD5_ADD
+#undef MD5_AND
+#undef MD5_OR
+#undef MD5_XOR
+#undef MD5_NOT
+#undef MD5_ROL
+#undef MD5_SET1
+#undef MD5_LOAD
+#undef MD5_STORE
+
+//-----------------------------------------------------------------------------
+// Lane scheduling. Each free lane takes the next block; lanes of finished blocks
+// are refilled, so blocks of different length keep all lanes busy
+
+static void StartLane(MD5_LANE & Lane, DWORD * State, DWORD dwLanes, DWORD dwLane, const void * pvData, size_t cbData, size_t nBlockIndex)
+{
+    ULONGLONG BitLength = (ULONGLONG)cbData << 3;
+    size_t cbFullChunks = cbData & ~(size_t)(MD5_CHUNK_SIZE - 1);
+    size_t cbRemaining = cbData - cbFullChunks;
+    size_t cbPadding = (cbRemaining < (MD5_CHUNK_SIZE - 8)) ? MD5_CHUNK_SIZE : (MD5_CHUNK_SIZE * 2);
+
+    // Prepare the padded last chunk(s): The rest of the data, 0x80, zeros and the bit length
+    memset(Lane.Padding, 0, sizeof(Lane.Padding));
+    memcpy(Lane.Padding, (const BYTE *)pvData + cbFullChunks, cbRemaining);
+    Lane.Padding[cbRemaining] = 0x80;
+    for(size_t i = 0; i < 8; i++)
+        Lane.Padding[cbPadding - 8 + i] = (BYTE)(BitLength >> (i * 8));
+
+    Lane.pbData = (const BYTE *)pvData;
+    Lane.cbData = cbData;
+    Lane.cbHashed = 0;
+    Lane.cbTotal = cbFullChunks + cbPadding;
+    Lane.nBlockIndex = nBlockIndex;
+
+    // Initial MD5 state
+    State[0 * dwLanes + dwLane] = 0x67452301;
+    State[1 * dwLanes + dwLane] = 0xefcdab89;
+    State[2 * dwLanes + dwLane] = 0x98badcfe;
+    State[3 * dwLanes + dwLane] = 0x10325476;
+}
+
+static const BYTE * GetLaneChunk(MD5_LANE & Lane)
+{
+    size_t cbFullChunks = Lane.cbData & ~(size_t)(MD5_CHUNK_SIZE - 1);
+
+    if(Lane.cbHashed < cbFullChunks)
+        return Lane.pbData + Lane.cbHashed;
+    return Lane.Padding + (Lane.cbHashed - cbFullChunks);
+}
+
+static void FinishLane(MD5_LANE & Lane, DWORD * State, DWORD dwLanes, DWORD dwLane, LPBYTE md5_hashes)
+{
+    LPBYTE md5_hash = md5_hashes + Lane.nBlockIndex * MD5_HASH_SIZE;
+
+    // The MD5 is the state, stored as little endian (as all x86 platforms are)
+    for(DWORD i = 0; i < 4; i++)
+        memcpy(md5_hash + i * 4, &State[i * dwLanes + dwLane], sizeof(DWORD));
+    Lane.nBlockIndex = MD5_LANE_FREE;
+}
+
+static void HashLanes(PFN_MD5_COMPRESS PfnCompress, DWORD dwLanes, const void ** DataBlocks, const size_t * BlockSizes, LPBYTE md5_hashes, size_t nBlockCount)
+{
+    MD5_LANE Lanes[MD5_MAX_LANES];
+    DWORD State[4 * MD5_MAX_LANES];
+    DWORD Words[0x10 * MD5_MAX_LANES];
+    size_t nNextBlock = 0;
+    DWORD dwActive = 0;
+
+    // Free lanes compress zeros; their state is never used
+    memset(State, 0, sizeof(State));
+    memset(Words, 0, sizeof(Words));
+    for(DWORD i = 0; i < dwLanes; i++)
+        Lanes[i].nBlockIndex = MD5_LANE_FREE;
+
+    for(;;)
+    {
+        // Give the next blocks to the free lanes
+        for(DWORD i = 0; i < dwLanes && nNextBlock < nBlockCount; i++)
+        {
+            if(Lanes[i].nBlockIndex == MD5_LANE_FREE)
+            {
+                StartLane(Lanes[i], State, dwLanes, i, DataBlocks[nNextBlock], BlockSizes[nNextBlock], nNextBlock);
+                nNextBlock++;
+                dwActive++;
+            }
+        }
+
+        // The last block is finished faster by the scalar code
+        if(dwActive <= 1 && nNextBlock >= nBlockCount)
+            break;
+
+        // Gather one chunk of each lane
+        for(DWORD i = 0; i < dwLanes; i++)
+        {
+            if(Lanes[i].nBlockIndex != MD5_LANE_FREE)
+            {
+                const BYTE * pbChunk = GetLaneChunk(Lanes[i]);
+
+                for(DWORD j = 0; j < 0x10; j++)
+                    memcpy(&Words[j * dwLanes + i], pbChunk + j * 4, sizeof(DWORD));
+            }
+        }
+
+        // Compress the chunks and finish the completed blocks
+        PfnCompress(State, Words);
+        for(DWORD i = 0; i < dwLanes; i++)
+        {
+            if(Lanes[i].nBlockIndex != MD5_LANE_FREE)
+            {
+                Lanes[i].cbHashed += MD5_CHUNK_SIZE;
+                if(Lanes[i].cbHashed == Lanes[i].cbTotal)
+                {
+                    FinishLane(Lanes[i], State, dwLanes, i, md5_hashes);
+                    dwActive--;
+                }
+            }
+        }
+    }
+
+    // Finish the remaining lane, if any
+    for(DWORD i = 0; i < dwLanes; i++)
+    {
+        if(Lanes[i].nBlockIndex != MD5_LANE_FREE)
+        {
+            DWORD ScalarState[4];
+
+            for(DWORD j = 0; j < 4; j++)
+                ScalarState[j] = State[j * dwLanes + i];
+
+            while(Lanes[i].cbHashed < Lanes[i].cbTotal)
+            {
+                memcpy(Words, GetLaneChunk(Lanes[i]), MD5_CHUNK_SIZE);
+                MD5_Compress_Scalar(ScalarState, Words);
+                Lanes[i].cbHashed += MD5_CHUNK_SIZE;
+            }
+
+            FinishLane(Lanes[i], ScalarState, 1, 0, md5_hashes);
+        }
+    }
+}
+
+#endif  // CASC_MD5_SSE2
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+void CascHash_MD5_Multi(const void ** DataBlocks, const size_t * BlockSizes, LPBYTE md5_hashes, size_t nBlockCount)
+{
+#ifdef CASC_MD5_SSE2
+    DWORD dwCpuFeatures = CascGetCpuFeatures();
+
+#ifdef CASC_CAN_USE_AVX512
+    if((dwCpuFeatures & CASC_CPU_AVX512) && nBlockCount > 8)
+    {
+        HashLanes(MD5_Compress_AVX512, 16, DataBlocks, BlockSizes, md5_hashes, nBlockCount);
+        return;
+    }
+#endif
+#ifdef CASC_CAN_USE_AVX2
+    if((dwCpuFeatures & CASC_CPU_AVX2) && nBlockCount > 4)
+    {
+        HashLanes(MD5_Compress_AVX2, 8, DataBlocks, BlockSizes, md5_hashes, nBlockCount);
+        return;
+    }
+#endif
+    HashLanes(MD5_Compress_SSE2, 4, DataBlocks, BlockSizes, md5_hashes, nBlockCount);
+#else
+    // No SIMD: Hash the blocks one-by-one
+    for(size_t i = 0; i < nBlockCount; i++)
+        CascHash_MD5(DataBlocks[i], BlockSizes[i], md5_hashes + i * MD5_HASH_SIZE);
+#endif
+}
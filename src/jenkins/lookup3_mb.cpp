@@ -0,0 +1,353 @@
+/*****************************************************************************/
+/* lookup3_mb.cpp                    Copyright (c) CascLib contributors 2024 */
+/*---------------------------------------------------------------------------*/
+/* Multi-lane hashlittle2: Hashes 4, 8 or 16 file names at once, each one    */
+/* in its own lane of SSE2, AVX2 or AVX-512 vector                           */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.24  1.00  ---  The first version of lookup3_mb.cpp                  */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Instruction sets. SSE2 is used if the compiler targets it, AVX2 and AVX-512
+// are compiled for x64 and used if the CPU supports them. On other platforms,
+// the names are hashed one-by-one by hashlittle2
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CASC_JENKINS_SSE2
+#endif
+
+#if defined(CASC_CAN_USE_AVX2) || defined(CASC_CAN_USE_AVX512)
+#include <immintrin.h>
+#endif
+
+#define JENKINS_MAX_LANES       16              // Lanes of AVX-512 vector
+#define JENKINS_BLOCK_SIZE      12              // hashlittle2 processes the data in 12-byte blocks
+#define JENKINS_MAX_LENGTH      264             // Longest name hashed in a lane (MAX_PATH, rounded up to blocks)
+#define JENKINS_MAX_WORDS       (JENKINS_MAX_LENGTH / 4)    // Size of one lane in JENKINS_GROUP::Data
+
+//-----------------------------------------------------------------------------
+// The mix() and final() of lookup3.c for any vector type. Each function defines
+// JENKINS_VECTOR, JENKINS_MASK and the operations JENKINS_ADD, JENKINS_SUB,
+// JENKINS_XOR, JENKINS_ROL, JENKINS_LOAD, JENKINS_STORE, JENKINS_SET1,
+// JENKINS_CMPGT, JENKINS_BLEND and JENKINS_GATHER before using it
+
+#define JENKINS_MIX(a, b, c)                                                    \
+{                                                                               \
+    a = JENKINS_SUB(a, c);  a = JENKINS_XOR(a, JENKINS_ROL(c,  4));  c = JENKINS_ADD(c, b); \
+    b = JENKINS_SUB(b, a);  b = JENKINS_XOR(b, JENKINS_ROL(a,  6));  a = JENKINS_ADD(a, c); \
+    c = JENKINS_SUB(c, b);  c = JENKINS_XOR(c, JENKINS_ROL(b,  8));  b = JENKINS_ADD(b, a); \
+    a = JENKINS_SUB(a, c);  a = JENKINS_XOR(a, JENKINS_ROL(c, 16));  c = JENKINS_ADD(c, b); \
+    b = JENKINS_SUB(b, a);  b = JENKINS_XOR(b, JENKINS_ROL(a, 19));  a = JENKINS_ADD(a, c); \
+    c = JENKINS_SUB(c, b);  c = JENKINS_XOR(c, JENKINS_ROL(b,  4));  b = JENKINS_ADD(b, a); \
+}
+
+#define JENKINS_FINAL(a, b, c)                                                  \
+{                                                                               \
+    c = JENKINS_XOR(c, b);  c = JENKINS_SUB(c, JENKINS_ROL(b, 14));             \
+    a = JENKINS_XOR(a, c);  a = JENKINS_SUB(a, JENKINS_ROL(c, 11));             \
+    b = JENKINS_XOR(b, a);  b = JENKINS_SUB(b, JENKINS_ROL(a, 25));             \
+    c = JENKINS_XOR(c, b);  c = JENKINS_SUB(c, JENKINS_ROL(b, 16));             \
+    a = JENKINS_XOR(a, c);  a = JENKINS_SUB(a, JENKINS_ROL(c,  4));             \
+    b = JENKINS_XOR(b, a);  b = JENKINS_SUB(b, JENKINS_ROL(a, 14));             \
+    c = JENKINS_XOR(c, b);  c = JENKINS_SUB(c, JENKINS_ROL(b, 24));             \
+}
+
+// Hashes one group of LANES names. All blocks except the last one are mixed;
+// the lanes whose names have less blocks keep their state. The last (zero-padded)
+// block of all names is then added and finalized at once
+#define JENKINS_HASH_GROUP(Group, LANES)                                        \
+{                                                                               \
+    JENKINS_VECTOR a = JENKINS_LOAD(Group.State + 0 * LANES);                   \
+    JENKINS_VECTOR b = JENKINS_LOAD(Group.State + 1 * LANES);                   \
+    JENKINS_VECTOR c = JENKINS_LOAD(Group.State + 2 * LANES);                   \
+    JENKINS_VECTOR BlockCounts = JENKINS_LOAD(Group.BlockCounts);               \
+    JENKINS_VECTOR LaneOffsets = JENKINS_LOAD(JenkinsLaneOffsets);              \
+    JENKINS_VECTOR Offsets;                                                     \
+                                                                                \
+    for(DWORD i = 0; i < Group.dwMaxBlocks; i++)                                \
+    {                                                                           \
+        JENKINS_VECTOR x, y, z;                                                 \
+        JENKINS_MASK Active;                                                    \
+                                                                                \
+        Offsets = JENKINS_ADD(LaneOffsets, JENKINS_SET1(i * 3));                \
+        x = JENKINS_ADD(a, JENKINS_GATHER(Group.Data, Offsets, 0));             \
+        y = JENKINS_ADD(b, JENKINS_GATHER(Group.Data, Offsets, 1));             \
+        z = JENKINS_ADD(c, JENKINS_GATHER(Group.Data, Offsets, 2));             \
+        JENKINS_MIX(x, y, z);                                                   \
+                                                                                \
+        Active = JENKINS_CMPGT(BlockCounts, JENKINS_SET1(i));                   \
+        a = JENKINS_BLEND(Active, x, a);                                        \
+        b = JENKINS_BLEND(Active, y, b);                                        \
+        c = JENKINS_BLEND(Active, z, c);                                        \
+    }                                                                           \
+                                                                                \
+    Offsets = JENKINS_ADD(BlockCounts, JENKINS_ADD(BlockCounts, BlockCounts));  \
+    Offsets = JENKINS_ADD(LaneOffsets, Offsets);                                \
+    a = JENKINS_ADD(a, JENKINS_GATHER(Group.Data, Offsets, 0));                 \
+    b = JENKINS_ADD(b, JENKINS_GATHER(Group.Data, Offsets, 1));                 \
+    c = JENKINS_ADD(c, JENKINS_GATHER(Group.Data, Offsets, 2));                 \
+    JENKINS_FINAL(a, b, c);                                                     \
+                                                                                \
+    JENKINS_STORE(Group.State + 1 * LANES, b);                                  \
+    JENKINS_STORE(Group.State + 2 * LANES, c);                                  \
+}
+
+// Names of one group, each one copied to its lane and padded with zeros.
+// The per-lane values are stored word-by-word, e.g. State[1 * LANES + 2] is the word b of lane 2
+struct JENKINS_GROUP
+{
+    DWORD Data[JENKINS_MAX_LANES][JENKINS_MAX_WORDS];   // Copies of the names
+    DWORD State[3 * JENKINS_MAX_LANES];             // Words a, b, c of all lanes
+    DWORD BlockCounts[JENKINS_MAX_LANES];           // Number of blocks before the last one
+    DWORD Lengths[JENKINS_MAX_LANES];               // Lengths of the names
+    size_t NameIndexes[JENKINS_MAX_LANES];          // Indexes of the names in the lanes
+    DWORD dwMaxBlocks;                              // Maximum of BlockCounts
+};
+
+typedef void (*PFN_JENKINS_HASH_GROUP)(JENKINS_GROUP & Group);
+
+// Offsets of the lanes in JENKINS_GROUP::Data, in words
+static const DWORD JenkinsLaneOffsets[JENKINS_MAX_LANES] =
+{
+    0x00 * JENKINS_MAX_WORDS, 0x01 * JENKINS_MAX_WORDS, 0x02 * JENKINS_MAX_WORDS, 0x03 * JENKINS_MAX_WORDS,
+    0x04 * JENKINS_MAX_WORDS, 0x05 * JENKINS_MAX_WORDS, 0x06 * JENKINS_MAX_WORDS, 0x07 * JENKINS_MAX_WORDS,
+    0x08 * JENKINS_MAX_WORDS, 0x09 * JENKINS_MAX_WORDS, 0x0A * JENKINS_MAX_WORDS, 0x0B * JENKINS_MAX_WORDS,
+    0x0C * JENKINS_MAX_WORDS, 0x0D * JENKINS_MAX_WORDS, 0x0E * JENKINS_MAX_WORDS, 0x0F * JENKINS_MAX_WORDS
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+#ifdef CASC_JENKINS_SSE2
+
+static void SetGroupLane(JENKINS_GROUP & Group, DWORD dwLanes, DWORD dwLane, const char * szNormName, size_t nLength, size_t nNameIndex)
+{
+    DWORD dwLength = (DWORD)nLength;
+    DWORD dwInitValue = 0xdeadbeef + dwLength;
+    DWORD dwBlockCount = (dwLength != 0) ? (dwLength - 1) / JENKINS_BLOCK_SIZE : 0;
+    PDWORD LastBlock = Group.Data[dwLane] + dwBlockCount * 3;
+
+    // Copy the name to the lane. The rest of the last block is zeros, the same as masked by lookup3.c
+    LastBlock[0] = LastBlock[1] = LastBlock[2] = 0;
+    memcpy(Group.Data[dwLane], szNormName, nLength);
+
+    Group.NameIndexes[dwLane] = nNameIndex;
+    Group.Lengths[dwLane] = dwLength;
+    Group.BlockCounts[dwLane] = dwBlockCount;
+    Group.dwMaxBlocks = CASCLIB_MAX(Group.dwMaxBlocks, dwBlockCount);
+
+    // Initial state of hashlittle2, with both initial values zero
+    Group.State[0 * dwLanes + dwLane] = dwInitValue;
+    Group.State[1 * dwLanes + dwLane] = dwInitValue;
+    Group.State[2 * dwLanes + dwLane] = dwInitValue;
+}
+
+// Loads one word of the current block of each lane. Offsets are the positions
+// of the blocks in Group.Data, AVX2 and AVX-512 have gather instructions for this
+static inline __m128i Gather_SSE2(const DWORD * Data, __m128i Offsets, DWORD dwWordIndex)
+{
+    DWORD LaneOffsets[4];
+
+    _mm_storeu_si128((__m128i *)LaneOffsets, Offsets);
+    return _mm_setr_epi32((int)Data[LaneOffsets[0] + dwWordIndex],
+                          (int)Data[LaneOffsets[1] + dwWordIndex],
+                          (int)Data[LaneOffsets[2] + dwWordIndex],
+                          (int)Data[LaneOffsets[3] + dwWordIndex]);
+}
+
+static void HashGroup(PFN_JENKINS_HASH_GROUP PfnHashGroup, JENKINS_GROUP & Group, DWORD dwLanes, DWORD dwUsedLanes, ULONGLONG * NameHashes)
+{
+    // Unused lanes hash an empty name
+    for(DWORD i = dwUsedLanes; i < dwLanes; i++)
+        SetGroupLane(Group, dwLanes, i, "", 0, 0);
+    PfnHashGroup(Group);
+
+    // hashlittle2 returns the initial state for empty names
+    for(DWORD i = 0; i < dwUsedLanes; i++)
+    {
+        if(Group.Lengths[i] != 0)
+            NameHashes[Group.NameIndexes[i]] = ((ULONGLONG)Group.State[2 * dwLanes + i] << 0x20) | Group.State[1 * dwLanes + i];
+        else
+            NameHashes[Group.NameIndexes[i]] = 0xdeadbeefdeadbeefULL;
+    }
+    Group.dwMaxBlocks = 0;
+}
+
+static void HashGroups(PFN_JENKINS_HASH_GROUP PfnHashGroup, DWORD dwLanes, const char ** NormNames, const size_t * NameLengths, ULONGLONG * NameHashes, size_t nNameCount)
+{
+    JENKINS_GROUP Group;
+    DWORD dwUsedLanes = 0;
+
+    // The lanes that have less blocks still load the data of the following ones
+    memset(Group.Data, 0, sizeof(Group.Data));
+    Group.dwMaxBlocks = 0;
+
+    for(size_t i = 0; i < nNameCount; i++)
+    {
+        // Names that don't fit into the lane are hashed by hashlittle2
+        if(NameLengths[i] > JENKINS_MAX_LENGTH)
+        {
+            NameHashes[i] = CalcNormNameHash(NormNames[i], NameLengths[i]);
+            continue;
+        }
+
+        // Hash the group when all lanes are used
+        SetGroupLane(Group, dwLanes, dwUsedLanes++, NormNames[i], NameLengths[i], i);
+        if(dwUsedLanes == dwLanes)
+        {
+            HashGroup(PfnHashGroup, Group, dwLanes, dwUsedLanes, NameHashes);
+            dwUsedLanes = 0;
+        }
+    }
+
+    // Hash the incomplete group
+    if(dwUsedLanes != 0)
+    {
+        HashGroup(PfnHashGroup, Group, dwLanes, dwUsedLanes, NameHashes);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Hashing functions for SSE2, AVX2 and AVX-512
+
+#define JENKINS_VECTOR          __m128i
+#define JENKINS_MASK            __m128i
+#define JENKINS_ADD(x, y)       _mm_add_epi32(x, y)
+#define JENKINS_SUB(x, y)       _mm_sub_epi32(x, y)
+#define JENKINS_XOR(x, y)       _mm_xor_si128(x, y)
+#define JENKINS_ROL(x, n)       _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define JENKINS_LOAD(p)         _mm_loadu_si128((const __m128i *)(p))
+#define JENKINS_STORE(p, x)     _mm_storeu_si128((__m128i *)(p), x)
+#define JENKINS_SET1(n)         _mm_set1_epi32((int)(n))
+#define JENKINS_CMPGT(x, y)     _mm_cmpgt_epi32(x, y)
+#define JENKINS_BLEND(m, x, y)  _mm_or_si128(_mm_and_si128(m, x), _mm_andnot_si128(m, y))
+#define JENKINS_GATHER(p, o, n) Gather_SSE2(p[0], o, n)
+
+static void Jenkins_HashGroup_SSE2(JENKINS_GROUP & Group)
+{
+    JENKINS_HASH_GROUP(Group, 4);
+}
+
+#undef JENKINS_VECTOR
+#undef JENKINS_MASK
+#undef JENKINS_ADD
+#undef JENKINS_SUB
+#undef JENKINS_XOR
+#undef JENKINS_ROL
+#undef JENKINS_LOAD
+#undef JENKINS_STORE
+#undef JENKINS_SET1
+#undef JENKINS_CMPGT
+#undef JENKINS_BLEND
+#undef JENKINS_GATHER
+
+#ifdef CASC_CAN_USE_AVX2
+
+#define JENKINS_VECTOR          __m256i
+#define JENKINS_MASK            __m256i
+#define JENKINS_ADD(x, y)       _mm256_add_epi32(x, y)
+#define JENKINS_SUB(x, y)       _mm256_sub_epi32(x, y)
+#define JENKINS_XOR(x, y)       _mm256_xor_si256(x, y)
+#define JENKINS_ROL(x, n)       _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define JENKINS_LOAD(p)         _mm256_loadu_si256((const __m256i *)(p))
+#define JENKINS_STORE(p, x)     _mm256_storeu_si256((__m256i *)(p), x)
+#define JENKINS_SET1(n)         _mm256_set1_epi32((int)(n))
+#define JENKINS_CMPGT(x, y)     _mm256_cmpgt_epi32(x, y)
+#define JENKINS_BLEND(m, x, y)  _mm256_blendv_epi8(y, x, m)
+#define JENKINS_GATHER(p, o, n) _mm256_i32gather_epi32((const int *)(p[0] + n), o, 4)
+
+CASC_TARGET_AVX2
+static void Jenkins_HashGroup_AVX2(JENKINS_GROUP & Group)
+{
+    JENKINS_HASH_GROUP(Group, 8);
+}
+
+#undef JENKINS_VECTOR
+#undef JENKINS_MASK
+#undef JENKINS_ADD
+#undef JENKINS_SUB
+#undef JENKINS_XOR
+#undef JENKINS_ROL
+#undef JENKINS_LOAD
+#undef JENKINS_STORE
+#undef JENKINS_SET1
+#undef JENKINS_CMPGT
+#undef JENKINS_BLEND
+#undef JENKINS_GATHER
+
+#endif  // CASC_CAN_USE_AVX2
+
+#ifdef CASC_CAN_USE_AVX512
+
+// AVX-512 has the rotation instruction and mask registers
+#define JENKINS_VECTOR          __m512i
+#define JENKINS_MASK            __mmask16
+#define JENKINS_ADD(x, y)       _mm512_add_epi32(x, y)
+#define JENKINS_SUB(x, y)       _mm512_sub_epi32(x, y)
+#define JENKINS_XOR(x, y)       _mm512_xor_si512(x, y)
+#define JENKINS_ROL(x, n)       _mm512_rol_epi32(x, n)
+#define JENKINS_LOAD(p)         _mm512_loadu_si512((const void *)(p))
+#define JENKINS_STORE(p, x)     _mm512_storeu_si512((void *)(p), x)
+#define JENKINS_SET1(n)         _mm512_set1_epi32((int)(n))
+#define JENKINS_CMPGT(x, y)     _mm512_cmpgt_epi32_mask(x, y)
+#define JENKINS_BLEND(m, x, y)  _mm512_mask_blend_epi32(m, y, x)
+#define JENKINS_GATHER(p, o, n) _mm512_i32gather_epi32(o, (const void *)(p[0] + n), 4)
+
+CASC_TARGET_AVX512
+static void Jenkins_HashGroup_AVX512(JENKINS_GROUP & Group)
+{
+    JENKINS_HASH_GROUP(Group, 16);
+}
+
+#undef JENKINS_VECTOR
+#undef JENKINS_MASK
+#undef JENKINS_ADD
+#undef JENKINS_SUB
+#undef JENKINS_XOR
+#undef JENKINS_ROL
+#undef JENKINS_LOAD
+#undef JENKINS_STORE
+#undef JENKINS_SET1
+#undef JENKINS_CMPGT
+#undef JENKINS_BLEND
+#undef JENKINS_GATHER
+
+#endif  // CASC_CAN_USE_AVX512
+#endif  // CASC_JENKINS_SSE2
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+void CalcNormNameHashes(const char ** NormNames, const size_t * NameLengths, ULONGLONG * NameHashes, size_t nNameCount)
+{
+#ifdef CASC_JENKINS_SSE2
+    DWORD dwCpuFeatures = CascGetCpuFeatures();
+
+#ifdef CASC_CAN_USE_AVX512
+    if((dwCpuFeatures & CASC_CPU_AVX512) && nNameCount > 8)
+    {
+        HashGroups(Jenkins_HashGroup_AVX512, 16, NormNames, NameLengths, NameHashes, nNameCount);
+        return;
+    }
+#endif
+#ifdef CASC_CAN_USE_AVX2
+    if((dwCpuFeatures & CASC_CPU_AVX2) && nNameCount > 4)
+    {
+        HashGroups(Jenkins_HashGroup_AVX2, 8, NormNames, NameLengths, NameHashes, nNameCount);
+        return;
+    }
+#endif
+    HashGroups(Jenkins_HashGroup_SSE2, 4, NormNames, NameLengths, NameHashes, nNameCount);
+#else
+    // No SIMD: Hash the names one-by-one
+    for(size_t i = 0; i < nNameCount; i++)
+        NameHashes[i] = CalcNormNameHash(NormNames[i], NameLengths[i]);
+#endif
+}
@@ -20,6 +20,7 @@
     #define PLATFORM_STD_THREAD
     #include <vector>
     #include <thread>
+    #include <chrono>
   #endif
 #endif
 
@@ -38,6 +39,14 @@
 #include <dirent.h>
 #endif
 
+#ifdef CASCLIB_PLATFORM_WINDOWS
+#include <ws2tcpip.h>
+#endif
+
+#ifndef INVALID_SOCKET
+#define INVALID_SOCKET (SOCKET)(-1)                 // Not defined in Linux
+#endif
+
 //------------------------------------------------------------------------------
 // Defines
 
@@ -737,6 +746,178 @@ static DWORD Storage_SeekFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
     return dwErrCode;
 }
 
+// Measures the speed of small sequential reads and random seeks within one (preferably large) file
+static DWORD Storage_SeekBenchmark(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    ULONGLONG FileSize = 0;
+    ULONGLONG ByteOffset;
+    ULONGLONG ReadCount = 0;
+    HANDLE hFile;
+    DWORD dwBytesRead;
+    DWORD dwTime;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    BYTE Buffer[0x1000];
+
+    // Check whether the file name was given
+    if(Params.szFileName == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if(CascOpenFile(Params.hStorage, Params.szFileName, 0, Params.dwOpenFlags, &hFile))
+    {
+        CascGetFileSize64(hFile, &FileSize);
+
+        //
+        // Phase 1: Read the entire file in 4 KB blocks
+        //
+
+        LogHelper.PrintProgress("Reading file sequentially ...");
+        LogHelper.SetStartTime();
+        for(ByteOffset = 0; ByteOffset < FileSize; ByteOffset += dwBytesRead, ReadCount++)
+        {
+            if(!CascReadFile(hFile, Buffer, sizeof(Buffer), &dwBytesRead) || dwBytesRead == 0)
+            {
+                LogHelper.PrintMessage("Error: Failed to read %u bytes at offset %llX.", (DWORD)sizeof(Buffer), ByteOffset);
+                dwErrCode = GetCascError();
+                break;
+            }
+        }
+        dwTime = LogHelper.SetEndTime();
+        LogHelper.PrintMessage("Sequential: %I64u reads in %u.%03u second(s)", ReadCount, (dwTime / 1000), (dwTime % 1000));
+
+        //
+        // Phase 2: Small reads from random positions in the file
+        //
+
+        if(dwErrCode == ERROR_SUCCESS && FileSize > 0x100)
+        {
+            // Always set random number generator to the same value
+            srand(0x12345678);
+
+            LogHelper.PrintProgress("Reading file from random positions ...");
+            LogHelper.SetStartTime();
+            for(DWORD i = 0; i < 0x10000; i++)
+            {
+                ULONGLONG RandomHi = rand();
+                DWORD RandomLo = rand();
+
+                // Read 256 bytes from a random position
+                ByteOffset = ((RandomHi << 0x20) | RandomLo) % (FileSize - 0x100);
+                CascSetFilePointer64(hFile, ByteOffset, NULL, FILE_BEGIN);
+                if(!CascReadFile(hFile, Buffer, 0x100, &dwBytesRead) || dwBytesRead != 0x100)
+                {
+                    LogHelper.PrintMessage("Error: Failed to read %u bytes at offset %llX.", 0x100, ByteOffset);
+                    dwErrCode = GetCascError();
+                    break;
+                }
+            }
+            dwTime = LogHelper.SetEndTime();
+            LogHelper.PrintMessage("Random:     %u reads in %u.%03u second(s)", 0x10000, (dwTime / 1000), (dwTime % 1000));
+        }
+
+        CascCloseFile(hFile);
+    }
+    else
+    {
+        LogHelper.PrintMessage("Error: Failed to open %s.", Params.szFileName);
+        dwErrCode = GetCascError();
+    }
+
+    return dwErrCode;
+}
+
+#ifdef PLATFORM_STD_THREAD
+struct READ_BENCH_CONTEXT
+{
+    TFileStream * pStream;          // Shared data file stream
+    ULONGLONG FileSize;             // Size of the data file
+    DWORD ReadCount;                // Number of reads per thread
+    DWORD ReadSize;                 // Size of one read
+    DWORD dwErrCode;                // Set to nonzero if any read failed
+};
+
+static void Worker_ReadDataFile(READ_BENCH_CONTEXT * pContext, DWORD dwSeed)
+{
+    ULONGLONG ByteOffset;
+    ULONGLONG RandomValue = dwSeed;
+    LPBYTE pbBuffer;
+
+    if((pbBuffer = CASC_ALLOC<BYTE>(pContext->ReadSize)) != NULL)
+    {
+        for(DWORD i = 0; i < pContext->ReadCount; i++)
+        {
+            // Simple LCG, so that each thread reads from a different set of offsets
+            RandomValue = RandomValue * 6364136223846793005ULL + 1442695040888963407ULL;
+            ByteOffset = (RandomValue >> 16) % (pContext->FileSize - pContext->ReadSize);
+
+            // Read the block. All threads read from the same stream
+            if(!FileStream_Read(pContext->pStream, &ByteOffset, pbBuffer, pContext->ReadSize))
+            {
+                pContext->dwErrCode = GetCascError();
+                break;
+            }
+        }
+        CASC_FREE(pbBuffer);
+    }
+}
+
+// Measures how the random reads from one data file scale with the number of threads
+static DWORD Storage_ReadScaling(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    READ_BENCH_CONTEXT Context = {0};
+    TCascStorage * hs;
+    DWORD dwTotalReads = 0x40000;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Only works on local storages
+    if((hs = TCascStorage::IsValid(Params.hStorage)) == NULL || hs->szIndexPath == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Open the first data file the same way as the library does
+    CASC_PATH<TCHAR> DataFile(hs->szIndexPath, _T("data.000"), NULL);
+    Context.pStream = FileStream_OpenFile(DataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_FILE);
+    if(Context.pStream == NULL)
+        return GetCascError();
+
+    // Verify the file size
+    FileStream_GetSize(Context.pStream, &Context.FileSize);
+    Context.ReadSize = 0x1000;
+    if(Context.FileSize > Context.ReadSize)
+    {
+        // Perform the same amount of reads with increasing number of threads
+        for(DWORD dwThreads = 1; dwThreads <= 32 && dwErrCode == ERROR_SUCCESS; dwThreads *= 2)
+        {
+            std::vector<std::thread> threads;
+            double fSeconds;
+
+            LogHelper.PrintProgress("Reading data.000 with %u thread(s) ...", dwThreads);
+            Context.ReadCount = dwTotalReads / dwThreads;
+
+            // Run the worker threads and wait for them to finish
+            auto StartTime = std::chrono::steady_clock::now();
+            for(DWORD i = 0; i < dwThreads; i++)
+                threads.emplace_back(&Worker_ReadDataFile, &Context, i + 1);
+            for(auto &thread : threads)
+                thread.join();
+            fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+
+            // Report the throughput
+            if((dwErrCode = Context.dwErrCode) == ERROR_SUCCESS && fSeconds > 0)
+            {
+                LogHelper.PrintMessage("%2u thread(s): %u reads of %u bytes in %.3f sec (%.1f MB/s)",
+                                       dwThreads,
+                                       Context.ReadCount * dwThreads,
+                                       Context.ReadSize,
+                                       fSeconds,
+                                       ((double)Context.ReadCount * dwThreads * Context.ReadSize) / (fSeconds * 1048576.0));
+            }
+        }
+    }
+
+    FileStream_Close(Context.pStream);
+    return dwErrCode;
+}
+#endif  // PLATFORM_STD_THREAD
+
 static DWORD Storage_EnumFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
 {
     PCASC_FIND_DATA_ARRAY pFiles;
@@ -876,183 +1057,1631 @@ static DWORD Storage_ReadFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
     return Storage_EnumFiles(LogHelper, Params);
 }
 
-static DWORD LocalStorage_Test(PFN_RUN_TEST PfnRunTest, STORAGE_INFO & StorInfo)
+// Reopens the storage with the frame cache enabled and reads all files twice.
+// The second pass is served from the frame cache and must give the same results
+static DWORD Storage_FrameCache(TLogHelper & LogHelper, TEST_PARAMS & Params)
 {
-    TLogHelper LogHelper(StorInfo.szPath);
-    HANDLE hStorage;
-    TCHAR szFullPath[MAX_PATH];
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    CASC_FRAME_CACHE_INFO CacheInfo = {0};
+    TEST_PARAMS CacheParams;
+    TCHAR szPathProduct[MAX_PATH];
     DWORD dwErrCode = ERROR_SUCCESS;
 
-    // Prepare the full path of the storage
-    MakeFullPath(szFullPath, _countof(szFullPath), StorInfo.szPath);
+    // Retrieve the full path of the storage
+    if(!CascGetStorageInfo(Params.hStorage, CascStoragePathProduct, szPathProduct, sizeof(szPathProduct), NULL))
+        return GetCascError();
 
-    // Open the CASC storage
-    LogHelper.PrintProgress("Opening storage ...");
-    if(CascOpenStorage(szFullPath, 0, &hStorage))
-    {
-        TEST_PARAMS Params;
+    // Open the storage again, with 64 MB frame cache
+    LogHelper.PrintProgress("Opening storage with frame cache ...");
+    OpenArgs.FrameCacheSize = 0x4000000;
+    if(!CascOpenStorageEx(szPathProduct, &OpenArgs, false, &CacheParams.hStorage))
+        return GetCascError();
+    CacheParams.szExpectedNameHash = Params.szExpectedNameHash;
+    CacheParams.szExpectedDataHash = Params.szExpectedDataHash;
 
-        // Configure the test parameters
-        Params.hStorage = hStorage;
-        Params.szExpectedNameHash = StorInfo.szNameHash;
-        Params.szExpectedDataHash = StorInfo.szDataHash;
-        Params.szFileName = StorInfo.szFileName;
-        dwErrCode = PfnRunTest(LogHelper, Params);
-    }
-    else
+    // Read all files twice
+    for(DWORD dwPass = 0; dwPass < 2 && dwErrCode == ERROR_SUCCESS; dwPass++)
     {
-        LogHelper.PrintError("Error: Failed to open storage %s", StorInfo.szPath);
-        assert(GetCascError() != ERROR_SUCCESS);
-        dwErrCode = GetCascError();
+        dwErrCode = Storage_ReadFiles(LogHelper, CacheParams);
+
+        // Show the cache statistics
+        if(CascGetStorageInfo(CacheParams.hStorage, CascStorageFrameCacheInfo, &CacheInfo, sizeof(CASC_FRAME_CACHE_INFO), NULL))
+        {
+            LogHelper.PrintMessage("Frame cache: %I64u hits, %I64u misses, %I64u evictions, %I64u frames (%I64u bytes)",
+                                   CacheInfo.Hits,
+                                   CacheInfo.Misses,
+                                   CacheInfo.Evictions,
+                                   CacheInfo.FrameCount,
+                                   CacheInfo.CurrentSize);
+        }
     }
 
     return dwErrCode;
 }
 
-static DWORD SpeedStorage_Test(PFN_RUN_TEST PfnRunTest, LPCSTR szStorage, LPCSTR szExpectedNameHash = NULL, LPCSTR szExpectedDataHash = NULL, LPCSTR szFileName = NULL)
+// Reopens the storage with one thread and with multiple threads and compares the load times.
+// The storage opened with multiple threads must give the same results, including the file names
+// that are applied from the listfile by multiple threads
+static DWORD Storage_ParallelOpen(TLogHelper & LogHelper, TEST_PARAMS & Params)
 {
-    TLogHelper LogHelper(szStorage);
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    TEST_PARAMS ParallelParams;
+    TCHAR szPathProduct[MAX_PATH];
     HANDLE hStorage;
-    TCHAR szFullPath[MAX_PATH];
+    DWORD dwFileCount1 = 0;
+    DWORD dwFileCount2 = 0;
+    DWORD dwTime;
     DWORD dwErrCode = ERROR_SUCCESS;
-    int nOpenCount = 100;
 
-    // Keep compiler happy
-    CASCLIB_UNUSED(PfnRunTest);
-    CASCLIB_UNUSED(szExpectedNameHash);
-    CASCLIB_UNUSED(szExpectedDataHash);
-    CASCLIB_UNUSED(szFileName);
-
-    // Prepare the full path of the storage
-    MakeFullPath(szFullPath, _countof(szFullPath), szStorage);
-
-    // Open the storage for the first time to load all files to the cache
-    LogHelper.PrintProgress("Opening storage (caching-in) ...");
-    if(CascOpenStorage(szFullPath, 0, &hStorage))
+    // Retrieve the full path of the storage
+    if(!CascGetStorageInfo(Params.hStorage, CascStoragePathProduct, szPathProduct, sizeof(szPathProduct), NULL))
+        return GetCascError();
+
+    // Open the storage with one thread
+    LogHelper.PrintProgress("Opening storage with 1 thread ...");
+    LogHelper.SetStartTime();
+    if(!CascOpenStorageEx(szPathProduct, &OpenArgs, false, &hStorage))
+        return GetCascError();
+    dwTime = LogHelper.SetEndTime();
+    CascGetStorageInfo(hStorage, CascStorageTotalFileCount, &dwFileCount1, sizeof(DWORD), NULL);
+    LogHelper.PrintMessage("1 thread:   %u files in %u.%03u second(s)", dwFileCount1, (dwTime / 1000), (dwTime % 1000));
+    CascCloseStorage(hStorage);
+
+    // Open the storage with multiple threads
+    LogHelper.PrintProgress("Opening storage with %u threads ...", GetNumberOfWorkerThreads());
+    LogHelper.SetStartTime();
+    OpenArgs.dwThreadCount = GetNumberOfWorkerThreads();
+    if(!CascOpenStorageEx(szPathProduct, &OpenArgs, false, &ParallelParams.hStorage))
+        return GetCascError();
+    dwTime = LogHelper.SetEndTime();
+    CascGetStorageInfo(ParallelParams.hStorage, CascStorageTotalFileCount, &dwFileCount2, sizeof(DWORD), NULL);
+    LogHelper.PrintMessage("%u threads: %u files in %u.%03u second(s)", OpenArgs.dwThreadCount, dwFileCount2, (dwTime / 1000), (dwTime % 1000));
+
+    // Both storages must have the same files
+    if(dwFileCount2 != dwFileCount1)
     {
-        // Close right away
-        CascCloseStorage(hStorage);
-        hStorage = NULL;
+        LogHelper.PrintMessage("Error: File count mismatch (%u vs %u)", dwFileCount1, dwFileCount2);
+        dwErrCode = ERROR_FILE_CORRUPT;
+    }
 
-        // Set the start time of the operation
-        LogHelper.SetStartTime();
+    // Verify the file names and data
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        ParallelParams.szExpectedNameHash = Params.szExpectedNameHash;
+        ParallelParams.szExpectedDataHash = Params.szExpectedDataHash;
+        dwErrCode = Storage_ReadFiles(LogHelper, ParallelParams);
+    }
 
-        // Now open the storage again, many times in order to measure how fast can we load it
-        for(int i = 0; i < nOpenCount; i++)
-        {
-            LogHelper.PrintProgress("Opening storage (%u /%u) ...", i, nOpenCount);
-            if(!CascOpenStorage(szFullPath, 0, &hStorage))
-            {
-                LogHelper.PrintError("Error: Failed to open storage %s", szStorage);
-                break;
-            }
+    return dwErrCode;
+}
 
-            CascCloseStorage(hStorage);
-            hStorage = NULL;
-        }
+static DWORD Storage_Snapshot(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    TEST_PARAMS SnapshotParams;
+    TCHAR szPathProduct[MAX_PATH];
+    HANDLE hStorage;
+    DWORD dwFileCount1 = 0;
+    DWORD dwFileCount2 = 0;
+    DWORD dwTime;
+    DWORD dwErrCode = ERROR_SUCCESS;
 
-        // Print the total time
-        LogHelper.PrintTotalTime();
+    // Retrieve the full path of the storage
+    if(!CascGetStorageInfo(Params.hStorage, CascStoragePathProduct, szPathProduct, sizeof(szPathProduct), NULL))
+        return GetCascError();
+    OpenArgs.szSnapshotFile = _T("CascTest.snapshot");
+    _tremove(OpenArgs.szSnapshotFile);
+
+    // Open the storage without a snapshot. This creates the snapshot
+    LogHelper.PrintProgress("Opening storage and creating snapshot ...");
+    LogHelper.SetStartTime();
+    if(!CascOpenStorageEx(szPathProduct, &OpenArgs, false, &hStorage))
+        return GetCascError();
+    dwTime = LogHelper.SetEndTime();
+    CascGetStorageInfo(hStorage, CascStorageTotalFileCount, &dwFileCount1, sizeof(DWORD), NULL);
+    LogHelper.PrintMessage("Without snapshot: %u files in %u.%03u second(s)", dwFileCount1, (dwTime / 1000), (dwTime % 1000));
+    CascCloseStorage(hStorage);
+
+    // Open the storage from the snapshot
+    LogHelper.PrintProgress("Opening storage from snapshot ...");
+    LogHelper.SetStartTime();
+    if(!CascOpenStorageEx(szPathProduct, &OpenArgs, false, &SnapshotParams.hStorage))
+        return GetCascError();
+    dwTime = LogHelper.SetEndTime();
+    CascGetStorageInfo(SnapshotParams.hStorage, CascStorageTotalFileCount, &dwFileCount2, sizeof(DWORD), NULL);
+    LogHelper.PrintMessage("With snapshot:    %u files in %u.%03u second(s)", dwFileCount2, (dwTime / 1000), (dwTime % 1000));
+
+    // Both storages must have the same files
+    if(dwFileCount2 != dwFileCount1)
+    {
+        LogHelper.PrintMessage("Error: File count mismatch (%u vs %u)", dwFileCount1, dwFileCount2);
+        dwErrCode = ERROR_FILE_CORRUPT;
     }
-    else
+
+    // Verify the file names and data
+    if(dwErrCode == ERROR_SUCCESS)
     {
-        LogHelper.PrintError("Error: Failed to open storage %s", szStorage);
-        assert(GetCascError() != ERROR_SUCCESS);
-        dwErrCode = GetCascError();
+        SnapshotParams.szExpectedNameHash = Params.szExpectedNameHash;
+        SnapshotParams.szExpectedDataHash = Params.szExpectedDataHash;
+        dwErrCode = Storage_ReadFiles(LogHelper, SnapshotParams);
     }
 
+    _tremove(OpenArgs.szSnapshotFile);
     return dwErrCode;
 }
 
-static bool WINAPI OnlineStorage_OpenCB(
-    void * PtrUserParam,                        // User-specific parameter passed to the callback
-    LPCSTR szWork,                              // Text for the current activity (example: "Loading "ENCODING" file")
-    LPCSTR szObject,                            // (optional) name of the object tied to the activity (example: index file name)
-    DWORD,                                      // (optional) current object being processed
-    DWORD)                                      // (optional) If non-zero, this is the total number of objects to process
+// Context for the batch read test
+struct READ_BATCH_CONTEXT
 {
-    TLogHelper * pLogHelper = (TLogHelper *)PtrUserParam;
+    LPBYTE FileHashes;              // MD5 of each file, as read by CascReadFile
+    DWORD dwFileCount;              // Number of files read by the batch
+    DWORD dwErrorCount;             // Number of files that failed to read
+    DWORD dwMismatchCount;          // Number of files whose data differ
+};
 
-    if(pLogHelper != NULL)
-        pLogHelper->PrintProgress(szWork, szObject);
+// Called for every file read by CascReadFilesBatch. The data must match the data read by CascReadFile
+static bool WINAPI Storage_ReadBatchCB(void * PtrUserParam, const CASC_BATCH_ITEM * pItem, DWORD dwErrCode, const void * pvFileData, ULONGLONG cbFileData)
+{
+    READ_BATCH_CONTEXT * pContext = (READ_BATCH_CONTEXT *)PtrUserParam;
+    MD5_CTX md5_ctx;
+    BYTE md5_digest[MD5_HASH_SIZE];
+    size_t nIndex = (size_t)pItem->pvUserData;
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        MD5_Init(&md5_ctx);
+        MD5_Update(&md5_ctx, (void *)pvFileData, (unsigned long)cbFileData);
+        MD5_Final(md5_digest, &md5_ctx);
+
+        if(memcmp(md5_digest, pContext->FileHashes + (nIndex * MD5_HASH_SIZE), MD5_HASH_SIZE))
+            pContext->dwMismatchCount++;
+    }
+    else
+    {
+        pContext->dwErrorCount++;
+    }
+
+    pContext->dwFileCount++;
     return false;
 }
 
-static DWORD OnlineStorage_Test(PFN_RUN_TEST PfnRunTest, STORAGE_INFO & StorInfo)
+// Reads all locally available files one-by-one and then by CascReadFilesBatch.
+// Both must give the same data
+static DWORD Storage_ReadBatch(TLogHelper & LogHelper, TEST_PARAMS & Params)
 {
-    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
-    TLogHelper LogHelper(StorInfo.szPath);
-    HANDLE hStorage;
-    TCHAR szParams[MAX_PATH+0x40];
+    READ_BATCH_CONTEXT Context = {0};
+    PCASC_BATCH_ITEM pItems = NULL;
+    CASC_FIND_DATA cf;
+    HANDLE hFind;
+    HANDLE hFile;
+    LPBYTE EKeys = NULL;
+    LPBYTE pbFileData;
+    DWORD dwMaxFiles = 0;
+    DWORD dwFileCount = 0;
+    DWORD dwTime;
     DWORD dwErrCode = ERROR_SUCCESS;
 
-    LogHelper.PrintMessage("Root File: %s", StorInfo.szPath);
-    LogHelper.PrintProgress("Opening storage ...");
-
-    // Prepare the path
-    CascStrPrintf(szParams, _countof(szParams), _T("%hs/%hs"), CASC_PATH_ROOT, StorInfo.szPath);
-
-    // Prepare the callbacks
-    OpenArgs.PfnProgressCallback = OnlineStorage_OpenCB;
-    OpenArgs.PtrProgressParam = &LogHelper;
-
-    // Enable or disable reusing VERSIONS and CDNS
-    if(strstr(StorInfo.szPath, "current") != NULL)
-        OpenArgs.dwFlags |= CASC_FEATURE_FORCE_DOWNLOAD;
+    // Allocate the arrays for all files
+    CascGetStorageInfo(Params.hStorage, CascStorageTotalFileCount, &dwMaxFiles, sizeof(DWORD), NULL);
+    pItems = CASC_ALLOC<CASC_BATCH_ITEM>(dwMaxFiles + 1);
+    EKeys = CASC_ALLOC<BYTE>((dwMaxFiles + 1) * MD5_HASH_SIZE);
+    Context.FileHashes = CASC_ALLOC<BYTE>((dwMaxFiles + 1) * MD5_HASH_SIZE);
+    if(pItems == NULL || EKeys == NULL || Context.FileHashes == NULL)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
 
-    // Open the online storage
-    if(CascOpenStorageEx(szParams, &OpenArgs, true, &hStorage))
+    // Read all local files one-by-one, in the order given by the ROOT file
+    if(dwErrCode == ERROR_SUCCESS)
     {
-        TEST_PARAMS Params;
-
-        // Check a specific file
-        if(StorInfo.szFileName != NULL)
+        LogHelper.PrintProgress("Reading files one-by-one ...");
+        LogHelper.SetStartTime();
+        hFind = CascFindFirstFile(Params.hStorage, "*", &cf, NULL);
+        if(hFind != INVALID_HANDLE_VALUE)
         {
-            CASC_FILE_FULL_INFO FileInfo = {0};
-            HANDLE hFile = NULL;
-            char szBuffer[MD5_STRING_SIZE + 1];
-            bool bSucceeded = false;
-
-            // Just get the file info
-            LogHelper.PrintProgress("Querying file \"%s\" ...", GetPlainFileName(StorInfo.szFileName));
-            if(CascOpenFile(hStorage, StorInfo.szFileName, 0, CASC_OPEN_BY_NAME, &hFile))
+            do
             {
-                if(CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
-                {
-                    LogHelper.PrintMessage("  File name:     %s", StorInfo.szFileName);
-                    LogHelper.PrintMessage("  File hash:     %s", GetHash(FileInfo.CKey, szBuffer));
-                    LogHelper.PrintMessage("  File size:     %08X", FileInfo.ContentSize);
-                    LogHelper.PrintMessage("  Locale flags:  %08X", FileInfo.LocaleFlags);
-                    LogHelper.PrintMessage("  Content flags: %08X", FileInfo.ContentFlags);
-                    bSucceeded = true;
-                }
+                // Only take files that are present locally
+                if(cf.bFileAvailable == 0 || dwFileCount >= dwMaxFiles)
+                    continue;
 
-                CascCloseFile(hFile);
-            }
+                if(CascOpenFile(Params.hStorage, cf.EKey, 0, CASC_OPEN_BY_EKEY, &hFile))
+                {
+                    ULONGLONG FileSize = 0;
+                    DWORD dwBytesRead = 0;
+                    MD5_CTX md5_ctx;
 
-            // Get error code on failure
-            if(bSucceeded == false)
-            {
-                dwErrCode = GetCascError();
-                LogHelper.PrintError("Failed to retrieve file information.", StorInfo.szFileName);
+                    CascGetFileSize64(hFile, &FileSize);
+                    if((pbFileData = CASC_ALLOC<BYTE>((size_t)FileSize + 1)) != NULL)
+                    {
+                        if(CascReadFile(hFile, pbFileData, (DWORD)FileSize, &dwBytesRead) && dwBytesRead == FileSize)
+                        {
+                            // Remember the file for the batch read
+                            memcpy(EKeys + (dwFileCount * MD5_HASH_SIZE), cf.EKey, MD5_HASH_SIZE);
+                            pItems[dwFileCount].pvFileName = EKeys + (dwFileCount * MD5_HASH_SIZE);
+                            pItems[dwFileCount].dwOpenFlags = CASC_OPEN_BY_EKEY;
+                            pItems[dwFileCount].pvUserData = (void *)(size_t)dwFileCount;
+
+                            MD5_Init(&md5_ctx);
+                            MD5_Update(&md5_ctx, pbFileData, dwBytesRead);
+                            MD5_Final(Context.FileHashes + (dwFileCount * MD5_HASH_SIZE), &md5_ctx);
+                            dwFileCount++;
+                        }
+                        CASC_FREE(pbFileData);
+                    }
+                    CascCloseFile(hFile);
+                }
             }
+            while(CascFindNextFile(hFind, &cf));
+            CascFindClose(hFind);
         }
-
-        // Configure the test parameters
-        Params.szExpectedNameHash = StorInfo.szNameHash;
-        Params.szExpectedDataHash = StorInfo.szDataHash;
-        Params.hStorage = hStorage;
-        Params.szFileName = NULL;
-        Params.bOnlineStorage = true;
-        dwErrCode = PfnRunTest(LogHelper, Params);
-        CascCloseStorage(hStorage);
+        dwTime = LogHelper.SetEndTime();
+        LogHelper.PrintMessage("One-by-one: %u files in %u.%03u second(s)", dwFileCount, (dwTime / 1000), (dwTime % 1000));
     }
-    else
+
+    // Read the same files by the batch
+    if(dwErrCode == ERROR_SUCCESS)
     {
-        LogHelper.PrintError("Error: Failed to open storage %s", StorInfo.szPath);
-        assert(GetCascError() != ERROR_SUCCESS);
-        dwErrCode = GetCascError();
-    }
+        LogHelper.PrintProgress("Reading files by batch ...");
+        LogHelper.SetStartTime();
+        if(!CascReadFilesBatch(Params.hStorage, pItems, dwFileCount, Storage_ReadBatchCB, &Context))
+            dwErrCode = GetCascError();
+        dwTime = LogHelper.SetEndTime();
+        LogHelper.PrintMessage("Batch:      %u files in %u.%03u second(s)", Context.dwFileCount, (dwTime / 1000), (dwTime % 1000));
+
+        // All files must have been read with the same data
+        if(Context.dwFileCount != dwFileCount || Context.dwErrorCount != 0 || Context.dwMismatchCount != 0)
+        {
+            LogHelper.PrintMessage("Error: %u files read, %u errors, %u mismatches", Context.dwFileCount, Context.dwErrorCount, Context.dwMismatchCount);
+            dwErrCode = ERROR_FILE_CORRUPT;
+        }
+    }
+
+    CASC_FREE(Context.FileHashes);
+    CASC_FREE(EKeys);
+    CASC_FREE(pItems);
+    return dwErrCode;
+}
+
+// Reading files by CascReadFileAsync: Size of one read request. On purpose not aligned to frames
+#define ASYNC_CHUNK_SIZE 0x18001
+
+// Context for the async read test
+struct READ_ASYNC_CONTEXT
+{
+    CASC_LOCK Lock;                 // Protects the members below
+    CASC_COND Cond;                 // Signalled when a read is complete
+    DWORD dwPending;                // Number of reads in progress
+    DWORD dwErrorCount;             // Number of reads that failed
+    ULONGLONG BytesRead;            // Total bytes read
+};
+
+static void WINAPI Storage_ReadAsyncCB(void * PtrUserParam, HANDLE /* hFile */, DWORD dwErrCode, DWORD dwBytesRead)
+{
+    READ_ASYNC_CONTEXT * pContext = (READ_ASYNC_CONTEXT *)PtrUserParam;
+
+    CascLock(pContext->Lock);
+    if(dwErrCode != ERROR_SUCCESS)
+        pContext->dwErrorCount++;
+    pContext->BytesRead += dwBytesRead;
+    pContext->dwPending--;
+    CascSignalCond(pContext->Cond);
+    CascUnlock(pContext->Lock);
+}
+
+// Reads all locally available files by CascReadFile and then by CascReadFileAsync
+// in chunks that are all submitted at once. Both must give the same data
+static DWORD Storage_ReadAsync(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    READ_ASYNC_CONTEXT Context;
+    CASC_FIND_DATA cf;
+    HANDLE hFind;
+    HANDLE hFile;
+    LPBYTE pbFileData1;
+    LPBYTE pbFileData2;
+    DWORD dwFileCount = 0;
+    DWORD dwMismatchCount = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    CascInitLock(Context.Lock);
+    CascInitCond(Context.Cond);
+    Context.dwPending = Context.dwErrorCount = 0;
+
+    LogHelper.PrintProgress("Reading files asynchronously ...");
+    hFind = CascFindFirstFile(Params.hStorage, "*", &cf, NULL);
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            // Only take files that are present locally
+            if(cf.bFileAvailable == 0)
+                continue;
+
+            if(CascOpenFile(Params.hStorage, cf.EKey, 0, CASC_OPEN_BY_EKEY, &hFile))
+            {
+                ULONGLONG FileSize = 0;
+                DWORD dwBytesRead = 0;
+
+                CascGetFileSize64(hFile, &FileSize);
+                pbFileData1 = CASC_ALLOC<BYTE>((size_t)FileSize + 1);
+                pbFileData2 = CASC_ALLOC<BYTE>((size_t)FileSize + 1);
+                if(pbFileData1 != NULL && pbFileData2 != NULL)
+                {
+                    if(CascReadFile(hFile, pbFileData1, (DWORD)FileSize, &dwBytesRead) && dwBytesRead == FileSize)
+                    {
+                        // Submit all chunks of the file at once
+                        Context.BytesRead = 0;
+                        for(ULONGLONG ByteOffset = 0; ByteOffset < FileSize; ByteOffset += ASYNC_CHUNK_SIZE)
+                        {
+                            CascLock(Context.Lock);
+                            Context.dwPending++;
+                            CascUnlock(Context.Lock);
+
+                            if(!CascReadFileAsync(hFile, ByteOffset, pbFileData2 + ByteOffset, ASYNC_CHUNK_SIZE, Storage_ReadAsyncCB, &Context))
+                            {
+                                CascLock(Context.Lock);
+                                Context.dwPending--;
+                                Context.dwErrorCount++;
+                                CascUnlock(Context.Lock);
+                            }
+                        }
+
+                        // Wait for all of them. The file must stay open until then
+                        CascLock(Context.Lock);
+                        while(Context.dwPending != 0)
+                            CascWaitCond(Context.Cond, Context.Lock);
+                        CascUnlock(Context.Lock);
+
+                        // Compare the data
+                        if(Context.BytesRead != FileSize || memcmp(pbFileData1, pbFileData2, (size_t)FileSize))
+                            dwMismatchCount++;
+                        dwFileCount++;
+                    }
+                }
+                CASC_FREE(pbFileData2);
+                CASC_FREE(pbFileData1);
+                CascCloseFile(hFile);
+            }
+        }
+        while(CascFindNextFile(hFind, &cf));
+        CascFindClose(hFind);
+    }
+
+    // All files must have been read with the same data
+    LogHelper.PrintMessage("Async: %u files read, %u errors, %u mismatches", dwFileCount, Context.dwErrorCount, dwMismatchCount);
+    if(Context.dwErrorCount != 0 || dwMismatchCount != 0)
+        dwErrCode = ERROR_FILE_CORRUPT;
+
+    CascFreeCond(Context.Cond);
+    CascFreeLock(Context.Lock);
+    return dwErrCode;
+}
+
+// Called by CascExtractFiles for every piece of every file, possibly from several threads at once.
+// Single-span files that come in one piece are checked against their CKey
+static bool WINAPI Storage_ExtractCB(void * PtrUserParam, const CASC_FIND_DATA * pFindData, DWORD dwErrCode, ULONGLONG ByteOffset, const void * pvFileData, DWORD cbFileData)
+{
+    DWORD * PtrMismatchCount = (DWORD *)PtrUserParam;
+    MD5_CTX md5_ctx;
+    BYTE md5_digest[MD5_HASH_SIZE];
+
+    if(dwErrCode == ERROR_SUCCESS && pvFileData != NULL && ByteOffset == 0 && cbFileData == pFindData->FileSize && pFindData->dwSpanCount == 1 && CascIsValidMD5((LPBYTE)pFindData->CKey))
+    {
+        MD5_Init(&md5_ctx);
+        MD5_Update(&md5_ctx, (void *)pvFileData, (unsigned long)cbFileData);
+        MD5_Final(md5_digest, &md5_ctx);
+
+        if(memcmp(md5_digest, pFindData->CKey, MD5_HASH_SIZE))
+            CascInterlockedIncrement(PtrMismatchCount);
+    }
+    return false;
+}
+
+// Reads all large files with and without CASC_PARALLEL_DECODE. Both must give the same data
+static DWORD Storage_ParallelDecode(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_FIND_DATA cf;
+    ULONGLONG TotalTime[2] = {0, 0};
+    HANDLE hFind;
+    HANDLE hFile;
+    LPBYTE pbFileData[2];
+    DWORD dwFileCount = 0;
+    DWORD dwMismatchCount = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    LogHelper.PrintProgress("Reading large files ...");
+    hFind = CascFindFirstFile(Params.hStorage, "*", &cf, NULL);
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            // Only take large files that are present locally
+            if(cf.bFileAvailable == 0 || cf.FileSize < 0x100000 || cf.FileSize > 0x40000000)
+                continue;
+
+            pbFileData[0] = CASC_ALLOC<BYTE>((size_t)cf.FileSize);
+            pbFileData[1] = CASC_ALLOC<BYTE>((size_t)cf.FileSize);
+            if(pbFileData[0] != NULL && pbFileData[1] != NULL)
+            {
+                // Read the file sequentially, then in parallel
+                for(DWORD i = 0; i < 2; i++)
+                {
+                    if(CascOpenFile(Params.hStorage, cf.EKey, 0, CASC_OPEN_BY_EKEY | (i ? CASC_PARALLEL_DECODE : 0), &hFile))
+                    {
+                        DWORD dwBytesRead = 0;
+
+                        LogHelper.SetStartTime();
+                        CascReadFile(hFile, pbFileData[i], (DWORD)cf.FileSize, &dwBytesRead);
+                        TotalTime[i] += LogHelper.SetEndTime();
+                        CascCloseFile(hFile);
+                    }
+                }
+
+                if(memcmp(pbFileData[0], pbFileData[1], (size_t)cf.FileSize))
+                    dwMismatchCount++;
+                dwFileCount++;
+            }
+            CASC_FREE(pbFileData[1]);
+            CASC_FREE(pbFileData[0]);
+        }
+        while(CascFindNextFile(hFind, &cf));
+        CascFindClose(hFind);
+    }
+
+    LogHelper.PrintMessage("Parallel decode: %u files, %u ms sequential, %u ms parallel, %u mismatches", dwFileCount, (DWORD)TotalTime[0], (DWORD)TotalTime[1], dwMismatchCount);
+    if(dwMismatchCount != 0)
+        dwErrCode = ERROR_FILE_CORRUPT;
+    return dwErrCode;
+}
+
+// Maximum size of the 'Z' frames collected for the inflate benchmark
+#define INFLATE_BENCHMARK_SIZE  0x4000000
+
+// The previous decompression: The zlib stream is created and freed for every frame
+static DWORD Inflate_PerFrame(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer)
+{
+    CASC_ZSTREAM z = {0};
+    DWORD dwErrCode = ERROR_FILE_CORRUPT;
+    int nResult;
+
+    z.next_in   = pbInBuffer;
+    z.avail_in  = cbInBuffer;
+    z.next_out  = pbOutBuffer;
+    z.avail_out = pcbOutBuffer[0];
+    pcbOutBuffer[0] = 0;
+
+    if(CascInflateInit(&z) == Z_OK)
+    {
+        nResult = CascInflate(&z, Z_NO_FLUSH);
+        if(nResult == Z_OK || nResult == Z_STREAM_END)
+        {
+            pcbOutBuffer[0] = (DWORD)z.total_out;
+            dwErrCode = ERROR_SUCCESS;
+        }
+        CascInflateEnd(&z);
+    }
+    return dwErrCode;
+}
+
+// Collects the 'Z' frames of the files present locally
+static DWORD Inflate_CollectFrames(HANDLE hStorage, CASC_ARRAY & Frames, CASC_BLOB & Encoded)
+{
+    CASC_FIND_DATA cf;
+    HANDLE hFind;
+    HANDLE hFile;
+    DWORD cbEncoded = 0;
+
+    hFind = CascFindFirstFile(hStorage, "*", &cf, NULL);
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(cf.bFileAvailable && CascOpenFile(hStorage, cf.EKey, 0, CASC_OPEN_BY_EKEY, &hFile))
+            {
+                TCascFile * hf = (TCascFile *)hFile;
+                BYTE Buffer[0x10];
+                DWORD dwBytesRead = 0;
+
+                // Reading the first bytes loads the frames of all spans
+                CascReadFile(hFile, Buffer, sizeof(Buffer), &dwBytesRead);
+                for(DWORD i = 0; i < hf->SpanCount; i++)
+                {
+                    PCASC_FILE_SPAN pFileSpan = hf->pFileSpan + i;
+
+                    for(DWORD j = 0; j < pFileSpan->FrameCount && pFileSpan->pStream != NULL; j++)
+                    {
+                        PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames + j;
+                        LPBYTE pbEncoded = Encoded.pbData + cbEncoded;
+
+                        if((cbEncoded + pFileFrame->EncodedSize) > Encoded.cbData)
+                            break;
+                        if(!FileStream_Read(pFileSpan->pStream, &pFileFrame->DataFileOffset, pbEncoded, pFileFrame->EncodedSize) || pbEncoded[0] != 'Z')
+                            continue;
+
+                        Frames.Insert(pFileFrame, 1);
+                        ((PCASC_FILE_FRAME)Frames.LastItem())->DataFileOffset = cbEncoded;
+                        cbEncoded += pFileFrame->EncodedSize;
+                    }
+                }
+                CascCloseFile(hFile);
+            }
+        }
+        while(CascFindNextFile(hFind, &cf) && (cbEncoded + 0x100000) < Encoded.cbData);
+        CascFindClose(hFind);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Decompresses real 'Z' frames by the previous per-frame zlib stream and by CascDecompress
+static DWORD Storage_InflateBenchmark(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_ARRAY Frames;
+    CASC_BLOB Encoded;
+    CASC_BLOB Decoded[2];
+    ULONGLONG TotalSize = 0;
+    DWORD dwMismatchCount = 0;
+    DWORD dwTime[2];
+    DWORD dwErrCode;
+
+    // Collect the frames
+    LogHelper.PrintProgress("Collecting compressed frames ...");
+    if((dwErrCode = Frames.Create<CASC_FILE_FRAME>(0x10000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = Encoded.SetSize(INFLATE_BENCHMARK_SIZE)) != ERROR_SUCCESS)
+        return dwErrCode;
+    Inflate_CollectFrames(Params.hStorage, Frames, Encoded);
+
+    // Allocate the output buffers for all frames
+    for(size_t i = 0; i < Frames.ItemCount(); i++)
+        TotalSize += ((PCASC_FILE_FRAME)Frames.ItemAt(i))->ContentSize;
+    if((dwErrCode = Decoded[0].SetSize((size_t)TotalSize)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = Decoded[1].SetSize((size_t)TotalSize)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Decompress all frames by both methods
+    for(DWORD i = 0; i < 2; i++)
+    {
+        LPBYTE pbDecoded = Decoded[i].pbData;
+
+        LogHelper.PrintProgress("Decompressing (%s) ...", (i == 0) ? "per-frame zlib" : "CascDecompress");
+        LogHelper.SetStartTime();
+        for(size_t j = 0; j < Frames.ItemCount(); j++)
+        {
+            PCASC_FILE_FRAME pFrame = (PCASC_FILE_FRAME)Frames.ItemAt(j);
+            LPBYTE pbEncoded = Encoded.pbData + (size_t)pFrame->DataFileOffset;
+            DWORD cbDecoded = pFrame->ContentSize;
+
+            if(i == 0)
+                Inflate_PerFrame(pbDecoded, &cbDecoded, pbEncoded + 1, pFrame->EncodedSize - 1);
+            else
+                CascDecompress(pbDecoded, &cbDecoded, pbEncoded + 1, pFrame->EncodedSize - 1);
+            pbDecoded += pFrame->ContentSize;
+        }
+        dwTime[i] = LogHelper.SetEndTime();
+    }
+
+    // Both methods must give the same data
+    if(memcmp(Decoded[0].pbData, Decoded[1].pbData, (size_t)TotalSize))
+        dwMismatchCount++;
+
+    LogHelper.PrintMessage("Inflate: %u frames, %u MB, %u ms per-frame zlib, %u ms CascDecompress%s",
+        (DWORD)Frames.ItemCount(),
+        (DWORD)(TotalSize / (1024 * 1024)),
+        dwTime[0],
+        dwTime[1],
+        dwMismatchCount ? " (data mismatch)" : "");
+    Frames.Free();
+    return (dwMismatchCount == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+// Extracts all files by CascExtractFiles with one thread and with one thread per CPU.
+// Both runs must extract the same data
+static DWORD Storage_Extract(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_EXTRACT_STATS Stats[2];
+    CASC_EXTRACT_ARGS Args = {sizeof(CASC_EXTRACT_ARGS)};
+    DWORD dwMismatchCount = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    Args.PfnCallback = Storage_ExtractCB;
+    Args.PtrUserParam = &dwMismatchCount;
+
+    for(DWORD i = 0; i < _countof(Stats); i++)
+    {
+        LogHelper.PrintProgress("Extracting files (%s) ...", (i == 0) ? "1 thread" : "all CPUs");
+        Args.dwThreadCount = (i == 0) ? 1 : 0;
+        if(!CascExtractFiles(Params.hStorage, &Args, &Stats[i]))
+            return GetCascError();
+
+        LogHelper.PrintMessage("Extract: %u threads, %u files (%u failed, %u skipped), %u MB/s, %u ms, %u steals",
+            Stats[i].dwThreadCount,
+            (DWORD)Stats[i].FilesExtracted,
+            (DWORD)Stats[i].FilesFailed,
+            (DWORD)Stats[i].FilesSkipped,
+            (DWORD)(Stats[i].BytesPerSecond / (1024 * 1024)),
+            (DWORD)Stats[i].ElapsedMs,
+            Stats[i].dwStealCount);
+    }
+
+    // Both runs must give the same results
+    if(dwMismatchCount != 0 || Stats[0].FilesExtracted != Stats[1].FilesExtracted || Stats[0].BytesExtracted != Stats[1].BytesExtracted)
+        dwErrCode = ERROR_FILE_CORRUPT;
+    return dwErrCode;
+}
+
+static bool WINAPI Storage_VerifyCB(void * PtrUserParam, const CASC_VERIFY_SPAN * pSpan)
+{
+    TLogHelper * PtrLogHelper = (TLogHelper *)PtrUserParam;
+
+    PtrLogHelper->PrintMessage("Problem %u: data.%03u, offset 0x%08X, size 0x%08X, frame %i (error %u)",
+        pSpan->dwProblem,
+        pSpan->ArchiveIndex,
+        pSpan->ArchiveOffs,
+        pSpan->EncodedSize,
+        (int)pSpan->FrameIndex,
+        pSpan->dwErrCode);
+    return false;
+}
+
+// Verifies the entire storage by CascVerifyStorage with one thread and with one thread per CPU.
+// Both runs must find the same problems. The second run also checks the content against the CKey
+static DWORD Storage_Verify(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_VERIFY_REPORT Report[2];
+    CASC_VERIFY_ARGS Args = {sizeof(CASC_VERIFY_ARGS)};
+
+    Args.PfnCallback = Storage_VerifyCB;
+    Args.PtrUserParam = &LogHelper;
+
+    for(DWORD i = 0; i < _countof(Report); i++)
+    {
+        LogHelper.PrintProgress("Verifying storage (%s) ...", (i == 0) ? "1 thread" : "all CPUs");
+        Args.dwThreadCount = (i == 0) ? 1 : 0;
+        Args.dwFlags = (i == 0) ? 0 : CASC_VERIFY_CONTENT;
+        if(!CascVerifyStorage(Params.hStorage, &Args, &Report[i]))
+            return GetCascError();
+
+        LogHelper.PrintMessage("Verify: %u threads, %u data files, %u spans (%u corrupt, %u missing, %u not decoded), %u MB/s, %u ms",
+            Report[i].dwThreadCount,
+            Report[i].dwSegmentCount,
+            (DWORD)Report[i].SpansVerified,
+            (DWORD)Report[i].SpansCorrupt,
+            (DWORD)Report[i].SpansMissing,
+            (DWORD)Report[i].SpansNotDecoded,
+            (DWORD)(Report[i].BytesPerSecond / (1024 * 1024)),
+            (DWORD)Report[i].ElapsedMs);
+    }
+
+    // The content check can only find more corrupt spans, never less
+    if(Report[0].SpansVerified != Report[1].SpansVerified || Report[0].SpansMissing != Report[1].SpansMissing || Report[0].SpansCorrupt > Report[1].SpansCorrupt)
+        return ERROR_FILE_CORRUPT;
+    return ERROR_SUCCESS;
+}
+
+// The previous lookup of CASC_MAP: Linear probing, with the key compared inside each object
+static void * Map_FindObject_Linear(CASC_MAP & Map, LPBYTE pbKey)
+{
+    void * pvObject;
+    size_t nHashIndex = ConvertBytesToInteger_4_LE(pbKey) & (Map.HashTableSize() - 1);
+
+    while((pvObject = Map.ItemAt(nHashIndex)) != NULL)
+    {
+        if(!memcmp(((PCASC_CKEY_ENTRY)pvObject)->CKey, pbKey, MD5_HASH_SIZE))
+            return pvObject;
+        nHashIndex = (nHashIndex + 1) & (Map.HashTableSize() - 1);
+    }
+    return NULL;
+}
+
+static void Map_PrintResult(TLogHelper & LogHelper, const char * szName, DWORD dwLookups, DWORD dwFound, DWORD dwTime)
+{
+    DWORD dwPerSecond = (dwTime != 0) ? (DWORD)(((ULONGLONG)dwLookups * 1000) / dwTime) : 0;
+
+    LogHelper.PrintMessage("%s %u lookups (%u found) in %u.%03u second(s), %u lookups/s", szName, dwLookups, dwFound, (dwTime / 1000), (dwTime % 1000), dwPerSecond);
+}
+
+// Compares the lookup throughput of the CKey map with WoW-sized number of entries
+static DWORD Map_Benchmark(TLogHelper & LogHelper, size_t nItemCount)
+{
+    PCASC_CKEY_ENTRY pCKeyEntries;
+    CASC_MAP CKeyMap;
+    LPBYTE pbMissingKeys;
+    void ** PtrKeys;
+    void ** PtrObjects;
+    DWORD dwFound;
+    DWORD dwTime;
+    DWORD dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+    // Allocate the entries and the lookup arrays
+    pCKeyEntries = new CASC_CKEY_ENTRY[nItemCount];
+    PtrKeys = CASC_ALLOC<void *>(nItemCount);
+    PtrObjects = CASC_ALLOC<void *>(nItemCount);
+    pbMissingKeys = CASC_ALLOC<BYTE>(nItemCount * MD5_HASH_SIZE);
+    if(PtrKeys != NULL && PtrObjects != NULL && pbMissingKeys != NULL)
+    {
+        // Always set random number generator to the same value
+        srand(0x12345678);
+
+        // Create the map the same way as the storage does
+        LogHelper.PrintProgress("Creating map with %u items ...", (DWORD)nItemCount);
+        dwErrCode = CKeyMap.Create(nItemCount, MD5_HASH_SIZE, FIELD_OFFSET(CASC_CKEY_ENTRY, CKey));
+        for(size_t i = 0; i < nItemCount && dwErrCode == ERROR_SUCCESS; i++)
+        {
+            for(size_t j = 0; j < MD5_HASH_SIZE; j++)
+                pCKeyEntries[i].CKey[j] = (BYTE)(rand() >> 4);
+            CKeyMap.InsertObject(&pCKeyEntries[i], pCKeyEntries[i].CKey);
+        }
+
+        // Look up the keys in random order
+        for(size_t i = 0; i < nItemCount; i++)
+            PtrKeys[i] = pCKeyEntries[(((size_t)rand() << 15) | rand()) % nItemCount].CKey;
+
+        // Phase 1: Linear probing, as the map did before
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            LogHelper.PrintProgress("Linear probing ...");
+            LogHelper.SetStartTime();
+            for(size_t i = dwFound = 0; i < nItemCount; i++)
+                dwFound += (Map_FindObject_Linear(CKeyMap, (LPBYTE)PtrKeys[i]) != NULL) ? 1 : 0;
+            dwTime = LogHelper.SetEndTime();
+            Map_PrintResult(LogHelper, "Linear:          ", (DWORD)nItemCount, dwFound, dwTime);
+        }
+
+        // Phase 2: Group probing, one key at a time
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            LogHelper.PrintProgress("Group probing ...");
+            LogHelper.SetStartTime();
+            for(size_t i = dwFound = 0; i < nItemCount; i++)
+                dwFound += (CKeyMap.FindObject(PtrKeys[i]) != NULL) ? 1 : 0;
+            dwTime = LogHelper.SetEndTime();
+            Map_PrintResult(LogHelper, "Group:           ", (DWORD)nItemCount, dwFound, dwTime);
+        }
+
+        // Phase 3: Group probing, batched lookups
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            LogHelper.PrintProgress("Batched group probing ...");
+            LogHelper.SetStartTime();
+            dwFound = (DWORD)CKeyMap.FindObjects(PtrKeys, PtrObjects, nItemCount);
+            dwTime = LogHelper.SetEndTime();
+            Map_PrintResult(LogHelper, "Batch:           ", (DWORD)nItemCount, dwFound, dwTime);
+        }
+
+        // Phase 4: Keys that are not in the map
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            for(size_t i = 0; i < nItemCount; i++)
+            {
+                memcpy(pbMissingKeys + i * MD5_HASH_SIZE, PtrKeys[i], MD5_HASH_SIZE);
+                pbMissingKeys[i * MD5_HASH_SIZE + MD5_HASH_SIZE - 1] ^= 0x5A;
+                PtrKeys[i] = pbMissingKeys + i * MD5_HASH_SIZE;
+            }
+
+            LogHelper.PrintProgress("Missing keys, linear probing ...");
+            LogHelper.SetStartTime();
+            for(size_t i = dwFound = 0; i < nItemCount; i++)
+                dwFound += (Map_FindObject_Linear(CKeyMap, (LPBYTE)PtrKeys[i]) != NULL) ? 1 : 0;
+            dwTime = LogHelper.SetEndTime();
+            Map_PrintResult(LogHelper, "Linear (missing):", (DWORD)nItemCount, dwFound, dwTime);
+
+            LogHelper.PrintProgress("Missing keys, group probing ...");
+            LogHelper.SetStartTime();
+            for(size_t i = dwFound = 0; i < nItemCount; i++)
+                dwFound += (CKeyMap.FindObject(PtrKeys[i]) != NULL) ? 1 : 0;
+            dwTime = LogHelper.SetEndTime();
+            Map_PrintResult(LogHelper, "Group (missing): ", (DWORD)nItemCount, dwFound, dwTime);
+        }
+    }
+
+    CASC_FREE(pbMissingKeys);
+    CASC_FREE(PtrObjects);
+    CASC_FREE(PtrKeys);
+    delete [] pCKeyEntries;
+    return dwErrCode;
+}
+
+// Verifies the SIMD implementations of Salsa20 against the scalar one
+static DWORD Salsa20_Test(TLogHelper & LogHelper)
+{
+    // Salsa20/20, 128-bit key, ECRYPT test vector set 1, vector 0
+    static const BYTE KeyStream[0x40] =
+    {
+        0x4D, 0xFA, 0x5E, 0x48, 0x1D, 0xA2, 0x3E, 0xA0, 0x9A, 0x31, 0x02, 0x20, 0x50, 0x85, 0x99, 0x36,
+        0xDA, 0x52, 0xFC, 0xEE, 0x21, 0x80, 0x05, 0x16, 0x4F, 0x26, 0x7C, 0xB6, 0x5F, 0x5C, 0xFD, 0x7F,
+        0x2B, 0x4F, 0x97, 0xE0, 0xFF, 0x16, 0x92, 0x4A, 0x52, 0xDF, 0x26, 0x95, 0x15, 0x11, 0x0A, 0x07,
+        0xF9, 0xE4, 0x60, 0xBC, 0x65, 0xEF, 0x95, 0xDA, 0x58, 0xF7, 0x40, 0xB7, 0xD1, 0xDB, 0xB0, 0xAA
+    };
+    static const char * szImplName[] = {"auto", "scalar", "SIMD4", "SIMD8"};
+    LPBYTE pbPlain;
+    LPBYTE pbExpected;
+    LPBYTE pbDecrypted;
+    BYTE Key[0x10] = {0x80};
+    BYTE Vector[0x08] = {0};
+    DWORD dwFailCount = 0;
+    DWORD dwTime;
+
+    pbPlain = CASC_ALLOC<BYTE>(0x1000000);
+    pbExpected = CASC_ALLOC<BYTE>(0x1000);
+    pbDecrypted = CASC_ALLOC<BYTE>(0x1000);
+    if(pbPlain == NULL || pbExpected == NULL || pbDecrypted == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    for(DWORD dwImpl = CASC_SALSA20_SCALAR; dwImpl <= CASC_SALSA20_SIMD8; dwImpl++)
+    {
+        // Known answer: The key stream of zero data
+        memset(pbPlain, 0, 0x1000000);
+        if(CascDecryptSalsa20(pbDecrypted, pbPlain, sizeof(KeyStream), Key, sizeof(Key), Vector, dwImpl) != ERROR_SUCCESS)
+        {
+            LogHelper.PrintMessage("Salsa20 (%s): Not supported by this CPU", szImplName[dwImpl]);
+            continue;
+        }
+        if(memcmp(pbDecrypted, KeyStream, sizeof(KeyStream)))
+        {
+            LogHelper.PrintMessage("Salsa20 (%s): Key stream mismatch", szImplName[dwImpl]);
+            dwFailCount++;
+        }
+
+        // Compare with the scalar implementation for all lengths, including partial groups and blocks
+        for(DWORD i = 0; i < 0x1000; i++)
+            pbPlain[i] = (BYTE)(i * 0x3F + 0x11);
+        for(DWORD cbData = 0; cbData < (0x1000 - 0x10); cbData++)
+        {
+            DWORD dwOffset = cbData & 0x0F;
+
+            Vector[0] = (BYTE)cbData;
+            CascDecryptSalsa20(pbExpected, pbPlain + dwOffset, cbData, Key, sizeof(Key), Vector, CASC_SALSA20_SCALAR);
+            CascDecryptSalsa20(pbDecrypted, pbPlain + dwOffset, cbData, Key, sizeof(Key), Vector, dwImpl);
+            if(memcmp(pbExpected, pbDecrypted, cbData))
+            {
+                LogHelper.PrintMessage("Salsa20 (%s): Data mismatch, length %u", szImplName[dwImpl], cbData);
+                dwFailCount++;
+                break;
+            }
+        }
+        Vector[0] = 0;
+
+        // Measure the speed
+        LogHelper.SetStartTime();
+        for(DWORD i = 0; i < 16; i++)
+            CascDecryptSalsa20(pbPlain, pbPlain, 0x1000000, Key, sizeof(Key), Vector, dwImpl);
+        dwTime = LogHelper.SetEndTime();
+        LogHelper.PrintMessage("Salsa20 (%s): 256 MB decrypted in %u ms", szImplName[dwImpl], dwTime);
+    }
+
+    CASC_FREE(pbDecrypted);
+    CASC_FREE(pbExpected);
+    CASC_FREE(pbPlain);
+    return (dwFailCount == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+// Verifies the multi-buffer MD5 against the scalar one and compares their speed
+static DWORD Md5Multi_Test(TLogHelper & LogHelper)
+{
+    const void * DataBlocks[CASC_HASH_BATCH_SIZE];
+    size_t BlockSizes[CASC_HASH_BATCH_SIZE];
+    LPBYTE pbData;
+    BYTE md5_hashes[CASC_HASH_BATCH_SIZE * MD5_HASH_SIZE];
+    BYTE md5_hash[MD5_HASH_SIZE];
+    DWORD dwFailCount = 0;
+    DWORD dwTime[2];
+
+    if((pbData = CASC_ALLOC<BYTE>(CASC_HASH_BATCH_SIZE * 0x10000)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    for(DWORD i = 0; i < CASC_HASH_BATCH_SIZE * 0x10000; i++)
+        pbData[i] = (BYTE)(i * 0x3F + (i >> 11));
+
+    // Any number of blocks, each block of different length, including all lengths of the padding
+    for(DWORD dwBlockCount = 0; dwBlockCount <= CASC_HASH_BATCH_SIZE; dwBlockCount++)
+    {
+        for(DWORD i = 0; i < dwBlockCount; i++)
+        {
+            DataBlocks[i] = pbData + i * 0x101;
+            BlockSizes[i] = (i & 1) ? ((dwBlockCount * 7 + i * 13) % 0x100) : ((dwBlockCount * 0x3001 + i * 0x1001) % 0x8000);
+        }
+
+        CascHash_MD5_Multi(DataBlocks, BlockSizes, md5_hashes, dwBlockCount);
+        for(DWORD i = 0; i < dwBlockCount; i++)
+        {
+            CascHash_MD5(DataBlocks[i], BlockSizes[i], md5_hash);
+            if(memcmp(md5_hash, md5_hashes + i * MD5_HASH_SIZE, MD5_HASH_SIZE))
+            {
+                LogHelper.PrintMessage("MD5 mismatch: %u blocks, block %u, length %u", dwBlockCount, i, (DWORD)BlockSizes[i]);
+                dwFailCount++;
+            }
+        }
+    }
+
+    // Measure the speed with 64 KB blocks, which is the usual frame size
+    for(DWORD i = 0; i < CASC_HASH_BATCH_SIZE; i++)
+    {
+        DataBlocks[i] = pbData + i * 0x10000;
+        BlockSizes[i] = 0x10000;
+    }
+
+    LogHelper.SetStartTime();
+    for(DWORD j = 0; j < 16; j++)
+    {
+        for(DWORD i = 0; i < CASC_HASH_BATCH_SIZE; i++)
+            CascHash_MD5(DataBlocks[i], BlockSizes[i], md5_hashes + i * MD5_HASH_SIZE);
+    }
+    dwTime[0] = LogHelper.SetEndTime();
+
+    LogHelper.SetStartTime();
+    for(DWORD j = 0; j < 16; j++)
+        CascHash_MD5_Multi(DataBlocks, BlockSizes, md5_hashes, CASC_HASH_BATCH_SIZE);
+    dwTime[1] = LogHelper.SetEndTime();
+
+    LogHelper.PrintMessage("MD5 of 64 MB: %u ms scalar, %u ms multi-buffer", dwTime[0], dwTime[1]);
+    CASC_FREE(pbData);
+    return (dwFailCount == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+// Generates a listfile of 2M WoW-like names and compares the batched file name hashing with CalcFileNameHash
+static DWORD NameHash_Test(TLogHelper & LogHelper)
+{
+    const char * szFolders[] = {"world/maps/azeroth/", "Interface/Icons/", "sound/music/ZoneMusic/", "character/bloodelf/female/", "World\\WMO\\Dungeon\\", ""};
+    const char * szExtensions[] = {".m2", ".blp", ".wmo", ".ogg", ".skin", ""};
+    const size_t nNameCount = 2000000;
+    ULONGLONG * NameHashes = NULL;
+    const char ** FileNames = NULL;
+    char * szListFile = NULL;
+    char * szNamePtr;
+    DWORD dwFailCount = 0;
+    DWORD dwTime[2];
+    DWORD dwSeed = 0x12345678;
+
+    // Allocate the listfile and the arrays
+    szListFile = CASC_ALLOC<char>(nNameCount * (MAX_PATH + 1));
+    FileNames = CASC_ALLOC<const char *>(nNameCount);
+    NameHashes = CASC_ALLOC<ULONGLONG>(nNameCount);
+    if(szListFile == NULL || FileNames == NULL || NameHashes == NULL)
+    {
+        CASC_FREE(NameHashes);
+        CASC_FREE(FileNames);
+        CASC_FREE(szListFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Generate the names. Every 1000th name has random length up to MAX_PATH,
+    // so there are empty names, names that are a multiple of 12 and cut names too
+    szNamePtr = szListFile;
+    for(size_t i = 0; i < nNameCount; i++)
+    {
+        size_t nLength = (i % 1000) ? (4 + i % 40) : (i / 1000) % (MAX_PATH + 2);
+
+        FileNames[i] = szNamePtr;
+        if(i % 1000)
+            szNamePtr += CascStrPrintf(szNamePtr, MAX_PATH, "%s", szFolders[i % _countof(szFolders)]);
+        for(size_t j = 0; j < nLength; j++)
+        {
+            dwSeed = dwSeed * 1103515245 + 12345;
+            *szNamePtr++ = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-/\\\xE4"[(dwSeed >> 16) % 67];
+        }
+        if(i % 1000)
+            szNamePtr += CascStrPrintf(szNamePtr, MAX_PATH, "%s", szExtensions[i % _countof(szExtensions)]);
+        *szNamePtr++ = 0;
+    }
+
+    // The batch must give exactly the same hashes
+    CalcFileNameHashes(FileNames, NameHashes, nNameCount);
+    for(size_t i = 0; i < nNameCount; i++)
+    {
+        if(NameHashes[i] != CalcFileNameHash(FileNames[i]))
+        {
+            if(dwFailCount++ < 10)
+                LogHelper.PrintMessage("Name hash mismatch: \"%s\"", FileNames[i]);
+        }
+    }
+
+    // Measure the speed
+    LogHelper.SetStartTime();
+    for(size_t i = 0; i < nNameCount; i++)
+        NameHashes[i] = CalcFileNameHash(FileNames[i]);
+    dwTime[0] = LogHelper.SetEndTime();
+
+    LogHelper.SetStartTime();
+    CalcFileNameHashes(FileNames, NameHashes, nNameCount);
+    dwTime[1] = LogHelper.SetEndTime();
+
+    LogHelper.PrintMessage("Hashing of %u names: %u ms scalar, %u ms batched (%u names/s)", (DWORD)nNameCount, dwTime[0], dwTime[1],
+                           (DWORD)((ULONGLONG)nNameCount * 1000 / CASCLIB_MAX(dwTime[1], 1)));
+    CASC_FREE(NameHashes);
+    CASC_FREE(FileNames);
+    CASC_FREE(szListFile);
+    return (dwFailCount == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+// Writes a listfile of 1M names with various line endings and patch suffixes into the work folder,
+// then checks that the (memory-mapped) listfile gives back the expected lines
+static DWORD ListFile_Test(TLogHelper & LogHelper)
+{
+    CASC_PATH<TCHAR> FilePath(_T(CASC_WORK_ROOT), _T("ListFileTest.txt"), NULL);
+    const char * szLineEnds[] = {"\n", "\r\n", "\x85"};
+    const size_t nNameCount = 1000000;
+    TFileStream * pStream;
+    const char * szLineBegin;
+    const char * szLineEnd;
+    size_t * NameLengths = NULL;
+    size_t nLength;
+    char * szListFile = NULL;
+    char * szNamePtr;
+    char * szName;
+    void * pvListFile;
+    DWORD dwFailCount = 0;
+    DWORD dwSeed = 0x12345678;
+    DWORD dwTime;
+
+    // Allocate the listfile
+    szListFile = CASC_ALLOC<char>(nNameCount * (MAX_PATH + 0x20));
+    NameLengths = CASC_ALLOC<size_t>(nNameCount);
+    if(szListFile == NULL || NameLengths == NULL)
+    {
+        CASC_FREE(NameLengths);
+        CASC_FREE(szListFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Generate the names. Some of them have the "~Patch" suffix, which is not part of the name,
+    // and some have "~" with another text, which stays in the name
+    szNamePtr = szListFile;
+    for(size_t i = 0; i < nNameCount; i++)
+    {
+        nLength = (i % 100) ? (4 + i % 60) : (1 + (i / 100) % MAX_PATH);
+
+        szName = szNamePtr;
+        for(size_t j = 0; j < nLength; j++)
+        {
+            dwSeed = dwSeed * 1103515245 + 12345;
+            *szNamePtr++ = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_./\\"[(dwSeed >> 16) % 66];
+        }
+        if((i % 7) == 3)
+            szNamePtr += CascStrPrintf(szNamePtr, 0x20, "~Temp");
+        NameLengths[i] = (size_t)(szNamePtr - szName);
+        if((i % 5) == 1)
+            szNamePtr += CascStrPrintf(szNamePtr, 0x20, "~Patch(Data#frFR,%u)", (DWORD)(i % 1000));
+        szNamePtr += CascStrPrintf(szNamePtr, 0x20, "%s", szLineEnds[i % _countof(szLineEnds)]);
+    }
+
+    // Write the listfile
+    if((pStream = FileStream_CreateFile(FilePath, 0)) == NULL)
+    {
+        CASC_FREE(NameLengths);
+        CASC_FREE(szListFile);
+        return GetCascError();
+    }
+    FileStream_Write(pStream, NULL, szListFile, (DWORD)(szNamePtr - szListFile));
+    FileStream_Close(pStream);
+
+    // Load the listfile and compare the lines
+    LogHelper.SetStartTime();
+    if((pvListFile = ListFile_OpenExternal(FilePath)) != NULL)
+    {
+        szNamePtr = szListFile;
+        for(size_t i = 0; i < nNameCount; i++)
+        {
+            nLength = ListFile_GetNextLine(pvListFile, &szLineBegin, &szLineEnd);
+            if(nLength != NameLengths[i] || memcmp(szLineBegin, szNamePtr, nLength))
+            {
+                if(dwFailCount++ < 10)
+                    LogHelper.PrintMessage("Listfile line mismatch: line %u", (DWORD)i);
+            }
+
+            // Move to the next name in the generated listfile
+            while(*szNamePtr != '\n' && *szNamePtr != '\r' && *szNamePtr != '\x85')
+                szNamePtr++;
+            szNamePtr += (szNamePtr[0] == '\r') ? 2 : 1;
+        }
+
+        // There must be no more lines
+        if(ListFile_GetNextLine(pvListFile, &szLineBegin, &szLineEnd) != 0)
+            dwFailCount++;
+        dwTime = LogHelper.SetEndTime();
+        ListFile_Free(pvListFile);
+
+        LogHelper.PrintMessage("Loading of %u listfile lines: %u ms (%u lines/s)", (DWORD)nNameCount, dwTime,
+                               (DWORD)((ULONGLONG)nNameCount * 1000 / CASCLIB_MAX(dwTime, 1)));
+    }
+    else
+    {
+        dwFailCount++;
+    }
+
+    CASC_FREE(NameLengths);
+    CASC_FREE(szListFile);
+    return (dwFailCount == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+#ifdef PLATFORM_STD_THREAD
+
+// In-process stand-in for a CDN server. It serves files from memory over HTTP/1.1,
+// keeping the connections open, so that the connection reuse of the client gets tested
+struct DOWNLOAD_SERVER
+{
+    SOCKET ListenSock;                          // Listening socket on 127.0.0.1
+    unsigned PortNum;                           // Port number assigned by the system
+    LPBYTE pbEKeys;                             // Names of the files (MD5 of their content)
+    LPBYTE * FileData;                          // Content of the files
+    DWORD * FileSizes;                          // Sizes of the files
+    size_t nFileCount;                          // Number of the files
+
+    std::thread ListenThread;                   // Thread accepting the connections
+    std::vector<std::thread> Threads;           // One thread for each accepted connection
+    std::vector<SOCKET> Connections;            // The accepted connections
+    CASC_LOCK Lock;                             // Lock for the members below
+    DWORD dwConnections;                        // Number of accepted connections
+    DWORD dwRequests;                           // Number of served requests
+    bool bStop;                                 // Set when the server is being stopped
+};
+
+static bool DownloadServer_Send(SOCKET sock, const void * pvData, size_t cbData)
+{
+    const char * pbData = (const char *)pvData;
+    int nSent;
+
+    while(cbData > 0)
+    {
+        if((nSent = send(sock, pbData, (int)CASCLIB_MIN(cbData, 0x10000), MSG_NOSIGNAL)) <= 0)
+            return false;
+        pbData += nSent;
+        cbData -= nSent;
+    }
+    return true;
+}
+
+// Finds the file by the name in the request line, e.g. "GET /tpr/test/data/c6/50/c650c203d52b9e5bdcf1d4b2b8b5bd16.index HTTP/1.1"
+static size_t DownloadServer_FindFile(DOWNLOAD_SERVER * pServer, const char * szRequest)
+{
+    const char * szUrlEnd = strstr(szRequest, " HTTP/");
+    const char * szName;
+    BYTE EKey[MD5_HASH_SIZE];
+
+    if(strncmp(szRequest, "GET /", 5) || szUrlEnd == NULL || (size_t)(szUrlEnd - szRequest) < 5 + MD5_STRING_SIZE + 6)
+        return CASC_INVALID_SIZE_T;
+    szName = szUrlEnd - (MD5_STRING_SIZE + 6);
+    if(strncmp(szName + MD5_STRING_SIZE, ".index", 6) || BinaryFromString(szName, MD5_STRING_SIZE, EKey) != ERROR_SUCCESS)
+        return CASC_INVALID_SIZE_T;
+
+    for(size_t i = 0; i < pServer->nFileCount; i++)
+    {
+        if(!memcmp(pServer->pbEKeys + i * MD5_HASH_SIZE, EKey, MD5_HASH_SIZE))
+            return i;
+    }
+    return CASC_INVALID_SIZE_T;
+}
+
+// Serves requests on one connection until the client closes it
+static void DownloadServer_Connection(DOWNLOAD_SERVER * pServer, SOCKET sock)
+{
+    char szRequest[0x400];
+    char szHeader[0x100];
+    char * szHeaderEnd;
+    size_t nLength = 0;
+    size_t nFile;
+    int nReceived;
+
+    for(;;)
+    {
+        // Receive the complete request header
+        szRequest[nLength] = 0;
+        while((szHeaderEnd = strstr(szRequest, "\r\n\r\n")) == NULL)
+        {
+            if(nLength + 1 >= sizeof(szRequest))
+                return;
+            if((nReceived = recv(sock, szRequest + nLength, (int)(sizeof(szRequest) - nLength - 1), 0)) <= 0)
+                return;
+            nLength += nReceived;
+            szRequest[nLength] = 0;
+        }
+
+        // Send the file, or report that it doesn't exist
+        if((nFile = DownloadServer_FindFile(pServer, szRequest)) != CASC_INVALID_SIZE_T)
+        {
+            CascStrPrintf(szHeader, _countof(szHeader), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\nConnection: Keep-Alive\r\n\r\n", pServer->FileSizes[nFile]);
+            if(!DownloadServer_Send(sock, szHeader, strlen(szHeader)) || !DownloadServer_Send(sock, pServer->FileData[nFile], pServer->FileSizes[nFile]))
+                return;
+        }
+        else
+        {
+            CascStrPrintf(szHeader, _countof(szHeader), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: Keep-Alive\r\n\r\n");
+            if(!DownloadServer_Send(sock, szHeader, strlen(szHeader)))
+                return;
+        }
+
+        CascLock(pServer->Lock);
+        pServer->dwRequests++;
+        CascUnlock(pServer->Lock);
+
+        // Keep whatever follows the request header
+        szHeaderEnd += 4;
+        nLength = nLength - (szHeaderEnd - szRequest);
+        memmove(szRequest, szHeaderEnd, nLength);
+    }
+}
+
+static void DownloadServer_Listen(DOWNLOAD_SERVER * pServer)
+{
+    SOCKET sock;
+
+    while((sock = accept(pServer->ListenSock, NULL, NULL)) != INVALID_SOCKET)
+    {
+        CascLock(pServer->Lock);
+        if(pServer->bStop)
+        {
+            CascUnlock(pServer->Lock);
+            closesocket(sock);
+            break;
+        }
+
+        pServer->Connections.push_back(sock);
+        pServer->Threads.emplace_back(&DownloadServer_Connection, pServer, sock);
+        pServer->dwConnections++;
+        CascUnlock(pServer->Lock);
+    }
+}
+
+static DWORD DownloadServer_Start(DOWNLOAD_SERVER * pServer)
+{
+    struct sockaddr_in ServerAddr;
+    socklen_t AddrLength = sizeof(ServerAddr);
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    WSADATA wsd;
+    WSAStartup(MAKEWORD(2, 2), &wsd);
+#endif
+
+    // Listen on a port that is assigned by the system
+    memset(&ServerAddr, 0, sizeof(ServerAddr));
+    ServerAddr.sin_family = AF_INET;
+    ServerAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if((pServer->ListenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET)
+        return ERROR_CAN_NOT_COMPLETE;
+    if(bind(pServer->ListenSock, (struct sockaddr *)&ServerAddr, sizeof(ServerAddr)) != 0 ||
+       listen(pServer->ListenSock, SOMAXCONN) != 0 ||
+       getsockname(pServer->ListenSock, (struct sockaddr *)&ServerAddr, &AddrLength) != 0)
+    {
+        closesocket(pServer->ListenSock);
+        return ERROR_CAN_NOT_COMPLETE;
+    }
+    pServer->PortNum = ntohs(ServerAddr.sin_port);
+
+    CascInitLock(pServer->Lock);
+    pServer->dwConnections = pServer->dwRequests = 0;
+    pServer->bStop = false;
+    pServer->ListenThread = std::thread(&DownloadServer_Listen, pServer);
+    return ERROR_SUCCESS;
+}
+
+static void DownloadServer_Stop(DOWNLOAD_SERVER * pServer)
+{
+    struct sockaddr_in ServerAddr;
+    SOCKET sock;
+
+    // Wake up the listening thread by a connection of our own
+    CascLock(pServer->Lock);
+    pServer->bStop = true;
+    CascUnlock(pServer->Lock);
+    if((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) != INVALID_SOCKET)
+    {
+        memset(&ServerAddr, 0, sizeof(ServerAddr));
+        ServerAddr.sin_family = AF_INET;
+        ServerAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ServerAddr.sin_port = htons((unsigned short)pServer->PortNum);
+        connect(sock, (struct sockaddr *)&ServerAddr, sizeof(ServerAddr));
+        closesocket(sock);
+    }
+    pServer->ListenThread.join();
+    closesocket(pServer->ListenSock);
+
+    // Connections still open by the client are shut down, so their threads finish
+    for(auto sock : pServer->Connections)
+        shutdown(sock, 2);
+    for(auto &thread : pServer->Threads)
+        thread.join();
+    for(auto sock : pServer->Connections)
+        closesocket(sock);
+    CascFreeLock(pServer->Lock);
+}
+
+// The downloaded files go to the temporary directory
+static void Download_GetLocalRoot(CASC_PATH<TCHAR> & LocalRoot)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    TCHAR szTempDir[MAX_PATH];
+
+    GetTempPath(_countof(szTempDir), szTempDir);
+    LocalRoot.Create(szTempDir, _T("CascDownloadTest"), NULL);
+#else
+    const char * szTempDir = getenv("TMPDIR");
+
+    LocalRoot.Create((szTempDir != NULL) ? szTempDir : "/tmp", "CascDownloadTest", NULL);
+#endif
+}
+
+// Downloads files from an in-process HTTP server, which stands in for the CDN.
+// The first server in the list doesn't exist, so each other file tests the failover.
+static DWORD Download_Test(TLogHelper & LogHelper, size_t nFileCount)
+{
+    DOWNLOAD_SERVER Server;
+    TCascStorage * hs;
+    CASC_PATH<TCHAR> LocalRoot;
+    CASC_BLOB FileData;
+    TCHAR szCdnServers[0x40];
+    DWORD dwThreadCount = 8;
+    DWORD dwVerified = 0;
+    DWORD dwTime;
+    DWORD dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+    // Prepare the files on the server. Their names are MD5 of their content
+    Server.nFileCount = nFileCount;
+    Server.pbEKeys = CASC_ALLOC<BYTE>(nFileCount * MD5_HASH_SIZE);
+    Server.FileData = CASC_ALLOC_ZERO<LPBYTE>(nFileCount);
+    Server.FileSizes = CASC_ALLOC<DWORD>(nFileCount);
+    if(Server.pbEKeys != NULL && Server.FileData != NULL && Server.FileSizes != NULL)
+    {
+        // Always set random number generator to the same value
+        srand(0x12345678);
+        Download_GetLocalRoot(LocalRoot);
+        dwErrCode = ERROR_SUCCESS;
+
+        LogHelper.PrintProgress("Creating %u files on the server ...", (DWORD)nFileCount);
+        for(size_t i = 0; i < nFileCount; i++)
+        {
+            Server.FileSizes[i] = (rand() % 0x40000) + 1;
+            if((Server.FileData[i] = CASC_ALLOC<BYTE>(Server.FileSizes[i])) == NULL)
+            {
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            for(DWORD j = 0; j < Server.FileSizes[i]; j++)
+                Server.FileData[i][j] = (BYTE)(rand() >> 4);
+            CascHash_MD5(Server.FileData[i], Server.FileSizes[i], Server.pbEKeys + i * MD5_HASH_SIZE);
+        }
+
+        // Start the server
+        if(dwErrCode == ERROR_SUCCESS && (dwErrCode = DownloadServer_Start(&Server)) == ERROR_SUCCESS)
+        {
+            // Setup an online storage that downloads from the local server
+            if((hs = new TCascStorage()) != NULL)
+            {
+                CascStrPrintf(szCdnServers, _countof(szCdnServers), _T("127.0.0.1:1 127.0.0.1:%u"), Server.PortNum);
+                hs->szRootPath = CascNewStr((LPCTSTR)LocalRoot);
+                hs->szCdnServers = CascNewStr(szCdnServers);
+                hs->szCdnPath = CascNewStr(_T("tpr/test"));
+                hs->dwFeatures = CASC_FEATURE_ONLINE;
+                hs->dwThreadCount = dwThreadCount;
+
+                // Online storages enable the socket cache when opened; TCascStorage::Release disables it
+                sockets_set_caching(true);
+
+                // Download all files
+                LogHelper.PrintProgress("Downloading ...");
+                LogHelper.SetStartTime();
+                dwErrCode = FetchCascFiles(hs, PathTypeData, Server.pbEKeys, nFileCount, _T(".index"), "Downloading");
+                dwTime = LogHelper.SetEndTime();
+                LogHelper.PrintMessage("Downloaded %u files in %u.%03u second(s)", (DWORD)nFileCount, (dwTime / 1000), (dwTime % 1000));
+
+                // Verify the downloaded files, then delete them
+                for(size_t i = 0; i < nFileCount && dwErrCode == ERROR_SUCCESS; i++)
+                {
+                    CASC_PATH<TCHAR> LocalPath(LocalRoot, _T("data"), NULL);
+
+                    LocalPath.AppendEKey(Server.pbEKeys + i * MD5_HASH_SIZE);
+                    LocalPath.AppendString(_T(".index"), false);
+                    if((dwErrCode = LoadFileToMemory(LocalPath, FileData)) == ERROR_SUCCESS)
+                    {
+                        if(CascVerifyDataBlockHash(FileData.pbData, FileData.cbData, Server.pbEKeys + i * MD5_HASH_SIZE))
+                            dwVerified++;
+                        FileData.Free();
+                    }
+                    _tremove(LocalPath);
+                }
+                LogHelper.PrintMessage("Verified %u of %u files", dwVerified, (DWORD)nFileCount);
+                if(dwErrCode == ERROR_SUCCESS && dwVerified != nFileCount)
+                    dwErrCode = ERROR_FILE_CORRUPT;
+                hs->Release();
+            }
+            else
+            {
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            }
+            DownloadServer_Stop(&Server);
+
+            // Each download thread should have kept one connection open for all its files
+            LogHelper.PrintMessage("Served %u requests over %u connection(s)", Server.dwRequests, Server.dwConnections);
+            if(dwErrCode == ERROR_SUCCESS && Server.dwConnections > dwThreadCount)
+                dwErrCode = ERROR_CAN_NOT_COMPLETE;
+        }
+    }
+
+    // Free the files of the server
+    for(size_t i = 0; Server.FileData != NULL && i < nFileCount; i++)
+        CASC_FREE(Server.FileData[i]);
+    CASC_FREE(Server.FileSizes);
+    CASC_FREE(Server.FileData);
+    CASC_FREE(Server.pbEKeys);
+    return dwErrCode;
+}
+#endif  // PLATFORM_STD_THREAD
+
+static DWORD LocalStorage_Test(PFN_RUN_TEST PfnRunTest, STORAGE_INFO & StorInfo)
+{
+    TLogHelper LogHelper(StorInfo.szPath);
+    HANDLE hStorage;
+    TCHAR szFullPath[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Prepare the full path of the storage
+    MakeFullPath(szFullPath, _countof(szFullPath), StorInfo.szPath);
+
+    // Open the CASC storage
+    LogHelper.PrintProgress("Opening storage ...");
+    if(CascOpenStorage(szFullPath, 0, &hStorage))
+    {
+        TEST_PARAMS Params;
+
+        // Configure the test parameters
+        Params.hStorage = hStorage;
+        Params.szExpectedNameHash = StorInfo.szNameHash;
+        Params.szExpectedDataHash = StorInfo.szDataHash;
+        Params.szFileName = StorInfo.szFileName;
+        dwErrCode = PfnRunTest(LogHelper, Params);
+    }
+    else
+    {
+        LogHelper.PrintError("Error: Failed to open storage %s", StorInfo.szPath);
+        assert(GetCascError() != ERROR_SUCCESS);
+        dwErrCode = GetCascError();
+    }
+
+    return dwErrCode;
+}
+
+static DWORD SpeedStorage_Test(PFN_RUN_TEST PfnRunTest, LPCSTR szStorage, LPCSTR szExpectedNameHash = NULL, LPCSTR szExpectedDataHash = NULL, LPCSTR szFileName = NULL)
+{
+    TLogHelper LogHelper(szStorage);
+    HANDLE hStorage;
+    TCHAR szFullPath[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    int nOpenCount = 100;
+
+    // Keep compiler happy
+    CASCLIB_UNUSED(PfnRunTest);
+    CASCLIB_UNUSED(szExpectedNameHash);
+    CASCLIB_UNUSED(szExpectedDataHash);
+    CASCLIB_UNUSED(szFileName);
+
+    // Prepare the full path of the storage
+    MakeFullPath(szFullPath, _countof(szFullPath), szStorage);
+
+    // Open the storage for the first time to load all files to the cache
+    LogHelper.PrintProgress("Opening storage (caching-in) ...");
+    if(CascOpenStorage(szFullPath, 0, &hStorage))
+    {
+        // Close right away
+        CascCloseStorage(hStorage);
+        hStorage = NULL;
+
+        // Set the start time of the operation
+        LogHelper.SetStartTime();
+
+        // Now open the storage again, many times in order to measure how fast can we load it
+        for(int i = 0; i < nOpenCount; i++)
+        {
+            LogHelper.PrintProgress("Opening storage (%u /%u) ...", i, nOpenCount);
+            if(!CascOpenStorage(szFullPath, 0, &hStorage))
+            {
+                LogHelper.PrintError("Error: Failed to open storage %s", szStorage);
+                break;
+            }
+
+            CascCloseStorage(hStorage);
+            hStorage = NULL;
+        }
+
+        // Print the total time
+        LogHelper.PrintTotalTime();
+    }
+    else
+    {
+        LogHelper.PrintError("Error: Failed to open storage %s", szStorage);
+        assert(GetCascError() != ERROR_SUCCESS);
+        dwErrCode = GetCascError();
+    }
+
+    return dwErrCode;
+}
+
+static bool WINAPI OnlineStorage_OpenCB(
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    LPCSTR szWork,                              // Text for the current activity (example: "Loading "ENCODING" file")
+    LPCSTR szObject,                            // (optional) name of the object tied to the activity (example: index file name)
+    DWORD,                                      // (optional) current object being processed
+    DWORD)                                      // (optional) If non-zero, this is the total number of objects to process
+{
+    TLogHelper * pLogHelper = (TLogHelper *)PtrUserParam;
+
+    if(pLogHelper != NULL)
+        pLogHelper->PrintProgress(szWork, szObject);
+    return false;
+}
+
+static DWORD OnlineStorage_Test(PFN_RUN_TEST PfnRunTest, STORAGE_INFO & StorInfo)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    TLogHelper LogHelper(StorInfo.szPath);
+    HANDLE hStorage;
+    TCHAR szParams[MAX_PATH+0x40];
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    LogHelper.PrintMessage("Root File: %s", StorInfo.szPath);
+    LogHelper.PrintProgress("Opening storage ...");
+
+    // Prepare the path
+    CascStrPrintf(szParams, _countof(szParams), _T("%hs/%hs"), CASC_PATH_ROOT, StorInfo.szPath);
+
+    // Prepare the callbacks
+    OpenArgs.PfnProgressCallback = OnlineStorage_OpenCB;
+    OpenArgs.PtrProgressParam = &LogHelper;
+
+    // Enable or disable reusing VERSIONS and CDNS
+    if(strstr(StorInfo.szPath, "current") != NULL)
+        OpenArgs.dwFlags |= CASC_FEATURE_FORCE_DOWNLOAD;
+
+    // Open the online storage
+    if(CascOpenStorageEx(szParams, &OpenArgs, true, &hStorage))
+    {
+        TEST_PARAMS Params;
+
+        // Check a specific file
+        if(StorInfo.szFileName != NULL)
+        {
+            CASC_FILE_FULL_INFO FileInfo = {0};
+            HANDLE hFile = NULL;
+            char szBuffer[MD5_STRING_SIZE + 1];
+            bool bSucceeded = false;
+
+            // Just get the file info
+            LogHelper.PrintProgress("Querying file \"%s\" ...", GetPlainFileName(StorInfo.szFileName));
+            if(CascOpenFile(hStorage, StorInfo.szFileName, 0, CASC_OPEN_BY_NAME, &hFile))
+            {
+                if(CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
+                {
+                    LogHelper.PrintMessage("  File name:     %s", StorInfo.szFileName);
+                    LogHelper.PrintMessage("  File hash:     %s", GetHash(FileInfo.CKey, szBuffer));
+                    LogHelper.PrintMessage("  File size:     %08X", FileInfo.ContentSize);
+                    LogHelper.PrintMessage("  Locale flags:  %08X", FileInfo.LocaleFlags);
+                    LogHelper.PrintMessage("  Content flags: %08X", FileInfo.ContentFlags);
+                    bSucceeded = true;
+                }
+
+                CascCloseFile(hFile);
+            }
+
+            // Get error code on failure
+            if(bSucceeded == false)
+            {
+                dwErrCode = GetCascError();
+                LogHelper.PrintError("Failed to retrieve file information.", StorInfo.szFileName);
+            }
+        }
+
+        // Configure the test parameters
+        Params.szExpectedNameHash = StorInfo.szNameHash;
+        Params.szExpectedDataHash = StorInfo.szDataHash;
+        Params.hStorage = hStorage;
+        Params.szFileName = NULL;
+        Params.bOnlineStorage = true;
+        dwErrCode = PfnRunTest(LogHelper, Params);
+        CascCloseStorage(hStorage);
+    }
+    else
+    {
+        LogHelper.PrintError("Error: Failed to open storage %s", StorInfo.szPath);
+        assert(GetCascError() != ERROR_SUCCESS);
+        dwErrCode = GetCascError();
+    }
 
     return dwErrCode;
 }
@@ -1179,6 +2808,23 @@ static bool WINAPI OnlineStorage_OpenCB_Simple(
 #define LOAD_STORAGES_CMD_LINE
 #define LOAD_STORAGES_LOCAL
 //#define LOAD_STORAGES_ONLINE
+//#define LOAD_STORAGES_BENCHMARK
+//#define LOAD_STORAGES_FRAME_CACHE
+//#define LOAD_STORAGES_SEEK_BENCHMARK
+//#define LOAD_STORAGES_PARALLEL_OPEN
+//#define LOAD_STORAGES_SNAPSHOT
+//#define LOAD_STORAGES_MAP_BENCHMARK
+//#define LOAD_STORAGES_DOWNLOAD
+//#define LOAD_STORAGES_READ_BATCH
+//#define LOAD_STORAGES_READ_ASYNC
+//#define LOAD_STORAGES_EXTRACT
+//#define LOAD_STORAGES_PARALLEL_DECODE
+//#define LOAD_STORAGES_INFLATE_BENCHMARK
+//#define LOAD_STORAGES_SALSA20
+//#define LOAD_STORAGES_MD5_MULTI
+//#define LOAD_STORAGES_NAME_HASH
+//#define LOAD_STORAGES_LISTFILE
+//#define LOAD_STORAGES_VERIFY
 
 int main(int argc, char * argv[])
 {
@@ -1241,6 +2887,224 @@ int main(int argc, char * argv[])
     }
 #endif
 
+#if defined(LOAD_STORAGES_BENCHMARK) && defined(PLATFORM_STD_THREAD)
+    //
+    // Run the read benchmarks for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_ReadScaling, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_SEEK_BENCHMARK
+    //
+    // Run the seek benchmark. Command line: CascLib_test <storage> <file name>
+    //
+    if(argc > 2)
+    {
+        STORAGE_INFO StorInfo = {argv[1], NULL, NULL, argv[2]};
+
+        dwErrCode = LocalStorage_Test(Storage_SeekBenchmark, StorInfo);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_FRAME_CACHE
+    //
+    // Run the frame cache test for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_FrameCache, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_PARALLEL_OPEN
+    //
+    // Compare single-threaded and multi-threaded opening for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_ParallelOpen, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_MAP_BENCHMARK
+    //
+    // Compare lookups in the map of CKeys. The number of items is about the size of WoW storage
+    //
+    {
+        TLogHelper LogHelper("MapBenchmark");
+
+        dwErrCode = Map_Benchmark(LogHelper, 3000000);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_SALSA20
+    //
+    // Verify the Salsa20 implementations with known answers and measure their speed
+    //
+    {
+        TLogHelper LogHelper("Salsa20Test");
+
+        dwErrCode = Salsa20_Test(LogHelper);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_MD5_MULTI
+    //
+    // Verify the multi-buffer MD5 and measure its speed
+    //
+    {
+        TLogHelper LogHelper("Md5MultiTest");
+
+        dwErrCode = Md5Multi_Test(LogHelper);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_NAME_HASH
+    //
+    // Verify the batched file name hashing and measure its speed
+    //
+    {
+        TLogHelper LogHelper("NameHashTest");
+
+        dwErrCode = NameHash_Test(LogHelper);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_LISTFILE
+    //
+    // Verify the lines of a listfile and measure the speed of loading it
+    //
+    {
+        TLogHelper LogHelper("ListFileTest");
+
+        dwErrCode = ListFile_Test(LogHelper);
+    }
+#endif
+
+#if defined(LOAD_STORAGES_DOWNLOAD) && defined(PLATFORM_STD_THREAD)
+    //
+    // Download files in parallel from an HTTP server running in this process
+    //
+    {
+        TLogHelper LogHelper("DownloadTest");
+
+        dwErrCode = Download_Test(LogHelper, 500);
+    }
+#endif
+
+#ifdef LOAD_STORAGES_SNAPSHOT
+    //
+    // Compare opening each storage entered on command line with and without a snapshot
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_Snapshot, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_READ_BATCH
+    //
+    // Compare reading files one-by-one and by batch for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_ReadBatch, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_READ_ASYNC
+    //
+    // Compare CascReadFile and CascReadFileAsync for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_ReadAsync, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_EXTRACT
+    //
+    // Extract all files by CascExtractFiles for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_Extract, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_PARALLEL_DECODE
+    //
+    // Compare reading large files with and without parallel decoding for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_ParallelDecode, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_INFLATE_BENCHMARK
+    //
+    // Compare decompression speed of real frames for each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_InflateBenchmark, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
+#ifdef LOAD_STORAGES_VERIFY
+    //
+    // Verify the integrity of each storage entered on command line
+    //
+    for(int i = 1; i < argc; i++)
+    {
+        STORAGE_INFO StorInfo = {argv[i]};
+
+        dwErrCode = LocalStorage_Test(Storage_Verify, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+#endif
+
 #ifdef LOAD_STORAGES_LOCAL
     //
     // Run the tests for every local storage in my collection
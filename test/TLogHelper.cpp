@@ -520,7 +520,10 @@ class TLogHelper
         //GetThreadTimes(GetCurrentThread(), (LPFILETIME)&TempTime, (LPFILETIME)&TempTime, (LPFILETIME)&KernelTime, (LPFILETIME)&UserTime);
         //return ((KernelTime + UserTime) / 10 / 1000);
 #else
-        return time(NULL) * 1000;
+        struct timespec TempTime;
+
+        clock_gettime(CLOCK_MONOTONIC, &TempTime);
+        return ((ULONGLONG)TempTime.tv_sec * 1000) + (TempTime.tv_nsec / 1000000);
 #endif
     }
 